@@ -18,3 +18,4 @@ group "core"
 group ""
 
 include "app/build-app.lua"
+include "tests/build-tests.lua"
@@ -33,9 +33,14 @@ project "app"
    targetdir ("../binaries/" .. OutputDir .. "/%{prj.name}")
    objdir ("../binaries/intermediates/" .. OutputDir .. "/%{prj.name}")
 
+   -- SPIR-V is not checked in: every shader is compiled into shaders/ before the app builds
    filter "system:windows"
        systemversion "latest"
        defines { "WINDOWS" }
+       prebuildcommands { "call \"%{wks.location}/scripts/shader_compiler.bat\"" }
+
+   filter "system:not windows"
+       prebuildcommands { "\"%{wks.location}/scripts/shader_compiler.sh\"" }
 
    filter "configurations:Debug"
        defines { "DEBUG" }
@@ -1 +0,0 @@
-C:/VulkanSDK/1.4.313.1/bin/slangc.exe shader.slang -target spirv -profile spirv_1_4 -emit-spirv-directly -fvk-use-entrypoint-name -entry vertMain -entry fragMain -o slang.spv
\ No newline at end of file
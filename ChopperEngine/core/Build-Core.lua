@@ -36,6 +36,13 @@ project "core"
        systemversion "latest"
        defines { }
 
+   -- SIMD kernels with AVX2 code paths, only called after a runtime CPU check
+   filter { "files:source/**_avx2.cc", "toolset:msc*" }
+       buildoptions { "/arch:AVX2" }
+
+   filter { "files:source/**_avx2.cc", "toolset:not msc*" }
+       buildoptions { "-mavx2", "-mfma" }
+
    filter "configurations:Debug"
        defines { "DEBUG" }
        runtime "Debug"
@@ -0,0 +1,146 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<uint64_t> total_allocations{0};
+    std::atomic<uint64_t> total_bytes{0};
+    thread_local uint64_t thread_allocations = 0;
+
+    void count(size_t size)
+    {
+        if constexpr (Chopper::AllocationCounter::enabled())
+        {
+            total_allocations.fetch_add(1, std::memory_order_relaxed);
+            total_bytes.fetch_add(size, std::memory_order_relaxed);
+            ++thread_allocations;
+        }
+    }
+}
+
+namespace Chopper::AllocationCounter
+{
+    uint64_t allocations() { return total_allocations.load(std::memory_order_relaxed); }
+    uint64_t allocatedBytes() { return total_bytes.load(std::memory_order_relaxed); }
+    uint64_t threadAllocations() { return thread_allocations; }
+
+    void* allocate(size_t size, void*)
+    {
+        count(size);
+        return std::malloc(size);
+    }
+
+    void release(void* block, void*)
+    {
+        std::free(block);
+    }
+}
+
+#if CHOPPER_COUNT_ALLOCATIONS
+
+namespace
+{
+    void* countedNew(size_t size)
+    {
+        if (size == 0) size = 1;
+        count(size);
+        if (void* block = std::malloc(size)) return block;
+        throw std::bad_alloc();
+    }
+
+    void* countedAlignedNew(size_t size, std::align_val_t alignment)
+    {
+        const auto align = static_cast<size_t>(alignment);
+        if (size == 0) size = 1;
+        count(size);
+#ifdef _MSC_VER
+        void* block = _aligned_malloc(size, align);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        void* block = std::aligned_alloc(align, (size + align - 1) & ~(align - 1));
+#endif
+        if (!block) throw std::bad_alloc();
+        return block;
+    }
+
+    void alignedFree(void* block)
+    {
+#ifdef _MSC_VER
+        _aligned_free(block);
+#else
+        std::free(block);
+#endif
+    }
+}
+
+void* operator new(size_t size) { return countedNew(size); }
+void* operator new[](size_t size) { return countedNew(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return countedNew(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return countedNew(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size, std::align_val_t alignment) { return countedAlignedNew(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAlignedNew(size, alignment); }
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return countedAlignedNew(size, alignment);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return countedAlignedNew(size, alignment);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void* block) noexcept { std::free(block); }
+void operator delete[](void* block) noexcept { std::free(block); }
+void operator delete(void* block, size_t) noexcept { std::free(block); }
+void operator delete[](void* block, size_t) noexcept { std::free(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { std::free(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { std::free(block); }
+void operator delete(void* block, std::align_val_t) noexcept { alignedFree(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { alignedFree(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept { alignedFree(block); }
+void operator delete[](void* block, size_t, std::align_val_t) noexcept { alignedFree(block); }
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(block); }
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(block); }
+
+#endif
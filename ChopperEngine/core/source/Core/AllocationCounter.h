@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Counting replaces the global operator new and delete; on by default in debug builds
+#ifndef CHOPPER_COUNT_ALLOCATIONS
+#ifdef NDEBUG
+#define CHOPPER_COUNT_ALLOCATIONS 0
+#else
+#define CHOPPER_COUNT_ALLOCATIONS 1
+#endif
+#endif
+
+namespace Chopper::AllocationCounter
+{
+    // False when counting is compiled out; the counters then stay at zero
+    constexpr bool enabled() { return CHOPPER_COUNT_ALLOCATIONS != 0; }
+
+    // Heap allocations since startup through operator new and allocate(), on every thread
+    uint64_t allocations();
+    uint64_t allocatedBytes();
+    // The same, made by the calling thread
+    uint64_t threadAllocations();
+
+    // Counted malloc/free, for libraries with their own allocator hooks (ImGui)
+    void* allocate(size_t size, void* userData = nullptr);
+    void release(void* block, void* userData = nullptr);
+}
@@ -9,6 +9,7 @@ void Camera::setupFrustum(float left, float right, float bottom, float top, floa
     proj_ = glm::frustum(left, right, bottom, top, znear, zfar);
     znear_ = znear;
     zfar_ = zfar;
+    updateFrustumPlanes();
 }
 
 void Camera::setupPerspective(float fovy, float aspect, float znear, float zfar)
@@ -18,8 +19,23 @@ void Camera::setupPerspective(float fovy, float aspect, float znear, float zfar)
     znear_ = znear;
     zfar_ = zfar;
 
-    proj_ = glm::perspective(fovy_, aspect_, znear_, zfar_);
+    if (reversed_z_)
+    {
+        // Depth is znear / distance: the float exponent keeps its precision all the way out,
+        // where standard depth bunches up next to 1. zfar is not used.
+        const float focal = 1.0f / glm::tan(fovy_ * 0.5f);
+        proj_ = glm::mat4(0.0f);
+        proj_[0][0] = focal / aspect_;
+        proj_[1][1] = focal;
+        proj_[2][3] = -1.0f;
+        proj_[3][2] = znear_;
+    }
+    else
+    {
+        proj_ = glm::perspective(fovy_, aspect_, znear_, zfar_);
+    }
     proj_[1][1] *= -1;
+    updateFrustumPlanes();
 }
 
 void Camera::setupOrtho(float left, float right, float bottom, float top, float znear, float zfar)
@@ -28,6 +44,7 @@ void Camera::setupOrtho(float left, float right, float bottom, float top, float
     proj_[1][1] *= -1; // Vulkan fix
     znear_ = znear;
     zfar_ = zfar;
+    updateFrustumPlanes();
 }
 
 void Camera::update(const double dt)
@@ -124,6 +141,7 @@ void Camera::update(const double dt)
 
     // Update view matrix
     view_ = glm::lookAt(pos_, pos_ + dir_, up_);
+    updateFrustumPlanes();
 }
 
 
@@ -183,6 +201,7 @@ void Camera::init(GLFWwindow* window, float const width, float const height)
 
     // Update view matrix
     view_ = glm::lookAt(pos_, pos_ + dir_, up_);
+    updateFrustumPlanes();
 }
 
 float Camera::getFov() const
@@ -190,6 +209,11 @@ float Camera::getFov() const
     return glm::degrees(fovy_);
 }
 
+float Camera::getNear() const
+{
+    return znear_;
+}
+
 void Camera::setFov(float const fov)
 {
     fovy_ = glm::radians(fov);
@@ -204,6 +228,20 @@ void Camera::setPerspective(bool type)
     }
 }
 
+void Camera::setReversedZ(bool reversed)
+{
+    reversed_z_ = reversed;
+    if (is_perspective)
+    {
+        setupPerspective(fovy_, aspect_, znear_, zfar_);
+    }
+}
+
+bool Camera::reversedZ() const
+{
+    return reversed_z_;
+}
+
 glm::mat4 Camera::getView()
 {
     return view_;
@@ -213,3 +251,29 @@ glm::mat4 Camera::getProj()
 {
     return proj_;
 }
+
+glm::mat4 Camera::getForwardZProj() const
+{
+    if (!reversed_z_ || !is_perspective) return proj_;
+
+    glm::mat4 proj = glm::infinitePerspective(fovy_, aspect_, znear_);
+    proj[1][1] *= -1;
+    return proj;
+}
+
+const Chopper::FrustumPlanes& Camera::getFrustumPlanes() const
+{
+    return frustum_planes_;
+}
+
+glm::mat4 Camera::jitterProjection(const glm::mat4& proj, const glm::vec2& offset, const glm::vec2& resolution)
+{
+    // Applied after the projection, so it moves every point by the same amount in NDC
+    const glm::vec2 ndcOffset = 2.0f * offset / resolution;
+    return glm::translate(glm::mat4(1.0f), glm::vec3(ndcOffset, 0.0f)) * proj;
+}
+
+void Camera::updateFrustumPlanes()
+{
+    frustum_planes_ = Chopper::extractFrustumPlanes(proj_ * view_);
+}
@@ -9,6 +9,8 @@
 #include <imgui/imgui.h>
 #include "GLFW/glfw3.h"
 
+#include "FrustumCulling.h"
+
 class Camera
 {
     
@@ -51,14 +53,29 @@ public:
     glm::vec3 getPosition();
     glm::vec3 getDirection();
     float getFov() const;
+    float getNear() const;
     void setFov(float fov);
     // type true = perspective, false = ortho
     void setPerspective(bool type);
+    // Perspective with reversed depth (1 at the near plane, 0 at infinity) and no far plane;
+    // depth tests compare with greater and clear to 0
+    void setReversedZ(bool reversed);
+    bool reversedZ() const;
 
     glm::mat4 getView();
     glm::mat4 getProj();
+    // getProj() with conventional depth (0 at the near plane, growing with distance), for code
+    // that assumes it, such as the CPU occlusion rasterizer. Still without a far plane when
+    // reversed-Z is on.
+    glm::mat4 getForwardZProj() const;
+    // World-space planes of proj_ * view_, refreshed whenever either changes
+    const Chopper::FrustumPlanes& getFrustumPlanes() const;
+    // proj shifted by a sub-pixel offset, in pixels of a target of `resolution`, for temporal
+    // accumulation. Culling keeps the unjittered matrix.
+    static glm::mat4 jitterProjection(const glm::mat4& proj, const glm::vec2& offset, const glm::vec2& resolution);
 
 private:
+    void updateFrustumPlanes();
     
     GLFWwindow* window_ = nullptr;
 
@@ -71,6 +88,7 @@ private:
 
     glm::mat4 view_{};
     glm::mat4 proj_{};
+    Chopper::FrustumPlanes frustum_planes_{};
 
     float fovy_   = glm::radians(45.0f);
     float aspect_ = 1920.0f / 1080.0f;
@@ -86,5 +104,6 @@ private:
     float pitch_ = 0.0f;
 
     bool is_perspective = true;
+    bool reversed_z_ = false;
     
 };
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "FrustumCulling.h"
+
+namespace Chopper
+{
+    // Camera state at the moment input was sampled
+    struct CameraSample
+    {
+        glm::mat4 view{1.0f};
+        glm::mat4 proj{1.0f};
+        FrustumPlanes planes{};
+        std::chrono::steady_clock::time_point sampledAt{};
+    };
+
+    // Latest camera sample, published by the input thread whenever it samples and read by the
+    // render thread right before it submits a frame. Only the newest sample is kept.
+    class CameraLatch
+    {
+    public:
+        void publish(const CameraSample& sample)
+        {
+            std::lock_guard lock(mutex_);
+            sample_ = sample;
+        }
+
+        CameraSample latest() const
+        {
+            std::lock_guard lock(mutex_);
+            return sample_;
+        }
+
+    private:
+        mutable std::mutex mutex_;
+        CameraSample sample_;
+    };
+
+    // How far the latched camera may drift from the camera CPU culling used. Culling pads its
+    // frustum by this much (padLatchFrustum()); a sample that drifted further is not latched,
+    // since objects the padding missed would pop in at the screen's edges.
+    static constexpr float LATCH_MAX_TRANSLATION = 0.25f;
+    static constexpr float LATCH_MAX_ANGLE = glm::radians(5.0f);
+
+    // Planes of a perspective frustum that contains the frustum of every camera with the same
+    // projection, up to `maxTranslation` away and turned by at most `maxAngle` radians. The
+    // sides are turned outwards about the eye, the near plane moves to the eye and the far
+    // plane, if any, is dropped.
+    inline FrustumPlanes padLatchFrustum(const glm::mat4& view, const glm::mat4& proj, float maxTranslation,
+                                         float maxAngle)
+    {
+        const glm::mat3 rotation(view);
+        const glm::vec3 eye = -(glm::transpose(rotation) * glm::vec3(view[3]));
+        const glm::vec3 forward = -glm::vec3(view[0][2], view[1][2], view[2][2]);
+
+        FrustumPlanes planes = extractFrustumPlanes(proj * view);
+        for (size_t i = 0; i < planes.size(); ++i)
+        {
+            const glm::vec3 normal(planes[i]);
+            if (i >= 4)
+            {
+                // Near or far, in either order depending on the depth convention
+                planes[i] = glm::dot(normal, forward) > 0.5f
+                                ? glm::vec4(forward, maxTranslation - glm::dot(forward, eye))
+                                : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+                continue;
+            }
+
+            // A side plane passes through the eye; lean its normal towards the view direction
+            const glm::vec3 lean = forward - glm::dot(forward, normal) * normal;
+            const glm::vec3 widened = glm::normalize(std::cos(maxAngle) * normal +
+                                                     std::sin(maxAngle) * glm::normalize(lean));
+            planes[i] = glm::vec4(widened, maxTranslation - glm::dot(widened, eye));
+        }
+        return planes;
+    }
+
+    // True when `latched` may be drawn in place of `culled` without leaving padLatchFrustum():
+    // the same projection, an eye at most `maxTranslation` away and a view turned by at most
+    // `maxAngle` radians
+    inline bool withinLatchBudget(const CameraSample& culled, const CameraSample& latched, float maxTranslation,
+                                  float maxAngle)
+    {
+        if (culled.proj != latched.proj) return false;
+
+        const glm::mat3 culledRotation(culled.view);
+        const glm::mat3 latchedRotation(latched.view);
+        const glm::vec3 culledEye = -(glm::transpose(culledRotation) * glm::vec3(culled.view[3]));
+        const glm::vec3 latchedEye = -(glm::transpose(latchedRotation) * glm::vec3(latched.view[3]));
+        if (glm::length(latchedEye - culledEye) > maxTranslation) return false;
+
+        // Angle of the relative rotation, from its trace
+        const glm::mat3 relative = latchedRotation * glm::transpose(culledRotation);
+        const float cosAngle = (relative[0][0] + relative[1][1] + relative[2][2] - 1.0f) * 0.5f;
+        return cosAngle >= std::cos(maxAngle);
+    }
+}
@@ -0,0 +1,296 @@
+#include "CascadedShadows.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace Chopper
+{
+    namespace
+    {
+        // Matches ShadowUniforms in shader.slang (std140)
+        struct ShadowUniforms
+        {
+            glm::mat4 cascadeViewProj[SHADOW_CASCADES];
+            // View distance where each cascade ends
+            glm::vec4 cascadeSplits;
+            // World-space size of a shadow map texel, per cascade
+            glm::vec4 cascadeTexels;
+            // Unit vector towards the sun, w unused
+            glm::vec4 toSun;
+            // Color times intensity, w unused
+            glm::vec4 sunColor;
+            uint32_t sunEnabled;
+            uint32_t shadowsEnabled;
+        };
+    }
+
+    VkImage CascadedShadows::createArray(VkImageUsageFlags usage, const char* name, VmaAllocation& allocation) const
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = static_cast<VkFormat>(FORMAT);
+        imageInfo.extent = {MAP_SIZE, MAP_SIZE, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = SHADOW_CASCADES;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        VkImage image = VK_NULL_HANDLE;
+        if (memory_->createImage(imageInfo, allocInfo, MemoryCategory::RenderTargets, name, image, allocation) !=
+            VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create shadow map!");
+        }
+        return image;
+    }
+
+    vk::raii::ImageView CascadedShadows::createView(VkImage image, vk::ImageViewType type, uint32_t firstLayer,
+                                                    uint32_t layerCount) const
+    {
+        vk::ImageViewCreateInfo viewInfo{};
+        viewInfo.image = image;
+        viewInfo.viewType = type;
+        viewInfo.format = FORMAT;
+        viewInfo.subresourceRange = {vk::ImageAspectFlagBits::eDepth, 0, 1, firstLayer, layerCount};
+        return vk::raii::ImageView(*device_, viewInfo);
+    }
+
+    void CascadedShadows::init(const vk::raii::Device& device, GpuMemory& memory, uint32_t framesInFlight)
+    {
+        device_ = &device;
+        memory_ = &memory;
+
+        map_ = createArray(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, "Shadow map", map_allocation_);
+        pages_ = createArray(VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "Static shadow pages", pages_allocation_);
+        map_view_ = createView(map_, vk::ImageViewType::e2DArray, 0, SHADOW_CASCADES);
+        for (uint32_t i = 0; i < SHADOW_CASCADES; ++i)
+        {
+            map_layer_views_[i] = createView(map_, vk::ImageViewType::e2D, i, 1);
+            page_views_[i] = createView(pages_, vk::ImageViewType::e2D, i, 1);
+        }
+
+        // Hardware 2x2 PCF; outside the map everything is lit
+        vk::SamplerCreateInfo samplerInfo{};
+        samplerInfo.magFilter = vk::Filter::eLinear;
+        samplerInfo.minFilter = vk::Filter::eLinear;
+        samplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+        samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToBorder;
+        samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToBorder;
+        samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToBorder;
+        samplerInfo.borderColor = vk::BorderColor::eFloatOpaqueWhite;
+        samplerInfo.compareEnable = vk::True;
+        samplerInfo.compareOp = vk::CompareOp::eLessOrEqual;
+        sampler_ = vk::raii::Sampler(device, samplerInfo);
+
+        frames_.resize(framesInFlight);
+        for (FrameBuffers& frame : frames_)
+        {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = sizeof(ShadowUniforms);
+            bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VmaAllocationCreateInfo allocInfo{};
+            allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+            allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            VmaAllocationInfo details{};
+            if (memory_->createBuffer(bufferInfo, allocInfo, MemoryCategory::Other, "Shadow uniforms",
+                                      frame.uniforms, frame.uniformsAllocation, &details) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create shadow uniform buffer!");
+            }
+            frame.uniformsMapped = details.pMappedData;
+        }
+
+        page_drawn_.fill(false);
+        map_initialized_ = false;
+        map_drawn_ = false;
+    }
+
+    void CascadedShadows::destroy()
+    {
+        for (FrameBuffers& frame : frames_)
+        {
+            memory_->destroyBuffer(frame.uniforms, frame.uniformsAllocation);
+        }
+        frames_.clear();
+        sampler_ = nullptr;
+        map_view_ = nullptr;
+        for (uint32_t i = 0; i < SHADOW_CASCADES; ++i)
+        {
+            map_layer_views_[i] = nullptr;
+            page_views_[i] = nullptr;
+        }
+        if (map_ != VK_NULL_HANDLE) memory_->destroyImage(map_, map_allocation_);
+        if (pages_ != VK_NULL_HANDLE) memory_->destroyImage(pages_, pages_allocation_);
+        map_ = VK_NULL_HANDLE;
+        pages_ = VK_NULL_HANDLE;
+    }
+
+    void CascadedShadows::updateUniforms(uint32_t frame, const std::array<ShadowCascade, SHADOW_CASCADES>& cascades,
+                                         const glm::vec3& toSun, const glm::vec3& sunColor, bool shadows)
+    {
+        ShadowUniforms uniforms{};
+        for (uint32_t i = 0; i < SHADOW_CASCADES; ++i)
+        {
+            uniforms.cascadeViewProj[i] = cascades[i].viewProj;
+            uniforms.cascadeSplits[i] = cascades[i].splitFar;
+            uniforms.cascadeTexels[i] = cascades[i].texelSize;
+        }
+        uniforms.toSun = glm::vec4(toSun, 0.0f);
+        uniforms.sunColor = glm::vec4(sunColor, 0.0f);
+        uniforms.sunEnabled = glm::any(glm::greaterThan(sunColor, glm::vec3(0.0f))) ? 1u : 0u;
+        uniforms.shadowsEnabled = shadows ? 1u : 0u;
+
+        FrameBuffers& buffers = frames_[frame];
+        std::memcpy(buffers.uniformsMapped, &uniforms, sizeof(uniforms));
+        vmaFlushAllocation(memory_->allocator(), buffers.uniformsAllocation, 0, sizeof(uniforms));
+        static_pages_drawn_ = 0;
+    }
+
+    void CascadedShadows::layerBarrier(const vk::raii::CommandBuffer& cmd, VkImage image, uint32_t layer,
+                                       uint32_t layerCount, vk::PipelineStageFlags2 srcStage,
+                                       vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStage,
+                                       vk::AccessFlags2 dstAccess, vk::ImageLayout oldLayout,
+                                       vk::ImageLayout newLayout)
+    {
+        vk::ImageMemoryBarrier2 barrier{};
+        barrier.srcStageMask = srcStage;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = dstStage;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {vk::ImageAspectFlagBits::eDepth, 0, 1, layer, layerCount};
+
+        vk::DependencyInfo info{};
+        info.imageMemoryBarrierCount = 1;
+        info.pImageMemoryBarriers = &barrier;
+        cmd.pipelineBarrier2(info);
+    }
+
+    void CascadedShadows::beginRendering(const vk::raii::CommandBuffer& cmd, vk::ImageView view,
+                                         vk::AttachmentLoadOp loadOp) const
+    {
+        vk::RenderingAttachmentInfo depthAttachment{};
+        depthAttachment.imageView = view;
+        depthAttachment.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal;
+        depthAttachment.loadOp = loadOp;
+        depthAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+        depthAttachment.clearValue = vk::ClearDepthStencilValue(1.0f, 0);
+
+        vk::RenderingInfo renderingInfo{};
+        renderingInfo.renderArea = vk::Rect2D({0, 0}, {MAP_SIZE, MAP_SIZE});
+        renderingInfo.layerCount = 1;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        cmd.beginRendering(renderingInfo);
+        cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(MAP_SIZE), static_cast<float>(MAP_SIZE),
+                                        0.0f, 1.0f));
+        cmd.setScissor(0, vk::Rect2D({0, 0}, {MAP_SIZE, MAP_SIZE}));
+    }
+
+    void CascadedShadows::beginStaticPage(const vk::raii::CommandBuffer& cmd, uint32_t cascade)
+    {
+        // Earlier copies out of the page must finish before it is cleared
+        layerBarrier(cmd, pages_, cascade, 1, vk::PipelineStageFlagBits2::eTransfer, {},
+                     vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                     vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+                     vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                     vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthAttachmentOptimal);
+        beginRendering(cmd, *page_views_[cascade], vk::AttachmentLoadOp::eClear);
+        page_drawn_[cascade] = true;
+        ++static_pages_drawn_;
+    }
+
+    void CascadedShadows::endStaticPage(const vk::raii::CommandBuffer& cmd, uint32_t cascade)
+    {
+        cmd.endRendering();
+        // The page stays in TRANSFER_SRC between redraws
+        layerBarrier(cmd, pages_, cascade, 1, vk::PipelineStageFlagBits2::eLateFragmentTests,
+                     vk::AccessFlagBits2::eDepthStencilAttachmentWrite, vk::PipelineStageFlagBits2::eTransfer,
+                     vk::AccessFlagBits2::eTransferRead, vk::ImageLayout::eDepthAttachmentOptimal,
+                     vk::ImageLayout::eTransferSrcOptimal);
+    }
+
+    void CascadedShadows::beginCascade(const vk::raii::CommandBuffer& cmd, uint32_t cascade)
+    {
+        const auto fragmentTests = vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+            vk::PipelineStageFlagBits2::eLateFragmentTests;
+        const auto attachmentAccess = vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+            vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+        map_drawn_ = true;
+        // Earlier frames' scene passes must be done sampling the layer before it is overwritten
+        if (!page_drawn_[cascade])
+        {
+            layerBarrier(cmd, map_, cascade, 1, vk::PipelineStageFlagBits2::eFragmentShader, {}, fragmentTests,
+                         attachmentAccess, vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthAttachmentOptimal);
+            beginRendering(cmd, *map_layer_views_[cascade], vk::AttachmentLoadOp::eClear);
+            return;
+        }
+
+        layerBarrier(cmd, map_, cascade, 1, vk::PipelineStageFlagBits2::eFragmentShader, {},
+                     vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+                     vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+        vk::ImageCopy region{};
+        region.srcSubresource = {vk::ImageAspectFlagBits::eDepth, 0, cascade, 1};
+        region.dstSubresource = {vk::ImageAspectFlagBits::eDepth, 0, cascade, 1};
+        region.extent = vk::Extent3D(MAP_SIZE, MAP_SIZE, 1);
+        cmd.copyImage(pages_, vk::ImageLayout::eTransferSrcOptimal, map_, vk::ImageLayout::eTransferDstOptimal,
+                      region);
+        layerBarrier(cmd, map_, cascade, 1, vk::PipelineStageFlagBits2::eTransfer,
+                     vk::AccessFlagBits2::eTransferWrite, fragmentTests, attachmentAccess,
+                     vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eDepthAttachmentOptimal);
+        beginRendering(cmd, *map_layer_views_[cascade], vk::AttachmentLoadOp::eLoad);
+    }
+
+    void CascadedShadows::endCascade(const vk::raii::CommandBuffer& cmd)
+    {
+        cmd.endRendering();
+    }
+
+    void CascadedShadows::finish(const vk::raii::CommandBuffer& cmd)
+    {
+        if (map_drawn_)
+        {
+            layerBarrier(cmd, map_, 0, SHADOW_CASCADES, vk::PipelineStageFlagBits2::eLateFragmentTests,
+                         vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                         vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead,
+                         vk::ImageLayout::eDepthAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+        }
+        else if (!map_initialized_)
+        {
+            // Never drawn, and not sampled while shadows are off, but the descriptor wants its layout
+            layerBarrier(cmd, map_, 0, SHADOW_CASCADES, vk::PipelineStageFlagBits2::eTopOfPipe, {},
+                         vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead,
+                         vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal);
+        }
+        map_initialized_ = true;
+        map_drawn_ = false;
+    }
+
+    vk::DescriptorBufferInfo CascadedShadows::uniformsInfo(uint32_t frame) const
+    {
+        return {vk::Buffer(frames_[frame].uniforms), 0, sizeof(ShadowUniforms)};
+    }
+
+    vk::DescriptorImageInfo CascadedShadows::mapInfo() const
+    {
+        return {nullptr, *map_view_, vk::ImageLayout::eShaderReadOnlyOptimal};
+    }
+
+    vk::DescriptorImageInfo CascadedShadows::samplerInfo() const
+    {
+        return {*sampler_, nullptr, vk::ImageLayout::eUndefined};
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+#include "vma/vk_mem_alloc.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "GpuMemory.h"
+#include "ShadowCascadeFitter.h"
+
+namespace Chopper
+{
+    // The sun's shadow maps: one SHADOW_CASCADES-layer depth array, sampled by the scene's fragment
+    // shader, and as many static pages. A cascade's static casters are drawn into its page only when
+    // ShadowCascade::redrawStatic asks for it; every frame the page is copied into the cascade's
+    // layer and only the dynamic casters are drawn on top.
+    //
+    // Shadow maps use standard depth (0 near, 1 far) whatever the scene's convention.
+    class CascadedShadows
+    {
+    public:
+        static constexpr uint32_t MAP_SIZE = SHADOW_MAP_SIZE;
+        static constexpr vk::Format FORMAT = vk::Format::eD32Sfloat;
+
+        void init(const vk::raii::Device& device, GpuMemory& memory, uint32_t framesInFlight);
+        void destroy();
+
+        // Writes `frame`'s shadow uniforms. `toSun` is a unit vector, `sunColor` is color times
+        // intensity (black for no sun), `shadows` turns the cascades on.
+        void updateUniforms(uint32_t frame, const std::array<ShadowCascade, SHADOW_CASCADES>& cascades,
+                            const glm::vec3& toSun, const glm::vec3& sunColor, bool shadows);
+
+        // Begins rendering into `cascade`'s static page, cleared. Draw the static casters, then
+        // call endStaticPage().
+        void beginStaticPage(const vk::raii::CommandBuffer& cmd, uint32_t cascade);
+        void endStaticPage(const vk::raii::CommandBuffer& cmd, uint32_t cascade);
+        // Copies `cascade`'s static page into its shadow map layer and begins rendering into it.
+        // Draw the dynamic casters, then call endCascade().
+        void beginCascade(const vk::raii::CommandBuffer& cmd, uint32_t cascade);
+        void endCascade(const vk::raii::CommandBuffer& cmd);
+        // Makes the shadow map readable by the scene pass; call it every frame, after the cascades
+        // if any were drawn
+        void finish(const vk::raii::CommandBuffer& cmd);
+
+        // What the scene's fragment shader reads for `frame`: uniforms, the shadow map and its
+        // comparison sampler
+        vk::DescriptorBufferInfo uniformsInfo(uint32_t frame) const;
+        vk::DescriptorImageInfo mapInfo() const;
+        vk::DescriptorImageInfo samplerInfo() const;
+
+        uint32_t staticPagesDrawn() const { return static_pages_drawn_; }
+
+    private:
+        struct FrameBuffers
+        {
+            VkBuffer uniforms = VK_NULL_HANDLE;
+            VmaAllocation uniformsAllocation = nullptr;
+            void* uniformsMapped = nullptr;
+        };
+
+        VkImage createArray(VkImageUsageFlags usage, const char* name, VmaAllocation& allocation) const;
+        vk::raii::ImageView createView(VkImage image, vk::ImageViewType type, uint32_t firstLayer,
+                                       uint32_t layerCount) const;
+        void beginRendering(const vk::raii::CommandBuffer& cmd, vk::ImageView view,
+                            vk::AttachmentLoadOp loadOp) const;
+        static void layerBarrier(const vk::raii::CommandBuffer& cmd, VkImage image, uint32_t layer,
+                                 uint32_t layerCount, vk::PipelineStageFlags2 srcStage,
+                                 vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStage,
+                                 vk::AccessFlags2 dstAccess, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+
+        const vk::raii::Device* device_ = nullptr;
+        GpuMemory* memory_ = nullptr;
+
+        VkImage map_ = VK_NULL_HANDLE;
+        VmaAllocation map_allocation_ = nullptr;
+        vk::raii::ImageView map_view_ = nullptr;
+        std::array<vk::raii::ImageView, SHADOW_CASCADES> map_layer_views_{
+            nullptr, nullptr, nullptr, nullptr
+        };
+        VkImage pages_ = VK_NULL_HANDLE;
+        VmaAllocation pages_allocation_ = nullptr;
+        std::array<vk::raii::ImageView, SHADOW_CASCADES> page_views_{nullptr, nullptr, nullptr, nullptr};
+        vk::raii::Sampler sampler_ = nullptr;
+        std::vector<FrameBuffers> frames_;
+
+        // Pages that hold a drawing; the others have never been drawn and are cleared instead
+        std::array<bool, SHADOW_CASCADES> page_drawn_{};
+        // The map has left UNDEFINED, and the cascades were drawn this frame
+        bool map_initialized_ = false;
+        bool map_drawn_ = false;
+        uint32_t static_pages_drawn_ = 0;
+    };
+}
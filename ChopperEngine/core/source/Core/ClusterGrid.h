@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+namespace Chopper
+{
+    // The cluster grid of ClusteredLighting and the binning math its shaders run on it. cluster.slang
+    // and shader.slang repeat these; the CPU copies are the reference they are tested against.
+    struct ClusterGrid
+    {
+        static constexpr uint32_t GRID_X = 16;
+        static constexpr uint32_t GRID_Y = 9;
+        static constexpr uint32_t GRID_Z = 24;
+        static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+        // View distances spanned by the depth slices; the last slice reaches past SLICE_FAR
+        static constexpr float SLICE_NEAR = 0.1f;
+        static constexpr float SLICE_FAR = 200.0f;
+        // Far end of the last slice, which takes everything beyond the slices
+        static constexpr float LAST_SLICE_FAR = 1.0e6f;
+    };
+
+    // Depth slice of a view distance d: log(d) * scale + bias. Exponential slices: slice k starts
+    // at SLICE_NEAR * (SLICE_FAR / SLICE_NEAR)^(k / GRID_Z).
+    struct ClusterSlicing
+    {
+        float scale = 0.0f;
+        float bias = 0.0f;
+    };
+
+    inline ClusterSlicing clusterSlicing()
+    {
+        const float logRange = std::log(ClusterGrid::SLICE_FAR / ClusterGrid::SLICE_NEAR);
+        ClusterSlicing slicing;
+        slicing.scale = static_cast<float>(ClusterGrid::GRID_Z) / logRange;
+        slicing.bias = -static_cast<float>(ClusterGrid::GRID_Z) * std::log(ClusterGrid::SLICE_NEAR) / logRange;
+        return slicing;
+    }
+
+    // View distance where `slice` starts
+    inline float clusterSliceDistance(const ClusterSlicing& slicing, uint32_t slice)
+    {
+        return std::exp((static_cast<float>(slice) - slicing.bias) / slicing.scale);
+    }
+
+    // Cluster of a fragment at `pixel` of a `renderSize` target, `viewDepth` in front of the camera
+    inline uint32_t clusterIndex(const ClusterSlicing& slicing, const glm::vec2& pixel, const glm::vec2& renderSize,
+                                 float viewDepth)
+    {
+        const glm::vec2 grid(ClusterGrid::GRID_X, ClusterGrid::GRID_Y);
+        const glm::uvec2 tile = glm::min(glm::uvec2(pixel / renderSize * grid),
+                                         glm::uvec2(ClusterGrid::GRID_X - 1, ClusterGrid::GRID_Y - 1));
+        const float slice = std::log(std::max(viewDepth, 1e-4f)) * slicing.scale + slicing.bias;
+        const auto z = static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(ClusterGrid::GRID_Z - 1)));
+        return (z * ClusterGrid::GRID_Y + tile.y) * ClusterGrid::GRID_X + tile.x;
+    }
+
+    // View-space box of a cluster: its tile's corner rays between its slice's distances. `projScale`
+    // is proj[0][0] and proj[1][1]; the camera looks down -z.
+    inline void clusterBox(const ClusterSlicing& slicing, uint32_t index, const glm::vec2& projScale,
+                           glm::vec3& boxMin, glm::vec3& boxMax)
+    {
+        const glm::uvec3 cell(index % ClusterGrid::GRID_X, (index / ClusterGrid::GRID_X) % ClusterGrid::GRID_Y,
+                              std::min(index / (ClusterGrid::GRID_X * ClusterGrid::GRID_Y), ClusterGrid::GRID_Z - 1));
+        const glm::vec2 grid(ClusterGrid::GRID_X, ClusterGrid::GRID_Y);
+        const glm::vec2 ndcMin = glm::vec2(cell.x, cell.y) / grid * 2.0f - 1.0f;
+        const glm::vec2 ndcMax = glm::vec2(cell.x + 1, cell.y + 1) / grid * 2.0f - 1.0f;
+        const float nearDistance = clusterSliceDistance(slicing, cell.z);
+        const float farDistance = cell.z + 1 < ClusterGrid::GRID_Z ? clusterSliceDistance(slicing, cell.z + 1)
+                                                                     : ClusterGrid::LAST_SLICE_FAR;
+
+        boxMin = glm::vec3(1.0e30f);
+        boxMax = -boxMin;
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            const float distance = (i & 4) != 0 ? farDistance : nearDistance;
+            const glm::vec2 ndc((i & 1) != 0 ? ndcMax.x : ndcMin.x, (i & 2) != 0 ? ndcMax.y : ndcMin.y);
+            const glm::vec3 corner(ndc * distance / projScale, -distance);
+            boxMin = glm::min(boxMin, corner);
+            boxMax = glm::max(boxMax, corner);
+        }
+    }
+
+    inline bool sphereTouchesBox(const glm::vec3& center, float radius, const glm::vec3& boxMin,
+                                 const glm::vec3& boxMax)
+    {
+        const glm::vec3 offset = glm::clamp(center, boxMin, boxMax) - center;
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    // Cone (apex, unit axis, length, cosine of a half-angle below 90 degrees) against a sphere
+    inline bool coneTouchesSphere(const glm::vec3& apex, const glm::vec3& axis, float length, float cosAngle,
+                                  const glm::vec3& center, float radius)
+    {
+        const glm::vec3 v = center - apex;
+        const float along = glm::dot(v, axis);
+        const float sinAngle = std::sqrt(std::max(0.0f, 1.0f - cosAngle * cosAngle));
+        // Distance from the sphere's center to the cone's side
+        const float side = cosAngle * std::sqrt(std::max(0.0f, glm::dot(v, v) - along * along)) - along * sinAngle;
+        return side <= radius && along <= length + radius && along >= -radius;
+    }
+}
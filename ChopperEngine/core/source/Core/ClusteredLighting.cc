@@ -0,0 +1,240 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace Chopper
+{
+    namespace
+    {
+        // Matches LightingUniforms in cluster.slang and shader.slang (std140)
+        struct LightingUniforms
+        {
+            glm::mat4 view;
+            // World-space camera position, w unused
+            glm::vec4 cameraPosition;
+            // proj[0][0] and proj[1][1]: view-space x and y over distance, to NDC
+            glm::vec2 projScale;
+            glm::vec2 renderSize;
+            uint32_t lightCount;
+            // Depth slice of a view distance d: log(d) * sliceScale + sliceBias
+            float sliceScale;
+            float sliceBias;
+            float ambient;
+        };
+
+        constexpr uint32_t WORKGROUP_SIZE = 64;
+    }
+
+    VkBuffer ClusteredLighting::createBuffer(vk::DeviceSize size, VkBufferUsageFlags usage, bool hostVisible,
+                                             const char* name, VmaAllocation& allocation, void** mapped)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = hostVisible ? VMA_MEMORY_USAGE_AUTO : VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        if (hostVisible)
+        {
+            allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        }
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocationInfo details{};
+        if (memory_->createBuffer(bufferInfo, allocInfo, MemoryCategory::Other, name, buffer, allocation, &details) !=
+            VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create clustered lighting buffer!");
+        }
+        if (mapped) *mapped = details.pMappedData;
+        return buffer;
+    }
+
+    void ClusteredLighting::init(const vk::raii::Device& device, GpuMemory& memory, const std::vector<char>& spirv,
+                                 uint32_t framesInFlight)
+    {
+        device_ = &device;
+        memory_ = &memory;
+
+        // 0 uniforms, 1 lights, 2 per-cluster counts, 3 per-cluster light indices
+        std::array bindings{
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1,
+                                           vk::ShaderStageFlagBits::eCompute, nullptr),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1,
+                                           vk::ShaderStageFlagBits::eCompute, nullptr),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1,
+                                           vk::ShaderStageFlagBits::eCompute, nullptr),
+            vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1,
+                                           vk::ShaderStageFlagBits::eCompute, nullptr)
+        };
+        vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+        set_layout_ = vk::raii::DescriptorSetLayout(device, layoutInfo);
+
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &*set_layout_;
+        pipeline_layout_ = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
+
+        vk::ShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.codeSize = spirv.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(spirv.data());
+        vk::raii::ShaderModule module(device, moduleInfo);
+        vk::ComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "binLights";
+        pipelineInfo.layout = pipeline_layout_;
+        pipeline_ = vk::raii::Pipeline(device, nullptr, pipelineInfo);
+
+        std::array poolSizes{
+            vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, framesInFlight),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 3 * framesInFlight)
+        };
+        vk::DescriptorPoolCreateInfo poolInfo{};
+        poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        poolInfo.maxSets = framesInFlight;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        descriptor_pool_ = vk::raii::DescriptorPool(device, poolInfo);
+
+        std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, *set_layout_);
+        vk::DescriptorSetAllocateInfo allocInfo{};
+        allocInfo.descriptorPool = descriptor_pool_;
+        allocInfo.descriptorSetCount = framesInFlight;
+        allocInfo.pSetLayouts = layouts.data();
+        descriptor_sets_ = device.allocateDescriptorSets(allocInfo);
+
+        // Per-frame buffers, cluster lists included, so binning a frame never touches what an
+        // in-flight frame shades with
+        frames_.resize(framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; ++i)
+        {
+            FrameBuffers& frame = frames_[i];
+            void* mapped = nullptr;
+            frame.lights = createBuffer(MAX_LIGHTS * sizeof(Light), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true,
+                                        "Lights", frame.lightsAllocation, &mapped);
+            frame.lightsMapped = static_cast<Light*>(mapped);
+            frame.uniforms = createBuffer(sizeof(LightingUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, true,
+                                          "Lighting uniforms", frame.uniformsAllocation, &frame.uniformsMapped);
+            frame.counts = createBuffer(CLUSTER_COUNT * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false,
+                                        "Cluster light counts", frame.countsAllocation, nullptr);
+            frame.indices = createBuffer(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t),
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false, "Cluster light indices",
+                                         frame.indicesAllocation, nullptr);
+
+            std::array bufferInfos{uniformsInfo(i), lightsInfo(i), countsInfo(i), indicesInfo(i)};
+            std::array<vk::WriteDescriptorSet, 4> writes;
+            for (uint32_t b = 0; b < bufferInfos.size(); ++b)
+            {
+                writes[b].dstSet = descriptor_sets_[i];
+                writes[b].dstBinding = b;
+                writes[b].descriptorCount = 1;
+                writes[b].descriptorType = b == 0 ? vk::DescriptorType::eUniformBuffer
+                                                  : vk::DescriptorType::eStorageBuffer;
+                writes[b].pBufferInfo = &bufferInfos[b];
+            }
+            device.updateDescriptorSets(writes, {});
+        }
+    }
+
+    void ClusteredLighting::destroy()
+    {
+        for (FrameBuffers& frame : frames_)
+        {
+            memory_->destroyBuffer(frame.lights, frame.lightsAllocation);
+            memory_->destroyBuffer(frame.uniforms, frame.uniformsAllocation);
+            memory_->destroyBuffer(frame.counts, frame.countsAllocation);
+            memory_->destroyBuffer(frame.indices, frame.indicesAllocation);
+        }
+        frames_.clear();
+        descriptor_sets_.clear();
+        descriptor_pool_ = nullptr;
+        pipeline_ = nullptr;
+        pipeline_layout_ = nullptr;
+        set_layout_ = nullptr;
+    }
+
+    vk::DescriptorBufferInfo ClusteredLighting::uniformsInfo(uint32_t frame) const
+    {
+        return {vk::Buffer(frames_[frame].uniforms), 0, sizeof(LightingUniforms)};
+    }
+
+    vk::DescriptorBufferInfo ClusteredLighting::lightsInfo(uint32_t frame) const
+    {
+        return {vk::Buffer(frames_[frame].lights), 0, MAX_LIGHTS * sizeof(Light)};
+    }
+
+    vk::DescriptorBufferInfo ClusteredLighting::countsInfo(uint32_t frame) const
+    {
+        return {vk::Buffer(frames_[frame].counts), 0, CLUSTER_COUNT * sizeof(uint32_t)};
+    }
+
+    vk::DescriptorBufferInfo ClusteredLighting::indicesInfo(uint32_t frame) const
+    {
+        return {vk::Buffer(frames_[frame].indices), 0, CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t)};
+    }
+
+    void ClusteredLighting::record(const vk::raii::CommandBuffer& cmd, uint32_t frame,
+                                   const std::vector<Light>& lights, vk::Extent2D renderExtent,
+                                   const glm::mat4& view, const glm::mat4& proj, float ambient)
+    {
+        FrameBuffers& buffers = frames_[frame];
+        light_count_ = static_cast<uint32_t>(std::min<size_t>(lights.size(), MAX_LIGHTS));
+        if (light_count_ > 0)
+        {
+            // Host writes before submission are visible to the device without a barrier
+            std::memcpy(buffers.lightsMapped, lights.data(), light_count_ * sizeof(Light));
+            vmaFlushAllocation(memory_->allocator(), buffers.lightsAllocation, 0, light_count_ * sizeof(Light));
+        }
+
+        const ClusterSlicing slicing = clusterSlicing();
+        LightingUniforms uniforms{};
+        uniforms.view = view;
+        uniforms.cameraPosition = glm::inverse(view)[3];
+        uniforms.projScale = glm::vec2(proj[0][0], proj[1][1]);
+        uniforms.renderSize = glm::vec2(renderExtent.width, renderExtent.height);
+        uniforms.lightCount = light_count_;
+        uniforms.sliceScale = slicing.scale;
+        uniforms.sliceBias = slicing.bias;
+        uniforms.ambient = ambient;
+        std::memcpy(buffers.uniformsMapped, &uniforms, sizeof(uniforms));
+        vmaFlushAllocation(memory_->allocator(), buffers.uniformsAllocation, 0, sizeof(uniforms));
+        if (light_count_ == 0) return;
+
+        // The slot's previous frame has finished, so its cluster lists are free to overwrite
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout_, 0, *descriptor_sets_[frame],
+                               nullptr);
+        cmd.dispatch((CLUSTER_COUNT + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+        vk::MemoryBarrier2 barrier{
+            vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+            vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageRead
+        };
+        vk::DependencyInfo info{};
+        info.memoryBarrierCount = 1;
+        info.pMemoryBarriers = &barrier;
+        cmd.pipelineBarrier2(info);
+    }
+
+    void ClusteredLighting::latchCamera(uint32_t frame, const glm::mat4& view, const glm::mat4& proj)
+    {
+        // view, cameraPosition and projScale lead LightingUniforms; the rest stays as record() wrote it
+        FrameBuffers& buffers = frames_[frame];
+        auto* uniforms = static_cast<LightingUniforms*>(buffers.uniformsMapped);
+        uniforms->view = view;
+        uniforms->cameraPosition = glm::inverse(view)[3];
+        uniforms->projScale = glm::vec2(proj[0][0], proj[1][1]);
+        vmaFlushAllocation(memory_->allocator(), buffers.uniformsAllocation, 0,
+                           offsetof(LightingUniforms, renderSize));
+    }
+}
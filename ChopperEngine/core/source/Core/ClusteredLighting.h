@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+#include "vma/vk_mem_alloc.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "ClusterGrid.h"
+#include "GpuMemory.h"
+
+namespace Chopper
+{
+    // Clustered forward lighting. The view frustum is split into GRID_X * GRID_Y screen tiles
+    // and GRID_Z depth slices, exponentially spaced so clusters stay roughly cubic with
+    // distance. A compute pass (shaders/cluster.spv) runs one thread per cluster: it builds the
+    // cluster's view-space box, walks the light list in workgroup-shared batches and keeps the
+    // lights whose range reaches the box (spot lights also by their cone). The scene's fragment
+    // shader finds its cluster from its pixel and view depth and shades only that cluster's
+    // lights, so a pixel pays for the lights that reach it, not for every light in the scene.
+    //
+    // A cluster keeps at most MAX_LIGHTS_PER_CLUSTER lights; any more are dropped.
+    class ClusteredLighting
+    {
+    public:
+        // GPU layout of one light (std430), consumed by cluster.slang and shader.slang
+        struct Light
+        {
+            glm::vec3 position{0.0f};
+            float range = 1.0f;
+            // Color times intensity
+            glm::vec3 color{1.0f};
+            // Cosine of the cone's outer half-angle; -1 for point lights
+            float cosOuter = -1.0f;
+            // Spot lights: the direction the cone opens towards
+            glm::vec3 direction{0.0f, 0.0f, -1.0f};
+            float cosInner = -1.0f;
+        };
+
+        static constexpr uint32_t GRID_X = ClusterGrid::GRID_X;
+        static constexpr uint32_t GRID_Y = ClusterGrid::GRID_Y;
+        static constexpr uint32_t GRID_Z = ClusterGrid::GRID_Z;
+        static constexpr uint32_t CLUSTER_COUNT = ClusterGrid::CLUSTER_COUNT;
+        static constexpr uint32_t MAX_LIGHTS = 4096;
+        static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+        void init(const vk::raii::Device& device, GpuMemory& memory, const std::vector<char>& spirv,
+                  uint32_t framesInFlight);
+        void destroy();
+
+        // Copies `lights` (at most MAX_LIGHTS) into `frame`'s buffer and records the binning
+        // pass, outside rendering and before the scene pass that reads it. Without lights the
+        // pass is skipped and the scene is drawn unlit.
+        void record(const vk::raii::CommandBuffer& cmd, uint32_t frame, const std::vector<Light>& lights,
+                    vk::Extent2D renderExtent, const glm::mat4& view, const glm::mat4& proj, float ambient);
+        // Replaces the camera of `frame`'s binning and shading, recorded by record(), before submission
+        void latchCamera(uint32_t frame, const glm::mat4& view, const glm::mat4& proj);
+
+        // What the scene's fragment shader reads for `frame`: uniforms, lights, per-cluster
+        // light counts and per-cluster light indices
+        vk::DescriptorBufferInfo uniformsInfo(uint32_t frame) const;
+        vk::DescriptorBufferInfo lightsInfo(uint32_t frame) const;
+        vk::DescriptorBufferInfo countsInfo(uint32_t frame) const;
+        vk::DescriptorBufferInfo indicesInfo(uint32_t frame) const;
+
+        uint32_t lightCount() const { return light_count_; }
+
+    private:
+        struct FrameBuffers
+        {
+            VkBuffer lights = VK_NULL_HANDLE;
+            VmaAllocation lightsAllocation = nullptr;
+            Light* lightsMapped = nullptr;
+            VkBuffer uniforms = VK_NULL_HANDLE;
+            VmaAllocation uniformsAllocation = nullptr;
+            void* uniformsMapped = nullptr;
+            // Written by the binning pass, read by the scene's fragment shader
+            VkBuffer counts = VK_NULL_HANDLE;
+            VmaAllocation countsAllocation = nullptr;
+            VkBuffer indices = VK_NULL_HANDLE;
+            VmaAllocation indicesAllocation = nullptr;
+        };
+
+        VkBuffer createBuffer(vk::DeviceSize size, VkBufferUsageFlags usage, bool hostVisible, const char* name,
+                              VmaAllocation& allocation, void** mapped);
+
+        const vk::raii::Device* device_ = nullptr;
+        GpuMemory* memory_ = nullptr;
+
+        vk::raii::DescriptorSetLayout set_layout_ = nullptr;
+        vk::raii::PipelineLayout pipeline_layout_ = nullptr;
+        vk::raii::Pipeline pipeline_ = nullptr;
+        vk::raii::DescriptorPool descriptor_pool_ = nullptr;
+        std::vector<vk::raii::DescriptorSet> descriptor_sets_;
+        std::vector<FrameBuffers> frames_;
+        uint32_t light_count_ = 0;
+    };
+}
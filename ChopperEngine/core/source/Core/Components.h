@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SceneGraph.h"
+
+namespace Chopper
+{
+    // Engine components stored in the ECS World. Each lives in its own SoA column, so a
+    // system only touches the data it reads or writes.
+
+    // Links an entity to its node in the SceneGraph, which owns the local and world transforms
+    struct TransformNode
+    {
+        NodeId node = INVALID_NODE;
+    };
+
+    struct Renderable
+    {
+        // Index into HelloTriangleApplication::materials
+        uint32_t material = 0;
+        // MeshId in the GeometryPool
+        uint32_t mesh = 0;
+        // Index of the per-object GPU resources (uniform buffers, descriptor sets)
+        uint32_t slot = 0;
+    };
+
+    // Tag: the entity's mesh is rasterized into the OcclusionBuffer to hide what is behind it.
+    // Best suited to large, closed, static meshes.
+    struct Occluder
+    {
+    };
+
+    // Tag: the entity never moves once spawned, so bakeStaticBatches() may merge it with its
+    // neighbours into a world-space batch. The entity is consumed by the bake.
+    struct Static
+    {
+    };
+
+    // Tag: a batch made by bakeStaticBatches(). Never moves, like the Static entities it replaced.
+    struct Baked
+    {
+    };
+
+    // Turns the entity's node at a constant rate, in radians per second per euler axis.
+    // Advanced by the fixed-step simulation.
+    struct Spin
+    {
+        glm::vec3 rate = glm::vec3(0.0f);
+    };
+
+    // A light at the entity's node, shaded by ClusteredLighting. A point light, or a spot light
+    // shining down the node's -Z when outerAngle is above zero.
+    struct Light
+    {
+        glm::vec3 color = glm::vec3(1.0f);
+        float intensity = 1.0f;
+        // Distance at which the light fades out completely
+        float range = 5.0f;
+        // Spot cone half-angles in radians; the light falls off from innerAngle to outerAngle
+        float innerAngle = 0.0f;
+        float outerAngle = 0.0f;
+    };
+
+    // Reference for composeTransforms() and the scene graph's local matrices
+    inline glm::mat4 composeModelMatrix(const glm::vec3& position, const glm::vec3& rotation,
+                                        const glm::vec3& scale)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::rotate(model, rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::rotate(model, rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::rotate(model, rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
+        model = glm::scale(model, scale);
+        return model;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace Chopper
+{
+    // Defers destroying GPU objects until the frames that may still use them have finished.
+    // Frames are numbered in submission order; an object retired after frame N was submitted is
+    // destroyed once frame N (and so every frame before it) is known to have finished on the GPU.
+    // Entries are destroyed in the order they were retired, so dependents go first.
+    // Not thread-safe: the render thread drives it, other threads retire only while the render
+    // thread is drained.
+    class DeletionQueue
+    {
+    public:
+        DeletionQueue() = default;
+        ~DeletionQueue() { flush(); }
+        DeletionQueue(const DeletionQueue&) = delete;
+        DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+        // Runs `destroy` once every frame submitted so far, plus `extraFrames` more, has finished.
+        // Objects the presentation engine still holds, such as an old swapchain, need one extra
+        // frame: a frame's completion does not cover its presentation.
+        void retire(std::function<void()> destroy, uint32_t extraFrames = 0)
+        {
+            entries_.push_back({submitted_ + extraFrames, std::move(destroy)});
+        }
+
+        // Takes ownership of a move-only object (RAII handles, containers of them) and destroys it
+        // the same way
+        template <typename T>
+        void retireObject(T&& object, uint32_t extraFrames = 0)
+        {
+            auto held = std::make_shared<std::decay_t<T>>(std::forward<T>(object));
+            retire([held]() mutable { held.reset(); }, extraFrames);
+        }
+
+        // Call when a frame is submitted; returns its number
+        uint64_t submitted() { return ++submitted_; }
+        uint64_t lastSubmitted() const { return submitted_; }
+
+        // Call once frame `frame` has finished on the GPU
+        void completed(uint64_t frame)
+        {
+            while (!entries_.empty() && entries_.front().frame <= frame)
+            {
+                // Popped first: a destructor may retire more
+                Entry entry = std::move(entries_.front());
+                entries_.pop_front();
+                entry.destroy();
+            }
+        }
+
+        // Destroys everything now; the device must be idle
+        void flush() { completed(UINT64_MAX); }
+
+        size_t size() const { return entries_.size(); }
+
+    private:
+        struct Entry
+        {
+            uint64_t frame = 0;
+            std::function<void()> destroy;
+        };
+
+        std::deque<Entry> entries_;
+        uint64_t submitted_ = 0;
+    };
+}
@@ -0,0 +1,312 @@
+#include "DynamicAabbTree.h"
+
+#include <stdexcept>
+
+namespace Chopper
+{
+    namespace
+    {
+        // How far ahead of its movement a reinserted proxy's fat box reaches
+        constexpr float DISPLACEMENT_MULTIPLIER = 2.0f;
+    }
+
+    Aabb transformAabb(const Aabb& box, const glm::mat4& transform)
+    {
+        const glm::vec3 center = glm::vec3(transform * glm::vec4(box.center(), 1.0f));
+        const glm::vec3 extents = box.extents();
+        const glm::vec3 worldExtents =
+            glm::abs(glm::vec3(transform[0])) * extents.x +
+            glm::abs(glm::vec3(transform[1])) * extents.y +
+            glm::abs(glm::vec3(transform[2])) * extents.z;
+        return {center - worldExtents, center + worldExtents};
+    }
+
+    DynamicAabbTree::DynamicAabbTree(float margin)
+        : margin_(margin)
+    {
+    }
+
+    uint32_t DynamicAabbTree::allocateNode()
+    {
+        if (free_list_ == NULL_NODE)
+        {
+            free_list_ = static_cast<uint32_t>(nodes_.size());
+            nodes_.emplace_back();
+        }
+
+        const uint32_t node = free_list_;
+        free_list_ = nodes_[node].parent;
+        nodes_[node] = Node{};
+        nodes_[node].height = 0;
+        return node;
+    }
+
+    void DynamicAabbTree::freeNode(uint32_t node)
+    {
+        nodes_[node].parent = free_list_;
+        nodes_[node].height = -1;
+        free_list_ = node;
+    }
+
+    uint32_t DynamicAabbTree::createProxy(const Aabb& box, uint32_t userData)
+    {
+        const uint32_t proxy = allocateNode();
+        const glm::vec3 margin(margin_);
+        nodes_[proxy].box = {box.min - margin, box.max + margin};
+        nodes_[proxy].userData = userData;
+        insertLeaf(proxy);
+        ++proxy_count_;
+        return proxy;
+    }
+
+    void DynamicAabbTree::destroyProxy(uint32_t proxy)
+    {
+        removeLeaf(proxy);
+        freeNode(proxy);
+        --proxy_count_;
+    }
+
+    bool DynamicAabbTree::moveProxy(uint32_t proxy, const Aabb& box, const glm::vec3& displacement)
+    {
+        if (nodes_[proxy].box.contains(box)) return false;
+
+        removeLeaf(proxy);
+
+        const glm::vec3 margin(margin_);
+        Aabb fat{box.min - margin, box.max + margin};
+        const glm::vec3 ahead = displacement * DISPLACEMENT_MULTIPLIER;
+        fat.min += glm::min(ahead, glm::vec3(0.0f));
+        fat.max += glm::max(ahead, glm::vec3(0.0f));
+        nodes_[proxy].box = fat;
+
+        insertLeaf(proxy);
+        return true;
+    }
+
+    void DynamicAabbTree::insertLeaf(uint32_t leaf)
+    {
+        if (root_ == NULL_NODE)
+        {
+            root_ = leaf;
+            nodes_[leaf].parent = NULL_NODE;
+            return;
+        }
+
+        // Descend towards the sibling that minimizes the surface area added to the tree
+        const Aabb leafBox = nodes_[leaf].box;
+        uint32_t index = root_;
+        while (!nodes_[index].isLeaf())
+        {
+            const Node& node = nodes_[index];
+            const float area = node.box.surfaceArea();
+            const float combinedArea = Aabb::merge(node.box, leafBox).surfaceArea();
+
+            // Cost of making a new parent for this node and the leaf
+            const float cost = 2.0f * combinedArea;
+            // Minimum cost of pushing the leaf further down
+            const float inheritanceCost = 2.0f * (combinedArea - area);
+
+            auto descendCost = [&](uint32_t child)
+            {
+                const Node& c = nodes_[child];
+                const float merged = Aabb::merge(c.box, leafBox).surfaceArea();
+                return (c.isLeaf() ? merged : merged - c.box.surfaceArea()) + inheritanceCost;
+            };
+            const float cost1 = descendCost(node.child1);
+            const float cost2 = descendCost(node.child2);
+
+            if (cost < cost1 && cost < cost2) break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        const uint32_t sibling = index;
+        const uint32_t oldParent = nodes_[sibling].parent;
+        const uint32_t newParent = allocateNode();
+        nodes_[newParent].parent = oldParent;
+        nodes_[newParent].box = Aabb::merge(leafBox, nodes_[sibling].box);
+        nodes_[newParent].height = nodes_[sibling].height + 1;
+        nodes_[newParent].child1 = sibling;
+        nodes_[newParent].child2 = leaf;
+        nodes_[sibling].parent = newParent;
+        nodes_[leaf].parent = newParent;
+
+        if (oldParent == NULL_NODE)
+        {
+            root_ = newParent;
+        }
+        else if (nodes_[oldParent].child1 == sibling)
+        {
+            nodes_[oldParent].child1 = newParent;
+        }
+        else
+        {
+            nodes_[oldParent].child2 = newParent;
+        }
+
+        refitAncestors(nodes_[leaf].parent);
+    }
+
+    void DynamicAabbTree::removeLeaf(uint32_t leaf)
+    {
+        if (leaf == root_)
+        {
+            root_ = NULL_NODE;
+            return;
+        }
+
+        const uint32_t parent = nodes_[leaf].parent;
+        const uint32_t grandParent = nodes_[parent].parent;
+        const uint32_t sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+        if (grandParent == NULL_NODE)
+        {
+            root_ = sibling;
+            nodes_[sibling].parent = NULL_NODE;
+            freeNode(parent);
+            return;
+        }
+
+        if (nodes_[grandParent].child1 == parent)
+        {
+            nodes_[grandParent].child1 = sibling;
+        }
+        else
+        {
+            nodes_[grandParent].child2 = sibling;
+        }
+        nodes_[sibling].parent = grandParent;
+        freeNode(parent);
+
+        refitAncestors(grandParent);
+    }
+
+    void DynamicAabbTree::refitAncestors(uint32_t node)
+    {
+        while (node != NULL_NODE)
+        {
+            node = balance(node);
+
+            Node& n = nodes_[node];
+            n.height = 1 + std::max(nodes_[n.child1].height, nodes_[n.child2].height);
+            n.box = Aabb::merge(nodes_[n.child1].box, nodes_[n.child2].box);
+            node = n.parent;
+        }
+    }
+
+    uint32_t DynamicAabbTree::balance(uint32_t iA)
+    {
+        Node& a = nodes_[iA];
+        if (a.isLeaf() || a.height < 2) return iA;
+
+        const uint32_t iB = a.child1;
+        const uint32_t iC = a.child2;
+        Node& b = nodes_[iB];
+        Node& c = nodes_[iC];
+
+        // Promotes `up` (a child of A) to A's place; `up` keeps its taller child and hands the
+        // other one to A in place of itself
+        auto rotate = [&](uint32_t iUp, Node& up, uint32_t& aSlotForUp, const Node& other)
+        {
+            const uint32_t iF = up.child1;
+            const uint32_t iG = up.child2;
+            Node& f = nodes_[iF];
+            Node& g = nodes_[iG];
+
+            up.child1 = iA;
+            up.parent = a.parent;
+            a.parent = iUp;
+
+            if (up.parent == NULL_NODE)
+            {
+                root_ = iUp;
+            }
+            else if (nodes_[up.parent].child1 == iA)
+            {
+                nodes_[up.parent].child1 = iUp;
+            }
+            else
+            {
+                nodes_[up.parent].child2 = iUp;
+            }
+
+            const bool keepF = f.height > g.height;
+            const uint32_t iKeep = keepF ? iF : iG;
+            const uint32_t iGive = keepF ? iG : iF;
+            Node& keep = nodes_[iKeep];
+            Node& give = nodes_[iGive];
+
+            up.child2 = iKeep;
+            aSlotForUp = iGive;
+            give.parent = iA;
+            a.box = Aabb::merge(other.box, give.box);
+            a.height = 1 + std::max(other.height, give.height);
+            up.box = Aabb::merge(a.box, keep.box);
+            up.height = 1 + std::max(a.height, keep.height);
+        };
+
+        const int32_t difference = c.height - b.height;
+        if (difference > 1)
+        {
+            rotate(iC, c, a.child2, b);
+            return iC;
+        }
+        if (difference < -1)
+        {
+            rotate(iB, b, a.child1, c);
+            return iB;
+        }
+        return iA;
+    }
+
+    float DynamicAabbTree::areaRatio() const
+    {
+        if (root_ == NULL_NODE) return 0.0f;
+
+        float total = 0.0f;
+        for (const Node& node : nodes_)
+        {
+            if (node.height >= 0) total += node.box.surfaceArea();
+        }
+        return total / nodes_[root_].box.surfaceArea();
+    }
+
+    void DynamicAabbTree::validate() const
+    {
+        if (root_ != NULL_NODE && nodes_[root_].parent != NULL_NODE)
+        {
+            throw std::runtime_error("dynamic AABB tree root has a parent");
+        }
+        validateNode(root_);
+    }
+
+    int32_t DynamicAabbTree::validateNode(uint32_t index) const
+    {
+        if (index == NULL_NODE) return 0;
+
+        const Node& node = nodes_[index];
+        if (node.isLeaf())
+        {
+            if (node.child2 != NULL_NODE || node.height != 0)
+            {
+                throw std::runtime_error("dynamic AABB tree leaf is malformed");
+            }
+            return 1;
+        }
+
+        const Node& child1 = nodes_[node.child1];
+        const Node& child2 = nodes_[node.child2];
+        if (child1.parent != index || child2.parent != index)
+        {
+            throw std::runtime_error("dynamic AABB tree child has the wrong parent");
+        }
+        if (node.height != 1 + std::max(child1.height, child2.height))
+        {
+            throw std::runtime_error("dynamic AABB tree node has a stale height");
+        }
+        if (!node.box.contains(child1.box) || !node.box.contains(child2.box))
+        {
+            throw std::runtime_error("dynamic AABB tree node does not enclose its children");
+        }
+        return validateNode(node.child1) + validateNode(node.child2);
+    }
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "FrustumCulling.h"
+
+namespace Chopper
+{
+    struct Aabb
+    {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+
+        glm::vec3 center() const { return (min + max) * 0.5f; }
+        glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+        float surfaceArea() const
+        {
+            const glm::vec3 d = max - min;
+            return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+
+        bool contains(const Aabb& other) const
+        {
+            return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+        }
+
+        bool overlaps(const Aabb& other) const
+        {
+            return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+        }
+
+        static Aabb merge(const Aabb& a, const Aabb& b)
+        {
+            return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+        }
+    };
+
+    // Bounds of `box` after an affine transform (Arvo)
+    Aabb transformAabb(const Aabb& box, const glm::mat4& transform);
+
+    // Dynamic bounding-volume hierarchy over AABBs. Leaves store a fattened box, so small
+    // movements leave the tree untouched; a proxy is reinserted only when it leaves its fat
+    // box. Insertion descends by the surface-area heuristic and the tree is kept balanced with
+    // AVL-style rotations, so queries visit O(log n) nodes plus the results.
+    // Query callbacks must not start another query of the same kind on the same thread.
+    class DynamicAabbTree
+    {
+    public:
+        static constexpr uint32_t NULL_NODE = ~0u;
+
+        explicit DynamicAabbTree(float margin = 0.1f);
+
+        // Returns a proxy id, stable until destroyProxy()
+        uint32_t createProxy(const Aabb& box, uint32_t userData);
+        void destroyProxy(uint32_t proxy);
+
+        // Updates the proxy's box; `displacement` (the expected movement until the next update)
+        // stretches the fat box in that direction. Returns true if the proxy was reinserted.
+        bool moveProxy(uint32_t proxy, const Aabb& box, const glm::vec3& displacement = glm::vec3(0.0f));
+
+        uint32_t userData(uint32_t proxy) const { return nodes_[proxy].userData; }
+        const Aabb& fatAabb(uint32_t proxy) const { return nodes_[proxy].box; }
+
+        size_t proxyCount() const { return proxy_count_; }
+        int32_t height() const { return root_ == NULL_NODE ? 0 : nodes_[root_].height; }
+        // Sum of node surface areas over the root's; lower is a better tree
+        float areaRatio() const;
+        // Checks structural invariants; throws std::runtime_error on corruption
+        void validate() const;
+
+        // fn(userData) for every proxy whose fat box intersects the frustum. Subtrees fully inside
+        // a plane stop testing it; subtrees inside all planes are reported without further tests.
+        template <typename Fn>
+        void queryFrustum(const FrustumPlanes& planes, Fn&& fn) const;
+
+        // fn(userData) for every proxy whose fat box overlaps `box`
+        template <typename Fn>
+        void queryAabb(const Aabb& box, Fn&& fn) const;
+
+        // fn(userData) for every proxy whose fat box overlaps the sphere
+        template <typename Fn>
+        void querySphere(const glm::vec3& center, float radius, Fn&& fn) const;
+
+        // Walks proxies whose fat box is hit by origin + t * direction, t in [0, maxT].
+        // fn(userData, maxT) returns the new maxT: the exact hit distance to clip the ray,
+        // maxT to continue unchanged, or 0 to stop.
+        template <typename Fn>
+        void rayCast(const glm::vec3& origin, const glm::vec3& direction, float maxT, Fn&& fn) const;
+
+    private:
+        struct Node
+        {
+            Aabb box;
+            // Parent while in the tree, next free node while on the free list
+            uint32_t parent = NULL_NODE;
+            uint32_t child1 = NULL_NODE;
+            uint32_t child2 = NULL_NODE;
+            // Leaf = 0, free = -1
+            int32_t height = -1;
+            uint32_t userData = 0;
+
+            bool isLeaf() const { return child1 == NULL_NODE; }
+        };
+
+        uint32_t allocateNode();
+        void freeNode(uint32_t node);
+        void insertLeaf(uint32_t leaf);
+        void removeLeaf(uint32_t leaf);
+        uint32_t balance(uint32_t node);
+        void refitAncestors(uint32_t node);
+        int32_t validateNode(uint32_t node) const;
+
+        template <typename Fn>
+        void reportSubtree(uint32_t node, Fn& fn) const;
+
+        std::vector<Node> nodes_;
+        uint32_t root_ = NULL_NODE;
+        uint32_t free_list_ = NULL_NODE;
+        size_t proxy_count_ = 0;
+        float margin_;
+    };
+
+    template <typename Fn>
+    void DynamicAabbTree::reportSubtree(uint32_t node, Fn& fn) const
+    {
+        thread_local std::vector<uint32_t> stack;
+        const size_t base = stack.size();
+        stack.push_back(node);
+        while (stack.size() > base)
+        {
+            const Node& n = nodes_[stack.back()];
+            stack.pop_back();
+            if (n.isLeaf())
+            {
+                fn(n.userData);
+                continue;
+            }
+            stack.push_back(n.child1);
+            stack.push_back(n.child2);
+        }
+    }
+
+    template <typename Fn>
+    void DynamicAabbTree::queryFrustum(const FrustumPlanes& planes, Fn&& fn) const
+    {
+        if (root_ == NULL_NODE) return;
+
+        // (node, bitmask of planes the node still straddles)
+        thread_local std::vector<std::pair<uint32_t, uint32_t>> stack;
+        stack.clear();
+        stack.emplace_back(root_, 0x3Fu);
+        while (!stack.empty())
+        {
+            auto [index, mask] = stack.back();
+            stack.pop_back();
+            const Node& node = nodes_[index];
+
+            const glm::vec3 center = node.box.center();
+            const glm::vec3 extents = node.box.extents();
+            bool outside = false;
+            for (uint32_t p = 0; p < 6 && !outside; ++p)
+            {
+                if (!(mask & (1u << p))) continue;
+                const glm::vec3 normal(planes[p]);
+                const float distance = glm::dot(normal, center) + planes[p].w;
+                const float radius = glm::dot(glm::abs(normal), extents);
+                if (distance + radius < 0.0f) outside = true;
+                else if (distance - radius >= 0.0f) mask &= ~(1u << p);
+            }
+            if (outside) continue;
+
+            if (node.isLeaf())
+            {
+                fn(node.userData);
+            }
+            else if (mask == 0)
+            {
+                reportSubtree(index, fn);
+            }
+            else
+            {
+                stack.emplace_back(node.child1, mask);
+                stack.emplace_back(node.child2, mask);
+            }
+        }
+    }
+
+    template <typename Fn>
+    void DynamicAabbTree::queryAabb(const Aabb& box, Fn&& fn) const
+    {
+        if (root_ == NULL_NODE) return;
+
+        thread_local std::vector<uint32_t> stack;
+        stack.clear();
+        stack.push_back(root_);
+        while (!stack.empty())
+        {
+            const Node& node = nodes_[stack.back()];
+            stack.pop_back();
+            if (!node.box.overlaps(box)) continue;
+
+            if (node.isLeaf())
+            {
+                fn(node.userData);
+            }
+            else
+            {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    template <typename Fn>
+    void DynamicAabbTree::querySphere(const glm::vec3& center, float radius, Fn&& fn) const
+    {
+        if (root_ == NULL_NODE) return;
+
+        const float radiusSquared = radius * radius;
+        thread_local std::vector<uint32_t> stack;
+        stack.clear();
+        stack.push_back(root_);
+        while (!stack.empty())
+        {
+            const Node& node = nodes_[stack.back()];
+            stack.pop_back();
+            const glm::vec3 closest = glm::clamp(center, node.box.min, node.box.max);
+            const glm::vec3 offset = closest - center;
+            if (glm::dot(offset, offset) > radiusSquared) continue;
+
+            if (node.isLeaf())
+            {
+                fn(node.userData);
+            }
+            else
+            {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    template <typename Fn>
+    void DynamicAabbTree::rayCast(const glm::vec3& origin, const glm::vec3& direction, float maxT, Fn&& fn) const
+    {
+        if (root_ == NULL_NODE) return;
+
+        // Infinities from zero components are handled by the slab test's min/max
+        const glm::vec3 inverse = 1.0f / direction;
+        thread_local std::vector<uint32_t> stack;
+        stack.clear();
+        stack.push_back(root_);
+        while (!stack.empty())
+        {
+            const Node& node = nodes_[stack.back()];
+            stack.pop_back();
+
+            const glm::vec3 t0 = (node.box.min - origin) * inverse;
+            const glm::vec3 t1 = (node.box.max - origin) * inverse;
+            const glm::vec3 tNear = glm::min(t0, t1);
+            const glm::vec3 tFar = glm::max(t0, t1);
+            const float entry = std::max({tNear.x, tNear.y, tNear.z, 0.0f});
+            const float exit = std::min({tFar.x, tFar.y, tFar.z, maxT});
+            if (entry > exit) continue;
+
+            if (node.isLeaf())
+            {
+                maxT = fn(node.userData, maxT);
+                if (maxT <= 0.0f) return;
+            }
+            else
+            {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+}
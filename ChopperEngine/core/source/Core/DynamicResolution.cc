@@ -0,0 +1,73 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Chopper
+{
+    namespace
+    {
+        // Weight of each new measurement in the smoothed frame time
+        constexpr double SMOOTHING = 0.2;
+        // The scale aims for this share of the budget, leaving room for spikes
+        constexpr double AIM = 0.9;
+        // Over the budget by this much scales down; under AIM by this much scales up
+        constexpr double DOWN_THRESHOLD = 1.0;
+        constexpr double UP_THRESHOLD = 0.85;
+        constexpr float MAX_STEP_DOWN = 0.15f;
+        constexpr float MAX_STEP_UP = 0.05f;
+        // Frames to skip after a change: the frames in flight still render at the old scale
+        constexpr uint32_t COOLDOWN_FRAMES = 8;
+        // Scales are kept on a grid so small corrections don't change the render size every frame
+        constexpr float SCALE_STEP = 1.0f / 64.0f;
+    }
+
+    void DynamicResolution::setRange(float minScale, float maxScale)
+    {
+        min_scale_ = std::clamp(minScale, SCALE_STEP, 1.0f);
+        max_scale_ = std::clamp(maxScale, min_scale_, 1.0f);
+        scale_ = std::clamp(scale_, min_scale_, max_scale_);
+    }
+
+    float DynamicResolution::update(double gpuMilliseconds)
+    {
+        if (gpuMilliseconds <= 0.0) return scale_;
+
+        smoothed_milliseconds_ = smoothed_milliseconds_ > 0.0
+                                     ? smoothed_milliseconds_ + (gpuMilliseconds - smoothed_milliseconds_) * SMOOTHING
+                                     : gpuMilliseconds;
+        if (cooldown_ > 0)
+        {
+            --cooldown_;
+            return scale_;
+        }
+
+        const double load = smoothed_milliseconds_ / target_milliseconds_;
+        if (load <= AIM * UP_THRESHOLD || load > DOWN_THRESHOLD)
+        {
+            const auto ideal = static_cast<float>(scale_ * std::sqrt(AIM / load));
+            float next = std::clamp(ideal, scale_ - MAX_STEP_DOWN, scale_ + MAX_STEP_UP);
+            next = std::clamp(std::round(next / SCALE_STEP) * SCALE_STEP, min_scale_, max_scale_);
+            if (next != scale_)
+            {
+                scale_ = next;
+                cooldown_ = COOLDOWN_FRAMES;
+            }
+        }
+        return scale_;
+    }
+
+    void DynamicResolution::reset()
+    {
+        scale_ = max_scale_;
+        smoothed_milliseconds_ = 0.0;
+        cooldown_ = 0;
+    }
+
+    uint32_t DynamicResolution::scaled(uint32_t full, float scale)
+    {
+        if (scale >= 1.0f) return full;
+        const auto pixels = static_cast<uint32_t>(std::lround(full * static_cast<double>(scale) / 8.0)) * 8;
+        return std::clamp(pixels, std::min(8u, full), full);
+    }
+}
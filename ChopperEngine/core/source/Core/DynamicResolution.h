@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Chopper
+{
+    // Picks the fraction of the output resolution to render at from measured GPU frame times.
+    // GPU time follows the pixel count, the square of the scale, so the scale moves by the
+    // square root of the headroom. It drops quickly when a frame goes over budget and climbs
+    // back slowly once there is room again, and waits a few frames after every change for the
+    // measurements to catch up, so it settles instead of oscillating.
+    class DynamicResolution
+    {
+    public:
+        void setTargetMilliseconds(double milliseconds) { target_milliseconds_ = milliseconds; }
+        void setRange(float minScale, float maxScale);
+
+        // Feeds the GPU time of one finished frame; returns the scale to render the next at
+        float update(double gpuMilliseconds);
+        // Back to full scale, forgetting past measurements
+        void reset();
+
+        float scale() const { return scale_; }
+        double targetMilliseconds() const { return target_milliseconds_; }
+        double smoothedMilliseconds() const { return smoothed_milliseconds_; }
+        float minScale() const { return min_scale_; }
+        float maxScale() const { return max_scale_; }
+
+        // `full` pixels at `scale`, rounded to a multiple of 8 and at least 8
+        static uint32_t scaled(uint32_t full, float scale);
+
+    private:
+        double target_milliseconds_ = 1000.0 / 60.0;
+        float min_scale_ = 0.5f;
+        float max_scale_ = 1.0f;
+        float scale_ = 1.0f;
+        double smoothed_milliseconds_ = 0.0;
+        uint32_t cooldown_ = 0;
+    };
+}
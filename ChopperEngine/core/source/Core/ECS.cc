@@ -0,0 +1,213 @@
+#include "ECS.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Chopper
+{
+    namespace detail
+    {
+        std::vector<ComponentInfo>& componentRegistry()
+        {
+            static std::vector<ComponentInfo> registry;
+            return registry;
+        }
+
+        ComponentId registerComponent(size_t size, size_t alignment)
+        {
+            auto& registry = componentRegistry();
+            if (registry.size() >= MAX_COMPONENT_TYPES)
+            {
+                throw std::runtime_error("too many ECS component types!");
+            }
+            // Chunks are 64-byte aligned and each column is padded by at most 64 bytes
+            if (alignment > 64)
+            {
+                throw std::runtime_error("ECS component alignment above 64 bytes!");
+            }
+            registry.push_back({size, alignment});
+            return static_cast<ComponentId>(registry.size() - 1);
+        }
+    }
+
+    Archetype::Archetype(const ComponentMask& mask)
+        : mask_(mask)
+    {
+        const auto& registry = detail::componentRegistry();
+
+        size_t rowBytes = sizeof(Entity);
+        for (ComponentId id = 0; id < MAX_COMPONENT_TYPES; ++id)
+        {
+            if (!mask_.test(id)) continue;
+            components_.push_back(id);
+            rowBytes += registry[id].size;
+        }
+
+        // Leave room for per-column alignment padding
+        const size_t padding = 64 * (components_.size() + 1);
+        if (rowBytes + padding > ECS_CHUNK_BYTES)
+        {
+            throw std::runtime_error("ECS component row does not fit in a chunk!");
+        }
+        capacity_ = static_cast<uint32_t>((ECS_CHUNK_BYTES - padding) / rowBytes);
+
+        offsets_.assign(MAX_COMPONENT_TYPES, 0);
+        size_t offset = sizeof(Entity) * capacity_;
+        for (ComponentId id : components_)
+        {
+            const size_t alignment = std::max<size_t>(registry[id].alignment, 16);
+            offset = (offset + alignment - 1) & ~(alignment - 1);
+            offsets_[id] = offset;
+            offset += registry[id].size * capacity_;
+        }
+        assert(offset <= ECS_CHUNK_BYTES);
+    }
+
+    uint32_t Archetype::size() const
+    {
+        if (chunks_.empty()) return 0;
+        return static_cast<uint32_t>(chunks_.size() - 1) * capacity_ + chunks_.back().count;
+    }
+
+    void Archetype::pushRow(Entity entity, uint32_t& chunkIndex, uint32_t& row)
+    {
+        if (chunks_.empty() || chunks_.back().count == capacity_)
+        {
+            Chunk chunk;
+            chunk.data.reset(static_cast<std::byte*>(::operator new(ECS_CHUNK_BYTES, std::align_val_t{64})));
+            chunks_.push_back(std::move(chunk));
+        }
+
+        chunkIndex = static_cast<uint32_t>(chunks_.size() - 1);
+        Chunk& chunk = chunks_.back();
+        row = chunk.count++;
+        entities(chunk)[row] = entity;
+    }
+
+    Entity Archetype::swapRemove(uint32_t chunkIndex, uint32_t row)
+    {
+        const auto& registry = detail::componentRegistry();
+
+        Chunk& last = chunks_.back();
+        const uint32_t lastRow = last.count - 1;
+        const bool removingLast = chunkIndex == chunks_.size() - 1 && row == lastRow;
+
+        Entity moved{};
+        if (!removingLast)
+        {
+            Chunk& target = chunks_[chunkIndex];
+            moved = entities(last)[lastRow];
+            entities(target)[row] = moved;
+            for (ComponentId id : components_)
+            {
+                const size_t size = registry[id].size;
+                std::memcpy(static_cast<std::byte*>(column(target, id)) + size * row,
+                            static_cast<std::byte*>(column(last, id)) + size * lastRow, size);
+            }
+        }
+
+        if (--last.count == 0) chunks_.pop_back();
+        return moved;
+    }
+
+    Entity World::allocateEntity()
+    {
+        alive_count_++;
+        if (!free_list_.empty())
+        {
+            const uint32_t index = free_list_.back();
+            free_list_.pop_back();
+            return {index, records_[index].generation};
+        }
+        records_.emplace_back();
+        return {static_cast<uint32_t>(records_.size() - 1), 0};
+    }
+
+    bool World::alive(Entity entity) const
+    {
+        return entity.index < records_.size() && records_[entity.index].archetype != nullptr &&
+            records_[entity.index].generation == entity.generation;
+    }
+
+    void World::removeRow(Archetype& archetype, uint32_t chunkIndex, uint32_t row)
+    {
+        const Entity moved = archetype.swapRemove(chunkIndex, row);
+        if (moved.valid())
+        {
+            records_[moved.index].chunk = chunkIndex;
+            records_[moved.index].row = row;
+        }
+    }
+
+    void World::destroy(Entity entity)
+    {
+        if (!alive(entity)) return;
+
+        Record& record = records_[entity.index];
+        removeRow(*record.archetype, record.chunk, record.row);
+
+        record.archetype = nullptr;
+        record.generation++;
+        free_list_.push_back(entity.index);
+        alive_count_--;
+    }
+
+    Archetype& World::archetypeFor(const ComponentMask& mask)
+    {
+        auto it = archetype_lookup_.find(mask);
+        if (it != archetype_lookup_.end()) return *it->second;
+
+        archetypes_.push_back(std::make_unique<Archetype>(mask));
+        Archetype* archetype = archetypes_.back().get();
+        archetype_lookup_.emplace(mask, archetype);
+
+        // Keep cached queries current instead of dropping them
+        for (auto& [queryMask, list] : query_cache_)
+        {
+            if ((mask & queryMask) == queryMask) list.push_back(archetype);
+        }
+        return *archetype;
+    }
+
+    const std::vector<Archetype*>& World::matching(const ComponentMask& mask)
+    {
+        auto it = query_cache_.find(mask);
+        if (it != query_cache_.end()) return it->second;
+
+        std::vector<Archetype*> list;
+        for (auto& archetype : archetypes_)
+        {
+            if ((archetype->mask() & mask) == mask) list.push_back(archetype.get());
+        }
+        return query_cache_.emplace(mask, std::move(list)).first->second;
+    }
+
+    void World::migrate(Entity entity, const ComponentMask& mask)
+    {
+        assert(alive(entity));
+        Record& record = records_[entity.index];
+        Archetype& source = *record.archetype;
+        if (source.mask() == mask) return;
+
+        Archetype& target = archetypeFor(mask);
+        uint32_t chunkIndex, row;
+        target.pushRow(entity, chunkIndex, row);
+
+        // Copy the components both archetypes share; new ones are left for the caller
+        const auto& registry = detail::componentRegistry();
+        Chunk& from = source.chunk(record.chunk);
+        Chunk& to = target.chunk(chunkIndex);
+        for (ComponentId id : target.components())
+        {
+            if (!source.mask().test(id)) continue;
+            const size_t size = registry[id].size;
+            std::memcpy(static_cast<std::byte*>(target.column(to, id)) + size * row,
+                        static_cast<std::byte*>(source.column(from, id)) + size * record.row, size);
+        }
+
+        removeRow(source, record.chunk, record.row);
+        record.archetype = &target;
+        record.chunk = chunkIndex;
+        record.row = row;
+    }
+}
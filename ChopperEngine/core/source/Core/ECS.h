@@ -0,0 +1,234 @@
+#pragma once
+
+#include <bitset>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace Chopper
+{
+    // Archetype-based entity-component system. Entities with the same set of components
+    // share an archetype; each archetype stores its entities in fixed-size chunks laid out
+    // as one contiguous array per component (structure of arrays). Components must be
+    // trivially copyable so rows can be moved with memcpy.
+
+    constexpr uint32_t MAX_COMPONENT_TYPES = 64;
+    constexpr size_t ECS_CHUNK_BYTES = 16 * 1024;
+
+    using ComponentId = uint32_t;
+    using ComponentMask = std::bitset<MAX_COMPONENT_TYPES>;
+
+    struct Entity
+    {
+        uint32_t index = ~0u;
+        uint32_t generation = 0;
+
+        bool valid() const { return index != ~0u; }
+        bool operator==(const Entity& other) const = default;
+    };
+
+    struct ComponentInfo
+    {
+        size_t size = 0;
+        size_t alignment = 0;
+    };
+
+    namespace detail
+    {
+        std::vector<ComponentInfo>& componentRegistry();
+        ComponentId registerComponent(size_t size, size_t alignment);
+    }
+
+    template <typename T>
+    ComponentId componentId()
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "ECS components must be trivially copyable");
+        static const ComponentId id = detail::registerComponent(sizeof(T), alignof(T));
+        return id;
+    }
+
+    template <typename... Ts>
+    ComponentMask componentMask()
+    {
+        ComponentMask mask;
+        (mask.set(componentId<Ts>()), ...);
+        return mask;
+    }
+
+    struct Chunk
+    {
+        struct Deleter
+        {
+            void operator()(std::byte* data) const { ::operator delete(data, std::align_val_t{64}); }
+        };
+
+        std::unique_ptr<std::byte[], Deleter> data;
+        uint32_t count = 0;
+    };
+
+    class Archetype
+    {
+    public:
+        explicit Archetype(const ComponentMask& mask);
+
+        const ComponentMask& mask() const { return mask_; }
+        uint32_t capacity() const { return capacity_; }
+        size_t chunkCount() const { return chunks_.size(); }
+        uint32_t size() const;
+
+        Chunk& chunk(size_t index) { return chunks_[index]; }
+
+        Entity* entities(Chunk& chunk) const { return reinterpret_cast<Entity*>(chunk.data.get()); }
+
+        void* column(Chunk& chunk, ComponentId id) const
+        {
+            assert(mask_.test(id));
+            return chunk.data.get() + offsets_[id];
+        }
+
+        template <typename T>
+        T* column(Chunk& chunk) const { return static_cast<T*>(column(chunk, componentId<T>())); }
+
+        // Appends an uninitialised row and returns its location
+        void pushRow(Entity entity, uint32_t& chunkIndex, uint32_t& row);
+
+        // Removes a row by moving the archetype's last row into it. Returns the entity that
+        // was moved, or an invalid entity if the removed row was the last one.
+        Entity swapRemove(uint32_t chunkIndex, uint32_t row);
+
+        const std::vector<ComponentId>& components() const { return components_; }
+
+    private:
+        ComponentMask mask_;
+        std::vector<ComponentId> components_;
+        std::vector<size_t> offsets_;
+        uint32_t capacity_ = 0;
+        std::vector<Chunk> chunks_;
+    };
+
+    // Not thread-safe: create, destroy, add, remove and archetype lookups belong to the main
+    // thread. Jobs it spawns may read and write component values of disjoint chunks, but must
+    // not change the structure of the world while they run.
+    class World
+    {
+    public:
+        World() = default;
+        World(const World&) = delete;
+        World& operator=(const World&) = delete;
+
+        template <typename... Ts>
+        Entity create(const Ts&... components)
+        {
+            Archetype& archetype = archetypeFor(componentMask<Ts...>());
+            Entity entity = allocateEntity();
+            Record& record = records_[entity.index];
+            record.archetype = &archetype;
+            archetype.pushRow(entity, record.chunk, record.row);
+
+            Chunk& chunk = archetype.chunk(record.chunk);
+            ((archetype.column<Ts>(chunk)[record.row] = components), ...);
+            return entity;
+        }
+
+        void destroy(Entity entity);
+        bool alive(Entity entity) const;
+        size_t size() const { return alive_count_; }
+
+        template <typename T>
+        bool has(Entity entity) const
+        {
+            return alive(entity) && records_[entity.index].archetype->mask().test(componentId<T>());
+        }
+
+        template <typename T>
+        T& get(Entity entity)
+        {
+            assert(has<T>(entity));
+            const Record& record = records_[entity.index];
+            return record.archetype->column<T>(record.archetype->chunk(record.chunk))[record.row];
+        }
+
+        // Moves the entity to the archetype that additionally contains T
+        template <typename T>
+        T& add(Entity entity, const T& component = {})
+        {
+            ComponentMask mask = records_[entity.index].archetype->mask();
+            mask.set(componentId<T>());
+            migrate(entity, mask);
+            T& stored = get<T>(entity);
+            stored = component;
+            return stored;
+        }
+
+        template <typename T>
+        void remove(Entity entity)
+        {
+            ComponentMask mask = records_[entity.index].archetype->mask();
+            mask.reset(componentId<T>());
+            migrate(entity, mask);
+        }
+
+        // Calls fn(count, const Entity*, Ts*...) once per chunk holding all of Ts. This is
+        // the fast path: every pointer is a dense array of `count` elements.
+        template <typename... Ts, typename F>
+        void eachChunk(F&& fn)
+        {
+            for (Archetype* archetype : matching(componentMask<Ts...>()))
+            {
+                for (size_t c = 0; c < archetype->chunkCount(); ++c)
+                {
+                    Chunk& chunk = archetype->chunk(c);
+                    if (chunk.count == 0) continue;
+                    fn(chunk.count, archetype->entities(chunk), archetype->column<Ts>(chunk)...);
+                }
+            }
+        }
+
+        // Calls fn(Entity, Ts&...) for every entity holding all of Ts
+        template <typename... Ts, typename F>
+        void each(F&& fn)
+        {
+            eachChunk<Ts...>([&fn](uint32_t count, const Entity* entities, Ts*... columns)
+            {
+                for (uint32_t i = 0; i < count; ++i) fn(entities[i], columns[i]...);
+            });
+        }
+
+        template <typename... Ts>
+        size_t count()
+        {
+            size_t total = 0;
+            for (Archetype* archetype : matching(componentMask<Ts...>())) total += archetype->size();
+            return total;
+        }
+
+    private:
+        struct Record
+        {
+            Archetype* archetype = nullptr;
+            uint32_t chunk = 0;
+            uint32_t row = 0;
+            uint32_t generation = 0;
+        };
+
+        Entity allocateEntity();
+        Archetype& archetypeFor(const ComponentMask& mask);
+        const std::vector<Archetype*>& matching(const ComponentMask& mask);
+        void removeRow(Archetype& archetype, uint32_t chunkIndex, uint32_t row);
+        void migrate(Entity entity, const ComponentMask& mask);
+
+        std::vector<std::unique_ptr<Archetype>> archetypes_;
+        std::unordered_map<ComponentMask, Archetype*> archetype_lookup_;
+        std::unordered_map<ComponentMask, std::vector<Archetype*>> query_cache_;
+
+        std::vector<Record> records_;
+        std::vector<uint32_t> free_list_;
+        size_t alive_count_ = 0;
+    };
+}
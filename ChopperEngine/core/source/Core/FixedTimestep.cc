@@ -0,0 +1,75 @@
+#include "FixedTimestep.h"
+
+#include <algorithm>
+
+#include <glm/gtc/quaternion.hpp>
+
+namespace Chopper
+{
+    namespace
+    {
+        // Below this a basis column has no usable direction
+        constexpr float MIN_AXIS_SCALE = 1e-6f;
+
+        // Rotation of an affine transform with the given per-axis scale; false when degenerate
+        bool rotationOf(const glm::mat4& transform, const glm::vec3& scale, glm::quat& rotation)
+        {
+            if (glm::min(scale.x, glm::min(scale.y, scale.z)) < MIN_AXIS_SCALE) return false;
+            rotation = glm::quat_cast(glm::mat3(glm::vec3(transform[0]) / scale.x,
+                                                glm::vec3(transform[1]) / scale.y,
+                                                glm::vec3(transform[2]) / scale.z));
+            return true;
+        }
+    }
+
+    FixedTimestep::FixedTimestep(double stepSeconds, uint32_t maxSteps)
+        : step_(stepSeconds), max_steps_(std::max(1u, maxSteps))
+    {
+    }
+
+    void FixedTimestep::setStep(double stepSeconds)
+    {
+        // Keep the banked time's fraction of a step, so the interpolation point doesn't jump
+        const double fraction = accumulator_ / step_;
+        step_ = stepSeconds;
+        accumulator_ = fraction * step_;
+    }
+
+    uint32_t FixedTimestep::advance(double frameSeconds)
+    {
+        accumulator_ += std::max(0.0, frameSeconds);
+        uint32_t steps = static_cast<uint32_t>(accumulator_ / step_);
+        accumulator_ -= steps * step_;
+        if (steps > max_steps_)
+        {
+            dropped_steps_ += steps - max_steps_;
+            steps = max_steps_;
+        }
+        step_count_ += steps;
+        return steps;
+    }
+
+    glm::mat4 interpolateTransform(const glm::mat4& from, const glm::mat4& to, float t)
+    {
+        const glm::vec3 fromScale(glm::length(glm::vec3(from[0])), glm::length(glm::vec3(from[1])),
+                                  glm::length(glm::vec3(from[2])));
+        const glm::vec3 toScale(glm::length(glm::vec3(to[0])), glm::length(glm::vec3(to[1])),
+                                glm::length(glm::vec3(to[2])));
+        glm::quat fromRotation(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::quat toRotation(1.0f, 0.0f, 0.0f, 0.0f);
+        const bool fromValid = rotationOf(from, fromScale, fromRotation);
+        const bool toValid = rotationOf(to, toScale, toRotation);
+        if (!fromValid) fromRotation = toRotation;
+        if (!toValid) toRotation = fromRotation;
+
+        // glm::slerp() takes the shortest path
+        const glm::mat3 rotation = glm::mat3_cast(glm::slerp(fromRotation, toRotation, t));
+        const glm::vec3 scale = glm::mix(fromScale, toScale, t);
+        glm::mat4 result(1.0f);
+        result[0] = glm::vec4(rotation[0] * scale.x, 0.0f);
+        result[1] = glm::vec4(rotation[1] * scale.y, 0.0f);
+        result[2] = glm::vec4(rotation[2] * scale.z, 0.0f);
+        result[3] = glm::mix(from[3], to[3], t);
+        return result;
+    }
+}
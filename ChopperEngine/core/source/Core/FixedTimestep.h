@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+namespace Chopper
+{
+    // Accumulator for a simulation that advances in fixed steps, independent of the frame rate.
+    // Frame time is banked and spent one step at a time; what is left over is the fraction of a
+    // step the renderer interpolates across. At most maxSteps run per frame, so a long frame does
+    // not make the next one longer still (the "spiral of death"): the excess time is dropped and
+    // the simulation runs slower than real time until the frame rate recovers.
+    class FixedTimestep
+    {
+    public:
+        explicit FixedTimestep(double stepSeconds = 1.0 / 60.0, uint32_t maxSteps = 8);
+
+        // Banks frameSeconds and returns the number of steps to run now
+        uint32_t advance(double frameSeconds);
+
+        void setStep(double stepSeconds);
+        // At least one step runs per frame that has banked one
+        void setMaxSteps(uint32_t maxSteps) { max_steps_ = maxSteps > 0 ? maxSteps : 1; }
+
+        double step() const { return step_; }
+        uint32_t maxSteps() const { return max_steps_; }
+        // Fraction of a step banked after the last advance(), in [0, 1)
+        float alpha() const { return static_cast<float>(accumulator_ / step_); }
+        uint64_t stepCount() const { return step_count_; }
+        uint64_t droppedSteps() const { return dropped_steps_; }
+
+    private:
+        double step_;
+        uint32_t max_steps_;
+        double accumulator_ = 0.0;
+        uint64_t step_count_ = 0;
+        uint64_t dropped_steps_ = 0;
+    };
+
+    // Blends two affine transforms: translation and scale linearly, rotation along the shortest
+    // arc. Shear is not preserved. A transform scaled to zero on some axis has no rotation of its
+    // own, so the other transform's rotation is used throughout.
+    glm::mat4 interpolateTransform(const glm::mat4& from, const glm::mat4& to, float t);
+}
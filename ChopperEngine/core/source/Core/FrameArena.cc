@@ -0,0 +1,53 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+
+namespace Chopper
+{
+    namespace
+    {
+        size_t alignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    FrameArena::FrameArena(size_t capacity)
+        : block_(new std::byte[capacity]), capacity_(capacity)
+    {
+    }
+
+    void* FrameArena::allocate(size_t size, size_t alignment)
+    {
+        // new[] aligns the block to max_align_t; larger alignments are padded within it
+        const auto base = reinterpret_cast<uintptr_t>(block_.get());
+        const size_t start = alignUp(base + offset_, alignment) - base;
+        if (start + size <= capacity_)
+        {
+            used_ += start + size - offset_;
+            offset_ = start + size;
+            return block_.get() + start;
+        }
+
+        // Overflow: a block of its own for this allocation, until reset() grows the arena
+        const size_t padded = size + alignment;
+        overflow_.push_back(std::unique_ptr<std::byte[]>(new std::byte[padded]));
+        used_ += padded;
+        const auto overflowBase = reinterpret_cast<uintptr_t>(overflow_.back().get());
+        return overflow_.back().get() + (alignUp(overflowBase, alignment) - overflowBase);
+    }
+
+    void FrameArena::reset()
+    {
+        peak_ = std::max(peak_, used_);
+        if (!overflow_.empty())
+        {
+            // Headroom so a slowly growing frame doesn't reallocate every time
+            capacity_ = std::max(capacity_ * 2, peak_ + peak_ / 2);
+            block_.reset(new std::byte[capacity_]);
+            overflow_.clear();
+        }
+        offset_ = 0;
+        used_ = 0;
+    }
+}
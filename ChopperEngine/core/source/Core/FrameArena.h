@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Chopper
+{
+    // Linear allocator for data that lives for one frame. allocate() bumps an offset and reset()
+    // takes everything back at once; nothing is freed on its own. When a frame needs more than
+    // the block holds, the rest comes from overflow blocks, and the next reset() replaces the
+    // block with one that fits the peak, so a steady frame loop stops touching the heap.
+    // One thread only: each thread that wants one owns its own.
+    class FrameArena
+    {
+    public:
+        explicit FrameArena(size_t capacity = 64 * 1024);
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        template <typename T>
+        T* allocateArray(size_t count)
+        {
+            return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        }
+
+        // Invalidates everything allocated since the previous reset()
+        void reset();
+
+        size_t capacity() const { return capacity_; }
+        // Bytes handed out since the last reset(), overflow included
+        size_t used() const { return used_; }
+        // Most bytes any frame has used
+        size_t peak() const { return peak_; }
+
+    private:
+        std::unique_ptr<std::byte[]> block_;
+        size_t capacity_ = 0;
+        size_t offset_ = 0;
+        size_t used_ = 0;
+        size_t peak_ = 0;
+        std::vector<std::unique_ptr<std::byte[]>> overflow_;
+    };
+
+    // STL allocator over a FrameArena. deallocate() does nothing, so containers using it must not
+    // outlive the arena's next reset().
+    template <typename T>
+    class ArenaAllocator
+    {
+    public:
+        using value_type = T;
+
+        explicit ArenaAllocator(FrameArena& arena) noexcept : arena_(&arena) {}
+
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena_(other.arena()) {}
+
+        T* allocate(size_t count) { return arena_->allocateArray<T>(count); }
+        void deallocate(T*, size_t) noexcept {}
+
+        FrameArena* arena() const noexcept { return arena_; }
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena_ == other.arena(); }
+
+    private:
+        FrameArena* arena_;
+    };
+
+    template <typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
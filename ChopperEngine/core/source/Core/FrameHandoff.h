@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Chopper
+{
+    // Double-buffered single-producer/single-consumer handoff of frame data. The producer fills
+    // one slot while the consumer reads the other; a slot changes hands with an atomic store, so
+    // neither side takes a lock, and a side only blocks when it is a full slot ahead of the other.
+    // Slots are reused, so containers inside T keep their capacity from frame to frame.
+    template <typename T>
+    class FrameHandoff
+    {
+    public:
+        // Producer: the slot to fill next. Blocks while the consumer still reads it.
+        T& beginWrite()
+        {
+            Slot& slot = slots_[write_];
+            slot.state.wait(READY, std::memory_order_acquire);
+            return slot.value;
+        }
+
+        // Producer: beginWrite() without blocking; nullptr while the consumer still reads the slot
+        T* tryBeginWrite()
+        {
+            Slot& slot = slots_[write_];
+            if (slot.state.load(std::memory_order_acquire) == READY) return nullptr;
+            return &slot.value;
+        }
+
+        // Producer: hands the slot returned by beginWrite() to the consumer
+        void publish()
+        {
+            Slot& slot = slots_[write_];
+            slot.state.store(READY, std::memory_order_release);
+            slot.state.notify_all();
+            write_ ^= 1;
+        }
+
+        // Producer: waits until the consumer has released every published slot
+        void drain()
+        {
+            for (Slot& slot : slots_)
+            {
+                slot.state.wait(READY, std::memory_order_acquire);
+            }
+        }
+
+        // Producer: the consumer's beginRead() returns nullptr once it has read everything
+        // published before this call
+        void close()
+        {
+            Slot& slot = slots_[write_];
+            slot.state.wait(READY, std::memory_order_acquire);
+            slot.state.store(CLOSED, std::memory_order_release);
+            slot.state.notify_all();
+        }
+
+        // Consumer: the next published slot, or nullptr after close(). Blocks until one arrives.
+        T* beginRead()
+        {
+            Slot& slot = slots_[read_];
+            slot.state.wait(FREE, std::memory_order_acquire);
+            if (slot.state.load(std::memory_order_acquire) == CLOSED) return nullptr;
+            return &slot.value;
+        }
+
+        // Consumer: returns the slot from beginRead() to the producer. Writes made to it are
+        // visible to the producer's next beginWrite() of that slot.
+        void endRead()
+        {
+            Slot& slot = slots_[read_];
+            slot.state.store(FREE, std::memory_order_release);
+            slot.state.notify_all();
+            read_ ^= 1;
+        }
+
+    private:
+        static constexpr uint32_t FREE = 0;
+        static constexpr uint32_t READY = 1;
+        static constexpr uint32_t CLOSED = 2;
+
+        struct alignas(64) Slot
+        {
+            std::atomic<uint32_t> state{FREE};
+            T value{};
+        };
+
+        Slot slots_[2];
+        // Only touched by their own side
+        alignas(64) uint32_t write_ = 0;
+        alignas(64) uint32_t read_ = 0;
+    };
+}
@@ -0,0 +1,51 @@
+#include "FrameLimiter.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace Chopper
+{
+    namespace
+    {
+        constexpr std::chrono::microseconds MIN_SPIN_MARGIN{200};
+    }
+
+    void FrameLimiter::setTargetFps(double fps)
+    {
+        target_fps_ = std::max(1.0, fps);
+        target_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / target_fps_));
+    }
+
+    void FrameLimiter::wait()
+    {
+        const Clock::time_point start = Clock::now();
+        deadline_ += target_;
+        if (deadline_ <= start)
+        {
+            deadline_ = start;
+            wait_milliseconds_ = 0.0;
+            spin_milliseconds_ = 0.0;
+            return;
+        }
+
+        const Clock::duration margin = std::max<Clock::duration>(MIN_SPIN_MARGIN, oversleep_ * 2);
+        if (deadline_ - start > margin)
+        {
+            const Clock::time_point wake = deadline_ - margin;
+            std::this_thread::sleep_until(wake);
+            // 1/8 weight: a single late wake-up widens the margin only a little
+            const Clock::duration late = std::max<Clock::duration>(Clock::now() - wake, Clock::duration::zero());
+            oversleep_ += (late - oversleep_) / 8;
+        }
+
+        const Clock::time_point spinStart = Clock::now();
+        while (Clock::now() < deadline_)
+        {
+            std::this_thread::yield();
+        }
+
+        const Clock::time_point end = Clock::now();
+        wait_milliseconds_ = std::chrono::duration<double, std::milli>(end - start).count();
+        spin_milliseconds_ = std::chrono::duration<double, std::milli>(end - spinStart).count();
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+
+namespace Chopper
+{
+    // Holds a loop to a target frame time on the CPU. Sleeping is cheap but wakes late by up to
+    // the scheduler's granularity (about 1 ms, or 15.6 ms on a default Windows timer), so the
+    // limiter sleeps until a margin before the deadline and spins through the rest. The margin
+    // follows the oversleep it measures.
+    class FrameLimiter
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        void setTargetFps(double fps);
+        double targetFps() const { return target_fps_; }
+
+        // Blocks until a target frame time has passed since the previous deadline. A loop that
+        // fell behind starts over from now instead of running fast to catch up.
+        void wait();
+
+        // Time the last wait() blocked, and how much of it was spent spinning
+        double waitMilliseconds() const { return wait_milliseconds_; }
+        double spinMilliseconds() const { return spin_milliseconds_; }
+
+    private:
+        double target_fps_ = 60.0;
+        Clock::duration target_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / 60.0));
+        Clock::time_point deadline_{};
+        // Smoothed oversleep of sleep_until(); the spin margin is a multiple of it
+        Clock::duration oversleep_ = std::chrono::microseconds(500);
+        double wait_milliseconds_ = 0.0;
+        double spin_milliseconds_ = 0.0;
+    };
+}
@@ -0,0 +1,156 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "FrustumCullingImpl.h"
+#include "Parallel.h"
+
+namespace Chopper
+{
+    namespace
+    {
+        // Spheres per worker batch; each batch compacts into its own slice of the output
+        constexpr size_t CULL_BATCH = 16384;
+
+        size_t cullRange(const BoundingSphereSet& spheres, size_t begin, size_t end, const float* planes,
+                         uint32_t* visible)
+        {
+            const float* x = spheres.x();
+            const float* y = spheres.y();
+            const float* z = spheres.z();
+            const float* r = spheres.radius();
+
+            switch (Simd::level())
+            {
+            case Simd::Level::AVX2:
+                return detail::cullSpheresAvx2(x, y, z, r, begin, end, planes, visible);
+#if defined(CHOPPER_SIMD_SSE2)
+            case Simd::Level::SSE2:
+                return Simd::cullRangeSse2(x, y, z, r, begin, end, planes, visible);
+#endif
+            default:
+                return Simd::cullRangeScalar(x, y, z, r, begin, end, planes, visible);
+            }
+        }
+    }
+
+    MeshBounds computeMeshBounds(const std::vector<Vertex>& vertices)
+    {
+        MeshBounds bounds{};
+        if (vertices.empty()) return bounds;
+
+        bounds.min = bounds.max = vertices[0].pos;
+        for (const Vertex& vertex : vertices)
+        {
+            bounds.min = glm::min(bounds.min, vertex.pos);
+            bounds.max = glm::max(bounds.max, vertex.pos);
+        }
+
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (const Vertex& vertex : vertices)
+        {
+            const glm::vec3 offset = vertex.pos - bounds.center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        bounds.radius = std::sqrt(radiusSquared);
+        return bounds;
+    }
+
+    FrustumPlanes extractFrustumPlanes(const glm::mat4& viewProj)
+    {
+        // Rows of the column-major matrix (Gribb/Hartmann)
+        const glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+        const glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+        const glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+        const glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+        FrustumPlanes planes = {
+            row3 + row0, // left
+            row3 - row0, // right
+            row3 + row1, // bottom
+            row3 - row1, // top
+            row2, // near (depth >= 0); far with reversed-Z
+            row3 - row2 // far (depth <= 1); near with reversed-Z
+        };
+        for (glm::vec4& plane : planes)
+        {
+            // An infinite far plane comes out with no normal; it culls nothing
+            const float length = glm::length(glm::vec3(plane));
+            plane = length > 1e-6f ? plane / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+        return planes;
+    }
+
+    void BoundingSphereSet::resize(size_t count)
+    {
+        x_.resize(count, 0.0f);
+        y_.resize(count, 0.0f);
+        z_.resize(count, 0.0f);
+        radius_.resize(count, -FLT_MAX);
+    }
+
+    void BoundingSphereSet::set(size_t index, const glm::vec3& center, float radius)
+    {
+        x_[index] = center.x;
+        y_[index] = center.y;
+        z_[index] = center.z;
+        radius_[index] = radius;
+    }
+
+    void BoundingSphereSet::set(size_t index, const MeshBounds& bounds, const glm::mat4& world)
+    {
+        const glm::vec3 center = glm::vec3(world * glm::vec4(bounds.center, 1.0f));
+        const float scale = std::sqrt(std::max({
+            glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+            glm::dot(glm::vec3(world[1]), glm::vec3(world[1])),
+            glm::dot(glm::vec3(world[2]), glm::vec3(world[2]))
+        }));
+        set(index, center, bounds.radius * scale);
+    }
+
+    void BoundingSphereSet::clear(size_t index)
+    {
+        set(index, glm::vec3(0.0f), -FLT_MAX);
+    }
+
+    size_t frustumCullSpheres(const BoundingSphereSet& spheres, size_t count, const FrustumPlanes& planes,
+                              uint32_t* visible)
+    {
+        return cullRange(spheres, 0, count, &planes[0].x, visible);
+    }
+
+    size_t frustumCullSpheresParallel(const BoundingSphereSet& spheres, size_t count, const FrustumPlanes& planes,
+                                      uint32_t* visible)
+    {
+        const size_t batches = (count + CULL_BATCH - 1) / CULL_BATCH;
+        if (batches <= 1) return frustumCullSpheres(spheres, count, planes, visible);
+
+        // Reused per calling thread. The workers must write to the caller's vector, and a lambda names
+        // a thread_local directly rather than capturing it, so they reach it through a reference.
+        thread_local std::vector<size_t> callerBatchCounts;
+        std::vector<size_t>& batchCounts = callerBatchCounts;
+        batchCounts.resize(batches);
+        parallelFor(batches, 1, [&](size_t first, size_t last)
+        {
+            for (size_t b = first; b < last; ++b)
+            {
+                const size_t begin = b * CULL_BATCH;
+                const size_t end = std::min(begin + CULL_BATCH, count);
+                batchCounts[b] = cullRange(spheres, begin, end, &planes[0].x, visible + begin);
+            }
+        });
+
+        // Close the gaps between batch slices; destinations never pass their sources
+        size_t total = batchCounts[0];
+        for (size_t b = 1; b < batches; ++b)
+        {
+            std::memmove(visible + total, visible + b * CULL_BATCH, batchCounts[b] * sizeof(uint32_t));
+            total += batchCounts[b];
+        }
+        return total;
+    }
+}
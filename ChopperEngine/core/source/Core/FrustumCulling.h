@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+namespace Chopper
+{
+    // Object-space bounds of a mesh, computed once at import
+    struct MeshBounds
+    {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+    };
+
+    // AABB of the vertices and a sphere around the AABB center enclosing every vertex
+    MeshBounds computeMeshBounds(const std::vector<Vertex>& vertices);
+
+    // Frustum planes as (normal, distance) with normals pointing inwards:
+    // a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all six
+    using FrustumPlanes = std::array<glm::vec4, 6>;
+
+    // Extracts normalized planes from a projection * view matrix with a [0, 1] depth range, in
+    // either direction and with the far plane possibly at infinity
+    FrustumPlanes extractFrustumPlanes(const glm::mat4& viewProj);
+
+    // World-space bounding spheres stored as structure of arrays, indexed by Renderable::slot.
+    // Cleared entries never pass a culling test.
+    class BoundingSphereSet
+    {
+    public:
+        void resize(size_t count);
+        void set(size_t index, const glm::vec3& center, float radius);
+        // Transforms mesh bounds into world space (radius scaled by the largest axis scale)
+        void set(size_t index, const MeshBounds& bounds, const glm::mat4& world);
+        void clear(size_t index);
+
+        size_t size() const { return radius_.size(); }
+        const float* x() const { return x_.data(); }
+        const float* y() const { return y_.data(); }
+        const float* z() const { return z_.data(); }
+        const float* radius() const { return radius_.data(); }
+
+    private:
+        std::vector<float> x_;
+        std::vector<float> y_;
+        std::vector<float> z_;
+        std::vector<float> radius_;
+    };
+
+    // Tests spheres [0, count) against the frustum, 4 or 8 at a time with SSE2/AVX2, and writes
+    // the indices of the visible ones to `visible` in ascending order. `visible` must hold
+    // `count` entries. Returns the number of visible spheres.
+    size_t frustumCullSpheres(const BoundingSphereSet& spheres, size_t count, const FrustumPlanes& planes,
+                              uint32_t* visible);
+
+    // Same as frustumCullSpheres(), split into batches across worker threads
+    size_t frustumCullSpheresParallel(const BoundingSphereSet& spheres, size_t count, const FrustumPlanes& planes,
+                                      uint32_t* visible);
+
+    namespace detail
+    {
+        size_t cullSpheresAvx2(const float* x, const float* y, const float* z, const float* radius, size_t begin,
+                               size_t end, const float* planes, uint32_t* visible);
+    }
+}
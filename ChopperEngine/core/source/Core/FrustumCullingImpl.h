@@ -0,0 +1,112 @@
+#pragma once
+
+// Kernel body shared by FrustumCulling.cc (scalar, SSE2) and FrustumCulling_avx2.cc.
+// Include only from those translation units.
+
+#include <bit>
+
+#include "SimdMath.h"
+
+namespace Chopper::Simd
+{
+    namespace
+    {
+        // `planes` holds six (nx, ny, nz, d) planes; writes absolute indices of visible spheres
+        inline size_t cullRangeScalar(const float* x, const float* y, const float* z, const float* radius,
+                                      size_t begin, size_t end, const float* planes, uint32_t* visible)
+        {
+            size_t count = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                bool inside = true;
+                for (int p = 0; p < 6; ++p)
+                {
+                    const float* plane = planes + p * 4;
+                    const float distance = x[i] * plane[0] + y[i] * plane[1] + z[i] * plane[2] + plane[3];
+                    inside &= distance + radius[i] >= 0.0f;
+                }
+                visible[count] = static_cast<uint32_t>(i);
+                count += inside;
+            }
+            return count;
+        }
+
+        // Appends the lanes set in `bits` as indices starting at `base`
+        inline size_t appendLanes(unsigned bits, size_t base, uint32_t* visible)
+        {
+            size_t count = 0;
+            while (bits)
+            {
+                visible[count++] = static_cast<uint32_t>(base + std::countr_zero(bits));
+                bits &= bits - 1;
+            }
+            return count;
+        }
+
+#if defined(CHOPPER_SIMD_SSE2)
+        inline size_t cullRangeSse2(const float* x, const float* y, const float* z, const float* radius,
+                                    size_t begin, size_t end, const float* planes, uint32_t* visible)
+        {
+            __m128 plane[6][4];
+            for (int p = 0; p < 6; ++p)
+            {
+                for (int c = 0; c < 4; ++c) plane[p][c] = _mm_set1_ps(planes[p * 4 + c]);
+            }
+
+            const __m128 zero = _mm_setzero_ps();
+            size_t count = 0;
+            size_t i = begin;
+            for (; i + 4 <= end; i += 4)
+            {
+                const __m128 px = _mm_loadu_ps(x + i);
+                const __m128 py = _mm_loadu_ps(y + i);
+                const __m128 pz = _mm_loadu_ps(z + i);
+                const __m128 r = _mm_loadu_ps(radius + i);
+
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int p = 0; p < 6; ++p)
+                {
+                    const __m128 distance = madd(px, plane[p][0], madd(py, plane[p][1], madd(pz, plane[p][2],
+                                                                                             plane[p][3])));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+                }
+                count += appendLanes(static_cast<unsigned>(_mm_movemask_ps(inside)), i, visible + count);
+            }
+            return count + cullRangeScalar(x, y, z, radius, i, end, planes, visible + count);
+        }
+#endif
+
+#if defined(__AVX2__)
+        inline size_t cullRangeAvx2(const float* x, const float* y, const float* z, const float* radius,
+                                    size_t begin, size_t end, const float* planes, uint32_t* visible)
+        {
+            __m256 plane[6][4];
+            for (int p = 0; p < 6; ++p)
+            {
+                for (int c = 0; c < 4; ++c) plane[p][c] = _mm256_set1_ps(planes[p * 4 + c]);
+            }
+
+            const __m256 zero = _mm256_setzero_ps();
+            size_t count = 0;
+            size_t i = begin;
+            for (; i + 8 <= end; i += 8)
+            {
+                const __m256 px = _mm256_loadu_ps(x + i);
+                const __m256 py = _mm256_loadu_ps(y + i);
+                const __m256 pz = _mm256_loadu_ps(z + i);
+                const __m256 r = _mm256_loadu_ps(radius + i);
+
+                __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (int p = 0; p < 6; ++p)
+                {
+                    const __m256 distance = madd(px, plane[p][0], madd(py, plane[p][1], madd(pz, plane[p][2],
+                                                                                             plane[p][3])));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_GE_OQ));
+                }
+                count += appendLanes(static_cast<unsigned>(_mm256_movemask_ps(inside)), i, visible + count);
+            }
+            return count + cullRangeScalar(x, y, z, radius, i, end, planes, visible + count);
+        }
+#endif
+    }
+}
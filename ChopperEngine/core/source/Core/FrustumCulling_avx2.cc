@@ -0,0 +1,17 @@
+// Compiled with AVX2 + FMA code generation, see Build-Core.lua
+#include "FrustumCulling.h"
+
+#include "FrustumCullingImpl.h"
+
+namespace Chopper::detail
+{
+    size_t cullSpheresAvx2(const float* x, const float* y, const float* z, const float* radius, size_t begin,
+                           size_t end, const float* planes, uint32_t* visible)
+    {
+#if defined(__AVX2__)
+        return Simd::cullRangeAvx2(x, y, z, radius, begin, end, planes, visible);
+#else
+        return Simd::cullRangeScalar(x, y, z, radius, begin, end, planes, visible);
+#endif
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace Chopper
+{
+    template <typename Signature>
+    class FunctionRef;
+
+    // Non-owning reference to a callable, for parameters that are only called during the call
+    // they are passed to. Unlike std::function it never allocates, whatever the callable
+    // captures. The callable must outlive the FunctionRef.
+    template <typename R, typename... Args>
+    class FunctionRef<R(Args...)>
+    {
+    public:
+        template <typename F>
+            requires (!std::is_same_v<std::remove_cvref_t<F>, FunctionRef> && std::is_invocable_r_v<R, F&, Args...>)
+        FunctionRef(F&& fn) noexcept
+            : object_(const_cast<void*>(static_cast<const void*>(std::addressof(fn)))),
+              call_([](void* object, Args... args) -> R
+              {
+                  return (*static_cast<std::remove_reference_t<F>*>(object))(std::forward<Args>(args)...);
+              })
+        {
+        }
+
+        R operator()(Args... args) const { return call_(object_, std::forward<Args>(args)...); }
+
+    private:
+        void* object_;
+        R (*call_)(void*, Args...);
+    };
+}
@@ -0,0 +1,190 @@
+#include "GeometryPool.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace Chopper
+{
+    void GeometryPool::init(GpuMemory& memory, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t maxMeshes)
+    {
+        memory_ = &memory;
+        max_meshes_ = maxMeshes;
+        vertices_.reset(vertexCapacity, maxMeshes);
+        indices_.reset(indexCapacity, maxMeshes);
+        meshes_.clear();
+        free_ids_.clear();
+        live_meshes_ = 0;
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+        bufferInfo.size = static_cast<VkDeviceSize>(vertexCapacity) * sizeof(Vertex);
+        bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if (memory_->createBuffer(bufferInfo, allocInfo, MemoryCategory::Geometry, "Geometry vertices",
+                                  vertex_buffer_, vertex_allocation_, nullptr, true) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create geometry vertex buffer!");
+        }
+
+        bufferInfo.size = static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t);
+        bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if (memory_->createBuffer(bufferInfo, allocInfo, MemoryCategory::Geometry, "Geometry indices",
+                                  index_buffer_, index_allocation_, nullptr, true) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create geometry index buffer!");
+        }
+    }
+
+    void GeometryPool::destroy()
+    {
+        if (vertex_buffer_ != VK_NULL_HANDLE)
+        {
+            memory_->destroyBuffer(vertex_buffer_, vertex_allocation_);
+            vertex_buffer_ = VK_NULL_HANDLE;
+        }
+        if (index_buffer_ != VK_NULL_HANDLE)
+        {
+            memory_->destroyBuffer(index_buffer_, index_allocation_);
+            index_buffer_ = VK_NULL_HANDLE;
+        }
+        meshes_.clear();
+        free_ids_.clear();
+        live_meshes_ = 0;
+    }
+
+    MeshId GeometryPool::add(const vk::raii::CommandBuffer& cmd, std::span<const Vertex> vertices,
+                             std::span<const uint32_t> indices, DeletionQueue& deletionQueue)
+    {
+        if (vertices.empty() || indices.empty())
+        {
+            throw std::runtime_error("cannot add an empty mesh to the geometry pool!");
+        }
+
+        Entry entry{};
+        {
+            std::lock_guard lock(mutex_);
+            if (live_meshes_ >= max_meshes_)
+            {
+                throw std::runtime_error("exceeded the geometry pool's mesh limit!");
+            }
+            entry.vertices = vertices_.allocate(static_cast<uint32_t>(vertices.size()));
+            entry.indices = indices_.allocate(static_cast<uint32_t>(indices.size()));
+            if (!entry.vertices.valid() || !entry.indices.valid())
+            {
+                vertices_.free(entry.vertices);
+                indices_.free(entry.indices);
+                throw std::runtime_error("geometry pool has no room for the mesh!");
+            }
+        }
+        entry.mesh.firstIndex = entry.indices.offset;
+        entry.mesh.indexCount = static_cast<uint32_t>(indices.size());
+        entry.mesh.vertexOffset = static_cast<int32_t>(entry.vertices.offset);
+        entry.mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+        entry.live = true;
+
+        // One staging buffer: vertices, then indices
+        const VkDeviceSize vertexBytes = vertices.size_bytes();
+        const VkDeviceSize indexBytes = indices.size_bytes();
+        VkBufferCreateInfo stagingInfo{};
+        stagingInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        stagingInfo.size = vertexBytes + indexBytes;
+        stagingInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        stagingInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo stagingAllocInfo{};
+        stagingAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+        stagingAllocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+            VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        VkBuffer staging = VK_NULL_HANDLE;
+        VmaAllocation stagingAllocation = nullptr;
+        VmaAllocationInfo stagingDetails{};
+        if (memory_->createBuffer(stagingInfo, stagingAllocInfo, MemoryCategory::Staging, "Geometry staging", staging,
+                                  stagingAllocation, &stagingDetails) != VK_SUCCESS)
+        {
+            std::lock_guard lock(mutex_);
+            vertices_.free(entry.vertices);
+            indices_.free(entry.indices);
+            throw std::runtime_error("failed to create geometry staging buffer!");
+        }
+        auto* mapped = static_cast<std::byte*>(stagingDetails.pMappedData);
+        std::memcpy(mapped, vertices.data(), vertexBytes);
+        std::memcpy(mapped + vertexBytes, indices.data(), indexBytes);
+        vmaFlushAllocation(memory_->allocator(), stagingAllocation, 0, stagingInfo.size);
+
+        // A defragmentation pass submitted earlier may still be copying the buffers to where it moved
+        // them; the upload goes into the moved buffers, after that copy
+        vk::MemoryBarrier2 moveBarrier{
+            vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+            vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite
+        };
+        vk::DependencyInfo moveDependency{};
+        moveDependency.memoryBarrierCount = 1;
+        moveDependency.pMemoryBarriers = &moveBarrier;
+        cmd.pipelineBarrier2(moveDependency);
+
+        cmd.copyBuffer(staging, vertex_buffer_,
+                       vk::BufferCopy(0, static_cast<VkDeviceSize>(entry.vertices.offset) * sizeof(Vertex),
+                                      vertexBytes));
+        cmd.copyBuffer(staging, index_buffer_,
+                       vk::BufferCopy(vertexBytes, static_cast<VkDeviceSize>(entry.indices.offset) * sizeof(uint32_t),
+                                      indexBytes));
+        vk::MemoryBarrier2 barrier{
+            vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+            vk::PipelineStageFlagBits2::eVertexAttributeInput | vk::PipelineStageFlagBits2::eIndexInput,
+            vk::AccessFlagBits2::eVertexAttributeRead | vk::AccessFlagBits2::eIndexRead
+        };
+        vk::DependencyInfo dependencyInfo{};
+        dependencyInfo.memoryBarrierCount = 1;
+        dependencyInfo.pMemoryBarriers = &barrier;
+        cmd.pipelineBarrier2(dependencyInfo);
+
+        // `cmd` may belong to a frame that has not been submitted yet
+        deletionQueue.retire([memory = memory_, staging, stagingAllocation]
+        {
+            memory->destroyBuffer(staging, stagingAllocation);
+        }, 1);
+
+        std::lock_guard lock(mutex_);
+        MeshId id;
+        if (!free_ids_.empty())
+        {
+            id = free_ids_.back();
+            free_ids_.pop_back();
+            meshes_[id] = entry;
+        }
+        else
+        {
+            id = static_cast<MeshId>(meshes_.size());
+            meshes_.push_back(entry);
+        }
+        ++live_meshes_;
+        return id;
+    }
+
+    void GeometryPool::remove(MeshId mesh, DeletionQueue& deletionQueue)
+    {
+        std::lock_guard lock(mutex_);
+        Entry& entry = meshes_[mesh];
+        if (!entry.live) return;
+        entry.live = false;
+        free_ids_.push_back(mesh);
+        --live_meshes_;
+        deletionQueue.retire([this, vertices = entry.vertices, indices = entry.indices]
+        {
+            std::lock_guard lock(mutex_);
+            vertices_.free(vertices);
+            indices_.free(indices);
+        });
+    }
+
+    GeometryPool::Stats GeometryPool::stats() const
+    {
+        std::lock_guard lock(mutex_);
+        return {live_meshes_, vertices_.storageReport(), indices_.storageReport()};
+    }
+}
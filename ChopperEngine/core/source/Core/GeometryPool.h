@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+#include "vma/vk_mem_alloc.h"
+
+#include "DeletionQueue.h"
+#include "GpuMemory.h"
+#include "OffsetAllocator.h"
+#include "Vertex.h"
+
+namespace Chopper
+{
+    using MeshId = uint32_t;
+    constexpr MeshId INVALID_MESH = 0xffffffff;
+
+    // Every mesh's vertices and indices in one device-local vertex buffer and one index buffer,
+    // suballocated by OffsetAllocators. A mesh is a range of each: draws pass its first index and
+    // base vertex, so the scene binds geometry once per frame and any mesh can be drawn by an
+    // indirect command. Meshes are added and removed at runtime; a removed mesh's ranges are
+    // reused once the frames that may still draw it have finished.
+    //
+    // add() and remove() go through a DeletionQueue, so like it they belong to the render thread
+    // or to a thread that has drained it. The buffers are relocatable: GpuMemory::defragment()
+    // may move them between frames, so their handles are read again for every upload and bind.
+    class GeometryPool
+    {
+    public:
+        // Where a mesh lives in the pool's buffers
+        struct Mesh
+        {
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            // Added to every index (base vertex)
+            int32_t vertexOffset = 0;
+            uint32_t vertexCount = 0;
+        };
+
+        struct Stats
+        {
+            uint32_t meshes = 0;
+            OffsetAllocator::StorageReport vertices;
+            OffsetAllocator::StorageReport indices;
+        };
+
+        void init(GpuMemory& memory, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t maxMeshes);
+        void destroy();
+
+        // Records the upload of a mesh into `cmd`, which must be submitted before any draw of it:
+        // a staging copy followed by a barrier to vertex input. The staging buffer is released
+        // through `deletionQueue`. Throws when either buffer has no range large enough.
+        MeshId add(const vk::raii::CommandBuffer& cmd, std::span<const Vertex> vertices,
+                   std::span<const uint32_t> indices, DeletionQueue& deletionQueue);
+        // The id may be reused at once; the ranges once the frames submitted so far have finished
+        void remove(MeshId mesh, DeletionQueue& deletionQueue);
+
+        const Mesh& mesh(MeshId mesh) const { return meshes_[mesh].mesh; }
+        bool contains(MeshId mesh) const { return mesh < meshes_.size() && meshes_[mesh].live; }
+        // One past the highest id in use, for tables indexed by MeshId
+        uint32_t idLimit() const { return static_cast<uint32_t>(meshes_.size()); }
+
+        // Render thread, or a thread that has drained it: defragmentation may replace them
+        VkBuffer vertexBuffer() const { return vertex_buffer_; }
+        VkBuffer indexBuffer() const { return index_buffer_; }
+        uint32_t vertexCapacity() const { return vertices_.size(); }
+        uint32_t indexCapacity() const { return indices_.size(); }
+        Stats stats() const;
+
+    private:
+        struct Entry
+        {
+            Mesh mesh;
+            OffsetAllocator::Allocation vertices;
+            OffsetAllocator::Allocation indices;
+            bool live = false;
+        };
+
+        GpuMemory* memory_ = nullptr;
+        VkBuffer vertex_buffer_ = VK_NULL_HANDLE;
+        VmaAllocation vertex_allocation_ = nullptr;
+        VkBuffer index_buffer_ = VK_NULL_HANDLE;
+        VmaAllocation index_allocation_ = nullptr;
+
+        // The allocators are also freed from deletion callbacks
+        mutable std::mutex mutex_;
+        OffsetAllocator vertices_;
+        OffsetAllocator indices_;
+        std::vector<Entry> meshes_;
+        std::vector<MeshId> free_ids_;
+        uint32_t max_meshes_ = 0;
+        uint32_t live_meshes_ = 0;
+    };
+}
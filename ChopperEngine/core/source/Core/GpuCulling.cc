@@ -0,0 +1,609 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace Chopper
+{
+    namespace
+    {
+        // Matches CullUniforms in cull.slang (std140)
+        struct CullUniforms
+        {
+            glm::mat4 viewProj;
+            glm::vec4 planes[6];
+            uint32_t instanceCount;
+            uint32_t compact;
+            uint32_t occlusion;
+            uint32_t commandCapacity;
+            uint32_t pyramidWidth;
+            uint32_t pyramidHeight;
+            uint32_t pyramidLevels;
+            uint32_t reversedZ;
+        };
+
+        // Matches HizConstants in hiz.slang
+        struct HizConstants
+        {
+            uint32_t srcWidth;
+            uint32_t srcHeight;
+            uint32_t dstWidth;
+            uint32_t dstHeight;
+            uint32_t sampleCount;
+            uint32_t reversedZ;
+        };
+
+        constexpr uint32_t WORKGROUP_SIZE = 64;
+        constexpr uint32_t HIZ_TILE = 8;
+
+        // Binding indices of cull.slang
+        constexpr uint32_t CULL_STORAGE_BINDINGS = 5;
+        constexpr uint32_t CULL_UNIFORM_BINDING = 5;
+        constexpr uint32_t CULL_PYRAMID_BINDING = 6;
+        constexpr uint32_t CULL_MESH_BINDING = 7;
+
+        vk::raii::Pipeline createComputePipeline(const vk::raii::Device& device, const vk::raii::ShaderModule& module,
+                                                 const char* entry, const vk::raii::PipelineLayout& layout)
+        {
+            vk::ComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+            pipelineInfo.stage.module = module;
+            pipelineInfo.stage.pName = entry;
+            pipelineInfo.layout = layout;
+            return vk::raii::Pipeline(device, nullptr, pipelineInfo);
+        }
+
+        vk::raii::ShaderModule createShaderModule(const vk::raii::Device& device, const std::vector<char>& spirv)
+        {
+            vk::ShaderModuleCreateInfo moduleInfo{};
+            moduleInfo.codeSize = spirv.size();
+            moduleInfo.pCode = reinterpret_cast<const uint32_t*>(spirv.data());
+            return vk::raii::ShaderModule(device, moduleInfo);
+        }
+
+        void memoryBarrier(const vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags2 srcStage,
+                           vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess)
+        {
+            vk::MemoryBarrier2 barrier{srcStage, srcAccess, dstStage, dstAccess};
+            vk::DependencyInfo info{};
+            info.memoryBarrierCount = 1;
+            info.pMemoryBarriers = &barrier;
+            cmd.pipelineBarrier2(info);
+        }
+    }
+
+    VkBuffer GpuCulling::createBuffer(vk::DeviceSize size, VkBufferUsageFlags usage, bool hostVisible,
+                                      const char* name, VmaAllocation& allocation, void** mapped)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = hostVisible ? VMA_MEMORY_USAGE_AUTO : VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        if (hostVisible)
+        {
+            allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        }
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocationInfo details{};
+        if (memory_->createBuffer(bufferInfo, allocInfo, MemoryCategory::Other, name, buffer, allocation, &details) !=
+            VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create GPU culling buffer!");
+        }
+        if (mapped) *mapped = details.pMappedData;
+        return buffer;
+    }
+
+    void GpuCulling::init(const vk::raii::Device& device, GpuMemory& memory, const std::vector<char>& cullSpirv,
+                          const std::vector<char>& hizSpirv, VkBuffer transforms, vk::DeviceSize transformsSize,
+                          uint32_t capacity, uint32_t framesInFlight, bool drawIndirectCount)
+    {
+        device_ = &device;
+        memory_ = &memory;
+        capacity_ = capacity;
+        draw_indirect_count_ = drawIndirectCount;
+
+        // 0 transforms, 1 instances, 2 commands, 3 per-group counts, 4 visibility, 5 uniforms, 6 pyramid,
+        // 7 mesh table
+        std::array<vk::DescriptorSetLayoutBinding, 8> bindings;
+        for (uint32_t i = 0; i < CULL_STORAGE_BINDINGS; ++i)
+        {
+            bindings[i] = vk::DescriptorSetLayoutBinding(i, vk::DescriptorType::eStorageBuffer, 1,
+                                                         vk::ShaderStageFlagBits::eCompute, nullptr);
+        }
+        bindings[CULL_UNIFORM_BINDING] = vk::DescriptorSetLayoutBinding(
+            CULL_UNIFORM_BINDING, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr);
+        bindings[CULL_PYRAMID_BINDING] = vk::DescriptorSetLayoutBinding(
+            CULL_PYRAMID_BINDING, vk::DescriptorType::eSampledImage, 1, vk::ShaderStageFlagBits::eCompute, nullptr);
+        bindings[CULL_MESH_BINDING] = vk::DescriptorSetLayoutBinding(
+            CULL_MESH_BINDING, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr);
+        vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+        set_layout_ = vk::raii::DescriptorSetLayout(device, layoutInfo);
+
+        // The phase index
+        vk::PushConstantRange pushConstants(vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t));
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &*set_layout_;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+        pipeline_layout_ = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
+
+        vk::raii::ShaderModule cullModule = createShaderModule(device, cullSpirv);
+        pipeline_ = createComputePipeline(device, cullModule, "cullMain", pipeline_layout_);
+
+        std::array poolSizes{
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, (CULL_STORAGE_BINDINGS + 1) * framesInFlight),
+            vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, framesInFlight),
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, framesInFlight)
+        };
+        vk::DescriptorPoolCreateInfo poolInfo{};
+        poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        poolInfo.maxSets = framesInFlight;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        descriptor_pool_ = vk::raii::DescriptorPool(device, poolInfo);
+
+        std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, *set_layout_);
+        vk::DescriptorSetAllocateInfo allocInfo{};
+        allocInfo.descriptorPool = descriptor_pool_;
+        allocInfo.descriptorSetCount = framesInFlight;
+        allocInfo.pSetLayouts = layouts.data();
+        descriptor_sets_ = device.allocateDescriptorSets(allocInfo);
+
+        const vk::DeviceSize visibilitySize = capacity_ * sizeof(uint32_t);
+        visibility_ = createBuffer(visibilitySize,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false,
+                                   "Cull visibility", visibility_allocation_, nullptr);
+        visibility_cleared_ = false;
+
+        // Per-frame buffers, so recording a frame never touches what an in-flight frame reads
+        const vk::DeviceSize instancesSize = capacity_ * sizeof(Instance);
+        const vk::DeviceSize meshesSize = MAX_MESHES * sizeof(Mesh);
+        const vk::DeviceSize commandsSize = 2 * capacity_ * sizeof(vk::DrawIndexedIndirectCommand);
+        const vk::DeviceSize countsSize = 2 * MAX_GROUPS * sizeof(uint32_t);
+        frames_.resize(framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; ++i)
+        {
+            FrameBuffers& frame = frames_[i];
+            void* mapped = nullptr;
+            frame.instances = createBuffer(instancesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true,
+                                           "Cull instances", frame.instancesAllocation, &mapped);
+            frame.instancesMapped = static_cast<Instance*>(mapped);
+            frame.meshes = createBuffer(meshesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true, "Cull meshes",
+                                        frame.meshesAllocation, &mapped);
+            frame.meshesMapped = static_cast<Mesh*>(mapped);
+            frame.uniforms = createBuffer(sizeof(CullUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, true,
+                                          "Cull uniforms", frame.uniformsAllocation, &frame.uniformsMapped);
+            frame.commands = createBuffer(commandsSize,
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                          false, "Cull commands", frame.commandsAllocation, nullptr);
+            frame.counts = createBuffer(countsSize,
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                        VK_BUFFER_USAGE_TRANSFER_DST_BIT, false, "Cull counts", frame.countsAllocation,
+                                        nullptr);
+            frame.version = 0;
+
+            std::array bufferInfos{
+                vk::DescriptorBufferInfo(vk::Buffer(transforms), 0, transformsSize),
+                vk::DescriptorBufferInfo(vk::Buffer(frame.instances), 0, instancesSize),
+                vk::DescriptorBufferInfo(vk::Buffer(frame.commands), 0, commandsSize),
+                vk::DescriptorBufferInfo(vk::Buffer(frame.counts), 0, countsSize),
+                vk::DescriptorBufferInfo(vk::Buffer(visibility_), 0, visibilitySize),
+                vk::DescriptorBufferInfo(vk::Buffer(frame.uniforms), 0, sizeof(CullUniforms))
+            };
+            std::array<vk::WriteDescriptorSet, 7> writes;
+            for (uint32_t b = 0; b < bufferInfos.size(); ++b)
+            {
+                writes[b].dstSet = descriptor_sets_[i];
+                writes[b].dstBinding = b;
+                writes[b].descriptorCount = 1;
+                writes[b].descriptorType = b == CULL_UNIFORM_BINDING
+                                               ? vk::DescriptorType::eUniformBuffer
+                                               : vk::DescriptorType::eStorageBuffer;
+                writes[b].pBufferInfo = &bufferInfos[b];
+            }
+            // The pyramid binding is written by record() once a pyramid exists
+            const vk::DescriptorBufferInfo meshesInfo(vk::Buffer(frame.meshes), 0, meshesSize);
+            writes[6] = writes[0];
+            writes[6].dstBinding = CULL_MESH_BINDING;
+            writes[6].pBufferInfo = &meshesInfo;
+            device.updateDescriptorSets(writes, {});
+        }
+
+        // Pyramid passes: 0 depth, 1 multisampled depth, 2 source level, 3 destination level
+        std::array hizBindings{
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eSampledImage, 1,
+                                           vk::ShaderStageFlagBits::eCompute, nullptr),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eSampledImage, 1,
+                                           vk::ShaderStageFlagBits::eCompute, nullptr),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageImage, 1,
+                                           vk::ShaderStageFlagBits::eCompute, nullptr),
+            vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageImage, 1,
+                                           vk::ShaderStageFlagBits::eCompute, nullptr)
+        };
+        vk::DescriptorSetLayoutCreateInfo hizLayoutInfo{};
+        hizLayoutInfo.bindingCount = static_cast<uint32_t>(hizBindings.size());
+        hizLayoutInfo.pBindings = hizBindings.data();
+        hiz_set_layout_ = vk::raii::DescriptorSetLayout(device, hizLayoutInfo);
+
+        vk::PushConstantRange hizPushConstants(vk::ShaderStageFlagBits::eCompute, 0, sizeof(HizConstants));
+        vk::PipelineLayoutCreateInfo hizPipelineLayoutInfo{};
+        hizPipelineLayoutInfo.setLayoutCount = 1;
+        hizPipelineLayoutInfo.pSetLayouts = &*hiz_set_layout_;
+        hizPipelineLayoutInfo.pushConstantRangeCount = 1;
+        hizPipelineLayoutInfo.pPushConstantRanges = &hizPushConstants;
+        hiz_pipeline_layout_ = vk::raii::PipelineLayout(device, hizPipelineLayoutInfo);
+
+        vk::raii::ShaderModule hizModule = createShaderModule(device, hizSpirv);
+        hiz_from_depth_ = createComputePipeline(device, hizModule, "depthToHiz", hiz_pipeline_layout_);
+        hiz_from_depth_ms_ = createComputePipeline(device, hizModule, "depthToHizMs", hiz_pipeline_layout_);
+        hiz_reduce_ = createComputePipeline(device, hizModule, "reduceHiz", hiz_pipeline_layout_);
+    }
+
+    void GpuCulling::destroyPyramid()
+    {
+        hiz_sets_.clear();
+        hiz_descriptor_pool_ = nullptr;
+        pyramid_mips_.clear();
+        pyramid_view_ = nullptr;
+        if (pyramid_ != VK_NULL_HANDLE)
+        {
+            memory_->destroyImage(pyramid_, pyramid_allocation_);
+            pyramid_ = VK_NULL_HANDLE;
+        }
+        pyramid_extent_ = vk::Extent2D{};
+    }
+
+    void GpuCulling::retirePyramid(DeletionQueue& deletionQueue)
+    {
+        if (pyramid_ == VK_NULL_HANDLE) return;
+
+        // Destroyed in this order: sets before their pool, views before their image
+        deletionQueue.retireObject(std::move(hiz_sets_));
+        deletionQueue.retireObject(std::move(hiz_descriptor_pool_));
+        deletionQueue.retireObject(std::move(pyramid_mips_));
+        deletionQueue.retireObject(std::move(pyramid_view_));
+        deletionQueue.retire([memory = memory_, image = pyramid_, allocation = pyramid_allocation_]
+        {
+            memory->destroyImage(image, allocation);
+        });
+        hiz_sets_.clear();
+        pyramid_mips_.clear();
+        pyramid_ = VK_NULL_HANDLE;
+        pyramid_allocation_ = nullptr;
+        pyramid_extent_ = vk::Extent2D{};
+    }
+
+    void GpuCulling::destroy()
+    {
+        destroyPyramid();
+        for (FrameBuffers& frame : frames_)
+        {
+            memory_->destroyBuffer(frame.instances, frame.instancesAllocation);
+            memory_->destroyBuffer(frame.meshes, frame.meshesAllocation);
+            memory_->destroyBuffer(frame.uniforms, frame.uniformsAllocation);
+            memory_->destroyBuffer(frame.commands, frame.commandsAllocation);
+            memory_->destroyBuffer(frame.counts, frame.countsAllocation);
+        }
+        frames_.clear();
+        if (visibility_ != VK_NULL_HANDLE)
+        {
+            memory_->destroyBuffer(visibility_, visibility_allocation_);
+            visibility_ = VK_NULL_HANDLE;
+        }
+        descriptor_sets_.clear();
+        descriptor_pool_ = nullptr;
+        pipeline_ = nullptr;
+        pipeline_layout_ = nullptr;
+        set_layout_ = nullptr;
+        hiz_reduce_ = nullptr;
+        hiz_from_depth_ms_ = nullptr;
+        hiz_from_depth_ = nullptr;
+        hiz_pipeline_layout_ = nullptr;
+        hiz_set_layout_ = nullptr;
+    }
+
+    void GpuCulling::setDepthSource(VkImage depthImage, vk::ImageView depthView, vk::Extent2D extent,
+                                    vk::SampleCountFlagBits samples, DeletionQueue& deletionQueue)
+    {
+        retirePyramid(deletionQueue);
+        depth_image_ = depthImage;
+        depth_extent_ = extent;
+        depth_samples_ = static_cast<uint32_t>(samples);
+        depth_multisampled_ = samples != vk::SampleCountFlagBits::e1;
+
+        // Power-of-two levels halve exactly, so every texel covers whole texels of the level below
+        pyramid_extent_ = vk::Extent2D{std::bit_floor(extent.width), std::bit_floor(extent.height)};
+        const auto levels = static_cast<uint32_t>(std::bit_width(
+            std::max(pyramid_extent_.width, pyramid_extent_.height)));
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.extent = {pyramid_extent_.width, pyramid_extent_.height, 1};
+        imageInfo.mipLevels = levels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        if (memory_->createImage(imageInfo, allocInfo, MemoryCategory::RenderTargets, "Depth pyramid", pyramid_,
+                                 pyramid_allocation_) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create depth pyramid!");
+        }
+
+        vk::ImageViewCreateInfo viewInfo{};
+        viewInfo.image = pyramid_;
+        viewInfo.viewType = vk::ImageViewType::e2D;
+        viewInfo.format = vk::Format::eR32Sfloat;
+        viewInfo.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, levels, 0, 1};
+        pyramid_view_ = vk::raii::ImageView(*device_, viewInfo);
+        for (uint32_t level = 0; level < levels; ++level)
+        {
+            viewInfo.subresourceRange = {vk::ImageAspectFlagBits::eColor, level, 1, 0, 1};
+            pyramid_mips_.emplace_back(*device_, viewInfo);
+        }
+
+        std::array poolSizes{
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, levels),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 2 * levels)
+        };
+        vk::DescriptorPoolCreateInfo poolInfo{};
+        poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        poolInfo.maxSets = levels;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        hiz_descriptor_pool_ = vk::raii::DescriptorPool(*device_, poolInfo);
+
+        std::vector<vk::DescriptorSetLayout> layouts(levels, *hiz_set_layout_);
+        vk::DescriptorSetAllocateInfo setInfo{};
+        setInfo.descriptorPool = hiz_descriptor_pool_;
+        setInfo.descriptorSetCount = levels;
+        setInfo.pSetLayouts = layouts.data();
+        hiz_sets_ = device_->allocateDescriptorSets(setInfo);
+
+        // Level 0 reads the depth attachment, every other level the one below it
+        const vk::DescriptorImageInfo depthInfo(nullptr, depthView, vk::ImageLayout::eShaderReadOnlyOptimal);
+        for (uint32_t level = 0; level < levels; ++level)
+        {
+            const vk::DescriptorImageInfo srcInfo(nullptr, pyramid_mips_[level == 0 ? 0 : level - 1],
+                                                  vk::ImageLayout::eGeneral);
+            const vk::DescriptorImageInfo dstInfo(nullptr, pyramid_mips_[level], vk::ImageLayout::eGeneral);
+
+            std::vector<vk::WriteDescriptorSet> writes(2);
+            writes[0].dstSet = hiz_sets_[level];
+            writes[0].dstBinding = 2;
+            writes[0].descriptorCount = 1;
+            writes[0].descriptorType = vk::DescriptorType::eStorageImage;
+            writes[0].pImageInfo = &srcInfo;
+            writes[1] = writes[0];
+            writes[1].dstBinding = 3;
+            writes[1].pImageInfo = &dstInfo;
+            if (level == 0)
+            {
+                vk::WriteDescriptorSet depthWrite = writes[0];
+                depthWrite.dstBinding = depth_multisampled_ ? 1 : 0;
+                depthWrite.descriptorType = vk::DescriptorType::eSampledImage;
+                depthWrite.pImageInfo = &depthInfo;
+                writes.push_back(depthWrite);
+            }
+            device_->updateDescriptorSets(writes, {});
+        }
+        // The cull sets may be in use by frames in flight; record() rebinds them
+        ++pyramid_version_;
+    }
+
+    void GpuCulling::setInstances(const std::vector<Instance>& instances, uint32_t groupCount,
+                                  const std::vector<Mesh>& meshes)
+    {
+        if (instances.size() > capacity_ || groupCount > MAX_GROUPS || meshes.size() > MAX_MESHES)
+        {
+            throw std::runtime_error("too many instances for GPU culling!");
+        }
+        instances_ = instances;
+        meshes_ = meshes;
+        group_count_ = groupCount;
+        ++version_;
+    }
+
+    void GpuCulling::dispatchCull(const vk::raii::CommandBuffer& cmd, uint32_t frame, uint32_t phase)
+    {
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline_);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipeline_layout_, 0, *descriptor_sets_[frame],
+                               nullptr);
+        cmd.pushConstants<uint32_t>(*pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, phase);
+        cmd.dispatch((instanceCount() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+        memoryBarrier(cmd, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+                      vk::PipelineStageFlagBits2::eDrawIndirect, vk::AccessFlagBits2::eIndirectCommandRead);
+    }
+
+    void GpuCulling::record(const vk::raii::CommandBuffer& cmd, uint32_t frame, const glm::mat4& viewProj,
+                            const FrustumPlanes& planes, bool occlusion, bool reversedZ)
+    {
+        FrameBuffers& buffers = frames_[frame];
+        if (buffers.version != version_)
+        {
+            // Host writes before submission are visible to the device without a barrier
+            std::memcpy(buffers.instancesMapped, instances_.data(), instances_.size() * sizeof(Instance));
+            vmaFlushAllocation(memory_->allocator(), buffers.instancesAllocation, 0,
+                               instances_.size() * sizeof(Instance));
+            std::memcpy(buffers.meshesMapped, meshes_.data(), meshes_.size() * sizeof(Mesh));
+            vmaFlushAllocation(memory_->allocator(), buffers.meshesAllocation, 0, meshes_.size() * sizeof(Mesh));
+            buffers.version = version_;
+        }
+        if (buffers.pyramidVersion != pyramid_version_ && pyramid_ != VK_NULL_HANDLE)
+        {
+            // The frame's previous submission has finished, so its set can be updated
+            const vk::DescriptorImageInfo pyramidInfo(nullptr, pyramid_view_, vk::ImageLayout::eGeneral);
+            vk::WriteDescriptorSet write{};
+            write.dstSet = descriptor_sets_[frame];
+            write.dstBinding = CULL_PYRAMID_BINDING;
+            write.descriptorCount = 1;
+            write.descriptorType = vk::DescriptorType::eSampledImage;
+            write.pImageInfo = &pyramidInfo;
+            device_->updateDescriptorSets(write, {});
+            buffers.pyramidVersion = pyramid_version_;
+        }
+        occlusion_ = occlusion && pyramid_ != VK_NULL_HANDLE;
+        reversed_z_ = reversedZ;
+        if (instances_.empty()) return;
+
+        CullUniforms uniforms{};
+        uniforms.viewProj = viewProj;
+        for (size_t i = 0; i < planes.size(); ++i)
+        {
+            uniforms.planes[i] = planes[i];
+        }
+        uniforms.instanceCount = instanceCount();
+        uniforms.compact = draw_indirect_count_ ? 1 : 0;
+        uniforms.occlusion = occlusion_ ? 1 : 0;
+        uniforms.commandCapacity = capacity_;
+        uniforms.pyramidWidth = pyramid_extent_.width;
+        uniforms.pyramidHeight = pyramid_extent_.height;
+        uniforms.pyramidLevels = pyramidLevels();
+        uniforms.reversedZ = reversed_z_ ? 1 : 0;
+        std::memcpy(buffers.uniformsMapped, &uniforms, sizeof(uniforms));
+        vmaFlushAllocation(memory_->allocator(), buffers.uniformsAllocation, 0, sizeof(uniforms));
+
+        if (!visibility_cleared_)
+        {
+            cmd.fillBuffer(vk::Buffer(visibility_), 0, vk::WholeSize, 0);
+            visibility_cleared_ = true;
+        }
+        if (draw_indirect_count_)
+        {
+            cmd.fillBuffer(vk::Buffer(buffers.counts), 0, vk::WholeSize, 0);
+        }
+        // Also orders this frame's visibility reads after the previous frame's phase 1 writes
+        memoryBarrier(cmd, vk::PipelineStageFlagBits2::eTransfer | vk::PipelineStageFlagBits2::eComputeShader,
+                      vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageWrite,
+                      vk::PipelineStageFlagBits2::eComputeShader,
+                      vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+        dispatchCull(cmd, frame, 0);
+    }
+
+    void GpuCulling::latchCamera(uint32_t frame, const glm::mat4& viewProj, const FrustumPlanes& planes)
+    {
+        if (instances_.empty()) return;
+
+        // viewProj and planes lead CullUniforms; the rest stays as record() wrote it
+        FrameBuffers& buffers = frames_[frame];
+        auto* uniforms = static_cast<CullUniforms*>(buffers.uniformsMapped);
+        uniforms->viewProj = viewProj;
+        for (size_t i = 0; i < planes.size(); ++i)
+        {
+            uniforms->planes[i] = planes[i];
+        }
+        vmaFlushAllocation(memory_->allocator(), buffers.uniformsAllocation, 0, offsetof(CullUniforms, instanceCount));
+    }
+
+    void GpuCulling::recordOcclusion(const vk::raii::CommandBuffer& cmd, uint32_t frame,
+                                     vk::Extent2D renderExtent)
+    {
+        if (!occlusion_ || instances_.empty()) return;
+
+        const vk::ImageSubresourceRange depthRange{vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1};
+        const vk::ImageSubresourceRange pyramidRange{vk::ImageAspectFlagBits::eColor, 0, pyramidLevels(), 0, 1};
+
+        // Phase 0 depth becomes readable; the pyramid is rebuilt from scratch every frame
+        std::array toCompute{
+            vk::ImageMemoryBarrier2{
+                vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead,
+                vk::ImageLayout::eDepthAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, depth_image_, depthRange
+            },
+            vk::ImageMemoryBarrier2{
+                vk::PipelineStageFlagBits2::eComputeShader, {},
+                vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+                vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+                VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, pyramid_, pyramidRange
+            }
+        };
+        vk::DependencyInfo toComputeInfo{};
+        toComputeInfo.imageMemoryBarrierCount = static_cast<uint32_t>(toCompute.size());
+        toComputeInfo.pImageMemoryBarriers = toCompute.data();
+        cmd.pipelineBarrier2(toComputeInfo);
+
+        // Each level keeps the farthest depth of the texels it covers
+        uint32_t srcWidth = std::min(renderExtent.width, depth_extent_.width);
+        uint32_t srcHeight = std::min(renderExtent.height, depth_extent_.height);
+        for (uint32_t level = 0; level < pyramidLevels(); ++level)
+        {
+            const uint32_t dstWidth = std::max(pyramid_extent_.width >> level, 1u);
+            const uint32_t dstHeight = std::max(pyramid_extent_.height >> level, 1u);
+            const vk::raii::Pipeline& pipeline = level > 0
+                                                     ? hiz_reduce_
+                                                     : depth_multisampled_ ? hiz_from_depth_ms_ : hiz_from_depth_;
+            cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline);
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *hiz_pipeline_layout_, 0, *hiz_sets_[level],
+                                   nullptr);
+            const HizConstants constants{srcWidth, srcHeight, dstWidth, dstHeight, depth_samples_,
+                                         reversed_z_ ? 1u : 0u};
+            cmd.pushConstants<HizConstants>(*hiz_pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, constants);
+            cmd.dispatch((dstWidth + HIZ_TILE - 1) / HIZ_TILE, (dstHeight + HIZ_TILE - 1) / HIZ_TILE, 1);
+
+            memoryBarrier(cmd, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+                          vk::PipelineStageFlagBits2::eComputeShader,
+                          vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderSampledRead);
+            srcWidth = dstWidth;
+            srcHeight = dstHeight;
+        }
+
+        // Phase 1 renders into the same depth
+        vk::ImageMemoryBarrier2 toAttachment{
+            vk::PipelineStageFlagBits2::eComputeShader, {},
+            vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+            vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+            vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eDepthAttachmentOptimal,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, depth_image_, depthRange
+        };
+        vk::DependencyInfo toAttachmentInfo{};
+        toAttachmentInfo.imageMemoryBarrierCount = 1;
+        toAttachmentInfo.pImageMemoryBarriers = &toAttachment;
+        cmd.pipelineBarrier2(toAttachmentInfo);
+
+        dispatchCull(cmd, frame, 1);
+    }
+
+    void GpuCulling::draw(const vk::raii::CommandBuffer& cmd, uint32_t frame, uint32_t phase, uint32_t group,
+                          uint32_t firstCommand, uint32_t count) const
+    {
+        const FrameBuffers& buffers = frames_[frame];
+        constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+        const vk::DeviceSize offset = (static_cast<vk::DeviceSize>(phase) * capacity_ + firstCommand) * stride;
+        if (draw_indirect_count_)
+        {
+            const vk::DeviceSize countOffset = (static_cast<vk::DeviceSize>(phase) * MAX_GROUPS + group) *
+                sizeof(uint32_t);
+            cmd.drawIndexedIndirectCount(vk::Buffer(buffers.commands), offset, vk::Buffer(buffers.counts), countOffset,
+                                         count, stride);
+        }
+        else
+        {
+            cmd.drawIndexedIndirect(vk::Buffer(buffers.commands), offset, count, stride);
+        }
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+#include "vma/vk_mem_alloc.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "DeletionQueue.h"
+#include "FrustumCulling.h"
+#include "GpuMemory.h"
+
+namespace Chopper
+{
+    // GPU-driven culling. A compute pass (shaders/cull.spv) tests every instance's bounding
+    // sphere, built from its world matrix in the TransformBuffer and its mesh's bounds, against
+    // the camera planes and writes one VkDrawIndexedIndirectCommand per survivor
+    // (firstInstance = slot, index range and base vertex from the mesh table). Instances are
+    // split into groups, one per material, and each group is drawn with a single indirect call,
+    // so the number of recorded commands does not depend on the scene size.
+    //
+    // With drawIndirectCount the survivors are compacted and counted per group. Without it every
+    // instance keeps its command and culled ones get instanceCount = 0.
+    //
+    // With occlusion enabled culling runs in two phases around a hierarchical-Z pyramid
+    // (shaders/hiz.spv), with no CPU readback:
+    //   phase 0: draw instances that were visible last frame (record() + draw(0, ...))
+    //   recordOcclusion(): build the max-depth pyramid from the depth those draws left behind,
+    //   then test every instance against it; the result is next frame's phase 0 set
+    //   phase 1: draw instances that passed but were not drawn in phase 0 (draw(1, ...))
+    class GpuCulling
+    {
+    public:
+        // GPU layout of one cull input, consumed by cull.slang
+        struct Instance
+        {
+            uint32_t slot = 0;
+            uint32_t group = 0;
+            // Index of the group's first command; instances of a group must be contiguous
+            uint32_t firstCommand = 0;
+            // Index into the mesh table
+            uint32_t mesh = 0;
+        };
+
+        // GPU layout of one mesh table entry: mesh-space bounding sphere and GeometryPool range
+        struct Mesh
+        {
+            glm::vec4 sphere{0.0f};
+            uint32_t indexCount = 0;
+            uint32_t firstIndex = 0;
+            int32_t vertexOffset = 0;
+            uint32_t padding = 0;
+        };
+
+        static constexpr uint32_t MAX_GROUPS = 1024;
+        static constexpr uint32_t MAX_MESHES = 1024;
+
+        // `transforms` is the TransformBuffer read by the pass; the spirv vectors hold cull.spv
+        // and hiz.spv
+        void init(const vk::raii::Device& device, GpuMemory& memory, const std::vector<char>& cullSpirv,
+                  const std::vector<char>& hizSpirv, VkBuffer transforms, vk::DeviceSize transformsSize,
+                  uint32_t capacity, uint32_t framesInFlight, bool drawIndirectCount);
+        void destroy();
+
+        // (Re)builds the pyramid for a new depth attachment; the depth image needs sampled usage.
+        // The previous pyramid goes to `deletionQueue`, as frames in flight may still use it; each
+        // frame's cull set picks up the new one the next time that frame is recorded.
+        void setDepthSource(VkImage depthImage, vk::ImageView depthView, vk::Extent2D extent,
+                            vk::SampleCountFlagBits samples, DeletionQueue& deletionQueue);
+
+        // Replaces the instance list and the mesh table it indexes; uploaded lazily into each
+        // frame's buffers by record()
+        void setInstances(const std::vector<Instance>& instances, uint32_t groupCount,
+                          const std::vector<Mesh>& meshes);
+
+        // Records phase 0 culling for `frame`, outside rendering and after the transform upload.
+        // Without occlusion every instance inside the frustum is drawn in phase 0. `reversedZ`
+        // tells how the depth the pyramid is built from was written.
+        void record(const vk::raii::CommandBuffer& cmd, uint32_t frame, const glm::mat4& viewProj,
+                    const FrustumPlanes& planes, bool occlusion, bool reversedZ);
+
+        // Replaces the camera of `frame`'s culling, recorded by record(), before submission
+        void latchCamera(uint32_t frame, const glm::mat4& viewProj, const FrustumPlanes& planes);
+
+        // Between the phase 0 and phase 1 rendering passes: pyramid build and phase 1 culling.
+        // Expects the depth attachment in DepthAttachmentOptimal and leaves it there. Only its
+        // top-left `renderExtent` was rendered to; the pyramid stretches that over the screen.
+        void recordOcclusion(const vk::raii::CommandBuffer& cmd, uint32_t frame, vk::Extent2D renderExtent);
+
+        // Draws group `group` (instances [firstCommand, firstCommand + count)) of `phase`
+        void draw(const vk::raii::CommandBuffer& cmd, uint32_t frame, uint32_t phase, uint32_t group,
+                  uint32_t firstCommand, uint32_t count) const;
+
+        bool compacts() const { return draw_indirect_count_; }
+        uint32_t instanceCount() const { return static_cast<uint32_t>(instances_.size()); }
+        uint32_t pyramidLevels() const { return static_cast<uint32_t>(pyramid_mips_.size()); }
+        vk::Extent2D pyramidExtent() const { return pyramid_extent_; }
+
+    private:
+        struct FrameBuffers
+        {
+            VkBuffer instances = VK_NULL_HANDLE;
+            VmaAllocation instancesAllocation = nullptr;
+            Instance* instancesMapped = nullptr;
+            VkBuffer meshes = VK_NULL_HANDLE;
+            VmaAllocation meshesAllocation = nullptr;
+            Mesh* meshesMapped = nullptr;
+            // Camera data for both phases
+            VkBuffer uniforms = VK_NULL_HANDLE;
+            VmaAllocation uniformsAllocation = nullptr;
+            void* uniformsMapped = nullptr;
+            // Both phases' commands and per-group counts, phase 1 after phase 0
+            VkBuffer commands = VK_NULL_HANDLE;
+            VmaAllocation commandsAllocation = nullptr;
+            VkBuffer counts = VK_NULL_HANDLE;
+            VmaAllocation countsAllocation = nullptr;
+            // Version of instances_ last copied into this frame's buffer
+            uint64_t version = 0;
+            // Version of the pyramid bound to this frame's cull set
+            uint64_t pyramidVersion = 0;
+        };
+
+        VkBuffer createBuffer(vk::DeviceSize size, VkBufferUsageFlags usage, bool hostVisible, const char* name,
+                              VmaAllocation& allocation, void** mapped);
+        void destroyPyramid();
+        void retirePyramid(DeletionQueue& deletionQueue);
+        void dispatchCull(const vk::raii::CommandBuffer& cmd, uint32_t frame, uint32_t phase);
+
+        const vk::raii::Device* device_ = nullptr;
+        GpuMemory* memory_ = nullptr;
+        uint32_t capacity_ = 0;
+        bool draw_indirect_count_ = false;
+
+        vk::raii::DescriptorSetLayout set_layout_ = nullptr;
+        vk::raii::PipelineLayout pipeline_layout_ = nullptr;
+        vk::raii::Pipeline pipeline_ = nullptr;
+        vk::raii::DescriptorPool descriptor_pool_ = nullptr;
+        std::vector<vk::raii::DescriptorSet> descriptor_sets_;
+        std::vector<FrameBuffers> frames_;
+
+        // Last phase-1 result per slot; decides what phase 0 draws
+        VkBuffer visibility_ = VK_NULL_HANDLE;
+        VmaAllocation visibility_allocation_ = nullptr;
+        bool visibility_cleared_ = false;
+
+        // Hi-Z pyramid: R32 max depth, power-of-two sized, one storage view per level
+        vk::raii::DescriptorSetLayout hiz_set_layout_ = nullptr;
+        vk::raii::PipelineLayout hiz_pipeline_layout_ = nullptr;
+        vk::raii::Pipeline hiz_from_depth_ = nullptr;
+        vk::raii::Pipeline hiz_from_depth_ms_ = nullptr;
+        vk::raii::Pipeline hiz_reduce_ = nullptr;
+        vk::raii::DescriptorPool hiz_descriptor_pool_ = nullptr;
+        std::vector<vk::raii::DescriptorSet> hiz_sets_;
+        VkImage pyramid_ = VK_NULL_HANDLE;
+        VmaAllocation pyramid_allocation_ = nullptr;
+        vk::raii::ImageView pyramid_view_ = nullptr;
+        std::vector<vk::raii::ImageView> pyramid_mips_;
+        vk::Extent2D pyramid_extent_{};
+        uint64_t pyramid_version_ = 0;
+        VkImage depth_image_ = VK_NULL_HANDLE;
+        vk::Extent2D depth_extent_{};
+        bool depth_multisampled_ = false;
+        uint32_t depth_samples_ = 1;
+        bool occlusion_ = false;
+        bool reversed_z_ = false;
+
+        std::vector<Instance> instances_;
+        std::vector<Mesh> meshes_;
+        uint32_t group_count_ = 0;
+        uint64_t version_ = 1;
+    };
+}
@@ -0,0 +1,320 @@
+#include "GpuMemory.h"
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Chopper
+{
+    namespace
+    {
+        // Bounds one pass, so a frame never copies more than this
+        constexpr VkDeviceSize MAX_BYTES_PER_PASS = 16ull * 1024 * 1024;
+        constexpr uint32_t MAX_MOVES_PER_PASS = 64;
+        // Frames without allocations or frees before an automatic run starts, so streaming
+        // bursts settle first
+        constexpr uint64_t IDLE_FRAMES = 120;
+        // Unused space in VMA's blocks that makes a run worth it
+        constexpr VkDeviceSize MIN_UNUSED_BYTES = 32ull * 1024 * 1024;
+        constexpr double MIN_UNUSED_FRACTION = 0.25;
+    }
+
+    const char* memoryCategoryName(MemoryCategory category)
+    {
+        switch (category)
+        {
+        case MemoryCategory::Textures: return "Textures";
+        case MemoryCategory::Geometry: return "Geometry";
+        case MemoryCategory::Uniforms: return "Uniforms";
+        case MemoryCategory::RenderTargets: return "RenderTargets";
+        case MemoryCategory::Staging: return "Staging";
+        case MemoryCategory::Other: return "Other";
+        default: return "Unknown";
+        }
+    }
+
+    void GpuMemory::init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t apiVersion,
+                         bool memoryBudget)
+    {
+        device_ = device;
+        memory_budget_ = memoryBudget;
+
+        VmaAllocatorCreateInfo allocatorInfo{};
+        allocatorInfo.physicalDevice = physicalDevice;
+        allocatorInfo.device = device;
+        allocatorInfo.instance = instance;
+        allocatorInfo.vulkanApiVersion = apiVersion;
+        if (memoryBudget) allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+
+        if (vmaCreateAllocator(&allocatorInfo, &allocator_) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create VMA allocator!");
+        }
+
+        const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+        vmaGetMemoryProperties(allocator_, &memoryProperties);
+        budgets_.heapCount = memoryProperties->memoryHeapCount;
+    }
+
+    void GpuMemory::destroy()
+    {
+        if (allocator_ == nullptr) return;
+        if (defragment_context_ != nullptr) endDefragmentation();
+        vmaDestroyAllocator(allocator_);
+        allocator_ = nullptr;
+        entries_.clear();
+        totals_ = {};
+    }
+
+    VkResult GpuMemory::createBuffer(const VkBufferCreateInfo& bufferInfo, const VmaAllocationCreateInfo& allocInfo,
+                                     MemoryCategory category, const char* name, VkBuffer& buffer,
+                                     VmaAllocation& allocation, VmaAllocationInfo* details, bool relocatable)
+    {
+        VkBufferCreateInfo info = bufferInfo;
+        if (relocatable)
+        {
+            // A move copies the old buffer into a new one
+            info.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        }
+
+        const VkResult result = vmaCreateBuffer(allocator_, &info, &allocInfo, &buffer, &allocation, details);
+        if (result != VK_SUCCESS) return result;
+        track(allocation, category, name, relocatable ? &buffer : nullptr, &info);
+        return result;
+    }
+
+    VkResult GpuMemory::createImage(const VkImageCreateInfo& imageInfo, const VmaAllocationCreateInfo& allocInfo,
+                                    MemoryCategory category, const char* name, VkImage& image,
+                                    VmaAllocation& allocation)
+    {
+        const VkResult result = vmaCreateImage(allocator_, &imageInfo, &allocInfo, &image, &allocation, nullptr);
+        if (result != VK_SUCCESS) return result;
+        track(allocation, category, name, nullptr, nullptr);
+        return result;
+    }
+
+    void GpuMemory::destroyBuffer(VkBuffer buffer, VmaAllocation allocation)
+    {
+        if (allocation == nullptr) return;
+        untrack(allocation);
+        vmaDestroyBuffer(allocator_, buffer, allocation);
+    }
+
+    void GpuMemory::destroyImage(VkImage image, VmaAllocation allocation)
+    {
+        if (allocation == nullptr) return;
+        untrack(allocation);
+        vmaDestroyImage(allocator_, image, allocation);
+    }
+
+    void GpuMemory::track(VmaAllocation allocation, MemoryCategory category, const char* name, VkBuffer* buffer,
+                          const VkBufferCreateInfo* bufferInfo)
+    {
+        vmaSetAllocationName(allocator_, allocation, name ? name : memoryCategoryName(category));
+        VmaAllocationInfo info{};
+        vmaGetAllocationInfo(allocator_, allocation, &info);
+
+        Entry entry{category, info.size, buffer, {}};
+        if (buffer)
+        {
+            // Recreated without the caller's extension chain or queue family list
+            entry.bufferInfo = *bufferInfo;
+            entry.bufferInfo.pNext = nullptr;
+            entry.bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            entry.bufferInfo.queueFamilyIndexCount = 0;
+            entry.bufferInfo.pQueueFamilyIndices = nullptr;
+        }
+
+        std::lock_guard lock(mutex_);
+        entries_[allocation] = entry;
+        CategoryStats& totals = totals_[static_cast<size_t>(category)];
+        ++totals.allocations;
+        totals.bytes += info.size;
+        last_change_frame_ = frame_;
+    }
+
+    void GpuMemory::untrack(VmaAllocation allocation)
+    {
+        std::lock_guard lock(mutex_);
+        const auto it = entries_.find(allocation);
+        if (it == entries_.end()) return;
+        CategoryStats& totals = totals_[static_cast<size_t>(it->second.category)];
+        --totals.allocations;
+        totals.bytes -= it->second.size;
+        entries_.erase(it);
+        last_change_frame_ = frame_;
+    }
+
+    void GpuMemory::update(uint32_t frameIndex)
+    {
+        vmaSetCurrentFrameIndex(allocator_, frameIndex);
+        vmaGetHeapBudgets(allocator_, budgets_.heaps.data());
+        std::lock_guard lock(mutex_);
+        ++frame_;
+    }
+
+    GpuMemory::CategoryTotals GpuMemory::categoryTotals() const
+    {
+        std::lock_guard lock(mutex_);
+        return totals_;
+    }
+
+    std::string GpuMemory::dumpJson() const
+    {
+        const CategoryTotals totals = categoryTotals();
+        std::string json = "{\n\"Categories\": {";
+        for (size_t i = 0; i < totals.size(); ++i)
+        {
+            json += i == 0 ? "\n" : ",\n";
+            json += "  \"";
+            json += memoryCategoryName(static_cast<MemoryCategory>(i));
+            json += "\": {\"Allocations\": " + std::to_string(totals[i].allocations) +
+                ", \"Bytes\": " + std::to_string(totals[i].bytes) + "}";
+        }
+        json += "\n},\n\"MemoryBudgetExtension\": ";
+        json += memory_budget_ ? "true" : "false";
+        json += ",\n\"Vma\": ";
+
+        // Thread-safe inside VMA; the detailed map lists every allocation by name
+        char* stats = nullptr;
+        vmaBuildStatsString(allocator_, &stats, VK_TRUE);
+        json += stats;
+        vmaFreeStatsString(allocator_, stats);
+        json += "\n}\n";
+        return json;
+    }
+
+    bool GpuMemory::shouldDefragment()
+    {
+        if (defragment_requested_.exchange(false)) return true;
+        if (!auto_defragment_.load()) return false;
+
+        {
+            std::lock_guard lock(mutex_);
+            if (frame_ - last_change_frame_ < IDLE_FRAMES) return false;
+            if (last_change_frame_ == defragmented_change_) return false;
+        }
+
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize allocationBytes = 0;
+        for (uint32_t heap = 0; heap < budgets_.heapCount; ++heap)
+        {
+            blockBytes += budgets_.heaps[heap].statistics.blockBytes;
+            allocationBytes += budgets_.heaps[heap].statistics.allocationBytes;
+        }
+        const VkDeviceSize unused = blockBytes - allocationBytes;
+        return unused >= MIN_UNUSED_BYTES && unused >= MIN_UNUSED_FRACTION * static_cast<double>(blockBytes);
+    }
+
+    void GpuMemory::defragment(const vk::raii::CommandBuffer& cmd, DeletionQueue& deletionQueue)
+    {
+        if (pass_pending_) return;
+        if (defragment_context_ == nullptr)
+        {
+            if (!shouldDefragment()) return;
+
+            VmaDefragmentationInfo info{};
+            info.maxBytesPerPass = MAX_BYTES_PER_PASS;
+            info.maxAllocationsPerPass = MAX_MOVES_PER_PASS;
+            if (vmaBeginDefragmentation(allocator_, &info, &defragment_context_) != VK_SUCCESS)
+            {
+                defragment_context_ = nullptr;
+                return;
+            }
+            defragment_stats_.running = true;
+        }
+
+        pass_ = {};
+        const VkResult result = vmaBeginDefragmentationPass(allocator_, defragment_context_, &pass_);
+        if (result == VK_SUCCESS)
+        {
+            // Nothing left to move
+            endDefragmentation();
+            return;
+        }
+        if (result != VK_INCOMPLETE)
+        {
+            throw std::runtime_error("failed to begin a defragmentation pass!");
+        }
+
+        std::vector<VkBuffer> movedFrom;
+        {
+            std::lock_guard lock(mutex_);
+            for (uint32_t i = 0; i < pass_.moveCount; ++i)
+            {
+                VmaDefragmentationMove& move = pass_.pMoves[i];
+                const auto it = entries_.find(move.srcAllocation);
+                VkBuffer moved = VK_NULL_HANDLE;
+                if (it == entries_.end() || it->second.buffer == nullptr ||
+                    vkCreateBuffer(device_, &it->second.bufferInfo, nullptr, &moved) != VK_SUCCESS)
+                {
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    continue;
+                }
+                if (vmaBindBufferMemory(allocator_, move.dstTmpAllocation, moved) != VK_SUCCESS)
+                {
+                    vkDestroyBuffer(device_, moved, nullptr);
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    continue;
+                }
+
+                Entry& entry = it->second;
+                cmd.copyBuffer(vk::Buffer(*entry.buffer), vk::Buffer(moved),
+                               vk::BufferCopy(0, 0, entry.bufferInfo.size));
+                movedFrom.push_back(*entry.buffer);
+                *entry.buffer = moved;
+                ++defragment_stats_.moves;
+                defragment_stats_.bytesMoved += entry.size;
+            }
+        }
+        ++defragment_stats_.passes;
+        pass_moved_ = !movedFrom.empty();
+
+        if (!pass_moved_)
+        {
+            endPass();
+            return;
+        }
+
+        // The rest of the frame reads the new buffers
+        vk::MemoryBarrier2 barrier{
+            vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+            vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead
+        };
+        vk::DependencyInfo dependencyInfo{};
+        dependencyInfo.memoryBarrierCount = 1;
+        dependencyInfo.pMemoryBarriers = &barrier;
+        cmd.pipelineBarrier2(dependencyInfo);
+
+        // Earlier frames may still read the old buffers and this one copies from them, so the
+        // pass ends, freeing the old memory, once this frame (not yet submitted) has finished
+        pass_pending_ = true;
+        deletionQueue.retire([this, movedFrom = std::move(movedFrom)]
+        {
+            for (VkBuffer buffer : movedFrom)
+            {
+                vkDestroyBuffer(device_, buffer, nullptr);
+            }
+            endPass();
+        }, 1);
+    }
+
+    void GpuMemory::endPass()
+    {
+        pass_pending_ = false;
+        const VkResult result = vmaEndDefragmentationPass(allocator_, defragment_context_, &pass_);
+        if (result == VK_SUCCESS || !pass_moved_) endDefragmentation();
+    }
+
+    void GpuMemory::endDefragmentation()
+    {
+        VmaDefragmentationStats stats{};
+        vmaEndDefragmentation(allocator_, defragment_context_, &stats);
+        defragment_context_ = nullptr;
+        defragment_stats_.running = false;
+        defragment_stats_.bytesFreed += stats.bytesFreed;
+
+        std::lock_guard lock(mutex_);
+        defragmented_change_ = last_change_frame_;
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <vulkan/vulkan_raii.hpp>
+#include "vma/vk_mem_alloc.h"
+
+#include "DeletionQueue.h"
+
+namespace Chopper
+{
+    // What an allocation holds; usage is totalled per category
+    enum class MemoryCategory : uint32_t
+    {
+        Textures,
+        Geometry,
+        Uniforms,
+        RenderTargets,
+        // Host-visible upload buffers
+        Staging,
+        // Culling buffers, the depth pyramid and other engine data
+        Other,
+        Count
+    };
+
+    const char* memoryCategoryName(MemoryCategory category);
+
+    // Owns the VMA allocator. Buffers and images are created through it so each allocation is
+    // named and counted under a category, and so relocatable buffers can be moved by
+    // incremental defragmentation.
+    //
+    // Defragmentation runs one bounded pass at a time on the render thread: defragment() records
+    // the copies into the frame being recorded, and the pass ends once that frame has finished.
+    // Only relocatable buffers move; images would need their views and descriptors rebuilt, so
+    // they stay where they are.
+    class GpuMemory
+    {
+    public:
+        // Per-heap usage and budget. With VK_EXT_memory_budget they come from the driver and
+        // include other processes; without it VMA estimates them from its own blocks.
+        struct Budgets
+        {
+            uint32_t heapCount = 0;
+            std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> heaps{};
+        };
+
+        struct CategoryStats
+        {
+            uint32_t allocations = 0;
+            VkDeviceSize bytes = 0;
+        };
+
+        using CategoryTotals = std::array<CategoryStats, static_cast<size_t>(MemoryCategory::Count)>;
+
+        struct DefragmentStats
+        {
+            bool running = false;
+            uint64_t passes = 0;
+            uint64_t moves = 0;
+            VkDeviceSize bytesMoved = 0;
+            VkDeviceSize bytesFreed = 0;
+        };
+
+        void init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t apiVersion,
+                  bool memoryBudget);
+        // Every allocation must have been destroyed and no defragmentation pass may be pending
+        void destroy();
+
+        VmaAllocator allocator() const { return allocator_; }
+        bool hasMemoryBudget() const { return memory_budget_; }
+
+        // A relocatable buffer may be moved by defragment(), which then stores the new handle in
+        // `buffer`. The variable must stay at the same address, only be read by the render
+        // thread or a thread that has drained it, and the buffer must not be destroyed while a
+        // pass is pending.
+        VkResult createBuffer(const VkBufferCreateInfo& bufferInfo, const VmaAllocationCreateInfo& allocInfo,
+                              MemoryCategory category, const char* name, VkBuffer& buffer, VmaAllocation& allocation,
+                              VmaAllocationInfo* details = nullptr, bool relocatable = false);
+        VkResult createImage(const VkImageCreateInfo& imageInfo, const VmaAllocationCreateInfo& allocInfo,
+                             MemoryCategory category, const char* name, VkImage& image, VmaAllocation& allocation);
+        void destroyBuffer(VkBuffer buffer, VmaAllocation allocation);
+        void destroyImage(VkImage image, VmaAllocation allocation);
+
+        // Render thread, once per frame: advances VMA's frame index and samples the heap budgets
+        void update(uint32_t frameIndex);
+        const Budgets& budgets() const { return budgets_; }
+
+        CategoryTotals categoryTotals() const;
+
+        // VMA's detailed statistics and map of every named allocation, with the category totals
+        std::string dumpJson() const;
+
+        // Starts a run on its own once the allocator has been idle for a while and enough block
+        // space is unused; requestDefragmentation() starts one regardless
+        void setAutoDefragment(bool enabled) { auto_defragment_.store(enabled); }
+        bool autoDefragment() const { return auto_defragment_.load(); }
+        void requestDefragmentation() { defragment_requested_.store(true); }
+
+        // Render thread, in a command buffer about to be submitted: runs the next defragmentation
+        // pass, if any. The moved-from buffers are released through `deletionQueue` once this
+        // frame has finished.
+        void defragment(const vk::raii::CommandBuffer& cmd, DeletionQueue& deletionQueue);
+        const DefragmentStats& defragmentStats() const { return defragment_stats_; }
+
+    private:
+        struct Entry
+        {
+            MemoryCategory category = MemoryCategory::Other;
+            VkDeviceSize size = 0;
+            // Relocatable buffers: where the owner keeps the handle, and how to recreate it
+            VkBuffer* buffer = nullptr;
+            VkBufferCreateInfo bufferInfo{};
+        };
+
+        void track(VmaAllocation allocation, MemoryCategory category, const char* name, VkBuffer* buffer,
+                   const VkBufferCreateInfo* bufferInfo);
+        void untrack(VmaAllocation allocation);
+        bool shouldDefragment();
+        void endPass();
+        void endDefragmentation();
+
+        VmaAllocator allocator_ = nullptr;
+        VkDevice device_ = VK_NULL_HANDLE;
+        bool memory_budget_ = false;
+        Budgets budgets_{};
+
+        mutable std::mutex mutex_;
+        std::unordered_map<VmaAllocation, Entry> entries_;
+        CategoryTotals totals_{};
+        // Frame index of the last update() and of the last allocation or free
+        uint64_t frame_ = 0;
+        uint64_t last_change_frame_ = 0;
+
+        std::atomic<bool> auto_defragment_{true};
+        std::atomic<bool> defragment_requested_{false};
+        VmaDefragmentationContext defragment_context_ = nullptr;
+        VmaDefragmentationPassMoveInfo pass_{};
+        bool pass_pending_ = false;
+        // A pass that moved nothing ends the run, since the rest cannot move
+        bool pass_moved_ = false;
+        // last_change_frame_ when the previous run ended; a new automatic run needs a change since
+        uint64_t defragmented_change_ = UINT64_MAX;
+        DefragmentStats defragment_stats_{};
+    };
+}
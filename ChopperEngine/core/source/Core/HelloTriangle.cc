@@ -12,6 +12,35 @@ struct std::hash<Chopper::Vertex>
 
 namespace Chopper
 {
+    namespace
+    {
+        // Unit cube with a full texture square per face, counter-clockwise seen from outside
+        void makeCubeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+        {
+            // Face normal and two edges with u x v = normal
+            const std::array<std::array<glm::vec3, 3>, 6> faces{{
+                {glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1)},
+                {glm::vec3(-1, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, 1, 0)},
+                {glm::vec3(0, 1, 0), glm::vec3(0, 0, 1), glm::vec3(1, 0, 0)},
+                {glm::vec3(0, -1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1)},
+                {glm::vec3(0, 0, 1), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0)},
+                {glm::vec3(0, 0, -1), glm::vec3(0, 1, 0), glm::vec3(1, 0, 0)}
+            }};
+            const std::array corners{glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1)};
+            vertices.clear();
+            indices.clear();
+            for (const auto& [normal, u, v] : faces)
+            {
+                const auto base = static_cast<uint32_t>(vertices.size());
+                for (const glm::vec2& corner : corners)
+                {
+                    vertices.push_back({normal + corner.x * u + corner.y * v, glm::vec3(1.0f), corner * 0.5f + 0.5f});
+                }
+                indices.insert(indices.end(), {base, base + 1, base + 2, base + 2, base + 3, base});
+            }
+        }
+    }
+
     void HelloTriangleApplication::run()
     {
         initWindow();
@@ -28,9 +57,13 @@ namespace Chopper
         // glfwWindowHint(GLFW_TRANSPARENT_FRAMEBUFFER, GLFW_TRUE);
         monitors = glfwGetMonitors(&monitors_count);
         window = glfwCreateWindow(WIDTH, HEIGHT, "Chopper Engine", nullptr, nullptr);
+        // The limiter defaults to the display's refresh rate
+        if (const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor()))
+        {
+            frameLimiter.setTargetFps(mode->refreshRate);
+        }
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
-        glfwSetWindowPosCallback(window, framebufferResizeCallback);
 
         // load chopper icon
         GLFWimage images[1];
@@ -52,48 +85,115 @@ namespace Chopper
     void HelloTriangleApplication::mainLoop()
     {
         initImGui();
-        while (!glfwWindowShouldClose(window))
+        // Loading took a while; the first frame's and input sample's time steps must not include it
+        last_frame_time = last_input_time = glfwGetTime();
+        renderThread = std::thread([this] { renderLoop(); });
+        try
         {
-            double current_time = glfwGetTime(); // time in seconds since glfwInit
-            delta_time = current_time - last_frame_time;
-            last_frame_time = current_time;
+            while (!glfwWindowShouldClose(window) && !renderFailed.load())
+            {
+                // Before input is sampled, so the wait doesn't add to input latency
+                if (limitFrameRate) frameLimiter.wait();
 
-            glfwPollEvents();
-            camera_.update(delta_time);
-            drawFrame();
+                double current_time = glfwGetTime(); // time in seconds since glfwInit
+                delta_time = current_time - last_frame_time;
+                last_frame_time = current_time;
+
+                glfwPollEvents();
+                sampleInput();
+                simulateFrame();
+                checkFrameAllocations();
+            }
+        }
+        catch (...)
+        {
+            frameHandoff.close();
+            renderThread.join();
+            throw;
         }
+        // The render thread draws whatever was already published, then stops
+        frameHandoff.close();
+        renderThread.join();
+        if (renderError) std::rethrow_exception(renderError);
         device.waitIdle();
     }
 
 
+    void HelloTriangleApplication::checkFrameAllocations()
+    {
+        // The steady state allocates nothing: transient data lives in frameArena, containers
+        // keep their capacity and jobs come from a pool. An allocation on every frame means
+        // something started allocating per frame again.
+        if constexpr (!AllocationCounter::enabled()) return;
+        const uint64_t allocations = AllocationCounter::allocations();
+        frameAllocations = allocations - allocationsBefore;
+        allocationsBefore = allocations;
+        allocatingFrames = frameAllocations > 0 ? allocatingFrames + 1 : 0;
+        // Once per run of allocating frames
+        if (warnOnFrameAllocations && allocatingFrames == ALLOCATION_WARN_FRAMES)
+        {
+            std::cerr << "heap allocations in each of the last " << ALLOCATION_WARN_FRAMES << " frames ("
+                      << frameAllocations << " in the last one)" << std::endl;
+        }
+    }
+
+
     void HelloTriangleApplication::initVulkan()
     {
         if (enableValidationLayers) printf("Validation Layers ON\n");
-        createInstance();
-        setupDebugMessenger();
-        createSurface();
-        pickPhysicalDevice();
-        msaaSamples = getMaxUsableSampleCount();
-        createLogicalDevice();
-        createAllocator(*instance, *physicalDevice, *device);
-        createSwapChain();
-        createImageViews();
-        createDescriptorSetLayout();
-        createGraphicsPipeline();
-        createCommandPool();
-        createColorResources();
-        createDepthResources();
+
+        // Decode the texture and parse the model on the workers while the device is set up
+        JobSystem& jobs = JobSystem::instance();
+        JobCounter assetJobs;
+        jobs.run([this] { loadTexturePixels(); }, &assetJobs);
+        jobs.run([this] { loadModel(); }, &assetJobs);
+        try
+        {
+            createInstance();
+            setupDebugMessenger();
+            createSurface();
+            pickPhysicalDevice();
+            supportedSampleCounts = getUsableSampleCounts();
+            msaaSamples = sampleCount(antiAliasing);
+            createLogicalDevice();
+            createAllocator(*instance, *physicalDevice, *device);
+            createSwapChain();
+            createImageViews();
+            createDescriptorSetLayout();
+            createPipelineLayout();
+            createMaterials();
+            createCommandPool();
+            createColorResources();
+            createDepthResources();
+            initCamera();
+        }
+        catch (...)
+        {
+            // The loading jobs write into this object, so they must finish before it unwinds
+            try
+            {
+                jobs.wait(assetJobs);
+            }
+            catch (...)
+            {
+            }
+            throw;
+        }
+        jobs.wait(assetJobs);
+
         createTextureImage();
         createTextureImageView();
         createTextureSampler();
-        initCamera();
-        loadModel();
-        setupGameObjects();
-        createVertexBuffer();
-        createIndexBuffer();
-        createUniformBuffers();
+        createGeometry();
         createDescriptorPool();
+        createUniformBuffers();
+        createClusteredLighting();
+        createShadowMaps();
         createDescriptorSets();
+        createUpscaler();
+        createGpuCulling();
+        createTimestampQueries();
+        setupGameObjects();
         createCommandBuffers();
         createSyncObjects();
     }
@@ -106,24 +206,39 @@ namespace Chopper
 
     void HelloTriangleApplication::vmaCleanup()
     {
-        vmaDestroyBuffer(allocator, vertexBuffer, vertexBufferAllocation);
-        vmaDestroyBuffer(allocator, indexBuffer, indexBufferAllocation);
-        vmaDestroyImage(allocator, colorImage, colorImageAllocation);
-        vmaDestroyImage(allocator, depthImage, depthImageAllocation);
-        vmaDestroyImage(allocator, textureImage, textureImageAllocation);
-        for (auto& gameObject : gameObjects)
+        geometryPool.destroy();
+        gpuMemory.destroyImage(colorImage, colorImageAllocation);
+        gpuMemory.destroyImage(depthImage, depthImageAllocation);
+        gpuMemory.destroyImage(textureImage, textureImageAllocation);
+        for (size_t i = 0; i < uniformBuffers.size(); ++i)
         {
-            for (int i = 0; i < gameObject.uniformBuffers.size(); ++i)
-            {
-                vmaDestroyBuffer(allocator, gameObject.uniformBuffers[i], gameObject.uniformBuffersAllocation[i]);
-            }
+            gpuMemory.destroyBuffer(uniformBuffers[i], uniformBuffersAllocation[i]);
+        }
+        gpuCulling.destroy();
+        clusteredLighting.destroy();
+        shadowMaps.destroy();
+        upscaler.destroy();
+        transformBuffer.destroy();
+        gpuMemory.destroy();
+    }
+
+    void HelloTriangleApplication::dumpMemoryStats()
+    {
+        const std::string path = "memory_stats.json";
+        std::ofstream file(path, std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "failed to write " << path << "\n";
+            return;
         }
-        vmaDestroyAllocator(allocator);
+        file << gpuMemory.dumpJson();
+        std::cout << "GPU memory statistics written to " << path << "\n";
     }
 
     void HelloTriangleApplication::cleanup()
     {
         device.waitIdle();
+        deletionQueue.flush();
 
         vmaCleanup();
 
@@ -154,16 +269,27 @@ namespace Chopper
             glfwWaitEvents();
         }
 
-        device.waitIdle();
-
-        vmaDestroyImage(allocator, colorImage, colorImageAllocation);
-        vmaDestroyImage(allocator, depthImage, depthImageAllocation);
+        // No device idle: frames in flight finish with the old swapchain and attachments, which
+        // are destroyed once those frames have finished. The render thread is drained, so the
+        // handles can be swapped under it.
+        const vk::Format previousFormat = swapChainImageFormat;
 
-        cleanupSwapChain();
-        createSwapChain();
+        vk::raii::SwapchainKHR oldSwapChain = std::move(swapChain);
+        createSwapChain(*oldSwapChain);
+        retireSwapChain();
+        deletionQueue.retireObject(std::move(oldSwapChain), 1);
         createImageViews();
+        createSwapChainSemaphores();
         createColorResources();
         createDepthResources();
+        upscaler.resize(swapChainExtent, swapChainImageFormat, findDepthFormat(), deletionQueue);
+        setCullingDepthSource();
+
+        if (swapChainImageFormat != previousFormat)
+        {
+            resolveMaterialPipelines();
+            drawListDirty = true;
+        }
     }
 
     void HelloTriangleApplication::createInstance()
@@ -263,12 +389,10 @@ namespace Chopper
                                                                          });
 
                 auto features = device.template getFeatures2<
-                    vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features,
-                    vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+                    vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features>();
                 bool supportsRequiredFeatures = features.template get<vk::PhysicalDeviceFeatures2>().features.
                                                          samplerAnisotropy &&
-                    features.template get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering &&
-                    features.template get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
+                    features.template get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering;
 
                 return supportsVulkan1_3 && supportsGraphics && supportsAllRequiredExtensions &&
                     supportsRequiredFeatures;
@@ -319,16 +443,49 @@ namespace Chopper
         vulkan_13_features.dynamicRendering = VK_TRUE;
         vulkan_13_features.synchronization2 = VK_TRUE;
 
-        vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT dynamic_state_features{};
-        dynamic_state_features.extendedDynamicState = VK_TRUE;
+        // Materials fall back to baking raster state into pipelines without it
+        auto supportedFeatures = physicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features,
+            vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+        supportsExtendedDynamicState =
+            supportedFeatures.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
 
-        vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features,
+        vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT dynamic_state_features{};
+        dynamic_state_features.extendedDynamicState = supportsExtendedDynamicState;
+
+        // GPU culling needs one indirect call to cover many draws, each with its own firstInstance;
+        // drawIndirectCount is optional even in Vulkan 1.3 and only saves the zero-instance draws
+        const vk::PhysicalDeviceFeatures& coreFeatures =
+            supportedFeatures.get<vk::PhysicalDeviceFeatures2>().features;
+        supportsGpuCulling = coreFeatures.multiDrawIndirect && coreFeatures.drawIndirectFirstInstance &&
+            (queueFamilyProperties[queueIndex].queueFlags & vk::QueueFlagBits::eCompute);
+        supportsDrawIndirectCount = supportsGpuCulling &&
+            supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+        physical_device_features2.features.multiDrawIndirect = supportsGpuCulling;
+        physical_device_features2.features.drawIndirectFirstInstance = supportsGpuCulling;
+
+        vk::PhysicalDeviceVulkan12Features vulkan_12_features{};
+        vulkan_12_features.drawIndirectCount = supportsDrawIndirectCount;
+        // Core since 1.2; frame completion is tracked with one timeline semaphore
+        vulkan_12_features.timelineSemaphore = VK_TRUE;
+
+        vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features,
+                           vk::PhysicalDeviceVulkan13Features,
                            vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> featureChain(
             physical_device_features2,
+            vulkan_12_features,
             vulkan_13_features,
             dynamic_state_features
         );
 
+        // Optional: without it VMA estimates heap usage from its own allocations only
+        const auto availableExtensions = physicalDevice.enumerateDeviceExtensionProperties();
+        supportsMemoryBudget = std::ranges::any_of(availableExtensions, [](const vk::ExtensionProperties& extension)
+        {
+            return strcmp(extension.extensionName, vk::EXTMemoryBudgetExtensionName) == 0;
+        });
+        if (supportsMemoryBudget) requiredDeviceExtension.push_back(vk::EXTMemoryBudgetExtensionName);
+
         // create a Device
         float queuePriority = 0.0f;
 
@@ -373,12 +530,7 @@ namespace Chopper
     void HelloTriangleApplication::createAllocator(VkInstance instance, VkPhysicalDevice physicalDevice,
                                                    VkDevice device)
     {
-        VmaAllocatorCreateInfo allocatorInfo = {};
-        allocatorInfo.physicalDevice = physicalDevice;
-        allocatorInfo.device = device;
-        allocatorInfo.instance = instance;
-
-        vmaCreateAllocator(&allocatorInfo, &allocator);
+        gpuMemory.init(instance, physicalDevice, device, VK_API_VERSION_1_3, supportsMemoryBudget);
     }
 
     void HelloTriangleApplication::createSurface()
@@ -391,7 +543,63 @@ namespace Chopper
         surface = vk::raii::SurfaceKHR(instance, _surface);
     }
 
-    void HelloTriangleApplication::createSwapChain()
+    void HelloTriangleApplication::retireSwapChain()
+    {
+        // Present semaphores are waited on by presents of the old swapchain, so they outlive it
+        // by the same extra frame
+        deletionQueue.retireObject(std::move(swapChainImageViews), 1);
+        deletionQueue.retireObject(std::move(renderFinishedSemaphore), 1);
+        swapChainImageViews.clear();
+        renderFinishedSemaphore.clear();
+        retireRenderTargets();
+    }
+
+    void HelloTriangleApplication::retireRenderTargets()
+    {
+        deletionQueue.retireObject(std::move(colorImageView));
+        deletionQueue.retireObject(std::move(depthImageView));
+        deletionQueue.retire([this, color = colorImage, colorAllocation = colorImageAllocation, depth = depthImage,
+                                 depthAllocation = depthImageAllocation]
+        {
+            gpuMemory.destroyImage(color, colorAllocation);
+            gpuMemory.destroyImage(depth, depthAllocation);
+        });
+        colorImage = VK_NULL_HANDLE;
+        colorImageAllocation = nullptr;
+        depthImage = VK_NULL_HANDLE;
+        depthImageAllocation = nullptr;
+    }
+
+    void HelloTriangleApplication::applyDepthConvention()
+    {
+        reversedZ = requestedReversedZ;
+        camera_.setReversedZ(reversedZ);
+        // A sample with the old projection must not be latched against the new depth clear
+        cameraLatch.publish({camera_.getView(), camera_.getProj(), camera_.getFrustumPlanes(),
+                             std::chrono::steady_clock::now()});
+        // Its depth is in the old convention
+        upscaler.resetHistory();
+        resolveMaterialPipelines();
+        drawListDirty = true;
+    }
+
+    void HelloTriangleApplication::applyAntiAliasing()
+    {
+        antiAliasing = requestedAntiAliasing;
+        const vk::SampleCountFlagBits samples = sampleCount(antiAliasing);
+        // Off and post-process only differ in the upscale pass
+        if (samples == msaaSamples) return;
+
+        msaaSamples = samples;
+        retireRenderTargets();
+        createColorResources();
+        createDepthResources();
+        setCullingDepthSource();
+        resolveMaterialPipelines();
+        drawListDirty = true;
+    }
+
+    void HelloTriangleApplication::createSwapChain(vk::SwapchainKHR oldSwapChain)
     {
         auto surfaceCapabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
         swapChainImageFormat = chooseSwapSurfaceFormat(physicalDevice.getSurfaceFormatsKHR(surface));
@@ -414,6 +622,8 @@ namespace Chopper
         swapChainCreateInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
         swapChainCreateInfo.presentMode = chooseSwapPresentMode(physicalDevice.getSurfacePresentModesKHR(surface));
         swapChainCreateInfo.clipped = true;
+        // Lets the driver reuse the old swapchain's resources while its images are still presented
+        swapChainCreateInfo.oldSwapchain = oldSwapChain;
 
         swapChain = vk::raii::SwapchainKHR(device, swapChainCreateInfo);
         swapChainImages = swapChain.getImages();
@@ -440,6 +650,24 @@ namespace Chopper
             vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex,
                                            nullptr),
             vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1,
+                                           vk::ShaderStageFlagBits::eVertex, nullptr),
+            // Clustered lighting: uniforms, lights, per-cluster counts and light indices
+            vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eUniformBuffer, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eStorageBuffer, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            // Cascaded shadows: uniforms, shadow map array and its comparison sampler
+            vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eUniformBuffer, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eSampledImage, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(9, vk::DescriptorType::eSampler, 1,
                                            vk::ShaderStageFlagBits::eFragment, nullptr)
         };
 
@@ -450,109 +678,366 @@ namespace Chopper
         descriptorSetLayout = vk::raii::DescriptorSetLayout(device, layoutInfo);
     }
 
-    void HelloTriangleApplication::createGraphicsPipeline()
-    {
-        vk::raii::ShaderModule shaderModule = createShaderModule(readFile("shaders/slang.spv"));
-
-        vk::PipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
-        vertShaderStageInfo.module = shaderModule;
-        vertShaderStageInfo.pName = "vertMain";
-
-        vk::PipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.stage = vk::ShaderStageFlagBits::eFragment;
-        fragShaderStageInfo.module = shaderModule;
-        fragShaderStageInfo.pName = "fragMain";
-
-        vk::PipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
-        vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-        vk::PipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
-
-        vk::PipelineViewportStateCreateInfo viewportState{};
-        viewportState.viewportCount = 1;
-        viewportState.scissorCount = 1;
-
-        vk::PipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.depthClampEnable = vk::False;
-        rasterizer.rasterizerDiscardEnable = vk::False;
-        rasterizer.polygonMode = vk::PolygonMode::eFill;
-        rasterizer.cullMode = vk::CullModeFlagBits::eBack;
-        rasterizer.frontFace = vk::FrontFace::eCounterClockwise;
-        rasterizer.depthBiasEnable = vk::False;
-        rasterizer.depthBiasSlopeFactor = 1.0f;
-        rasterizer.lineWidth = 1.0f;
-
-        vk::PipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.rasterizationSamples = msaaSamples;
-        multisampling.sampleShadingEnable = vk::False;
-
-        vk::PipelineDepthStencilStateCreateInfo depthStencil{};
-        depthStencil.depthTestEnable = vk::True;
-        depthStencil.depthWriteEnable = vk::True;
-        depthStencil.depthCompareOp = vk::CompareOp::eLess;
-        depthStencil.depthBoundsTestEnable = vk::False;
-        depthStencil.stencilTestEnable = vk::False;
-
-
-        vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.blendEnable = vk::False;
-        colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-
-        vk::PipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.logicOpEnable = vk::False;
-        colorBlending.logicOp = vk::LogicOp::eCopy;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-
-        std::vector dynamicStates = {
-            vk::DynamicState::eViewport,
-            vk::DynamicState::eScissor
-        };
-        vk::PipelineDynamicStateCreateInfo dynamicState{};
-        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-        dynamicState.pDynamicStates = dynamicStates.data();
-
+    void HelloTriangleApplication::createPipelineLayout()
+    {
         vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.setLayoutCount = 1;
         pipelineLayoutInfo.pSetLayouts = &*descriptorSetLayout;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        // The shadow passes push their cascade's view-projection
+        const vk::PushConstantRange shadowRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::mat4));
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &shadowRange;
 
         pipelineLayout = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
+    }
 
-        vk::Format depthFormat = findDepthFormat();
-        vk::PipelineRenderingCreateInfo pipelineRenderingCreateInfo{};
-        pipelineRenderingCreateInfo.colorAttachmentCount = 1;
-        pipelineRenderingCreateInfo.pColorAttachmentFormats = &swapChainImageFormat;
-        pipelineRenderingCreateInfo.depthAttachmentFormat = depthFormat;
+    void HelloTriangleApplication::createMaterials()
+    {
+        pipelineCache.init(device, supportsExtendedDynamicState);
+
+        Material opaque{};
+        opaque.name = "Opaque";
+
+        // Only differs in dynamic state, so it shares the opaque pipeline when
+        // extended dynamic state is available
+        Material twoSided = opaque;
+        twoSided.name = "Opaque Two Sided";
+        twoSided.state.cullMode = vk::CullModeFlagBits::eNone;
+
+        materials = {opaque, twoSided};
+        resolveMaterialPipelines();
+    }
+
+    void HelloTriangleApplication::resolveMaterialPipelines()
+    {
+        // Attachment state and the depth convention are owned by the renderer, not the material
+        const vk::Format depthFormat = findDepthFormat();
+        // Runs with the render thread drained, so pipelines of the old settings can go
+        pipelineCache.beginRequests();
+        for (auto& material : materials)
+        {
+            material.state.layout = *pipelineLayout;
+            material.state.samples = msaaSamples;
+            material.state.colorFormat = swapChainImageFormat;
+            material.state.depthFormat = depthFormat;
+
+            material.shadowPipeline = ~0u;
+            if (material.state.depthTest && material.state.depthWrite && !material.state.blendEnable)
+            {
+                // Shadow maps keep standard depth whatever the scene's convention. Casters are drawn
+                // two-sided, so thin and open meshes still cast, with a slope bias against acne.
+                PipelineState shadowState = material.state;
+                shadowState.vertexEntry = "vertShadow";
+                shadowState.fragmentEntry.clear();
+                shadowState.colorFormat = vk::Format::eUndefined;
+                shadowState.colorWriteMask = {};
+                shadowState.depthFormat = CascadedShadows::FORMAT;
+                shadowState.samples = vk::SampleCountFlagBits::e1;
+                shadowState.cullMode = vk::CullModeFlagBits::eNone;
+                shadowState.depthCompareOp = vk::CompareOp::eLessOrEqual;
+                shadowState.depthBiasConstant = 1.0f;
+                shadowState.depthBiasSlope = 1.5f;
+                material.shadowPipeline = pipelineCache.request(shadowState);
+                material.shadowDynamic = dynamicRasterStateOf(shadowState);
+            }
+
+            PipelineState state = material.state;
+            if (reversedZ) state.depthCompareOp = reversedCompareOp(state.depthCompareOp);
+
+            material.depthPipeline = ~0u;
+            if (depthPrepass && state.depthTest && state.depthWrite && !state.blendEnable)
+            {
+                PipelineState depthState = state;
+                depthState.fragmentEntry.clear();
+                depthState.colorFormat = vk::Format::eUndefined;
+                depthState.colorWriteMask = {};
+                material.depthPipeline = pipelineCache.request(depthState);
+                material.depthDynamic = dynamicRasterStateOf(depthState);
+
+                // Depth is final after the pre-pass: only the visible surface passes, so each
+                // pixel is shaded once. The equal half of the test lets it through.
+                state.depthWrite = false;
+                state.depthCompareOp = reversedZ ? vk::CompareOp::eGreaterOrEqual : vk::CompareOp::eLessOrEqual;
+            }
+            material.pipeline = pipelineCache.request(state);
+            material.dynamic = dynamicRasterStateOf(state);
+        }
+        pipelineCache.evictUnrequested(deletionQueue);
+    }
+
+    void HelloTriangleApplication::rebuildDrawList()
+    {
+        drawList.clear();
+        std::vector<ShadowCaster> staticCasters;
+        dynamicShadowCasters.clear();
+        world.each<Renderable>([this, &staticCasters](Entity entity, const Renderable& renderable)
+        {
+            drawList.push_back({materials[renderable.material].pipeline, renderable.material, renderable.mesh,
+                                renderable.slot});
+            if (materials[renderable.material].shadowPipeline == ~0u) return;
+            const ShadowCaster caster{renderable.material, renderable.mesh, renderable.slot};
+            if (world.has<Static>(entity) || world.has<Baked>(entity)) staticCasters.push_back(caster);
+            else dynamicShadowCasters.push_back(caster);
+        });
+
+        // Casters in material order, and static ones in a stable order so an unrelated edit does
+        // not look like a change to them
+        const auto byMaterial = [](const ShadowCaster& a, const ShadowCaster& b)
+        {
+            if (a.material != b.material) return a.material < b.material;
+            return a.slot < b.slot;
+        };
+        std::ranges::sort(staticCasters, byMaterial);
+        std::ranges::sort(dynamicShadowCasters, byMaterial);
+        if (staticCasters != staticShadowCasters)
+        {
+            staticShadowCasters = std::move(staticCasters);
+            ++staticCasterVersion;
+        }
+
+        std::ranges::sort(drawList, [](const DrawItem& a, const DrawItem& b)
+        {
+            if (a.pipeline != b.pipeline) return a.pipeline < b.pipeline;
+            if (a.material != b.material) return a.material < b.material;
+            if (a.mesh != b.mesh) return a.mesh < b.mesh;
+            return a.slot < b.slot;
+        });
+
+        // Commands of one material are contiguous, so a group is a range of drawList
+        drawGroups.clear();
+        gpuInstances.clear();
+        for (uint32_t i = 0; i < drawList.size(); ++i)
+        {
+            const DrawItem& item = drawList[i];
+            if (drawGroups.empty() || drawGroups.back().material != item.material)
+            {
+                drawGroups.push_back({item.pipeline, item.material, i, 0});
+            }
+            ++drawGroups.back().count;
+            gpuInstances.push_back({item.slot, static_cast<uint32_t>(drawGroups.size() - 1),
+                                    drawGroups.back().firstCommand, item.mesh});
+        }
+        // Indexed by MeshId; slots of removed meshes are left as they are, nothing draws them
+        gpuMeshes.resize(geometryPool.idLimit());
+        for (MeshId mesh = 0; mesh < geometryPool.idLimit(); ++mesh)
+        {
+            if (!geometryPool.contains(mesh)) continue;
+            const GeometryPool::Mesh& range = geometryPool.mesh(mesh);
+            const MeshBounds& bounds = meshAssets[mesh].bounds;
+            gpuMeshes[mesh] = {glm::vec4(bounds.center, bounds.radius), range.indexCount, range.firstIndex,
+                               range.vertexOffset, 0};
+        }
+        gpuInstancesDirty = true;
+        drawListDirty = false;
+    }
+
+    void HelloTriangleApplication::cullObjects()
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        visibleDrawList.clear();
+        if (cullMode == CullMode::Gpu)
+        {
+            // Survivors are only known on the GPU; recordCommandBuffer() draws drawGroups instead
+            cullStats = {static_cast<uint32_t>(drawList.size()), 0, 0.0};
+            return;
+        }
+        if (cullMode == CullMode::Off)
+        {
+            visibleDrawList.assign(drawList.begin(), drawList.end());
+            cullStats = {static_cast<uint32_t>(drawList.size()), 0, 0.0};
+            return;
+        }
+
+        // A late-latched camera may have moved a little by the time the frame is drawn
+        const FrustumPlanes planes = lateLatchCamera
+                                         ? padLatchFrustum(camera_.getView(), camera_.getProj(),
+                                                           LATCH_MAX_TRANSLATION, LATCH_MAX_ANGLE)
+                                         : camera_.getFrustumPlanes();
+        slotVisible.assign(objectSlotCount, 0);
+        if (cullMode == CullMode::Bvh)
+        {
+            objectTree.queryFrustum(planes, [this](uint32_t slot)
+            {
+                slotVisible[slot] = 1;
+            });
+        }
+        else
+        {
+            // Compacted list of visible slots
+            visibleSlots.resize(objectSlotCount);
+            const size_t visibleCount = frustumCullSpheresParallel(objectBounds, objectSlotCount, planes,
+                                                                   visibleSlots.data());
+            for (size_t i = 0; i < visibleCount; ++i)
+            {
+                slotVisible[visibleSlots[i]] = 1;
+            }
+        }
+
+        if (occlusionCulling) cullOccluded();
+
+        // Keep the pipeline-sorted order of drawList
+        for (const DrawItem& item : drawList)
+        {
+            if (slotVisible[item.slot]) visibleDrawList.push_back(item);
+        }
+
+        cullStats.visible = static_cast<uint32_t>(visibleDrawList.size());
+        cullStats.culled = static_cast<uint32_t>(drawList.size() - visibleDrawList.size());
+        cullStats.milliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void HelloTriangleApplication::cullShadowCasters()
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t c = 0; c < SHADOW_CASCADES; ++c)
+        {
+            cascadeDynamicCasters[c].clear();
+            cascadeStaticCasters[c].clear();
+        }
+        toSun = glm::vec3(std::cos(glm::radians(sunPitch)) * std::sin(glm::radians(sunYaw)),
+                          std::sin(glm::radians(sunPitch)),
+                          std::cos(glm::radians(sunPitch)) * std::cos(glm::radians(sunYaw)));
+        if (!sunEnabled || !shadowsEnabled)
+        {
+            shadowCullMilliseconds = 0.0;
+            return;
+        }
+
+        shadowFitter.fit(camera_.getView(), camera_.getProj(), camera_.getNear(), toSun, shadowDistance,
+                         staticCasterVersion, shadowCascades);
+
+        // Each cascade culls against its own box; static casters only matter when its page is redrawn
+        shadowVisibleSlots.resize(objectSlotCount);
+        for (uint32_t c = 0; c < SHADOW_CASCADES; ++c)
+        {
+            const ShadowCascade& cascade = shadowCascades[c];
+            shadowSlotVisible.assign(objectSlotCount, 0);
+            const size_t visibleCount = frustumCullSpheresParallel(objectBounds, objectSlotCount, cascade.planes,
+                                                                   shadowVisibleSlots.data());
+            for (size_t i = 0; i < visibleCount; ++i)
+            {
+                shadowSlotVisible[shadowVisibleSlots[i]] = 1;
+            }
+
+            for (const ShadowCaster& caster : dynamicShadowCasters)
+            {
+                if (shadowSlotVisible[caster.slot]) cascadeDynamicCasters[c].push_back(caster);
+            }
+            if (!cascade.redrawStatic) continue;
+            for (const ShadowCaster& caster : staticShadowCasters)
+            {
+                if (shadowSlotVisible[caster.slot]) cascadeStaticCasters[c].push_back(caster);
+            }
+        }
+        shadowCullMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void HelloTriangleApplication::cullOccluded()
+    {
+        // Rasterize the occluders that survived frustum culling
+        occlusionBuffer.begin(camera_.getForwardZProj() * camera_.getView());
+        world.each<TransformNode, Renderable, Occluder>(
+            [this](Entity, const TransformNode&, const Renderable& renderable, const Occluder&)
+            {
+                if (!slotVisible[renderable.slot]) return;
+                const MeshAsset& mesh = meshAssets[renderable.mesh];
+                occlusionBuffer.addOccluder(mesh.positions.data(), mesh.positions.size(), mesh.indices.data(),
+                                            mesh.indices.size(), renderWorlds[renderable.slot]);
+            });
+        if (occlusionBuffer.stats().occluders == 0) return;
+        occlusionBuffer.rasterize();
+
+        // Test the remaining visible slots' boxes against it
+        occludeeSlots.clear();
+        occludeeBoxes.clear();
+        for (uint32_t slot = 0; slot < objectSlotCount; ++slot)
+        {
+            if (!slotVisible[slot]) continue;
+            occludeeSlots.push_back(slot);
+            occludeeBoxes.push_back(slotBoxes[slot]);
+        }
+        occludeeVisible.resize(occludeeSlots.size());
+        occlusionBuffer.testVisibility(occludeeBoxes.data(), occludeeBoxes.size(), occludeeVisible.data());
+        for (size_t i = 0; i < occludeeSlots.size(); ++i)
+        {
+            slotVisible[occludeeSlots[i]] = occludeeVisible[i];
+        }
+    }
+
+    void HelloTriangleApplication::createGpuCulling()
+    {
+        // Built with the other shaders by scripts/shader_compiler before the app is compiled
+        const std::string shaderPath = "shaders/cull.spv";
+        const std::string hizShaderPath = "shaders/hiz.spv";
+        if (!supportsGpuCulling || !std::filesystem::exists(shaderPath) || !std::filesystem::exists(hizShaderPath))
+        {
+            supportsGpuCulling = false;
+            if (cullMode == CullMode::Gpu) cullMode = CullMode::Bvh;
+            return;
+        }
+
+        gpuCulling.init(device, gpuMemory, readFile(shaderPath), readFile(hizShaderPath), transformBuffer.buffer(),
+                        transformBuffer.size(), MAX_OBJECTS, MAX_FRAMES_IN_FLIGHT, supportsDrawIndirectCount);
+        setCullingDepthSource();
+    }
+
+    void HelloTriangleApplication::setCullingDepthSource()
+    {
+        if (!supportsGpuCulling) return;
+        if (msaaSamples == vk::SampleCountFlagBits::e1)
+        {
+            // No multisampled depth: the scene's depth is the upscaler's
+            gpuCulling.setDepthSource(upscaler.sceneDepthImage(), upscaler.sceneDepthView(), swapChainExtent,
+                                      msaaSamples, deletionQueue);
+        }
+        else
+        {
+            gpuCulling.setDepthSource(depthImage, *depthImageView, swapChainExtent, msaaSamples, deletionQueue);
+        }
+    }
+
+    void HelloTriangleApplication::createUpscaler()
+    {
+        // The scene always goes through it, so unlike the culling shaders it is required
+        upscaler.init(device, gpuMemory, readFile("shaders/upscale.spv"), MAX_FRAMES_IN_FLIGHT);
+        upscaler.resize(swapChainExtent, swapChainImageFormat, findDepthFormat(), deletionQueue);
+    }
 
+    void HelloTriangleApplication::createClusteredLighting()
+    {
+        // The scene's fragment shader reads its buffers, so it is required like the upscaler
+        clusteredLighting.init(device, gpuMemory, readFile("shaders/cluster.spv"), MAX_FRAMES_IN_FLIGHT);
+    }
+
+    void HelloTriangleApplication::createShadowMaps()
+    {
+        shadowMaps.init(device, gpuMemory, MAX_FRAMES_IN_FLIGHT);
+    }
 
-        vk::GraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.pNext = &pipelineRenderingCreateInfo;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages;
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pDepthStencilState = &depthStencil;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = &dynamicState;
-        pipelineInfo.layout = pipelineLayout;
-        pipelineInfo.renderPass = nullptr;
+    void HelloTriangleApplication::createTimestampQueries()
+    {
+        // Without timestamps dynamic resolution has nothing to go by and keeps its scale
+        const vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+        if (!properties.limits.timestampComputeAndGraphics) return;
+
+        timestampPeriod = properties.limits.timestampPeriod;
+        vk::QueryPoolCreateInfo poolInfo{};
+        poolInfo.queryType = vk::QueryType::eTimestamp;
+        poolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+        gpuTimestamps = vk::raii::QueryPool(device, poolInfo);
+    }
 
+    double HelloTriangleApplication::readGpuMilliseconds(uint32_t frame)
+    {
+        if (!timestampsWritten[frame]) return 0.0;
 
-        graphicsPipeline = vk::raii::Pipeline(device, nullptr, pipelineInfo);
+        const auto [result, ticks] = gpuTimestamps.getResult<std::array<uint64_t, 2>>(
+            2 * frame, 2, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess) return 0.0;
+        return static_cast<double>(ticks[1] - ticks[0]) * timestampPeriod * 1e-6;
     }
 
     void HelloTriangleApplication::createCommandPool()
@@ -566,6 +1051,8 @@ namespace Chopper
 
     void HelloTriangleApplication::createColorResources()
     {
+        // Single-sampled, the scene renders into the upscaler's targets instead
+        if (msaaSamples == vk::SampleCountFlagBits::e1) return;
         vk::Format colorFormat = swapChainImageFormat;
 
         createImage(
@@ -576,6 +1063,8 @@ namespace Chopper
             colorFormat,
             vk::ImageTiling::eOptimal,
             vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment,
+            MemoryCategory::RenderTargets,
+            "MSAA color",
             colorImage, // VkImage
             colorImageAllocation // VmaAllocation
         );
@@ -584,6 +1073,7 @@ namespace Chopper
 
     void HelloTriangleApplication::createDepthResources()
     {
+        if (msaaSamples == vk::SampleCountFlagBits::e1) return;
         vk::Format depthFormat = findDepthFormat();
 
         createImage(
@@ -593,7 +1083,12 @@ namespace Chopper
             msaaSamples,
             depthFormat,
             vk::ImageTiling::eOptimal,
-            vk::ImageUsageFlagBits::eDepthStencilAttachment,
+            // The GPU occlusion pass builds its depth pyramid from it
+            supportsGpuCulling
+                ? vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled
+                : vk::ImageUsageFlagBits::eDepthStencilAttachment,
+            MemoryCategory::RenderTargets,
+            "Depth",
             depthImage, // VkImage
             depthImageAllocation // VmaAllocation
         );
@@ -632,17 +1127,24 @@ namespace Chopper
         return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
     }
 
-    void HelloTriangleApplication::createTextureImage()
+    void HelloTriangleApplication::loadTexturePixels()
     {
-        int texWidth, texHeight, texChannels;
-        stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        vk::DeviceSize imageSize = texWidth * texHeight * 4;
-        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-        if (!pixels)
+        int texChannels;
+        texturePixels = stbi_load(TEXTURE_PATH.c_str(), &textureWidth, &textureHeight, &texChannels, STBI_rgb_alpha);
+        if (!texturePixels)
         {
             throw std::runtime_error("failed to load texture image!");
         }
+    }
+
+    void HelloTriangleApplication::createTextureImage()
+    {
+        const int texWidth = textureWidth;
+        const int texHeight = textureHeight;
+        stbi_uc* pixels = texturePixels;
+        texturePixels = nullptr;
+        vk::DeviceSize imageSize = texWidth * texHeight * 4;
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
 
         // ---------------------------
         // 1. Create staging buffer (CPU visible)
@@ -662,8 +1164,8 @@ namespace Chopper
         allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
             VMA_ALLOCATION_CREATE_MAPPED_BIT; // so we can memcpy directly
 
-        if (vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &stagingBuffer, &stagingAllocation,
-                            &stagingAllocInfo) != VK_SUCCESS)
+        if (gpuMemory.createBuffer(bufferInfo, allocInfo, MemoryCategory::Staging, "Texture staging", stagingBuffer,
+                                   stagingAllocation, &stagingAllocInfo) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create staging buffer for texture!");
         }
@@ -686,6 +1188,8 @@ namespace Chopper
             vk::ImageUsageFlagBits::eTransferSrc | // needed for mipmap generation
             vk::ImageUsageFlagBits::eTransferDst | // we copy into it from staging
             vk::ImageUsageFlagBits::eSampled,
+            MemoryCategory::Textures,
+            "Model texture",
             textureImage, // VkImage
             textureImageAllocation // VmaAllocation
         );
@@ -704,7 +1208,7 @@ namespace Chopper
         // ---------------------------
         // 4. Cleanup staging
         // ---------------------------
-        vmaDestroyBuffer(allocator, stagingBuffer, stagingAllocation);
+        gpuMemory.destroyBuffer(stagingBuffer, stagingAllocation);
     }
 
 
@@ -791,20 +1295,25 @@ namespace Chopper
         endSingleTimeCommands(*commandBuffer);
     }
 
-    vk::SampleCountFlagBits HelloTriangleApplication::getMaxUsableSampleCount()
+    vk::SampleCountFlags HelloTriangleApplication::getUsableSampleCounts()
     {
         vk::PhysicalDeviceProperties physicalDeviceProperties = physicalDevice.getProperties();
 
-        vk::SampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts &
+        return physicalDeviceProperties.limits.framebufferColorSampleCounts &
             physicalDeviceProperties.limits.framebufferDepthSampleCounts;
-        if (counts & vk::SampleCountFlagBits::e64) { return vk::SampleCountFlagBits::e64; }
-        if (counts & vk::SampleCountFlagBits::e32) { return vk::SampleCountFlagBits::e32; }
-        if (counts & vk::SampleCountFlagBits::e16) { return vk::SampleCountFlagBits::e16; }
-        if (counts & vk::SampleCountFlagBits::e8) { return vk::SampleCountFlagBits::e8; }
-        if (counts & vk::SampleCountFlagBits::e4) { return vk::SampleCountFlagBits::e4; }
-        if (counts & vk::SampleCountFlagBits::e2) { return vk::SampleCountFlagBits::e2; }
+    }
 
-        return vk::SampleCountFlagBits::e1;
+    vk::SampleCountFlagBits HelloTriangleApplication::sampleCount(AntiAliasing mode) const
+    {
+        vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+        if (mode == AntiAliasing::Msaa2x) samples = vk::SampleCountFlagBits::e2;
+        if (mode == AntiAliasing::Msaa4x) samples = vk::SampleCountFlagBits::e4;
+        if (mode == AntiAliasing::Msaa8x) samples = vk::SampleCountFlagBits::e8;
+        while (samples != vk::SampleCountFlagBits::e1 && !(supportedSampleCounts & samples))
+        {
+            samples = static_cast<vk::SampleCountFlagBits>(static_cast<uint32_t>(samples) >> 1);
+        }
+        return samples;
     }
 
 
@@ -849,7 +1358,8 @@ namespace Chopper
     void HelloTriangleApplication::createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
                                                vk::SampleCountFlagBits numSamples, vk::Format format,
                                                vk::ImageTiling tiling, vk::ImageUsageFlags usage,
-                                               VkImage& image, VmaAllocation& imageAllocation)
+                                               MemoryCategory category, const char* name, VkImage& image,
+                                               VmaAllocation& imageAllocation)
     {
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -870,7 +1380,7 @@ namespace Chopper
         allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE; // VRAM preferred
         // For GPU-only images (textures, depth, color attachments), device-local is usually best.
 
-        if (vmaCreateImage(allocator, &imageInfo, &allocInfo, &image, &imageAllocation, nullptr) != VK_SUCCESS)
+        if (gpuMemory.createImage(imageInfo, allocInfo, category, name, image, imageAllocation) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create image with VMA!");
         }
@@ -972,9 +1482,39 @@ namespace Chopper
         commandBuffers = vk::raii::CommandBuffers(device, allocInfo);
     }
 
-    void HelloTriangleApplication::recordCommandBuffer(uint32_t imageIndex)
+    void HelloTriangleApplication::recordCommandBuffer(uint32_t imageIndex, RenderSnapshot& snapshot)
     {
         commandBuffers[currentFrame].begin({});
+        if (*gpuTimestamps)
+        {
+            commandBuffers[currentFrame].resetQueryPool(gpuTimestamps, 2 * currentFrame, 2);
+            // The submit waits for the swapchain image at color attachment output, so a start stamped
+            // there leaves out the acquire (vsync) wait. Work that overlaps the wait isn't counted, which
+            // only matters when the GPU has time to spare.
+            commandBuffers[currentFrame].writeTimestamp2(vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                                                         gpuTimestamps, 2 * currentFrame);
+        }
+        // Moves buffers before anything below binds them
+        gpuMemory.defragment(commandBuffers[currentFrame], deletionQueue);
+        // Scatter this frame's changed transforms before any draw reads them
+        transformBuffer.record(commandBuffers[currentFrame], currentFrame);
+        if (snapshot.cullMode == CullMode::Gpu)
+        {
+            gpuCulling.record(commandBuffers[currentFrame], currentFrame, snapshot.proj * snapshot.view,
+                              snapshot.frustumPlanes, snapshot.gpuOcclusion, snapshot.reversedZ);
+        }
+        // The scene covers the top-left renderExtent of its targets and ends up in the upscaler's,
+        // which brings it to the swapchain's size
+        const vk::Extent2D renderExtent{
+            std::min(snapshot.renderExtent.width, swapChainExtent.width),
+            std::min(snapshot.renderExtent.height, swapChainExtent.height)
+        };
+        // Per-cluster light lists for the scene's fragment shader
+        clusteredLighting.record(commandBuffers[currentFrame], currentFrame, snapshot.lights, renderExtent,
+                                 snapshot.view, snapshot.proj, snapshot.ambientLight);
+        recordShadows(snapshot);
+        // Phase 0 and phase 1 draws are split by the depth pyramid build
+        const bool twoPhase = snapshot.cullMode == CullMode::Gpu && snapshot.gpuOcclusion;
         // Before starting rendering, transition the swapchain image to COLOR_ATTACHMENT_OPTIMAL
         transition_image_layout(
             imageIndex,
@@ -986,66 +1526,84 @@ namespace Chopper
             vk::PipelineStageFlagBits2::eColorAttachmentOutput // dstStage
         );
 
-        // Transition the multisampled color image to COLOR_ATTACHMENT_OPTIMAL
-        transition_image_layout_custom(
-            colorImage,
-            vk::ImageLayout::eUndefined,
-            vk::ImageLayout::eColorAttachmentOptimal,
-            {},
-            vk::AccessFlagBits2::eColorAttachmentWrite,
-            vk::PipelineStageFlagBits2::eTopOfPipe,
-            vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-            vk::ImageAspectFlagBits::eColor
-        );
+        // Single-sampled, the scene draws straight into the upscaler's targets, which it transitions
+        const bool multisampled = msaaSamples != vk::SampleCountFlagBits::e1;
+        if (multisampled)
+        {
+            // Transition the multisampled color image to COLOR_ATTACHMENT_OPTIMAL
+            transition_image_layout_custom(
+                colorImage,
+                vk::ImageLayout::eUndefined,
+                vk::ImageLayout::eColorAttachmentOptimal,
+                {},
+                vk::AccessFlagBits2::eColorAttachmentWrite,
+                vk::PipelineStageFlagBits2::eTopOfPipe,
+                vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                vk::ImageAspectFlagBits::eColor
+            );
 
-        // Transition the depth image to DEPTH_ATTACHMENT_OPTIMAL
-        transition_image_layout_custom(
-            depthImage,
-            vk::ImageLayout::eUndefined,
-            vk::ImageLayout::eDepthAttachmentOptimal,
-            {},
-            vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
-            vk::PipelineStageFlagBits2::eTopOfPipe,
-            vk::PipelineStageFlagBits2::eEarlyFragmentTests,
-            vk::ImageAspectFlagBits::eDepth
-        );
-        // Transition depth image to depth attachment optimal layout
-        vk::ImageMemoryBarrier2 depthBarrier = {
-            vk::PipelineStageFlagBits2::eTopOfPipe,
-            {},
-            vk::PipelineStageFlagBits2::eEarlyFragmentTests |
-            vk::PipelineStageFlagBits2::eLateFragmentTests,
-            vk::AccessFlagBits2::eDepthStencilAttachmentRead |
-            vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
-            vk::ImageLayout::eUndefined,
-            vk::ImageLayout::eDepthStencilAttachmentOptimal,
-            VK_QUEUE_FAMILY_IGNORED,
-            VK_QUEUE_FAMILY_IGNORED,
-            depthImage,
-            vk::ImageSubresourceRange{
-                vk::ImageAspectFlagBits::eDepth,
-                0,
-                1,
-                0,
-                1
-            }
-        };
-        vk::DependencyInfo depthDependencyInfo = {};
-        depthDependencyInfo.dependencyFlags = {};
-        depthDependencyInfo.imageMemoryBarrierCount = 1;
-        depthDependencyInfo.pImageMemoryBarriers = &depthBarrier;
+            // Transition the depth image to DEPTH_ATTACHMENT_OPTIMAL
+            transition_image_layout_custom(
+                depthImage,
+                vk::ImageLayout::eUndefined,
+                vk::ImageLayout::eDepthAttachmentOptimal,
+                {},
+                vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                vk::PipelineStageFlagBits2::eTopOfPipe,
+                vk::PipelineStageFlagBits2::eEarlyFragmentTests,
+                vk::ImageAspectFlagBits::eDepth
+            );
+            // Transition depth image to depth attachment optimal layout
+            vk::ImageMemoryBarrier2 depthBarrier = {
+                vk::PipelineStageFlagBits2::eTopOfPipe,
+                {},
+                vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+                vk::PipelineStageFlagBits2::eLateFragmentTests,
+                vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+                vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                vk::ImageLayout::eUndefined,
+                vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                depthImage,
+                vk::ImageSubresourceRange{
+                    vk::ImageAspectFlagBits::eDepth,
+                    0,
+                    1,
+                    0,
+                    1
+                }
+            };
+            vk::DependencyInfo depthDependencyInfo = {};
+            depthDependencyInfo.dependencyFlags = {};
+            depthDependencyInfo.imageMemoryBarrierCount = 1;
+            depthDependencyInfo.pImageMemoryBarriers = &depthBarrier;
+
+            commandBuffers[currentFrame].pipelineBarrier2(depthDependencyInfo);
+        }
 
-        commandBuffers[currentFrame].pipelineBarrier2(depthDependencyInfo);
+        upscaler.beginFrame(commandBuffers[currentFrame], currentFrame, renderExtent, snapshot.temporalUpscale,
+                            snapshot.postProcessAntiAliasing);
+        const vk::ResolveModeFlagBits colorResolve = multisampled
+                                                         ? vk::ResolveModeFlagBits::eAverage
+                                                         : vk::ResolveModeFlagBits::eNone;
+        // The upscaler reprojects with the depth; any sample will do
+        const vk::ResolveModeFlagBits depthResolve = multisampled
+                                                         ? vk::ResolveModeFlagBits::eSampleZero
+                                                         : vk::ResolveModeFlagBits::eNone;
+        const vk::AttachmentStoreOp depthStore = multisampled
+                                                     ? vk::AttachmentStoreOp::eDontCare
+                                                     : vk::AttachmentStoreOp::eStore;
 
         vk::ClearValue clearColor = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
-        vk::ClearValue clearDepth = vk::ClearDepthStencilValue(1.0f, 0);
+        vk::ClearValue clearDepth = vk::ClearDepthStencilValue(snapshot.reversedZ ? 0.0f : 1.0f, 0);
 
-        // Color attachment (multisampled) with resolve attachment
+        // Color attachment, multisampled with resolve attachment or the upscaler's target
         vk::RenderingAttachmentInfo colorAttachment = {};
-        colorAttachment.imageView = colorImageView;
+        colorAttachment.imageView = multisampled ? *colorImageView : upscaler.sceneColorView();
         colorAttachment.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
-        colorAttachment.resolveMode = vk::ResolveModeFlagBits::eAverage;
-        colorAttachment.resolveImageView = swapChainImageViews[imageIndex];
+        colorAttachment.resolveMode = colorResolve;
+        colorAttachment.resolveImageView = upscaler.sceneColorView();
         colorAttachment.resolveImageLayout = vk::ImageLayout::eColorAttachmentOptimal;
         colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
         colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
@@ -1054,68 +1612,261 @@ namespace Chopper
 
         // Depth attachment
         vk::RenderingAttachmentInfo depthAttachment = {};
-        depthAttachment.imageView = depthImageView;
+        depthAttachment.imageView = multisampled ? *depthImageView : upscaler.sceneDepthView();
         depthAttachment.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal;
+        depthAttachment.resolveMode = depthResolve;
+        depthAttachment.resolveImageView = upscaler.sceneDepthView();
+        depthAttachment.resolveImageLayout = vk::ImageLayout::eDepthAttachmentOptimal;
         depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-        depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+        depthAttachment.storeOp = depthStore;
         depthAttachment.clearValue = clearDepth;
 
 
         vk::RenderingInfo renderingInfo = {};
         renderingInfo.renderArea.offset.setX(0);
         renderingInfo.renderArea.offset.setY(0);
-        renderingInfo.renderArea.extent = swapChainExtent;
+        renderingInfo.renderArea.extent = renderExtent;
         renderingInfo.layerCount = 1;
         renderingInfo.colorAttachmentCount = 1;
         renderingInfo.pColorAttachments = &colorAttachment;
         renderingInfo.pDepthAttachment = &depthAttachment;
 
 
-        commandBuffers[currentFrame].beginRendering(renderingInfo);
-        commandBuffers[currentFrame].bindPipeline(vk::PipelineBindPoint::eGraphics, *graphicsPipeline);
-        commandBuffers[currentFrame].setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapChainExtent.width),
-                                                                 static_cast<float>(swapChainExtent.height), 0.0f,
-                                                                 1.0f));
-        commandBuffers[currentFrame].setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapChainExtent));
-        // Bind vertex and index buffers
-        commandBuffers[currentFrame].bindVertexBuffers(0, vk::Buffer(vertexBuffer), {0});
-        commandBuffers[currentFrame].bindIndexBuffer(indexBuffer, 0, vk::IndexType::eUint32);
-
-
-        // Draw each object with its own descriptor set
-        for (const auto& gameObject : gameObjects)
-        {
-            // Bind the descriptor set for this object
-            commandBuffers[currentFrame].bindDescriptorSets(
-                vk::PipelineBindPoint::eGraphics,
-                *pipelineLayout,
-                0,
-                *gameObject.descriptorSets[currentFrame],
-                nullptr
-            );
+        if (snapshot.depthPrepass)
+        {
+            // Depth only, from the same draws; the color pass then tests against the final depth
+            vk::RenderingAttachmentInfo prepassDepth = depthAttachment;
+            prepassDepth.resolveMode = vk::ResolveModeFlagBits::eNone;
+            prepassDepth.storeOp = vk::AttachmentStoreOp::eStore;
+            vk::RenderingInfo prepassInfo = renderingInfo;
+            prepassInfo.colorAttachmentCount = 0;
+            prepassInfo.pColorAttachments = nullptr;
+            prepassInfo.pDepthAttachment = &prepassDepth;
+
+            beginScenePass(prepassInfo);
+            if (snapshot.cullMode == CullMode::Gpu)
+            {
+                drawGpuGroups(snapshot, 0, true);
+            }
+            else
+            {
+                for (const RenderDraw& draw : snapshot.draws)
+                {
+                    if (!draw.depthPipeline) continue;
+                    pipelineCache.bind(commandBuffers[currentFrame], draw.depthPipeline, draw.depthDynamic);
+                    commandBuffers[currentFrame].drawIndexed(draw.mesh.indexCount, 1, draw.mesh.firstIndex,
+                                                             draw.mesh.vertexOffset, draw.slot);
+                }
+            }
+            commandBuffers[currentFrame].endRendering();
+
+            if (twoPhase)
+            {
+                // The pyramid only needs depth, so both phases go through the pre-pass before
+                // anything is shaded
+                gpuCulling.recordOcclusion(commandBuffers[currentFrame], currentFrame, renderExtent);
+                prepassDepth.loadOp = vk::AttachmentLoadOp::eLoad;
+                beginScenePass(prepassInfo);
+                drawGpuGroups(snapshot, 1, true);
+                commandBuffers[currentFrame].endRendering();
+            }
+
+            vk::MemoryBarrier2 prepassBarrier{
+                vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite
+            };
+            vk::DependencyInfo prepassDependencyInfo{};
+            prepassDependencyInfo.memoryBarrierCount = 1;
+            prepassDependencyInfo.pMemoryBarriers = &prepassBarrier;
+            commandBuffers[currentFrame].pipelineBarrier2(prepassDependencyInfo);
 
-            // Draw the object
-            commandBuffers[currentFrame].drawIndexed(indices.size(), 1, 0, 0, 0);
+            depthAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
         }
+        else if (twoPhase)
+        {
+            // Phase 0 keeps its color and depth for phase 1; the resolve happens at the very end
+            colorAttachment.resolveMode = vk::ResolveModeFlagBits::eNone;
+            depthAttachment.resolveMode = vk::ResolveModeFlagBits::eNone;
+            depthAttachment.storeOp = vk::AttachmentStoreOp::eStore;
 
-        // ImGui!
-        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *commandBuffers[currentFrame]);
+            beginScenePass(renderingInfo);
+            drawGpuGroups(snapshot, 0);
+            commandBuffers[currentFrame].endRendering();
 
-        commandBuffers[currentFrame].endRendering();
+            gpuCulling.recordOcclusion(commandBuffers[currentFrame], currentFrame, renderExtent);
 
-        // After rendering, transition the swapchain image to PRESENT_SRC
-        transition_image_layout(
-            imageIndex,
-            vk::ImageLayout::eColorAttachmentOptimal,
-            vk::ImageLayout::ePresentSrcKHR,
+            vk::MemoryBarrier2 colorBarrier{
+                vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+                vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite
+            };
+            vk::DependencyInfo colorDependencyInfo{};
+            colorDependencyInfo.memoryBarrierCount = 1;
+            colorDependencyInfo.pMemoryBarriers = &colorBarrier;
+            commandBuffers[currentFrame].pipelineBarrier2(colorDependencyInfo);
+
+            colorAttachment.resolveMode = colorResolve;
+            depthAttachment.resolveMode = depthResolve;
+            colorAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+            depthAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+            depthAttachment.storeOp = depthStore;
+        }
+
+        beginScenePass(renderingInfo);
+
+        if (snapshot.cullMode == CullMode::Gpu)
+        {
+            // After a two-phase pre-pass both phases are shaded here
+            if (twoPhase && snapshot.depthPrepass) drawGpuGroups(snapshot, 0);
+            drawGpuGroups(snapshot, twoPhase ? 1 : 0);
+        }
+        else
+        {
+            // Draw each object grouped by pipeline; firstInstance selects its transform and the
+            // mesh's range selects its geometry in the pool
+            for (const RenderDraw& draw : snapshot.draws)
+            {
+                pipelineCache.bind(commandBuffers[currentFrame], draw.pipeline, draw.dynamic);
+
+                commandBuffers[currentFrame].drawIndexed(draw.mesh.indexCount, 1, draw.mesh.firstIndex,
+                                                         draw.mesh.vertexOffset, draw.slot);
+            }
+        }
+
+        commandBuffers[currentFrame].endRendering();
+
+        upscaler.record(commandBuffers[currentFrame], currentFrame, swapChainImageViews[imageIndex]);
+        vk::MemoryBarrier2 upscaleBarrier{
+            vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+            vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite
+        };
+        vk::DependencyInfo upscaleDependencyInfo{};
+        upscaleDependencyInfo.memoryBarrierCount = 1;
+        upscaleDependencyInfo.pMemoryBarriers = &upscaleBarrier;
+        commandBuffers[currentFrame].pipelineBarrier2(upscaleDependencyInfo);
+
+        // ImGui! At full resolution, over the upscaled scene
+        vk::RenderingAttachmentInfo uiAttachment = {};
+        uiAttachment.imageView = swapChainImageViews[imageIndex];
+        uiAttachment.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        uiAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+        uiAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+        vk::RenderingInfo uiRenderingInfo = {};
+        uiRenderingInfo.renderArea.extent = swapChainExtent;
+        uiRenderingInfo.layerCount = 1;
+        uiRenderingInfo.colorAttachmentCount = 1;
+        uiRenderingInfo.pColorAttachments = &uiAttachment;
+        commandBuffers[currentFrame].beginRendering(uiRenderingInfo);
+        ImGui_ImplVulkan_RenderDrawData(snapshot.ui.drawData(), *commandBuffers[currentFrame]);
+        commandBuffers[currentFrame].endRendering();
+
+        // After rendering, transition the swapchain image to PRESENT_SRC
+        transition_image_layout(
+            imageIndex,
+            vk::ImageLayout::eColorAttachmentOptimal,
+            vk::ImageLayout::ePresentSrcKHR,
             vk::AccessFlagBits2::eColorAttachmentWrite, // srcAccessMask
             {}, // dstAccessMask
             vk::PipelineStageFlagBits2::eColorAttachmentOutput, // srcStage
             vk::PipelineStageFlagBits2::eBottomOfPipe // dstStage
         );
+        if (*gpuTimestamps)
+        {
+            commandBuffers[currentFrame].writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, gpuTimestamps,
+                                                         2 * currentFrame + 1);
+            timestampsWritten[currentFrame] = true;
+        }
         commandBuffers[currentFrame].end();
     }
 
+    void HelloTriangleApplication::beginScenePass(const vk::RenderingInfo& renderingInfo)
+    {
+        commandBuffers[currentFrame].beginRendering(renderingInfo);
+        pipelineCache.resetBindings();
+        const vk::Extent2D extent = renderingInfo.renderArea.extent;
+        commandBuffers[currentFrame].setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width),
+                                                                 static_cast<float>(extent.height), 0.0f, 1.0f));
+        commandBuffers[currentFrame].setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+        bindSceneResources();
+    }
+
+    void HelloTriangleApplication::bindSceneResources()
+    {
+        // Every mesh lives in the geometry pool, so its buffers are bound once per pass
+        commandBuffers[currentFrame].bindVertexBuffers(0, vk::Buffer(geometryPool.vertexBuffer()), {0});
+        commandBuffers[currentFrame].bindIndexBuffer(geometryPool.indexBuffer(), 0, vk::IndexType::eUint32);
+
+
+        // Every material shares the pipeline layout, so one set serves the whole frame
+        commandBuffers[currentFrame].bindDescriptorSets(
+            vk::PipelineBindPoint::eGraphics,
+            *pipelineLayout,
+            0,
+            *descriptorSets[currentFrame],
+            nullptr
+        );
+    }
+
+    void HelloTriangleApplication::recordShadows(const RenderSnapshot& snapshot)
+    {
+        const vk::raii::CommandBuffer& cmd = commandBuffers[currentFrame];
+        shadowMaps.updateUniforms(currentFrame, snapshot.cascades, snapshot.toSun, snapshot.sunColor,
+                                  snapshot.shadows);
+        const auto drawCasters = [&](const ShadowCascade& cascade, const std::vector<ShadowDraw>& draws)
+        {
+            pipelineCache.resetBindings();
+            bindSceneResources();
+            cmd.pushConstants<glm::mat4>(*pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, cascade.viewProj);
+            for (const ShadowDraw& draw : draws)
+            {
+                pipelineCache.bind(cmd, draw.pipeline, draw.dynamic);
+                cmd.drawIndexed(draw.mesh.indexCount, 1, draw.mesh.firstIndex, draw.mesh.vertexOffset, draw.slot);
+            }
+        };
+
+        if (snapshot.shadows)
+        {
+            for (uint32_t c = 0; c < SHADOW_CASCADES; ++c)
+            {
+                // Static casters only when the cascade's cached page went stale
+                if (staticShadowPending[c])
+                {
+                    shadowMaps.beginStaticPage(cmd, c);
+                    drawCasters(snapshot.cascades[c], pendingStaticShadowDraws[c]);
+                    shadowMaps.endStaticPage(cmd, c);
+                    staticShadowPending[c] = false;
+                }
+                shadowMaps.beginCascade(cmd, c);
+                drawCasters(snapshot.cascades[c], snapshot.dynamicShadowDraws[c]);
+                shadowMaps.endCascade(cmd);
+            }
+        }
+        shadowMaps.finish(cmd);
+    }
+
+    void HelloTriangleApplication::drawGpuGroups(const RenderSnapshot& snapshot, uint32_t phase, bool depthOnly)
+    {
+        // One indirect call per material, however many objects it has
+        for (uint32_t group = 0; group < snapshot.groups.size(); ++group)
+        {
+            const RenderGroup& drawGroup = snapshot.groups[group];
+            if (depthOnly)
+            {
+                if (!drawGroup.depthPipeline) continue;
+                pipelineCache.bind(commandBuffers[currentFrame], drawGroup.depthPipeline, drawGroup.depthDynamic);
+            }
+            else
+            {
+                pipelineCache.bind(commandBuffers[currentFrame], drawGroup.pipeline, drawGroup.dynamic);
+            }
+            gpuCulling.draw(commandBuffers[currentFrame], currentFrame, phase, group, drawGroup.firstCommand,
+                            drawGroup.count);
+        }
+    }
+
     void HelloTriangleApplication::transition_image_layout(
         uint32_t imageIndex,
         vk::ImageLayout old_layout,
@@ -1171,11 +1922,11 @@ namespace Chopper
             {
                 Vertex vertex{};
 
-                vertex.pos = {
+                vertex.pos = glm::vec3(modelPreTransform * glm::vec4(
                     attrib.vertices[3 * index.vertex_index + 0],
                     attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-                };
+                    attrib.vertices[3 * index.vertex_index + 2],
+                    1.0f));
                 vertex.texCoord = {
                     attrib.texcoords[2 * index.texcoord_index + 0],
                     1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
@@ -1193,98 +1944,336 @@ namespace Chopper
                 indices.push_back(uniqueVertices[vertex]);
             }
         }
+
+        occlusionBuffer.resize(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
     }
 
     void HelloTriangleApplication::setupGameObjects()
     {
         // Object 1 - Center
-        gameObjects[0].position = {0.0f, 0.0f, 0.0f};
-        gameObjects[0].rotation = {0.0f, 0.0f, 0.0f};
-        gameObjects[0].scale = {1.0f, 1.0f, 1.0f};
+        Entity center = spawnObject({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0, modelMesh);
+        NodeId centerNode = world.get<TransformNode>(center).node;
+        world.add<Occluder>(center);
+        // Turns slowly, carrying its children with it
+        world.add<Spin>(center, Spin{{0.0f, 0.5f, 0.0f}});
+
+        // Object 2 - Left, follows the center object
+        spawnObject({0.0f, 0.0f, 0.0f}, {0.0f, glm::radians(45.0f), 0.0f}, {1.0f, 1.0f, 1.0f}, 1, modelMesh,
+                    centerNode);
+
+        // Object 3 - Right, follows the center object
+        spawnObject({0.0f, 0.0f, 0.0f}, {0.0f, glm::radians(-45.0f), 0.0f}, {1.0f, 1.0f, 1.0f}, 0, modelMesh,
+                    centerNode);
+    }
 
-        // Object 2 - Left
-        gameObjects[1].position = {0.0f, 0.0f, 0.0f};
-        gameObjects[1].rotation = {0.0f, glm::radians(45.0f), 0.0f};
-        gameObjects[1].scale = {1.0f, 1.0f, 1.0f};
+    Entity HelloTriangleApplication::spawnObject(const glm::vec3& position, const glm::vec3& rotation,
+                                                 const glm::vec3& scale, uint32_t material, MeshId mesh,
+                                                 NodeId parent)
+    {
+        uint32_t slot;
+        if (!freeObjectSlots.empty())
+        {
+            // The new node's first upload overwrites whatever the slot held
+            slot = freeObjectSlots.back();
+            freeObjectSlots.pop_back();
+        }
+        else
+        {
+            if (objectSlotCount >= MAX_OBJECTS)
+            {
+                throw std::runtime_error("exceeded MAX_OBJECTS renderable entities!");
+            }
+            slot = objectSlotCount++;
+            objectBounds.resize(objectSlotCount);
+            slotProxies.resize(objectSlotCount, DynamicAabbTree::NULL_NODE);
+            slotBoxes.resize(objectSlotCount);
+            previousWorlds.resize(objectSlotCount);
+            currentWorlds.resize(objectSlotCount);
+            renderWorlds.resize(objectSlotCount);
+            slotSentFrame.resize(objectSlotCount);
+            slotMeshes.resize(objectSlotCount);
+        }
+        slotMeshes[slot] = mesh;
+
+        // New nodes start dirty, so the slot's matrix is uploaded on the next update
+        NodeId node = sceneGraph.create(parent, position, rotation, scale);
+        if (nodeSlots.size() <= node) nodeSlots.resize(node + 1, ~0u);
+        nodeSlots[node] = slot;
+        Entity entity = world.create(TransformNode{node}, Renderable{material, mesh, slot});
+        spawnedEntities.push_back(entity);
+        drawListDirty = true;
+        return entity;
+    }
 
-        // Object 3 - Right
-        gameObjects[2].position = {0.0f, 0.0f, 0.0f};
-        gameObjects[2].rotation = {0.0f, glm::radians(-45.0f), 0.0f};
-        gameObjects[2].scale = {1.0f, 1.0f, 1.0f};
+    void HelloTriangleApplication::destroyObject(Entity entity)
+    {
+        if (!world.alive(entity)) return;
+
+        const NodeId node = world.get<TransformNode>(entity).node;
+        const uint32_t slot = world.get<Renderable>(entity).slot;
+        freeObjectSlots.push_back(slot);
+        nodeSlots[node] = ~0u;
+        objectBounds.clear(slot);
+        if (slotProxies[slot] != DynamicAabbTree::NULL_NODE)
+        {
+            objectTree.destroyProxy(slotProxies[slot]);
+            slotProxies[slot] = DynamicAabbTree::NULL_NODE;
+        }
+        std::erase(movingSlots, slot);
+        std::erase(settledSlots, slot);
+        sceneGraph.destroy(node);
+        world.destroy(entity);
+        std::erase(spawnedEntities, entity);
+        drawListDirty = true;
     }
 
+    void HelloTriangleApplication::spawnStaticField()
+    {
+        // A floor of small cubes: thousands of tiny draws until they are baked
+        const MeshId mesh = loadCubeMesh();
+        constexpr float SPACING = 2.0f;
+        const float origin = -0.5f * SPACING * (STATIC_FIELD_SIZE - 1);
+        for (int z = 0; z < STATIC_FIELD_SIZE; ++z)
+        {
+            for (int x = 0; x < STATIC_FIELD_SIZE; ++x)
+            {
+                const glm::vec3 position(origin + SPACING * x, -3.0f, origin + SPACING * z);
+                const glm::vec3 rotation(0.0f, 0.3f * static_cast<float>((x * 7 + z * 3) % 11), 0.0f);
+                const Entity entity = spawnObject(position, rotation, glm::vec3(0.4f),
+                                                  static_cast<uint32_t>((x + z) % 2), mesh);
+                world.add<Static>(entity);
+            }
+        }
+    }
 
-    void HelloTriangleApplication::createVertexBuffer()
+    void HelloTriangleApplication::spawnLights(int count)
     {
-        //-------------------------------------------------------- Old way
-        /*
-        
-        vk::DeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-        
-        // 1. Create staging buffer
-        vk::raii::Buffer stagingBuffer({});
-
-        vk::raii::DeviceMemory stagingBufferMemory({});
-        
-        createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
-                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-                     stagingBuffer, stagingBufferMemory);
-
-        void* dataStaging = stagingBufferMemory.mapMemory(0, bufferSize);
-        // Copy vertex data
-        memcpy(dataStaging, vertices.data(), bufferSize);
-        stagingBufferMemory.unmapMemory();
-        // 2. Create GPU-local vertex buffer
-
-        createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-                     vk::MemoryPropertyFlagBits::eDeviceLocal, vertexBuffer, vertexBufferMemory);
-
-        // 3. Copy staging → vertex buffer
-        copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-        */
+        // A grid over the static field, just above its cubes; every fourth light is a spot
+        // shining straight down from higher up
+        count = std::min(count, static_cast<int>(ClusteredLighting::MAX_LIGHTS - lightEntities.size()));
+        if (count <= 0) return;
+        const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+        // The static field's width
+        const float extent = 2.0f * STATIC_FIELD_SIZE;
+        const float spacing = extent / static_cast<float>(side);
+        const float origin = -0.5f * extent + 0.5f * spacing;
+        for (int i = 0; i < count; ++i)
+        {
+            const int x = i % side;
+            const int z = i / side;
+            const bool spot = i % 4 == 3;
+            const glm::vec3 position(origin + spacing * x, spot ? 0.0f : -2.0f, origin + spacing * z);
+            const glm::vec3 rotation(spot ? glm::radians(-90.0f) : 0.0f, 0.0f, 0.0f);
+
+            // Hues spread by the golden ratio, so neighbours differ
+            const float hue = std::fmod(0.618034f * static_cast<float>(lightEntities.size()), 1.0f);
+            Light light{};
+            light.color = 0.5f + 0.5f * glm::cos(glm::two_pi<float>() * (hue + glm::vec3(0.0f, 1.0f, 2.0f) / 3.0f));
+            light.intensity = 4.0f;
+            light.range = std::max(3.0f, 1.5f * spacing);
+            if (spot)
+            {
+                light.range *= 2.0f;
+                light.innerAngle = glm::radians(20.0f);
+                light.outerAngle = glm::radians(35.0f);
+            }
 
-        //-------------------------------------------------------- VMA way underneath
+            // Lights have a node but no renderable slot
+            const NodeId node = sceneGraph.create(INVALID_NODE, position, rotation, glm::vec3(1.0f));
+            if (nodeSlots.size() <= node) nodeSlots.resize(node + 1, ~0u);
+            lightEntities.push_back(world.create(TransformNode{node}, light));
+        }
+    }
 
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+    void HelloTriangleApplication::clearLights()
+    {
+        for (const Entity entity : lightEntities)
+        {
+            sceneGraph.destroy(world.get<TransformNode>(entity).node);
+            world.destroy(entity);
+        }
+        lightEntities.clear();
+    }
 
-        // 1. Create staging buffer (CPU-visible, for uploading data)
-        VkBuffer stagingBuffer;
-        VmaAllocation stagingAllocation;
+    void HelloTriangleApplication::gatherLights(std::vector<ClusteredLighting::Light>& lights)
+    {
+        lights.clear();
+        if (!lightingEnabled) return;
 
-        VkBufferCreateInfo stagingInfo = {};
-        stagingInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        stagingInfo.size = bufferSize;
-        stagingInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        world.each<TransformNode, Light>([this, &lights](Entity, const TransformNode& transform, const Light& light)
+        {
+            if (lights.size() >= ClusteredLighting::MAX_LIGHTS) return;
+
+            const glm::mat4& worldMatrix = sceneGraph.worldMatrix(transform.node);
+            ClusteredLighting::Light gpuLight{};
+            gpuLight.position = glm::vec3(worldMatrix[3]);
+            gpuLight.range = light.range;
+            gpuLight.color = light.color * light.intensity;
+            if (light.outerAngle > 0.0f)
+            {
+                // The binning's cone test needs a cone narrower than a half-space
+                const float outer = std::min(light.outerAngle, glm::radians(89.0f));
+                gpuLight.direction = glm::normalize(-glm::vec3(worldMatrix[2]));
+                gpuLight.cosOuter = std::cos(outer);
+                // Kept apart so the cone's falloff has a range to blend over
+                gpuLight.cosInner = std::max(std::cos(std::min(light.innerAngle, outer)), gpuLight.cosOuter + 1e-4f);
+            }
+            lights.push_back(gpuLight);
+        });
+    }
 
-        VmaAllocationCreateInfo stagingAllocInfo = {};
-        stagingAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
-        stagingAllocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-            VMA_ALLOCATION_CREATE_MAPPED_BIT; // CPU write access
+    void HelloTriangleApplication::bakeStaticBatches()
+    {
+        // World matrices must be current, so this runs after applySceneEdits()
+        std::vector<StaticInstance> instances;
+        std::vector<Entity> sources;
+        world.each<TransformNode, Renderable, Static>(
+            [&](Entity entity, const TransformNode& transform, const Renderable& renderable, const Static&)
+            {
+                const MeshAsset& asset = meshAssets[renderable.mesh];
+                // Only meshes loaded with keepVertices can be merged
+                if (asset.vertices.empty()) return;
+                instances.push_back({renderable.material, asset.vertices, asset.indices, asset.bounds.center,
+                                     sceneGraph.worldMatrix(transform.node)});
+                sources.push_back(entity);
+            });
+        if (instances.empty()) return;
+
+        // Every batch takes a mesh id of its own; merge cells until the batches fit in the free ones
+        const uint32_t freeMeshes = MAX_MESHES - geometryPool.stats().meshes;
+        float cellSize = staticCellSize;
+        std::vector<StaticBatch> batches = buildStaticBatches(instances, cellSize, STATIC_BATCH_MAX_VERTICES);
+        while (batches.size() > freeMeshes && cellSize < STATIC_MAX_CELL_SIZE)
+        {
+            cellSize *= 2.0f;
+            batches = buildStaticBatches(instances, cellSize, STATIC_BATCH_MAX_VERTICES);
+        }
+        if (batches.size() > freeMeshes)
+        {
+            std::cerr << "static bake skipped: " << batches.size() << " batches for " << freeMeshes
+                      << " free mesh ids" << std::endl;
+            return;
+        }
+
+        // Upload every batch before the scene changes, so a pool without room leaves it as it was
+        std::vector<MeshId> batchMeshes;
+        batchMeshes.reserve(batches.size());
+        try
+        {
+            for (const StaticBatch& batch : batches)
+            {
+                batchMeshes.push_back(loadMesh("Static batch " +
+                                               std::to_string(staticBatchMeshes.size() + batchMeshes.size()),
+                                               batch.vertices, batch.indices));
+            }
+        }
+        catch (const std::runtime_error& e)
+        {
+            for (const MeshId mesh : batchMeshes)
+            {
+                unloadMesh(mesh);
+            }
+            std::cerr << "static bake skipped: " << e.what() << std::endl;
+            return;
+        }
+
+        for (const Entity entity : sources)
+        {
+            destroyObject(entity);
+        }
+        // Vertices are in world space and the mesh bounds are the batch's, so an entity with an
+        // identity transform is drawn and culled like any other
+        for (size_t i = 0; i < batches.size(); ++i)
+        {
+            const Entity entity = spawnObject(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f), batches[i].material,
+                                              batchMeshes[i]);
+            // Still static as far as the shadow pages are concerned
+            world.add<Baked>(entity);
+            staticBatchMeshes.push_back(batchMeshes[i]);
+        }
+        staticBatchedObjects += static_cast<uint32_t>(sources.size());
+    }
 
-        VmaAllocationInfo stagingAllocDetails;
-        vmaCreateBuffer(allocator, &stagingInfo, &stagingAllocInfo,
-                        &stagingBuffer, &stagingAllocation, &stagingAllocDetails);
+    void HelloTriangleApplication::clearStaticBatches()
+    {
+        for (const MeshId mesh : staticBatchMeshes)
+        {
+            unloadMesh(mesh);
+        }
+        staticBatchMeshes.clear();
+        staticBatchedObjects = 0;
+    }
 
-        // Copy vertex data
-        memcpy(stagingAllocDetails.pMappedData, vertices.data(), (size_t)bufferSize);
 
-        // 2. Create GPU-local vertex buffer
-        VkBufferCreateInfo vertexInfo = {};
-        vertexInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        vertexInfo.size = bufferSize;
-        vertexInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    void HelloTriangleApplication::createGeometry()
+    {
+        // Sized for the model with room to spare, and at least the default pool
+        geometryPool.init(gpuMemory, std::max(GEOMETRY_VERTICES, 2 * static_cast<uint32_t>(vertices.size())),
+                          std::max(GEOMETRY_INDICES, 2 * static_cast<uint32_t>(indices.size())), MAX_MESHES);
+        modelMesh = loadMesh("Model", vertices, indices);
+        // The pool and meshAssets hold what is still needed
+        vertices = {};
+        indices = {};
+    }
 
-        VmaAllocationCreateInfo vertexAllocInfo = {};
-        vertexAllocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE; // Let VMA choose VRAM
+    MeshId HelloTriangleApplication::loadMesh(const std::string& name, const std::vector<Vertex>& meshVertices,
+                                              const std::vector<uint32_t>& meshIndices, bool keepVertices)
+    {
+        // The upload is a queue submission and the deletion queue is the render thread's
+        frameHandoff.drain();
+        std::unique_ptr<vk::raii::CommandBuffer> commandBuffer = beginSingleTimeCommands();
+        const MeshId mesh = geometryPool.add(*commandBuffer, meshVertices, meshIndices, deletionQueue);
+        endSingleTimeCommands(*commandBuffer);
 
-        vmaCreateBuffer(allocator, &vertexInfo, &vertexAllocInfo,
-                        &vertexBuffer, &vertexBufferAllocation, nullptr);
+        if (meshAssets.size() <= mesh) meshAssets.resize(mesh + 1);
+        MeshAsset& asset = meshAssets[mesh];
+        asset.name = name;
+        asset.bounds = computeMeshBounds(meshVertices);
+        asset.positions.clear();
+        asset.positions.reserve(meshVertices.size());
+        for (const Vertex& vertex : meshVertices)
+        {
+            asset.positions.push_back(vertex.pos);
+        }
+        asset.indices = meshIndices;
+        asset.vertices.clear();
+        if (keepVertices) asset.vertices = meshVertices;
+        drawListDirty = true;
+        return mesh;
+    }
 
-        // 3. Copy staging → vertex buffer
-        copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+    MeshId HelloTriangleApplication::loadCubeMesh()
+    {
+        if (cubeMesh == INVALID_MESH)
+        {
+            std::vector<Vertex> cubeVertices;
+            std::vector<uint32_t> cubeIndices;
+            makeCubeMesh(cubeVertices, cubeIndices);
+            cubeMesh = loadMesh("Cube", cubeVertices, cubeIndices, true);
+        }
+        return cubeMesh;
+    }
 
-        // 4. Cleanup staging
-        vmaDestroyBuffer(allocator, stagingBuffer, stagingAllocation);
+    void HelloTriangleApplication::unloadMesh(MeshId mesh)
+    {
+        if (!geometryPool.contains(mesh)) return;
+
+        std::vector<Entity> users;
+        world.each<Renderable>([&](Entity entity, const Renderable& renderable)
+        {
+            if (renderable.mesh == mesh) users.push_back(entity);
+        });
+        for (const Entity entity : users)
+        {
+            destroyObject(entity);
+        }
+
+        // Frames in flight may still draw it; the pool reuses its ranges once they finish
+        frameHandoff.drain();
+        geometryPool.remove(mesh, deletionQueue);
+        meshAssets[mesh] = {};
+        if (spawnMesh == mesh) spawnMesh = modelMesh;
+        drawListDirty = true;
     }
 
     void HelloTriangleApplication::copyBuffer(VkBuffer srcBuffer,
@@ -1307,184 +2296,166 @@ namespace Chopper
         queue.waitIdle();
     }
 
-    void HelloTriangleApplication::createIndexBuffer()
+    void HelloTriangleApplication::createUniformBuffers()
     {
-        // 1. Create staging buffer (CPU-visible, for uploading data)
-        vk::DeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
-        VkBuffer stagingBuffer;
-        VmaAllocation stagingAllocation;
-
-        VkBufferCreateInfo stagingInfo = {};
-        stagingInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        stagingInfo.size = bufferSize;
-        stagingInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingInfo.pNext = nullptr;
-
-        VmaAllocationCreateInfo stagingAllocInfo = {};
-        stagingAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
-        stagingAllocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-            VMA_ALLOCATION_CREATE_MAPPED_BIT; // CPU write access
-
-        VmaAllocationInfo stagingAllocDetails;
-        vmaCreateBuffer(allocator, &stagingInfo, &stagingAllocInfo,
-                        &stagingBuffer, &stagingAllocation, &stagingAllocDetails);
-
-        // Copy vertex data
-        memcpy(stagingAllocDetails.pMappedData, indices.data(), (size_t)bufferSize);
-
-        // 2. Create GPU-local vertex buffer
-        VkBufferCreateInfo indexInfo = {};
-        indexInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        indexInfo.size = bufferSize;
-        indexInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        uniformBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
+        uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-        VmaAllocationCreateInfo indexAllocInfo = {};
-        indexAllocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE; // Let VMA choose VRAM
-
-        vmaCreateBuffer(allocator, &indexInfo, &indexAllocInfo,
-                        &indexBuffer, &indexBufferAllocation, nullptr);
-
-        // 3. Copy staging → index buffer
-        copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = bufferSize;
+            bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VmaAllocationCreateInfo allocInfo{};
+            allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+            allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                VMA_ALLOCATION_CREATE_MAPPED_BIT; // keep it mapped
+
+            VmaAllocationInfo vmaAllocDetails{};
+            if (gpuMemory.createBuffer(bufferInfo, allocInfo, MemoryCategory::Uniforms, "Camera uniforms",
+                                       uniformBuffers[i], uniformBuffersAllocation[i], &vmaAllocDetails) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create uniform buffer with VMA!");
+            }
 
-        // 4. Cleanup staging
-        vmaDestroyBuffer(allocator, stagingBuffer, stagingAllocation);
+            // Already mapped because of the flag
+            uniformBuffersMapped[i] = vmaAllocDetails.pMappedData;
+        }
 
-        /*
-                // 1. Create staging buffer
-                vk::raii::Buffer stagingBuffer({});
-                vk::raii::DeviceMemory stagingBufferMemory({});
-                
-                createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
-                             vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-                             stagingBuffer, stagingBufferMemory);
-        
-                void* data = stagingBufferMemory.mapMemory(0, bufferSize);
-                // Copy vertex data
-                memcpy(data, indices.data(), (size_t)bufferSize);
-                stagingBufferMemory.unmapMemory();
-        // 2. Create GPU-local vertex buffer
-                createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-                             vk::MemoryPropertyFlagBits::eDeviceLocal, indexBuffer, indexBufferMemory);
-        // 3. Copy staging → vertex buffer
-                copyBuffer(*stagingBuffer, *indexBuffer, bufferSize);
-        */
+        transformBuffer.init(gpuMemory, MAX_OBJECTS, MAX_FRAMES_IN_FLIGHT);
     }
 
-    void HelloTriangleApplication::createUniformBuffers()
+    void HelloTriangleApplication::createDescriptorSets()
     {
-        for (auto& gameObject : gameObjects)
-        {
-            gameObject.uniformBuffers.clear();
-            gameObject.uniformBuffersAllocation.clear();
-            gameObject.uniformBuffersMapped.clear();
-
-            VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-            gameObject.uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-            gameObject.uniformBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
-            gameObject.uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        std::vector<vk::DescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+        vk::DescriptorSetAllocateInfo allocInfo{};
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+        allocInfo.pSetLayouts = layouts.data();
 
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-            {
-                VkBufferCreateInfo bufferInfo{};
-                bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-                bufferInfo.size = bufferSize;
-                bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-                bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-                VmaAllocationCreateInfo allocInfo{};
-                allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
-                allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-                    VMA_ALLOCATION_CREATE_MAPPED_BIT; // keep it mapped
+        descriptorSets = device.allocateDescriptorSets(allocInfo);
 
-                VmaAllocationInfo vmaAllocDetails{};
-                if (vmaCreateBuffer(allocator, &bufferInfo, &allocInfo,
-                                    &gameObject.uniformBuffers[i], &gameObject.uniformBuffersAllocation[i],
-                                    &vmaAllocDetails) != VK_SUCCESS)
-                {
-                    throw std::runtime_error("failed to create uniform buffer with VMA!");
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            vk::DescriptorBufferInfo bufferInfo{};
+            bufferInfo.buffer = uniformBuffers[i];
+            bufferInfo.offset = 0;
+            bufferInfo.range = sizeof(UniformBufferObject);
+
+            vk::DescriptorImageInfo imageInfo{};
+            imageInfo.sampler = textureSampler;
+            imageInfo.imageView = textureImageView;
+            imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+            vk::DescriptorBufferInfo transformInfo{};
+            transformInfo.buffer = transformBuffer.buffer();
+            transformInfo.offset = 0;
+            transformInfo.range = transformBuffer.size();
+
+            vk::WriteDescriptorSet descriptor_set0 = {};
+            descriptor_set0.dstSet = descriptorSets[i];
+            descriptor_set0.dstBinding = 0;
+            descriptor_set0.dstArrayElement = 0;
+            descriptor_set0.descriptorCount = 1;
+            descriptor_set0.descriptorType = vk::DescriptorType::eUniformBuffer;
+            descriptor_set0.pBufferInfo = &bufferInfo;
+
+
+            vk::WriteDescriptorSet descriptor_set1 = {};
+            descriptor_set1.dstSet = descriptorSets[i];
+            descriptor_set1.dstBinding = 1;
+            descriptor_set1.dstArrayElement = 0;
+            descriptor_set1.descriptorCount = 1;
+            descriptor_set1.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+            descriptor_set1.pImageInfo = &imageInfo;
+
+            vk::WriteDescriptorSet descriptor_set2 = {};
+            descriptor_set2.dstSet = descriptorSets[i];
+            descriptor_set2.dstBinding = 2;
+            descriptor_set2.dstArrayElement = 0;
+            descriptor_set2.descriptorCount = 1;
+            descriptor_set2.descriptorType = vk::DescriptorType::eStorageBuffer;
+            descriptor_set2.pBufferInfo = &transformInfo;
+
+            std::array descriptorWrites{
+                vk::WriteDescriptorSet{
+                    descriptor_set0
+                },
+                vk::WriteDescriptorSet{
+                    descriptor_set1
+                },
+                vk::WriteDescriptorSet{
+                    descriptor_set2
                 }
+            };
+            device.updateDescriptorSets(descriptorWrites, {});
 
-                // Already mapped because of the flag
-                gameObject.uniformBuffersMapped[i] = vmaAllocDetails.pMappedData;
+            // Bindings 3 to 6: the frame's clustered lighting buffers
+            const auto frame = static_cast<uint32_t>(i);
+            const std::array lightingInfos{
+                clusteredLighting.uniformsInfo(frame), clusteredLighting.lightsInfo(frame),
+                clusteredLighting.countsInfo(frame), clusteredLighting.indicesInfo(frame)
+            };
+            std::array<vk::WriteDescriptorSet, 4> lightingWrites;
+            for (uint32_t b = 0; b < lightingWrites.size(); ++b)
+            {
+                lightingWrites[b].dstSet = descriptorSets[i];
+                lightingWrites[b].dstBinding = 3 + b;
+                lightingWrites[b].descriptorCount = 1;
+                lightingWrites[b].descriptorType = b == 0
+                                                       ? vk::DescriptorType::eUniformBuffer
+                                                       : vk::DescriptorType::eStorageBuffer;
+                lightingWrites[b].pBufferInfo = &lightingInfos[b];
+            }
+            device.updateDescriptorSets(lightingWrites, {});
+
+            // Bindings 7 to 9: shadow uniforms, the shadow map and its comparison sampler
+            const vk::DescriptorBufferInfo shadowInfo = shadowMaps.uniformsInfo(frame);
+            const vk::DescriptorImageInfo shadowMapInfo = shadowMaps.mapInfo();
+            const vk::DescriptorImageInfo shadowSamplerInfo = shadowMaps.samplerInfo();
+            std::array<vk::WriteDescriptorSet, 3> shadowWrites;
+            for (uint32_t b = 0; b < shadowWrites.size(); ++b)
+            {
+                shadowWrites[b].dstSet = descriptorSets[i];
+                shadowWrites[b].dstBinding = 7 + b;
+                shadowWrites[b].descriptorCount = 1;
             }
+            shadowWrites[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+            shadowWrites[0].pBufferInfo = &shadowInfo;
+            shadowWrites[1].descriptorType = vk::DescriptorType::eSampledImage;
+            shadowWrites[1].pImageInfo = &shadowMapInfo;
+            shadowWrites[2].descriptorType = vk::DescriptorType::eSampler;
+            shadowWrites[2].pImageInfo = &shadowSamplerInfo;
+            device.updateDescriptorSets(shadowWrites, {});
         }
     }
 
 
     void HelloTriangleApplication::createDescriptorPool()
     {
-        // We need MAX_OBJECTS * MAX_FRAMES_IN_FLIGHT descriptor sets
+        // One descriptor set per frame in flight, shared by every object
         std::array poolSize{
-            vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, MAX_OBJECTS * MAX_FRAMES_IN_FLIGHT),
-            vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, MAX_OBJECTS * MAX_FRAMES_IN_FLIGHT)
+            vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, 3 * MAX_FRAMES_IN_FLIGHT),
+            vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, MAX_FRAMES_IN_FLIGHT),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 4 * MAX_FRAMES_IN_FLIGHT),
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, MAX_FRAMES_IN_FLIGHT),
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampler, MAX_FRAMES_IN_FLIGHT)
         };
         vk::DescriptorPoolCreateInfo poolInfo{};
         poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
-        poolInfo.maxSets = MAX_OBJECTS * MAX_FRAMES_IN_FLIGHT,
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT,
             poolInfo.poolSizeCount = static_cast<uint32_t>(poolSize.size());
         poolInfo.pPoolSizes = poolSize.data();
 
         descriptorPool = vk::raii::DescriptorPool(device, poolInfo);
     }
 
-    void HelloTriangleApplication::createDescriptorSets()
-    {
-        for (auto& gameObject : gameObjects)
-        {
-            std::vector<vk::DescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-            vk::DescriptorSetAllocateInfo allocInfo{};
-            allocInfo.descriptorPool = descriptorPool;
-            allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
-            allocInfo.pSetLayouts = layouts.data();
-
-            gameObject.descriptorSets.clear();
-            gameObject.descriptorSets = device.allocateDescriptorSets(allocInfo);
-
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-            {
-                vk::DescriptorBufferInfo bufferInfo{};
-                bufferInfo.buffer = gameObject.uniformBuffers[i];
-                bufferInfo.offset = 0;
-                bufferInfo.range = sizeof(UniformBufferObject);
-
-                vk::DescriptorImageInfo imageInfo{};
-                imageInfo.sampler = textureSampler;
-                imageInfo.imageView = textureImageView;
-                imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-
-                vk::WriteDescriptorSet descriptor_set0 = {};
-                descriptor_set0.dstSet = gameObject.descriptorSets[i];
-                descriptor_set0.dstBinding = 0;
-                descriptor_set0.dstArrayElement = 0;
-                descriptor_set0.descriptorCount = 1;
-                descriptor_set0.descriptorType = vk::DescriptorType::eUniformBuffer;
-                descriptor_set0.pBufferInfo = &bufferInfo;
-
-
-                vk::WriteDescriptorSet descriptor_set1 = {};
-                descriptor_set1.dstSet = gameObject.descriptorSets[i];
-                descriptor_set1.dstBinding = 1;
-                descriptor_set1.dstArrayElement = 0;
-                descriptor_set1.descriptorCount = 1;
-                descriptor_set1.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-                descriptor_set1.pImageInfo = &imageInfo;
-
-                std::array descriptorWrites{
-                    vk::WriteDescriptorSet{
-                        descriptor_set0
-                    },
-                    vk::WriteDescriptorSet{
-                        descriptor_set1
-                    }
-                };
-                device.updateDescriptorSets(descriptorWrites, {});
-            }
-        }
-    }
-
     void HelloTriangleApplication::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage,
                                                 vk::MemoryPropertyFlags properties, vk::raii::Buffer& buffer,
                                                 vk::raii::DeviceMemory& bufferMemory)
@@ -1555,61 +2526,371 @@ namespace Chopper
         commandBuffers[currentFrame].pipelineBarrier2(dependency_info);
     }
 
+    void HelloTriangleApplication::createSwapChainSemaphores()
+    {
+        for (size_t i = 0; i < swapChainImages.size(); i++)
+        {
+            renderFinishedSemaphore.emplace_back(device, vk::SemaphoreCreateInfo());
+        }
+    }
+
     void HelloTriangleApplication::createSyncObjects()
     {
         presentCompleteSemaphore.clear();
         renderFinishedSemaphore.clear();
-        inFlightFences.clear();
 
-        for (size_t i = 0; i < swapChainImages.size(); i++)
+        createSwapChainSemaphores();
+
+        // An acquire semaphore may only be reused once the frame that waited on it has finished,
+        // which is known per frame slot
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
             presentCompleteSemaphore.emplace_back(device, vk::SemaphoreCreateInfo());
-            renderFinishedSemaphore.emplace_back(device, vk::SemaphoreCreateInfo());
         }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        vk::SemaphoreTypeCreateInfo timelineInfo{vk::SemaphoreType::eTimeline, 0};
+        frameTimeline = vk::raii::Semaphore(device, vk::SemaphoreCreateInfo{{}, &timelineInfo});
+    }
+
+    double HelloTriangleApplication::waitForFrame(uint64_t frame)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        vk::SemaphoreWaitInfo waitInfo{};
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &*frameTimeline;
+        waitInfo.pValues = &frame;
+        if (device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess)
         {
-            inFlightFences.emplace_back(device, vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+            throw std::runtime_error("failed to wait for frame completion!");
         }
+        deletionQueue.completed(frameTimeline.getCounterValue());
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
     }
 
-    void HelloTriangleApplication::updateUniformBuffer(uint32_t currentImage)
+    void HelloTriangleApplication::simulationStep(float stepSeconds)
     {
-        static auto startTime = std::chrono::high_resolution_clock::now();
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float>(currentTime - startTime).count();
+        // What moved last step starts this one at rest; it stays in settledSlots so its final
+        // state is still drawn if nothing moves it again
+        for (const uint32_t slot : movingSlots)
+        {
+            previousWorlds[slot] = currentWorlds[slot];
+        }
+        settledSlots.insert(settledSlots.end(), movingSlots.begin(), movingSlots.end());
+        movingSlots.clear();
 
-        glm::mat4 view = camera_.getView();
-        glm::mat4 proj = camera_.getProj();
-        
-        for (auto& gameObject : gameObjects)
+        world.each<TransformNode, Spin>([this, stepSeconds](Entity, const TransformNode& transform, const Spin& spin)
         {
-            gameObject.rotation.y += 0.000f; // Slow rotation around Y axis
-            glm::mat4 initialRotation = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            glm::mat4 model = gameObject.getModelMatrix() * initialRotation;
-            UniformBufferObject ubo{
-                .model = model,
-                .view = view,
-                .proj = proj
-            };
-            memcpy(gameObject.uniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+            sceneGraph.setRotation(transform.node, sceneGraph.rotation(transform.node) + spin.rate * stepSeconds);
+        });
+
+        // Only nodes edited since the last step, and their descendants, are recomputed
+        sceneGraph.update();
+        for (const NodeId node : sceneGraph.changed())
+        {
+            const uint32_t slot = nodeSlots[node];
+            if (slot == ~0u) continue;
+            currentWorlds[slot] = sceneGraph.worldMatrix(node);
+            movingSlots.push_back(slot);
         }
     }
 
-    void HelloTriangleApplication::drawFrame()
+    void HelloTriangleApplication::applySceneEdits()
     {
-        while (vk::Result::eTimeout == device.waitForFences(*inFlightFences[currentFrame], vk::True, UINT64_MAX));
-        if (framebufferResized)
+        // Edits made outside the simulation (UI, spawns) take effect at once, without blending
+        sceneGraph.update();
+        for (const NodeId node : sceneGraph.changed())
         {
-            framebufferResized = false;
-            recreateSwapChain();
-            return;
+            const uint32_t slot = nodeSlots[node];
+            if (slot == ~0u) continue;
+            previousWorlds[slot] = sceneGraph.worldMatrix(node);
+            currentWorlds[slot] = previousWorlds[slot];
+            settledSlots.push_back(slot);
+        }
+    }
+
+    void HelloTriangleApplication::updateScene(std::vector<TransformUpdate>& transforms)
+    {
+        // Slots between two simulation states are blended at the frame's point between the
+        // steps; only they, and slots that just came to rest, go to the render thread for upload
+        transforms.clear();
+        ++simulationFrame;
+        const float alpha = interpolateTransforms ? simulationClock.alpha() : 1.0f;
+        auto send = [&](uint32_t slot)
+        {
+            if (slotSentFrame[slot] == simulationFrame) return;
+            slotSentFrame[slot] = simulationFrame;
+
+            const glm::mat4 worldMatrix = interpolateTransform(previousWorlds[slot], currentWorlds[slot], alpha);
+            renderWorlds[slot] = worldMatrix;
+            transforms.push_back({slot, worldMatrix});
+            const MeshBounds& bounds = meshAssets[slotMeshes[slot]].bounds;
+            objectBounds.set(slot, bounds, worldMatrix);
+
+            const Aabb box = transformAabb({bounds.min, bounds.max}, worldMatrix);
+            slotBoxes[slot] = box;
+            if (slotProxies[slot] == DynamicAabbTree::NULL_NODE)
+            {
+                slotProxies[slot] = objectTree.createProxy(box, slot);
+            }
+            else
+            {
+                objectTree.moveProxy(slotProxies[slot], box);
+            }
+        };
+        for (const uint32_t slot : settledSlots)
+        {
+            send(slot);
+        }
+        settledSlots.clear();
+        for (const uint32_t slot : movingSlots)
+        {
+            send(slot);
+        }
+    }
+
+    void HelloTriangleApplication::updateUniformBuffer(const CameraSample& camera)
+    {
+        UniformBufferObject ubo{
+            .view = camera.view,
+            .proj = camera.proj
+        };
+        memcpy(uniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+        vmaFlushAllocation(gpuMemory.allocator(), uniformBuffersAllocation[currentFrame], 0, sizeof(ubo));
+    }
+
+    void HelloTriangleApplication::sampleInput()
+    {
+        // GLFW input is main-thread only, so this thread is the input sampler: once per frame,
+        // and every INPUT_SAMPLE_INTERVAL while it waits for the render thread
+        const double now = glfwGetTime();
+        camera_.update(now - last_input_time);
+        last_input_time = now;
+        cameraLatch.publish({camera_.getView(), camera_.getProj(), camera_.getFrustumPlanes(),
+                             std::chrono::steady_clock::now()});
+    }
+
+    void HelloTriangleApplication::simulateFrame()
+    {
+        const bool resized = framebufferResized.exchange(false);
+        if (resized || requestedAntiAliasing != antiAliasing || requestedReversedZ != reversedZ ||
+            requestedDepthPrepass != depthPrepass)
+        {
+            // The swapchain and its attachments are the render thread's until it is idle
+            frameHandoff.drain();
+            if (resized) recreateSwapChain();
+            if (requestedAntiAliasing != antiAliasing) applyAntiAliasing();
+            if (requestedReversedZ != reversedZ) applyDepthConvention();
+            if (requestedDepthPrepass != depthPrepass)
+            {
+                depthPrepass = requestedDepthPrepass;
+                resolveMaterialPipelines();
+                drawListDirty = true;
+            }
+        }
+
+        // Waits only while the render thread is still drawing the frame before last, sampling
+        // input meanwhile; the render thread posts an empty event when it frees a slot
+        RenderSnapshot* next;
+        while (!(next = frameHandoff.tryBeginWrite()))
+        {
+            glfwWaitEventsTimeout(INPUT_SAMPLE_INTERVAL);
+            sampleInput();
+        }
+        RenderSnapshot& snapshot = *next;
+        renderFeedback = snapshot.feedback;
+        const auto start = std::chrono::high_resolution_clock::now();
+        frameArena.reset();
+
+        // UI first so spawns and edits made this frame are simulated and drawn this frame
+        paintImGui();
+        applySceneEdits();
+        if (staticBakeRequested)
+        {
+            // The batches it spawns are applied like any other edit
+            staticBakeRequested = false;
+            bakeStaticBatches();
+            applySceneEdits();
+        }
+
+        // A frame-time spike changes how many steps run, never the length of one, so the
+        // simulation's results don't depend on the frame rate
+        simulationSteps = simulationClock.advance(delta_time);
+        for (uint32_t i = 0; i < simulationSteps; ++i)
+        {
+            simulationStep(static_cast<float>(simulationClock.step()));
+        }
+        updateScene(snapshot.transforms);
+        if (drawListDirty) rebuildDrawList();
+        cullObjects();
+        cullShadowCasters();
+        fillSnapshot(snapshot);
+        updateImGuiTextures();
+
+        simulationMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        frameHandoff.publish();
+    }
+
+    void HelloTriangleApplication::fillSnapshot(RenderSnapshot& snapshot)
+    {
+        snapshot.view = camera_.getView();
+        snapshot.proj = camera_.getProj();
+        snapshot.frustumPlanes = camera_.getFrustumPlanes();
+        snapshot.cameraSampledAt = cameraLatch.latest().sampledAt;
+        snapshot.lateLatchCamera = lateLatchCamera;
+        snapshot.framesInFlight = static_cast<uint32_t>(framesInFlight);
+        // Scaled down while the GPU misses the target frame time, back up once it has room
+        if (dynamicResolutionEnabled)
+        {
+            dynamicResolution.setTargetMilliseconds(1000.0 / targetGpuFps);
+            renderScale = dynamicResolution.update(renderFeedback.gpuMilliseconds);
+        }
+        else
+        {
+            renderScale = fixedRenderScale;
+        }
+        snapshot.renderExtent = vk::Extent2D{DynamicResolution::scaled(swapChainExtent.width, renderScale),
+                                             DynamicResolution::scaled(swapChainExtent.height, renderScale)};
+        snapshot.temporalUpscale = temporalUpscale;
+        snapshot.postProcessAntiAliasing = antiAliasing == AntiAliasing::PostProcess;
+        snapshot.reversedZ = reversedZ;
+        snapshot.depthPrepass = depthPrepass;
+        snapshot.cullMode = cullMode;
+        snapshot.gpuOcclusion = gpuOcclusion;
+
+        // Pipelines are resolved here, so the render thread never reads the cache's entries
+        snapshot.draws.clear();
+        for (const DrawItem& item : visibleDrawList)
+        {
+            const Material& material = materials[item.material];
+            snapshot.draws.push_back({pipelineCache.get(item.pipeline), material.dynamic,
+                                      material.depthPipeline != ~0u ? pipelineCache.get(material.depthPipeline)
+                                                                    : vk::Pipeline{},
+                                      material.depthDynamic, geometryPool.mesh(item.mesh), item.slot});
+        }
+        snapshot.groups.clear();
+        for (const DrawGroup& group : drawGroups)
+        {
+            const Material& material = materials[group.material];
+            snapshot.groups.push_back({pipelineCache.get(group.pipeline), material.dynamic,
+                                       material.depthPipeline != ~0u ? pipelineCache.get(material.depthPipeline)
+                                                                     : vk::Pipeline{},
+                                       material.depthDynamic, group.firstCommand, group.count});
+        }
+        snapshot.instancesChanged = gpuInstancesDirty;
+        if (gpuInstancesDirty)
+        {
+            snapshot.instances.assign(gpuInstances.begin(), gpuInstances.end());
+            snapshot.meshes.assign(gpuMeshes.begin(), gpuMeshes.end());
+            gpuInstancesDirty = false;
+        }
+        gatherLights(snapshot.lights);
+        snapshot.ambientLight = ambientLight;
+        snapshot.toSun = toSun;
+        snapshot.sunColor = sunEnabled ? sunColor * sunIntensity : glm::vec3(0.0f);
+        snapshot.shadows = sunEnabled && shadowsEnabled;
+        snapshot.cascades = shadowCascades;
+        const auto resolveCasters = [this](const std::vector<ShadowCaster>& casters, std::vector<ShadowDraw>& draws)
+        {
+            draws.clear();
+            for (const ShadowCaster& caster : casters)
+            {
+                const Material& material = materials[caster.material];
+                draws.push_back({pipelineCache.get(material.shadowPipeline), material.shadowDynamic,
+                                 geometryPool.mesh(caster.mesh), caster.slot});
+            }
+        };
+        for (uint32_t c = 0; c < SHADOW_CASCADES; ++c)
+        {
+            resolveCasters(cascadeDynamicCasters[c], snapshot.dynamicShadowDraws[c]);
+            resolveCasters(cascadeStaticCasters[c], snapshot.staticShadowDraws[c]);
+        }
+
+        snapshot.ui.capture(*ImGui::GetDrawData());
+    }
+
+    void HelloTriangleApplication::updateImGuiTextures()
+    {
+        // Snapshots carry no texture updates. Uploads submit to the queue the render thread
+        // uses, so they wait for it to go idle; they only happen when the font atlas changes.
+        bool pending = false;
+        for (const ImTextureData* texture : ImGui::GetPlatformIO().Textures)
+        {
+            pending = pending || texture->Status != ImTextureStatus_OK;
+        }
+        if (!pending) return;
+
+        frameHandoff.drain();
+        for (ImTextureData* texture : ImGui::GetPlatformIO().Textures)
+        {
+            if (texture->Status != ImTextureStatus_OK) ImGui_ImplVulkan_UpdateTexture(texture);
+        }
+    }
+
+    void HelloTriangleApplication::renderLoop()
+    {
+        while (RenderSnapshot* snapshot = frameHandoff.beginRead())
+        {
+            // After a failure snapshots are still released, so the main thread never blocks on
+            // the handoff before it sees renderFailed
+            if (!renderFailed.load())
+            {
+                try
+                {
+                    renderFrame(*snapshot);
+                }
+                catch (...)
+                {
+                    renderError = std::current_exception();
+                    renderFailed.store(true);
+                }
+            }
+            frameHandoff.endRead();
+            glfwPostEmptyEvent();
+        }
+    }
+
+    void HelloTriangleApplication::renderFrame(RenderSnapshot& snapshot)
+    {
+        // The slot's resources are free once its last frame has finished; frames in flight are
+        // capped by also waiting for the frame framesInFlight before this one
+        const uint64_t previousFrames = deletionQueue.lastSubmitted();
+        snapshot.feedback.frameWaitMilliseconds = waitForFrame(std::max(
+            frameNumbers[currentFrame],
+            previousFrames >= snapshot.framesInFlight ? previousFrames + 1 - snapshot.framesInFlight : 0));
+        snapshot.feedback.gpuMilliseconds = readGpuMilliseconds(currentFrame);
+        gpuMemory.update(static_cast<uint32_t>(previousFrames + 1));
+        snapshot.feedback.memoryBudgets = gpuMemory.budgets();
+        if (frameCameraSampledAt[currentFrame] != std::chrono::steady_clock::time_point{})
+        {
+            snapshot.feedback.inputToGpuMilliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - frameCameraSampledAt[currentFrame]).count();
+            frameCameraSampledAt[currentFrame] = {};
+        }
+
+        // Queued even if this frame is skipped below; the next recorded frame uploads them
+        for (const TransformUpdate& update : snapshot.transforms)
+        {
+            transformBuffer.set(update.slot, update.world);
+        }
+        if (snapshot.instancesChanged && supportsGpuCulling)
+        {
+            gpuCulling.setInstances(snapshot.instances, static_cast<uint32_t>(snapshot.groups.size()),
+                                    snapshot.meshes);
+        }
+        // Static shadow pages are only asked for once, so a redraw waits here until it is recorded
+        for (uint32_t c = 0; c < SHADOW_CASCADES && snapshot.shadows; ++c)
+        {
+            if (!snapshot.cascades[c].redrawStatic) continue;
+            pendingStaticShadowDraws[c].swap(snapshot.staticShadowDraws[c]);
+            staticShadowPending[c] = true;
         }
+
         auto [result, imageIndex] = swapChain.acquireNextImage(
-            UINT64_MAX, *presentCompleteSemaphore[semaphoreIndex], nullptr);
+            UINT64_MAX, *presentCompleteSemaphore[currentFrame], nullptr);
         if (result == vk::Result::eErrorOutOfDateKHR)
         {
-            recreateSwapChain();
+            framebufferResized = true;
             return;
         }
         if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
@@ -1617,26 +2898,71 @@ namespace Chopper
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
-        updateUniformBuffer(currentFrame);
-
-        paintImGui();
-
-        device.resetFences(*inFlightFences[currentFrame]);
         commandBuffers[currentFrame].reset();
-        recordCommandBuffer(imageIndex);
-
-        vk::PipelineStageFlags waitDestinationStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-
-        vk::SubmitInfo submitInfo{};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = &*presentCompleteSemaphore[semaphoreIndex];
-        submitInfo.pWaitDstStageMask = &waitDestinationStageMask;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &*commandBuffers[currentFrame];
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = &*renderFinishedSemaphore[imageIndex];
+        const auto recordStart = std::chrono::high_resolution_clock::now();
+        recordCommandBuffer(imageIndex, snapshot);
+        snapshot.feedback.recordMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - recordStart).count();
+        snapshot.feedback.binds = pipelineCache.bindsThisFrame();
+        snapshot.feedback.staticShadowPages = shadowMaps.staticPagesDrawn();
+        snapshot.feedback.uploads = transformBuffer.stats();
+        snapshot.feedback.defragment = gpuMemory.defragmentStats();
+
+        const uint64_t frameNumber = previousFrames + 1;
+        const vk::SemaphoreSubmitInfo waitInfo{*presentCompleteSemaphore[currentFrame], 0,
+                                               vk::PipelineStageFlagBits2::eColorAttachmentOutput};
+        const std::array signalInfos{
+            vk::SemaphoreSubmitInfo{*renderFinishedSemaphore[imageIndex], 0, vk::PipelineStageFlagBits2::eAllCommands},
+            vk::SemaphoreSubmitInfo{*frameTimeline, frameNumber, vk::PipelineStageFlagBits2::eAllCommands}
+        };
+        const vk::CommandBufferSubmitInfo commandBufferInfo{*commandBuffers[currentFrame]};
+        vk::SubmitInfo2 submitInfo{};
+        submitInfo.waitSemaphoreInfoCount = 1;
+        submitInfo.pWaitSemaphoreInfos = &waitInfo;
+        submitInfo.commandBufferInfoCount = 1;
+        submitInfo.pCommandBufferInfos = &commandBufferInfo;
+        submitInfo.signalSemaphoreInfoCount = static_cast<uint32_t>(signalInfos.size());
+        submitInfo.pSignalSemaphoreInfos = signalInfos.data();
+
+        // Late latch: the camera is read from the newest input sample as the last thing before
+        // submission. The commands only reference the uniform buffers, so their contents can
+        // still change. CPU culling used the snapshot's camera with a padded frustum, so a sample
+        // that drifted past the padding is not latched.
+        CameraSample camera{snapshot.view, snapshot.proj, snapshot.frustumPlanes, snapshot.cameraSampledAt};
+        snapshot.feedback.latchRejected = false;
+        if (snapshot.lateLatchCamera)
+        {
+            const CameraSample latest = cameraLatch.latest();
+            const bool culledOnCpu = snapshot.cullMode == CullMode::Linear || snapshot.cullMode == CullMode::Bvh;
+            if (!culledOnCpu || withinLatchBudget(camera, latest, LATCH_MAX_TRANSLATION, LATCH_MAX_ANGLE))
+            {
+                camera = latest;
+            }
+            else
+            {
+                snapshot.feedback.latchRejected = true;
+            }
+        }
+        // Only the draws see the jitter; culling and reprojection use the camera as it is
+        CameraSample jittered = camera;
+        jittered.proj = Camera::jitterProjection(camera.proj, upscaler.jitter(currentFrame),
+                                                 glm::vec2(snapshot.renderExtent.width, snapshot.renderExtent.height));
+        updateUniformBuffer(jittered);
+        upscaler.latchCamera(currentFrame, camera.proj * camera.view);
+        clusteredLighting.latchCamera(currentFrame, camera.view, camera.proj);
+        if (snapshot.cullMode == CullMode::Gpu)
+        {
+            gpuCulling.latchCamera(currentFrame, camera.proj * camera.view, camera.planes);
+        }
+        const auto submitTime = std::chrono::steady_clock::now();
+        snapshot.feedback.inputAgeMilliseconds = std::chrono::duration<double, std::milli>(
+            submitTime - camera.sampledAt).count();
+        snapshot.feedback.snapshotCameraAgeMilliseconds = std::chrono::duration<double, std::milli>(
+            submitTime - snapshot.cameraSampledAt).count();
+        frameCameraSampledAt[currentFrame] = camera.sampledAt;
 
-        queue.submit(submitInfo, *inFlightFences[currentFrame]);
+        queue.submit2(submitInfo);
+        frameNumbers[currentFrame] = deletionQueue.submitted();
 
         vk::PresentInfoKHR presentInfoKHR{};
         presentInfoKHR.waitSemaphoreCount = 1;
@@ -1647,18 +2973,17 @@ namespace Chopper
 
         result = queue.presentKHR(presentInfoKHR);
 
-        if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR || framebufferResized)
+        if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
         {
-            framebufferResized = false;
-            recreateSwapChain();
+            // Recreated by the main thread once this thread is idle
+            framebufferResized = true;
         }
         else if (result != vk::Result::eSuccess)
         {
             throw std::runtime_error("failed to present swap chain image!");
         }
 
-        semaphoreIndex = (semaphoreIndex + 1) % presentCompleteSemaphore.size();
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % snapshot.framesInFlight;
     }
 
     void HelloTriangleApplication::initImGui()
@@ -1695,6 +3020,8 @@ namespace Chopper
         glfwGetFramebufferSize(window, &w, &h);
 
         IMGUI_CHECKVERSION();
+        // Counted like operator new, so UI allocations show up in the per-frame check
+        ImGui::SetAllocatorFunctions(AllocationCounter::allocate, AllocationCounter::release);
         ImGui::CreateContext();
         io = &ImGui::GetIO();
         //(void)io;
@@ -1720,8 +3047,10 @@ namespace Chopper
         init_info.DescriptorPoolSize = 0;
         init_info.RenderPass = nullptr;
         init_info.MinImageCount = 2;
-        init_info.ImageCount = 2;
-        init_info.MSAASamples = VkSampleCountFlagBits(msaaSamples);
+        // The backend cycles its vertex buffers over ImageCount frames; cover every frame in flight
+        init_info.ImageCount = MAX_FRAMES_IN_FLIGHT;
+        // Drawn after the upscale, straight into the swapchain image
+        init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
         init_info.UseDynamicRendering = true;
         init_info.Subpass = 0;
 
@@ -1735,7 +3064,7 @@ namespace Chopper
         init_info.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
         VkFormat format = VkFormat::VK_FORMAT_B8G8R8A8_SRGB;
         init_info.PipelineRenderingCreateInfo.pColorAttachmentFormats = &format;
-        init_info.PipelineRenderingCreateInfo.depthAttachmentFormat = VK_FORMAT_D32_SFLOAT;
+        init_info.PipelineRenderingCreateInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
         init_info.PipelineRenderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
 
         ImGui_ImplVulkan_Init(&init_info);
@@ -1780,13 +3109,319 @@ namespace Chopper
             ImGui::Text("counter = %d", counter);
 
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io->Framerate, io->Framerate);
+            ImGui::Text("Simulation %.3f ms, render thread recording %.3f ms", simulationMilliseconds,
+                        renderFeedback.recordMilliseconds);
+            const char* pacingModes[] = {"Low latency", "Max throughput", "Custom"};
+            int pacingIndex = static_cast<int>(framePacing);
+            if (ImGui::Combo("Frame pacing", &pacingIndex, pacingModes, IM_ARRAYSIZE(pacingModes)))
+            {
+                framePacing = static_cast<FramePacing>(pacingIndex);
+                if (framePacing == FramePacing::LowLatency)
+                {
+                    framesInFlight = 1;
+                    limitFrameRate = true;
+                }
+                else if (framePacing == FramePacing::Throughput)
+                {
+                    framesInFlight = 3;
+                    limitFrameRate = false;
+                }
+            }
+            // Editing either setting leaves the preset
+            if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1, MAX_FRAMES_IN_FLIGHT))
+            {
+                framePacing = FramePacing::Custom;
+            }
+            if (ImGui::Checkbox("Frame limiter", &limitFrameRate))
+            {
+                framePacing = FramePacing::Custom;
+            }
+            if (limitFrameRate)
+            {
+                float targetFps = static_cast<float>(frameLimiter.targetFps());
+                if (ImGui::SliderFloat("Target FPS", &targetFps, 20.0f, 360.0f, "%.0f"))
+                {
+                    frameLimiter.setTargetFps(targetFps);
+                }
+                ImGui::Text("Limiter wait %.2f ms (%.2f ms spinning)", frameLimiter.waitMilliseconds(),
+                            frameLimiter.spinMilliseconds());
+            }
+            ImGui::Text("Render thread waited %.2f ms for the GPU", renderFeedback.frameWaitMilliseconds);
+            ImGui::Checkbox("Late-latch camera", &lateLatchCamera);
+            ImGui::Text("Input age at submit: %.2f ms (snapshot camera %.2f ms), to GPU done <= %.2f ms",
+                        renderFeedback.inputAgeMilliseconds, renderFeedback.snapshotCameraAgeMilliseconds,
+                        renderFeedback.inputToGpuMilliseconds);
+            if (renderFeedback.latchRejected) ImGui::TextUnformatted("Latest camera moved past the cull padding");
+
+            const PipelineCache::Stats& pipelineStats = pipelineCache.stats();
+            ImGui::Text("Materials: %zu  Pipelines: %u  Binds/frame: %u", materials.size(),
+                        pipelineStats.pipelines, renderFeedback.binds);
+            ImGui::Text("Pipeline requests: %u (%u cache hits, %u evicted)%s", pipelineStats.requests,
+                        pipelineStats.hits, pipelineStats.evicted,
+                        pipelineCache.usesDynamicState() ? "  [dynamic state]" : "");
+
+            ImGui::Text("Entities: %zu", world.size());
+            const SceneGraph::Stats& sceneStats = sceneGraph.stats();
+            ImGui::Text("Scene graph: %u nodes, %u levels, %u updated", sceneStats.nodes, sceneStats.levels,
+                        sceneStats.worldUpdates);
+            ImGui::Text("Transforms: %.3f ms (%s, %u threads)", sceneStats.milliseconds,
+                        Simd::levelName(Simd::level()), parallelThreadCount());
+            if (ImGui::SliderInt("Simulation rate (Hz)", &simulationHz, 10, 240))
+            {
+                simulationClock.setStep(1.0 / simulationHz);
+            }
+            ImGui::Checkbox("Interpolate transforms", &interpolateTransforms);
+            ImGui::Text("Steps this frame: %u, alpha %.2f, %llu steps dropped", simulationSteps,
+                        simulationClock.alpha(), static_cast<unsigned long long>(simulationClock.droppedSteps()));
+            const JobSystem::Stats& jobStats = JobSystem::instance().sampleStats();
+            ImGui::Text("Jobs: %llu (%llu stolen), worker utilization %.0f%%",
+                        static_cast<unsigned long long>(jobStats.jobs),
+                        static_cast<unsigned long long>(jobStats.steals), jobStats.workerUtilization * 100.0f);
+            ArenaVector<float> threadLoad{ArenaAllocator<float>(frameArena)};
+            threadLoad.reserve(jobStats.threads.size());
+            for (const JobSystem::ThreadStats& thread : jobStats.threads)
+            {
+                threadLoad.push_back(thread.utilization);
+            }
+            // Bar 0 is the main thread
+            ImGui::PlotHistogram("Thread load", threadLoad.data(), static_cast<int>(threadLoad.size()), 0, nullptr,
+                                 0.0f, 1.0f, ImVec2(0.0f, 40.0f));
+            if (AllocationCounter::enabled())
+            {
+                ImGui::Text("Heap allocations: %llu last frame, frame arena peak %zu bytes",
+                            static_cast<unsigned long long>(frameAllocations), frameArena.peak());
+                ImGui::Checkbox("Warn on per-frame allocations", &warnOnFrameAllocations);
+            }
+            const char* cullModes[] = {"Off", "Linear SIMD", "BVH", "GPU compute"};
+            int cullModeIndex = static_cast<int>(cullMode);
+            // The GPU entry is hidden when the device can't run the pass
+            const int cullModeCount = supportsGpuCulling ? IM_ARRAYSIZE(cullModes) : IM_ARRAYSIZE(cullModes) - 1;
+            if (ImGui::Combo("Frustum culling", &cullModeIndex, cullModes, cullModeCount))
+            {
+                cullMode = static_cast<CullMode>(cullModeIndex);
+            }
+            if (cullMode == CullMode::Gpu)
+            {
+                ImGui::Text("%zu instances culled on the GPU, %zu indirect draws (%s)", gpuInstances.size(),
+                            drawGroups.size(), gpuCulling.compacts() ? "draw count" : "zero-instance commands");
+                ImGui::Checkbox("Hi-Z occlusion (GPU)", &gpuOcclusion);
+                if (gpuOcclusion)
+                {
+                    const vk::Extent2D pyramidExtent = gpuCulling.pyramidExtent();
+                    ImGui::Text("Depth pyramid: %ux%u, %u levels", pyramidExtent.width, pyramidExtent.height,
+                                gpuCulling.pyramidLevels());
+                }
+            }
+            else
+            {
+                ImGui::Text("%u visible, %u culled (%.3f ms)", cullStats.visible, cullStats.culled,
+                            cullStats.milliseconds);
+            }
+            ImGui::Text("BVH: %zu proxies, height %d", objectTree.proxyCount(), objectTree.height());
+            ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+            if (occlusionCulling)
+            {
+                const OcclusionBuffer::Stats& occlusionStats = occlusionBuffer.stats();
+                ImGui::Text("Occluders: %u (%u triangles, %.3f ms), %u/%u occluded (%.3f ms)",
+                            occlusionStats.occluders, occlusionStats.triangles, occlusionStats.rasterMilliseconds,
+                            occlusionStats.occluded, occlusionStats.tested, occlusionStats.testMilliseconds);
+            }
+            if (ImGui::CollapsingHeader("GPU memory"))
+            {
+                constexpr double MIB = 1024.0 * 1024.0;
+                const GpuMemory::Budgets& budgets = renderFeedback.memoryBudgets;
+                ImGui::Text("Heap budgets (%s)", supportsMemoryBudget ? "VK_EXT_memory_budget" : "estimated");
+                for (uint32_t heap = 0; heap < budgets.heapCount; ++heap)
+                {
+                    const VmaBudget& budget = budgets.heaps[heap];
+                    const float used = budget.budget > 0
+                                           ? static_cast<float>(static_cast<double>(budget.usage) / budget.budget)
+                                           : 0.0f;
+                    char overlay[96];
+                    snprintf(overlay, sizeof(overlay), "heap %u: %.1f / %.1f MiB", heap, budget.usage / MIB,
+                             budget.budget / MIB);
+                    ImGui::ProgressBar(used, ImVec2(-1.0f, 0.0f), overlay);
+                    ImGui::Text("  ours: %.1f MiB in %u blocks, %.1f MiB allocated (%u allocations)",
+                                budget.statistics.blockBytes / MIB, budget.statistics.blockCount,
+                                budget.statistics.allocationBytes / MIB, budget.statistics.allocationCount);
+                }
+                const GpuMemory::CategoryTotals totals = gpuMemory.categoryTotals();
+                for (size_t i = 0; i < totals.size(); ++i)
+                {
+                    ImGui::Text("%-14s %8.2f MiB  %u allocations",
+                                memoryCategoryName(static_cast<MemoryCategory>(i)), totals[i].bytes / MIB,
+                                totals[i].allocations);
+                }
+                bool autoDefragment = gpuMemory.autoDefragment();
+                if (ImGui::Checkbox("Defragment when idle", &autoDefragment))
+                {
+                    gpuMemory.setAutoDefragment(autoDefragment);
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Defragment now")) gpuMemory.requestDefragmentation();
+                const GpuMemory::DefragmentStats& defragment = renderFeedback.defragment;
+                ImGui::Text("Defragmentation%s: %llu passes, %llu moves, %.2f MiB moved, %.2f MiB freed",
+                            defragment.running ? " (running)" : "",
+                            static_cast<unsigned long long>(defragment.passes),
+                            static_cast<unsigned long long>(defragment.moves), defragment.bytesMoved / MIB,
+                            defragment.bytesFreed / MIB);
+                if (ImGui::Button("Dump memory JSON")) dumpMemoryStats();
+            }
+            const TransformBuffer::Stats& uploadStats = renderFeedback.uploads;
+            ImGui::Text("Transform uploads: %u (%u copies, %llu bytes)", uploadStats.uploads,
+                        uploadStats.copyRegions, static_cast<unsigned long long>(uploadStats.bytes));
+            if (ImGui::CollapsingHeader("Geometry pool"))
+            {
+                const GeometryPool::Stats geometryStats = geometryPool.stats();
+                ImGui::Text("Meshes: %u", geometryStats.meshes);
+                ImGui::Text("Vertices: %u of %u free, largest run %u, %u runs", geometryStats.vertices.freeUnits,
+                            geometryPool.vertexCapacity(), geometryStats.vertices.largestFree,
+                            geometryStats.vertices.freeRanges);
+                ImGui::Text("Indices: %u of %u free, largest run %u, %u runs", geometryStats.indices.freeUnits,
+                            geometryPool.indexCapacity(), geometryStats.indices.largestFree,
+                            geometryStats.indices.freeRanges);
+                if (cubeMesh == INVALID_MESH)
+                {
+                    if (ImGui::Button("Load cube mesh")) loadCubeMesh();
+                }
+                else if (ImGui::Button("Unload cube mesh"))
+                {
+                    unloadMesh(cubeMesh);
+                    cubeMesh = INVALID_MESH;
+                }
+            }
+            if (ImGui::CollapsingHeader("Static batching"))
+            {
+                const auto staticObjects = static_cast<uint32_t>(world.count<Static>());
+                ImGui::Text("Static objects: %u unbaked", staticObjects);
+                ImGui::Text("Batches: %u, merging %u objects", static_cast<uint32_t>(staticBatchMeshes.size()),
+                            staticBatchedObjects);
+                // Smaller cells split the static field into more batches than there are mesh ids
+                ImGui::SliderFloat("Cell size", &staticCellSize, 8.0f, 64.0f);
+                if (ImGui::Button("Spawn static field")) spawnStaticField();
+                ImGui::SameLine();
+                if (ImGui::Button("Bake") && staticObjects > 0) staticBakeRequested = true;
+                ImGui::SameLine();
+                if (ImGui::Button("Clear batches")) clearStaticBatches();
+            }
+            if (ImGui::CollapsingHeader("Lighting"))
+            {
+                ImGui::Checkbox("Clustered lighting", &lightingEnabled);
+                ImGui::SliderFloat("Ambient", &ambientLight, 0.0f, 1.0f);
+                ImGui::SliderInt("Lights to spawn", &lightSpawnCount, 1,
+                                 static_cast<int>(ClusteredLighting::MAX_LIGHTS));
+                if (ImGui::Button("Spawn lights")) spawnLights(lightSpawnCount);
+                ImGui::SameLine();
+                if (ImGui::Button("Clear lights")) clearLights();
+                ImGui::Text("Lights: %u of %u, %ux%ux%u clusters of up to %u",
+                            static_cast<uint32_t>(lightEntities.size()), ClusteredLighting::MAX_LIGHTS,
+                            ClusteredLighting::GRID_X, ClusteredLighting::GRID_Y, ClusteredLighting::GRID_Z,
+                            ClusteredLighting::MAX_LIGHTS_PER_CLUSTER);
+            }
+            if (ImGui::CollapsingHeader("Shadows"))
+            {
+                ImGui::Checkbox("Sun", &sunEnabled);
+                ImGui::SliderFloat("Sun yaw", &sunYaw, -180.0f, 180.0f, "%.0f deg");
+                ImGui::SliderFloat("Sun elevation", &sunPitch, 5.0f, 90.0f, "%.0f deg");
+                ImGui::SliderFloat("Sun intensity", &sunIntensity, 0.0f, 4.0f);
+                ImGui::ColorEdit3("Sun color", &sunColor.x);
+                ImGui::Checkbox("Cascaded shadows", &shadowsEnabled);
+                ImGui::SliderFloat("Shadow distance", &shadowDistance, 10.0f, 300.0f, "%.0f");
+                uint32_t dynamicDraws = 0;
+                uint32_t staticDraws = 0;
+                for (uint32_t c = 0; c < SHADOW_CASCADES; ++c)
+                {
+                    dynamicDraws += static_cast<uint32_t>(cascadeDynamicCasters[c].size());
+                    staticDraws += static_cast<uint32_t>(cascadeStaticCasters[c].size());
+                    ImGui::Text("Cascade %u: to %.1f, %.3f per texel, %zu dynamic casters%s", c,
+                                shadowCascades[c].splitFar, shadowCascades[c].texelSize,
+                                cascadeDynamicCasters[c].size(), shadowCascades[c].redrawStatic ? ", redrawn" : "");
+                }
+                ImGui::Text("Casters: %zu static (cached), %zu dynamic", staticShadowCasters.size(),
+                            dynamicShadowCasters.size());
+                ImGui::Text("Shadow draws: %u dynamic, %u static", dynamicDraws, staticDraws);
+                ImGui::Text("Static pages redrawn last frame: %u", renderFeedback.staticShadowPages);
+                ImGui::Text("Shadow culling: %.3f ms", shadowCullMilliseconds);
+            }
+            if (ImGui::CollapsingHeader("Resolution"))
+            {
+                const char* antiAliasingModes[] = {"Off", "MSAA 2x", "MSAA 4x", "MSAA 8x", "Post-process"};
+                if (ImGui::BeginCombo("Anti-aliasing", antiAliasingModes[static_cast<int>(requestedAntiAliasing)]))
+                {
+                    for (int i = 0; i < IM_ARRAYSIZE(antiAliasingModes); ++i)
+                    {
+                        const auto mode = static_cast<AntiAliasing>(i);
+                        // An MSAA tier the device can't do falls back to the one below it; list that once
+                        const bool msaa = mode != AntiAliasing::Off && mode != AntiAliasing::PostProcess;
+                        if (msaa && sampleCount(mode) == sampleCount(static_cast<AntiAliasing>(i - 1))) continue;
+                        if (ImGui::Selectable(antiAliasingModes[i], mode == requestedAntiAliasing))
+                        {
+                            requestedAntiAliasing = mode;
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
+                ImGui::Checkbox("Dynamic resolution", &dynamicResolutionEnabled);
+                if (dynamicResolutionEnabled)
+                {
+                    ImGui::SliderFloat("Target GPU FPS", &targetGpuFps, 30.0f, 240.0f, "%.0f");
+                    float minScale = dynamicResolution.minScale();
+                    if (ImGui::SliderFloat("Minimum scale", &minScale, 0.25f, 1.0f))
+                    {
+                        dynamicResolution.setRange(minScale, dynamicResolution.maxScale());
+                    }
+                }
+                else
+                {
+                    ImGui::SliderFloat("Render scale", &fixedRenderScale, 0.25f, 1.0f);
+                }
+                ImGui::Checkbox("Temporal upscaling", &temporalUpscale);
+                ImGui::Text("Rendering %ux%u (%.0f%%), GPU %.2f ms",
+                            DynamicResolution::scaled(swapChainExtent.width, renderScale),
+                            DynamicResolution::scaled(swapChainExtent.height, renderScale), renderScale * 100.0f,
+                            renderFeedback.gpuMilliseconds);
+            }
+            if (ImGui::CollapsingHeader("Depth"))
+            {
+                ImGui::Checkbox("Reversed-Z, infinite far plane", &requestedReversedZ);
+                ImGui::Checkbox("Depth pre-pass", &requestedDepthPrepass);
+                // Compare against the same view with either setting toggled
+                ImGui::Text("GPU %.2f ms at %ux%u", renderFeedback.gpuMilliseconds,
+                            DynamicResolution::scaled(swapChainExtent.width, renderScale),
+                            DynamicResolution::scaled(swapChainExtent.height, renderScale));
+            }
+            if (ImGui::BeginCombo("Spawn mesh", meshAssets[spawnMesh].name.c_str()))
+            {
+                for (MeshId mesh = 0; mesh < geometryPool.idLimit(); ++mesh)
+                {
+                    if (!geometryPool.contains(mesh)) continue;
+                    if (ImGui::Selectable(meshAssets[mesh].name.c_str(), mesh == spawnMesh)) spawnMesh = mesh;
+                }
+                ImGui::EndCombo();
+            }
+            if (ImGui::Button("Spawn"))
+            {
+                const float offset = static_cast<float>(spawnedEntities.size());
+                spawnObject({offset, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0, spawnMesh);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Destroy") && !spawnedEntities.empty())
+            {
+                destroyObject(spawnedEntities.back());
+            }
 
-            ImGui::SliderFloat3("Position1", &gameObjects[0].position[0], -10.0f, 10.0f);
-            // Edit 1 float using a slider from 0.0f to 1.0f
-            ImGui::SliderFloat3("Position2", &gameObjects[1].position[0], -10.0f, 10.0f);
-            // Edit 1 float using a slider from 0.0f to 1.0f
-            ImGui::SliderFloat3("Position3", &gameObjects[2].position[0], -10.0f, 10.0f);
-            // Edit 1 float using a slider from 0.0f to 1.0f
+            // Edit the first few positions using a slider from -10.0f to 10.0f
+            for (size_t i = 0; i < std::min<size_t>(spawnedEntities.size(), 8); ++i)
+            {
+                ImGui::PushID(static_cast<int>(i));
+                const NodeId node = world.get<TransformNode>(spawnedEntities[i]).node;
+                glm::vec3 position = sceneGraph.position(node);
+                if (ImGui::SliderFloat3("Position", &position[0], -10.0f, 10.0f))
+                {
+                    sceneGraph.setPosition(node, position);
+                }
+                ImGui::PopID();
+            }
 
 
             ImGui::End();
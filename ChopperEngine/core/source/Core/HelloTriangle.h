@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 #include <stdexcept>
 #include <vector>
 #include <cstring>
@@ -11,6 +12,8 @@
 #include <limits>
 #include <array>
 #include <chrono>
+#include <atomic>
+#include <thread>
 
 
 #include <vulkan/vulkan.hpp>
@@ -36,7 +39,36 @@
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_vulkan.h>
 
+#include "AllocationCounter.h"
 #include "Camera.h"
+#include "CameraLatch.h"
+#include "CascadedShadows.h"
+#include "ClusteredLighting.h"
+#include "Components.h"
+#include "DynamicAabbTree.h"
+#include "DeletionQueue.h"
+#include "DynamicResolution.h"
+#include "ECS.h"
+#include "FixedTimestep.h"
+#include "FrameArena.h"
+#include "FrameHandoff.h"
+#include "FrameLimiter.h"
+#include "FrustumCulling.h"
+#include "GeometryPool.h"
+#include "GpuCulling.h"
+#include "GpuMemory.h"
+#include "ImGuiSnapshot.h"
+#include "JobSystem.h"
+#include "OcclusionBuffer.h"
+#include "Parallel.h"
+#include "SceneGraph.h"
+#include "Simd.h"
+#include "StaticBatcher.h"
+#include "TemporalUpscaler.h"
+#include "TransformBuffer.h"
+#include "Material.h"
+#include "PipelineCache.h"
+#include "Vertex.h"
 
 namespace Chopper
 {
@@ -45,9 +77,32 @@ namespace Chopper
     constexpr uint64_t FenceTimeout = 100000000;
     const std::string MODEL_PATH = "testmodels/hercules_kalliope/hercules_kalliope.obj";
     const std::string TEXTURE_PATH = "testmodels/hercules_kalliope/T_Herkules_Kalliope.png";
-    constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-    // Define the number of objects to render
-    constexpr int MAX_OBJECTS = 3;
+    // Upper bound of the frames-in-flight setting; per-frame resources exist for all of them
+    constexpr int MAX_FRAMES_IN_FLIGHT = 4;
+    // Maximum number of renderable entities alive at once (slots in the transform buffer)
+    constexpr int MAX_OBJECTS = 65536;
+    // Geometry pool size; grown at startup if the model alone needs more
+    constexpr uint32_t GEOMETRY_VERTICES = 1u << 21;
+    constexpr uint32_t GEOMETRY_INDICES = 1u << 23;
+    constexpr uint32_t MAX_MESHES = GpuCulling::MAX_MESHES;
+
+    // Static batches are split above this many vertices
+    constexpr uint32_t STATIC_BATCH_MAX_VERTICES = 1u << 16;
+    // A bake that needs more mesh ids than are free doubles its cell size up to this
+    constexpr float STATIC_MAX_CELL_SIZE = 1024.0f;
+    // Cubes per side of the static test field
+    constexpr int STATIC_FIELD_SIZE = 32;
+
+    // How often the main thread samples input while it waits for the render thread
+    constexpr double INPUT_SAMPLE_INTERVAL = 0.001;
+
+    // Resolution of the CPU occlusion depth buffer
+    constexpr uint32_t OCCLUSION_WIDTH = 320;
+    constexpr uint32_t OCCLUSION_HEIGHT = 192;
+
+    // Consecutive frames that must allocate before the steady-state allocation check warns;
+    // one-off growth (a resize, a spawn, a new UI window) doesn't trip it
+    constexpr uint32_t ALLOCATION_WARN_FRAMES = 60;
 
     const std::vector validationLayers = {
         "VK_LAYER_KHRONOS_validation"
@@ -59,65 +114,196 @@ namespace Chopper
     constexpr bool enableValidationLayers = true;
 #endif
 
-    // Define a structure to hold per-object data
-    struct GameObject
+    // Presets for frames in flight and the frame limiter
+    enum class FramePacing : int
     {
-        // Transform properties
-        glm::vec3 position = {0.0f, 0.0f, 0.0f};
-        glm::vec3 rotation = {0.0f, 0.0f, 0.0f};
-        glm::vec3 scale = {1.0f, 1.0f, 1.0f};
+        // One frame in flight, limiter on: input is sampled as late as the CPU can afford
+        LowLatency,
+        // Three frames in flight, no limiter: CPU and GPU never wait on each other
+        Throughput,
+        Custom
+    };
 
-        // Uniform buffer for this object (one per frame in flight)
-        std::vector<VkBuffer> uniformBuffers;
-        std::vector<VmaAllocation> uniformBuffersAllocation;
-        std::vector<void*> uniformBuffersMapped;
+    enum class AntiAliasing : int
+    {
+        Off,
+        Msaa2x,
+        Msaa4x,
+        Msaa8x,
+        // Single-sampled scene, edges smoothed by the upscale pass (TemporalUpscaler)
+        PostProcess
+    };
 
-        // Descriptor sets for this object (one per frame in flight)
-        std::vector<vk::raii::DescriptorSet> descriptorSets;
+    enum class CullMode : int
+    {
+        Off,
+        // SIMD test of every bounding sphere
+        Linear,
+        // Frustum query of the dynamic AABB tree
+        Bvh,
+        // Compute pass writing indirect draws (GpuCulling)
+        Gpu
+    };
 
-        // Calculate model matrix based on position, rotation, and scale
-        glm::mat4 getModelMatrix() const
-        {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, position);
-            model = glm::rotate(model, rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::rotate(model, rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::rotate(model, rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
-            model = glm::scale(model, scale);
-            return model;
-        }
+    struct CullStats
+    {
+        uint32_t visible = 0;
+        uint32_t culled = 0;
+        double milliseconds = 0.0;
     };
 
-    struct Vertex
+    struct DrawItem
     {
-        glm::vec3 pos;
-        glm::vec3 color;
-        glm::vec2 texCoord;
+        uint32_t pipeline;
+        uint32_t material;
+        MeshId mesh;
+        uint32_t slot;
+    };
 
-        static vk::VertexInputBindingDescription getBindingDescription()
-        {
-            return {0, sizeof(Vertex), vk::VertexInputRate::eVertex};
-        }
+    // Run of drawList sharing one material, drawn with one indirect call when culling on the GPU
+    struct DrawGroup
+    {
+        uint32_t pipeline;
+        uint32_t material;
+        uint32_t firstCommand;
+        uint32_t count;
+    };
 
-        static std::array<vk::VertexInputAttributeDescription, 3> getAttributeDescriptions()
-        {
-            return {
-                vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos)),
-                vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, color)),
-                vk::VertexInputAttributeDescription(2, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, texCoord))
-            };
-        }
+    // A drawn object with its pipeline resolved, so the render thread never reads materials
+    struct RenderDraw
+    {
+        vk::Pipeline pipeline;
+        DynamicRasterState dynamic;
+        // Null when the draw is not part of the depth pre-pass
+        vk::Pipeline depthPipeline;
+        DynamicRasterState depthDynamic;
+        GeometryPool::Mesh mesh;
+        uint32_t slot;
+    };
 
-        bool operator==(const Vertex& other) const
-        {
-            return pos == other.pos && color == other.color && texCoord == other.texCoord;
-        }
+    // An object drawn into a cascade's shadow map
+    struct ShadowCaster
+    {
+        uint32_t material;
+        MeshId mesh;
+        uint32_t slot;
+
+        bool operator==(const ShadowCaster& other) const = default;
     };
 
+    // ShadowCaster resolved for the render thread
+    struct ShadowDraw
+    {
+        vk::Pipeline pipeline;
+        DynamicRasterState dynamic;
+        GeometryPool::Mesh mesh;
+        uint32_t slot;
+    };
 
+    // A mesh in the GeometryPool with what the CPU keeps of it: bounds for culling, and positions
+    // and indices for the occlusion rasterizer
+    struct MeshAsset
+    {
+        std::string name;
+        MeshBounds bounds;
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        // Full vertices, kept only for meshes that static batches may merge
+        std::vector<Vertex> vertices;
+    };
+
+    // DrawGroup resolved for the render thread
+    struct RenderGroup
+    {
+        vk::Pipeline pipeline;
+        DynamicRasterState dynamic;
+        vk::Pipeline depthPipeline;
+        DynamicRasterState depthDynamic;
+        uint32_t firstCommand;
+        uint32_t count;
+    };
+
+    struct TransformUpdate
+    {
+        uint32_t slot;
+        glm::mat4 world;
+    };
+
+    // Written by the render thread while it draws a snapshot; the main thread reads it the next
+    // time it fills that slot
+    struct RenderFeedback
+    {
+        TransformBuffer::Stats uploads;
+        uint32_t binds = 0;
+        // Cascade pages whose static casters were drawn again
+        uint32_t staticShadowPages = 0;
+        double recordMilliseconds = 0.0;
+        // Render thread blocked on the frame timeline before reusing a frame's resources
+        double frameWaitMilliseconds = 0.0;
+        // Age of the camera the frame was submitted with, and of the snapshot's camera
+        double inputAgeMilliseconds = 0.0;
+        double snapshotCameraAgeMilliseconds = 0.0;
+        // The latest camera sample had moved too far from the snapshot's for its culling
+        bool latchRejected = false;
+        // From sampling the camera of an earlier frame to seeing it finish on the GPU; an upper
+        // bound on the GPU side of input latency, presentation not included
+        double inputToGpuMilliseconds = 0.0;
+        // GPU time of the last finished frame in the slot, from timestamps; 0 when unknown
+        double gpuMilliseconds = 0.0;
+        GpuMemory::Budgets memoryBudgets;
+        GpuMemory::DefragmentStats defragment;
+    };
+
+    // Everything the render thread reads to draw one frame. The main thread fills it and does
+    // not touch it again until the render thread hands it back.
+    struct RenderSnapshot
+    {
+        glm::mat4 view{1.0f};
+        glm::mat4 proj{1.0f};
+        FrustumPlanes frustumPlanes{};
+        std::chrono::steady_clock::time_point cameraSampledAt{};
+        // Draw with the newest camera sample instead of view/proj
+        bool lateLatchCamera = true;
+        uint32_t framesInFlight = 2;
+        // Part of the swapchain extent the scene renders at, upscaled to the full extent
+        vk::Extent2D renderExtent{};
+        bool temporalUpscale = true;
+        bool postProcessAntiAliasing = false;
+        // Depth clears to 0 and tests with greater; proj is reversed to match
+        bool reversedZ = false;
+        // Depth-only pass over the same draws before the color pass
+        bool depthPrepass = false;
+        // World matrices changed since the previous snapshot
+        std::vector<TransformUpdate> transforms;
+        CullMode cullMode = CullMode::Bvh;
+        bool gpuOcclusion = false;
+        // CPU culling survivors in pipeline order
+        std::vector<RenderDraw> draws;
+        // GPU culling: one indirect draw per group; the instance list and mesh table only when
+        // they changed
+        std::vector<RenderGroup> groups;
+        bool instancesChanged = false;
+        std::vector<GpuCulling::Instance> instances;
+        std::vector<GpuCulling::Mesh> meshes;
+        // Every Light entity, binned into clusters on the GPU; empty draws the scene unlit
+        std::vector<ClusteredLighting::Light> lights;
+        float ambientLight = 0.1f;
+        // Directional sun, unit vector towards it and color times intensity; black for no sun
+        glm::vec3 toSun{0.0f, 1.0f, 0.0f};
+        glm::vec3 sunColor{0.0f};
+        // Cascaded shadow maps of the sun. Per cascade, the dynamic casters it sees, and the static
+        // ones only when cascades[c].redrawStatic asks for its cached page to be drawn again.
+        bool shadows = false;
+        std::array<ShadowCascade, SHADOW_CASCADES> cascades{};
+        std::array<std::vector<ShadowDraw>, SHADOW_CASCADES> dynamicShadowDraws;
+        std::array<std::vector<ShadowDraw>, SHADOW_CASCADES> staticShadowDraws;
+        ImGuiSnapshot ui;
+        RenderFeedback feedback;
+    };
+
+    // Per-frame camera data; model matrices live in the TransformBuffer
     struct UniformBufferObject
     {
-        alignas(16) glm::mat4 model;
         alignas(16) glm::mat4 view;
         alignas(16) glm::mat4 proj;
     };
@@ -137,7 +323,9 @@ namespace Chopper
         vk::raii::DebugUtilsMessengerEXT debugMessenger = nullptr;
         vk::raii::SurfaceKHR surface = nullptr;
         vk::raii::PhysicalDevice physicalDevice = nullptr;
+        // Sample count of the scene attachments and pipelines, set by antiAliasing
         vk::SampleCountFlagBits msaaSamples = vk::SampleCountFlagBits::e1;
+        vk::SampleCountFlags supportedSampleCounts = vk::SampleCountFlagBits::e1;
         vk::raii::Device device = nullptr;
         uint32_t queueIndex = ~0;
         vk::raii::Queue queue = nullptr;
@@ -150,7 +338,18 @@ namespace Chopper
 
         vk::raii::DescriptorSetLayout descriptorSetLayout = nullptr;
         vk::raii::PipelineLayout pipelineLayout = nullptr;
-        vk::raii::Pipeline graphicsPipeline = nullptr;
+
+        PipelineCache pipelineCache;
+        std::vector<Material> materials;
+        // Renderables sorted by pipeline so each pipeline is bound once per frame
+        std::vector<DrawItem> drawList;
+        bool drawListDirty = true;
+        // drawList filtered by frustum culling, rebuilt every frame
+        std::vector<DrawItem> visibleDrawList;
+        bool supportsExtendedDynamicState = false;
+        // multiDrawIndirect + drawIndirectFirstInstance on a compute-capable queue
+        bool supportsGpuCulling = false;
+        bool supportsDrawIndirectCount = false;
 
         VkImage colorImage = nullptr;
         VmaAllocation colorImageAllocation = nullptr;
@@ -161,44 +360,209 @@ namespace Chopper
         vk::raii::ImageView depthImageView = nullptr;
 
         uint32_t mipLevels = 0;
+        // Decoded by a loading job, uploaded and freed by createTextureImage()
+        stbi_uc* texturePixels = nullptr;
+        int textureWidth = 0;
+        int textureHeight = 0;
         VkImage textureImage = nullptr;
         VmaAllocation textureImageAllocation = nullptr;
         vk::raii::ImageView textureImageView = nullptr;
         vk::raii::Sampler textureSampler = nullptr;
 
+        // Decoded by a loading job, moved into the geometry pool by createGeometry()
         std::vector<Vertex> vertices;
         std::vector<uint32_t> indices;
-        VkBuffer vertexBuffer = {};
-        VmaAllocation vertexBufferAllocation = {};
-        VkBuffer indexBuffer = nullptr;
-        VmaAllocation indexBufferAllocation = nullptr;
+        // Vertices and indices of every mesh; bound once per frame
+        GeometryPool geometryPool;
+        // Indexed by MeshId; entries of removed meshes are empty
+        std::vector<MeshAsset> meshAssets;
+        MeshId modelMesh = INVALID_MESH;
+        // Generated at runtime to exercise loading and unloading
+        MeshId cubeMesh = INVALID_MESH;
+        MeshId spawnMesh = 0;
+        // Meshes made by bakeStaticBatches(), each drawn by one entity at the origin
+        std::vector<MeshId> staticBatchMeshes;
+        uint32_t staticBatchedObjects = 0;
+        float staticCellSize = 16.0f;
+        // Baked in simulateFrame() once this frame's edits are applied
+        bool staticBakeRequested = false;
 
-        //std::vector<VkBuffer> uniformBuffers;
-        //std::vector<VmaAllocation> uniformBuffersAllocation;
-        //std::vector<void*> uniformBuffersMapped;
+        std::vector<VkBuffer> uniformBuffers;
+        std::vector<VmaAllocation> uniformBuffersAllocation;
+        std::vector<void*> uniformBuffersMapped;
 
         vk::raii::DescriptorPool descriptorPool = nullptr;
-        //std::vector<vk::raii::DescriptorSet> descriptorSets;
+        std::vector<vk::raii::DescriptorSet> descriptorSets;
+
+        TransformBuffer transformBuffer;
 
         vk::raii::CommandPool commandPool = nullptr;
         std::vector<vk::raii::CommandBuffer> commandBuffers;
 
+        // Acquire semaphores per frame slot, present semaphores per swapchain image
         std::vector<vk::raii::Semaphore> presentCompleteSemaphore;
         std::vector<vk::raii::Semaphore> renderFinishedSemaphore;
-        std::vector<vk::raii::Fence> inFlightFences;
-        uint32_t semaphoreIndex = 0;
+        // Signaled with each frame's number when the GPU finishes it
+        vk::raii::Semaphore frameTimeline = nullptr;
         uint32_t currentFrame = 0;
-
-        // Array of game objects to render
-        std::array<GameObject, MAX_OBJECTS> gameObjects;
-
-        bool framebufferResized = false;
-
-        VmaAllocator allocator;
+        // Objects replaced while frames in flight may still use them, e.g. on swapchain recreation
+        DeletionQueue deletionQueue;
+        // Number of the frame last submitted from each frame slot
+        std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frameNumbers{};
+
+        World world;
+        uint32_t objectSlotCount = 0;
+        std::vector<uint32_t> freeObjectSlots;
+        // Renderable slot of each scene graph node, ~0u for nodes without one
+        std::vector<uint32_t> nodeSlots;
+
+        // Mesh drawn by each renderable slot
+        std::vector<MeshId> slotMeshes;
+        // World-space bounding sphere per renderable slot
+        BoundingSphereSet objectBounds;
+        // Spatial index over renderable slots, proxy per slot
+        DynamicAabbTree objectTree;
+        std::vector<uint32_t> slotProxies;
+        std::vector<uint32_t> visibleSlots;
+        std::vector<uint8_t> slotVisible;
+        CullMode cullMode = CullMode::Bvh;
+        CullStats cullStats;
+        // Exact world-space box per renderable slot
+        std::vector<Aabb> slotBoxes;
+        // Per renderable slot: world matrix after the previous and the latest simulation step,
+        // and the blend of the two that was last drawn
+        std::vector<glm::mat4> previousWorlds;
+        std::vector<glm::mat4> currentWorlds;
+        std::vector<glm::mat4> renderWorlds;
+        // Slots moved by the latest step; drawn interpolated until the next one
+        std::vector<uint32_t> movingSlots;
+        // Slots moved by a step since the last frame, drawn once more at their final state
+        std::vector<uint32_t> settledSlots;
+        // Last frame each slot was handed to the render thread, so a slot goes out once per frame
+        std::vector<uint64_t> slotSentFrame;
+        uint64_t simulationFrame = 0;
+        OcclusionBuffer occlusionBuffer;
+        bool occlusionCulling = true;
+        std::vector<uint32_t> occludeeSlots;
+        std::vector<Aabb> occludeeBoxes;
+        std::vector<uint8_t> occludeeVisible;
+        GpuCulling gpuCulling;
+        // Two-phase Hi-Z occlusion in GPU mode
+        bool gpuOcclusion = true;
+        std::vector<DrawGroup> drawGroups;
+        std::vector<GpuCulling::Instance> gpuInstances;
+        std::vector<GpuCulling::Mesh> gpuMeshes;
+        // gpuInstances changed since the last snapshot
+        bool gpuInstancesDirty = false;
+        std::vector<Entity> spawnedEntities;
+        SceneGraph sceneGraph;
+        ClusteredLighting clusteredLighting;
+        bool lightingEnabled = true;
+        // Ambient term of lit shading, relative to the unlit texture
+        float ambientLight = 0.1f;
+        std::vector<Entity> lightEntities;
+        int lightSpawnCount = 1024;
+        // Directional sun, from its yaw and elevation in degrees
+        bool sunEnabled = true;
+        float sunYaw = 35.0f;
+        float sunPitch = 50.0f;
+        float sunIntensity = 1.0f;
+        glm::vec3 sunColor{1.0f, 0.95f, 0.85f};
+        // Unit vector towards the sun, from sunYaw and sunPitch
+        glm::vec3 toSun{0.0f, 1.0f, 0.0f};
+        CascadedShadows shadowMaps;
+        ShadowCascadeFitter shadowFitter;
+        bool shadowsEnabled = true;
+        float shadowDistance = 80.0f;
+        std::array<ShadowCascade, SHADOW_CASCADES> shadowCascades{};
+        // drawList's shadow casters: static ones never move, so their cascade pages are cached
+        std::vector<ShadowCaster> staticShadowCasters;
+        std::vector<ShadowCaster> dynamicShadowCasters;
+        // Bumped whenever staticShadowCasters changes, which redraws every page
+        uint64_t staticCasterVersion = 0;
+        // Per cascade: the casters it sees this frame; the static ones only when its page is redrawn
+        std::array<std::vector<ShadowCaster>, SHADOW_CASCADES> cascadeDynamicCasters;
+        std::array<std::vector<ShadowCaster>, SHADOW_CASCADES> cascadeStaticCasters;
+        std::vector<uint32_t> shadowVisibleSlots;
+        std::vector<uint8_t> shadowSlotVisible;
+        double shadowCullMilliseconds = 0.0;
+        // Render thread: static page redraws taken from snapshots, kept until recorded so a
+        // skipped frame cannot lose one
+        std::array<std::vector<ShadowDraw>, SHADOW_CASCADES> pendingStaticShadowDraws;
+        std::array<bool, SHADOW_CASCADES> staticShadowPending{};
+        // Baked into the model's vertices at load time (the test model is Z-up)
+        const glm::mat4 modelPreTransform = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
+                                                        glm::vec3(1.0f, 0.0f, 0.0f));
+
+        // Set by the resize callback and by the render thread when presentation goes out of date;
+        // the main thread recreates the swapchain
+        std::atomic<bool> framebufferResized{false};
+
+        // The main thread simulates frame N+1 while the render thread records and presents frame N
+        FrameHandoff<RenderSnapshot> frameHandoff;
+        std::thread renderThread;
+        std::atomic<bool> renderFailed{false};
+        // How far the CPU may run ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT
+        FramePacing framePacing = FramePacing::Custom;
+        int framesInFlight = 2;
+        // Paces the main loop, before input is sampled
+        FrameLimiter frameLimiter;
+        bool limitFrameRate = false;
+        std::exception_ptr renderError;
+        // Feedback of the last snapshot the render thread finished
+        RenderFeedback renderFeedback;
+        double simulationMilliseconds = 0.0;
+        // Transient main-thread data, valid until the next frame starts
+        FrameArena frameArena;
+        // Heap allocations made by the last frame, on any thread, and the run of frames that allocated
+        uint64_t frameAllocations = 0;
+        uint64_t allocationsBefore = 0;
+        uint32_t allocatingFrames = 0;
+        // Warns once ALLOCATION_WARN_FRAMES frames in a row have allocated. The tests target is what
+        // enforces the steady state; here it is a diagnostic.
+        bool warnOnFrameAllocations = false;
+
+        GpuMemory gpuMemory;
+        // VK_EXT_memory_budget: heap budgets come from the driver instead of VMA's estimate
+        bool supportsMemoryBudget = false;
 
         Camera camera_;
         double delta_time = 0.0;
         double last_frame_time = 0.0;
+        double last_input_time = 0.0;
+        // Written by sampleInput(), read by the render thread just before each submit
+        CameraLatch cameraLatch;
+        bool lateLatchCamera = true;
+        // Render thread: when the camera each frame in flight was submitted with was sampled
+        std::array<std::chrono::steady_clock::time_point, MAX_FRAMES_IN_FLIGHT> frameCameraSampledAt{};
+        // Scene resolution: picked from GPU frame times, or fixed, then upscaled to the swapchain
+        TemporalUpscaler upscaler;
+        DynamicResolution dynamicResolution;
+        bool dynamicResolutionEnabled = true;
+        float targetGpuFps = 60.0f;
+        float fixedRenderScale = 1.0f;
+        float renderScale = 1.0f;
+        bool temporalUpscale = true;
+        // Applied between frames, with the render thread drained, when it differs from antiAliasing
+        AntiAliasing antiAliasing = AntiAliasing::Msaa4x;
+        AntiAliasing requestedAntiAliasing = AntiAliasing::Msaa4x;
+        // Reversed-Z with an infinite far plane; applied like antiAliasing, as the camera the
+        // render thread latches must match the depth its snapshot clears to
+        bool reversedZ = false;
+        bool requestedReversedZ = false;
+        // Applied like antiAliasing: switching it replaces pipelines the render thread may hold
+        bool depthPrepass = false;
+        bool requestedDepthPrepass = false;
+        // Render thread: start and end of each frame slot's commands
+        vk::raii::QueryPool gpuTimestamps = nullptr;
+        // Nanoseconds per tick
+        double timestampPeriod = 0.0;
+        std::array<bool, MAX_FRAMES_IN_FLIGHT> timestampsWritten{};
+        // Scene simulation rate, independent of the frame rate; the camera stays per frame
+        FixedTimestep simulationClock{1.0 / 30.0, 5};
+        int simulationHz = 30;
+        uint32_t simulationSteps = 0;
+        bool interpolateTransforms = true;
 
         //ImGui
         ImGuiIO* io = nullptr;
@@ -220,22 +584,42 @@ namespace Chopper
         void pickPhysicalDevice();
         void createLogicalDevice();
         void mainLoop();
+        // Updates frameAllocations after a frame; warns once the steady state has kept allocating
+        // for ALLOCATION_WARN_FRAMES frames
+        void checkFrameAllocations();
         void cleanupSwapChain();
         void cleanup();
         void recreateSwapChain();
         void createInstance();
         void createSurface();
-        void createSwapChain();
+        void createSwapChain(vk::SwapchainKHR oldSwapChain = nullptr);
+        void retireSwapChain();
+        void createSwapChainSemaphores();
         void createImageViews();
-        void createGraphicsPipeline();
+        void createPipelineLayout();
+        void createMaterials();
+        void resolveMaterialPipelines();
+        void rebuildDrawList();
+        void cullObjects();
+        void cullOccluded();
+        // Fits the shadow cascades to the camera and culls the shadow casters per cascade
+        void cullShadowCasters();
+        void createGpuCulling();
+        void createUpscaler();
+        void createClusteredLighting();
+        void createShadowMaps();
+        void createTimestampQueries();
+        // GPU time of the frame slot's last submission, which must have finished; 0 when unknown
+        double readGpuMilliseconds(uint32_t frame);
         void createCommandPool();
+        void loadTexturePixels();
         void createTextureImage();
         void generateMipmaps(VkImage& image, vk::Format imageFormat, int32_t texWidth,
                              int32_t texHeight, uint32_t mipLevels);
         void createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
                          vk::SampleCountFlagBits numSamples, vk::Format format,
-                         vk::ImageTiling tiling, vk::ImageUsageFlags usage,
-                         VkImage& image, VmaAllocation& imageAllocation);
+                         vk::ImageTiling tiling, vk::ImageUsageFlags usage, MemoryCategory category,
+                         const char* name, VkImage& image, VmaAllocation& imageAllocation);
         void transitionImageLayout(const VkImage& image, const vk::ImageLayout oldLayout,
                                    const vk::ImageLayout newLayout, uint32_t mipLevels);
         void copyBufferToImage(const VkBuffer& buffer, VkImage& image,
@@ -243,14 +627,27 @@ namespace Chopper
         std::unique_ptr<vk::raii::CommandBuffer> beginSingleTimeCommands();
         void endSingleTimeCommands(vk::raii::CommandBuffer& commandBuffer);
         void createCommandBuffers();
-        void recordCommandBuffer(uint32_t imageIndex);
+        void recordCommandBuffer(uint32_t imageIndex, RenderSnapshot& snapshot);
+        void beginScenePass(const vk::RenderingInfo& renderingInfo);
+        // Vertex and index buffers and the descriptor set, shared by every graphics pass
+        void bindSceneResources();
+        // Draws the shadow cascades, static pages first where they are pending
+        void recordShadows(const RenderSnapshot& snapshot);
+        // With `depthOnly`, the depth pre-pass pipelines of the groups that have one
+        void drawGpuGroups(const RenderSnapshot& snapshot, uint32_t phase, bool depthOnly = false);
         void createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
                           vk::raii::Buffer& buffer, vk::raii::DeviceMemory& bufferMemory);
         void copyBuffer(VkBuffer srcBuffer,
                         VkBuffer dstBuffer,
                         VkDeviceSize size);
-        void createIndexBuffer();
-        void createVertexBuffer();
+        void createGeometry();
+        // Uploads a mesh into the geometry pool; waits for the render thread to go idle.
+        // keepVertices keeps a CPU copy so static batches can merge the mesh.
+        MeshId loadMesh(const std::string& name, const std::vector<Vertex>& meshVertices,
+                        const std::vector<uint32_t>& meshIndices, bool keepVertices = false);
+        MeshId loadCubeMesh();
+        // Destroys the entities drawing the mesh, then removes it
+        void unloadMesh(MeshId mesh);
         uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
         void transition_image_layout(
             uint32_t imageIndex,
@@ -262,18 +659,34 @@ namespace Chopper
             vk::PipelineStageFlags2 dst_stage_mask
         );
         void createSyncObjects();
-        void drawFrame();
+        // Blocks until the GPU has finished frame `frame`; returns the milliseconds waited
+        double waitForFrame(uint64_t frame);
+        void simulateFrame();
+        void fillSnapshot(RenderSnapshot& snapshot);
+        void updateImGuiTextures();
+        void renderLoop();
+        void renderFrame(RenderSnapshot& snapshot);
         void createDescriptorSetLayout();
         void createUniformBuffers();
+        void createDescriptorSets();
         void setupDebugMessenger();
         void createDescriptorPool();
-        void createDescriptorSets();
-        void updateUniformBuffer(uint32_t currentImage);
+        void applySceneEdits();
+        void simulationStep(float stepSeconds);
+        void updateScene(std::vector<TransformUpdate>& transforms);
+        void updateUniformBuffer(const CameraSample& camera);
+        void sampleInput();
         void createTextureImageView();
         void createTextureSampler();
         void createDepthResources();
         void loadModel();
-        vk::SampleCountFlagBits getMaxUsableSampleCount();
+        vk::SampleCountFlags getUsableSampleCounts();
+        // Sample count of `mode`, dropping to the highest supported one below it
+        vk::SampleCountFlagBits sampleCount(AntiAliasing mode) const;
+        void applyAntiAliasing();
+        void applyDepthConvention();
+        void retireRenderTargets();
+        void setCullingDepthSource();
         void createColorResources();
         void transition_image_layout_custom(
             VkImage& image,
@@ -286,9 +699,21 @@ namespace Chopper
             vk::ImageAspectFlags aspect_mask
         );
         void setupGameObjects();
+        Entity spawnObject(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale,
+                           uint32_t material, MeshId mesh, NodeId parent = INVALID_NODE);
+        void destroyObject(Entity entity);
+        void spawnStaticField();
+        // Scatters point and spot lights over the static field, up to ClusteredLighting::MAX_LIGHTS
+        void spawnLights(int count);
+        void clearLights();
+        void gatherLights(std::vector<ClusteredLighting::Light>& lights);
+        // Replaces every Static entity with batches merged per material and cell
+        void bakeStaticBatches();
+        void clearStaticBatches();
         void createAllocator(VkInstance instance, VkPhysicalDevice physicalDevice,
                              VkDevice device);
         void vmaCleanup();
+        void dumpMemoryStats();
         void initImGui();
         void paintImGui();
         void initCamera();
@@ -0,0 +1,64 @@
+#include "ImGuiSnapshot.h"
+
+#include <cstring>
+
+namespace Chopper
+{
+    namespace
+    {
+        // ImVector's assignment frees the destination first; this keeps its capacity
+        template <typename T>
+        void copyInto(ImVector<T>& dst, const ImVector<T>& src)
+        {
+            dst.resize(src.Size);
+            if (src.Size > 0)
+            {
+                std::memcpy(dst.Data, src.Data, static_cast<size_t>(src.Size) * sizeof(T));
+            }
+        }
+    }
+
+    ImGuiSnapshot::~ImGuiSnapshot()
+    {
+        for (ImDrawList* list : lists_)
+        {
+            IM_DELETE(list);
+        }
+    }
+
+    void ImGuiSnapshot::capture(const ImDrawData& source)
+    {
+        clear();
+        data_.Valid = source.Valid;
+        data_.DisplayPos = source.DisplayPos;
+        data_.DisplaySize = source.DisplaySize;
+        data_.FramebufferScale = source.FramebufferScale;
+        data_.Textures = nullptr;
+        // The source lists were already validated by ImGui::Render(); AddDrawList() would check
+        // write cursors a copy does not have. Same copy as ImDrawList::CloneOutput(), into lists
+        // kept from earlier captures.
+        for (int i = 0; i < source.CmdLists.Size; ++i)
+        {
+            const ImDrawList* list = source.CmdLists[i];
+            if (i == lists_.Size)
+            {
+                lists_.push_back(IM_NEW(ImDrawList)(nullptr));
+            }
+            ImDrawList* copy = lists_[i];
+            copyInto(copy->CmdBuffer, list->CmdBuffer);
+            copyInto(copy->IdxBuffer, list->IdxBuffer);
+            copyInto(copy->VtxBuffer, list->VtxBuffer);
+            copy->Flags = list->Flags;
+            data_.CmdLists.push_back(copy);
+        }
+        data_.CmdListsCount = source.CmdListsCount;
+        data_.TotalVtxCount = source.TotalVtxCount;
+        data_.TotalIdxCount = source.TotalIdxCount;
+    }
+
+    void ImGuiSnapshot::clear()
+    {
+        // Keeps the lists and their capacity for the next capture
+        data_.Clear();
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <imgui/imgui.h>
+
+namespace Chopper
+{
+    // Owned copy of ImGui's draw data. ImGui::NewFrame() reuses the lists behind
+    // ImGui::GetDrawData(), so a frame rendered on another thread needs its own copy.
+    // The copy carries no texture update list: ImGui textures are updated by the thread that
+    // owns the context, while no copy is being rendered. The copied lists and their buffers are
+    // kept between captures, so a steady UI is copied without touching the heap.
+    class ImGuiSnapshot
+    {
+    public:
+        ImGuiSnapshot() = default;
+        ~ImGuiSnapshot();
+        ImGuiSnapshot(const ImGuiSnapshot&) = delete;
+        ImGuiSnapshot& operator=(const ImGuiSnapshot&) = delete;
+
+        void capture(const ImDrawData& source);
+        void clear();
+
+        ImDrawData* drawData() { return &data_; }
+
+    private:
+        ImDrawData data_;
+        // Owned lists, reused by later captures; data_ points at the first CmdListsCount
+        ImVector<ImDrawList*> lists_;
+    };
+}
@@ -0,0 +1,443 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Chopper
+{
+    struct JobCounter::Job
+    {
+        std::function<void()> fn;
+        JobCounter* counter = nullptr;
+    };
+
+    namespace
+    {
+        constexpr uint32_t NO_THREAD = ~0u;
+        // Failed searches before an idle worker goes to sleep
+        constexpr uint32_t IDLE_SPINS = 64;
+
+        thread_local const JobSystem* current_system = nullptr;
+        thread_local uint32_t current_index = NO_THREAD;
+        // Jobs nest when a job waits; only the outermost one counts as busy time
+        thread_local uint32_t current_depth = 0;
+        thread_local uint32_t steal_seed = 0x9e3779b9u;
+
+        // 0 picks hardware concurrency
+        uint32_t instance_thread_count = 0;
+
+        uint32_t nextRandom()
+        {
+            // xorshift32
+            steal_seed ^= steal_seed << 13;
+            steal_seed ^= steal_seed >> 17;
+            steal_seed ^= steal_seed << 5;
+            return steal_seed;
+        }
+    }
+
+    bool JobSystem::Deque::push(Job* job)
+    {
+        const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        const int64_t top = top_.load(std::memory_order_acquire);
+        if (bottom - top >= CAPACITY) return false;
+        buffer_[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    JobSystem::Job* JobSystem::Deque::pop()
+    {
+        const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        if (top > bottom)
+        {
+            // Empty
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* job = buffer_[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // Last job: race the thieves for it
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed))
+            {
+                job = nullptr;
+            }
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    JobSystem::Job* JobSystem::Deque::steal()
+    {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) return nullptr;
+
+        Job* job = buffer_[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return job;
+    }
+
+    JobSystem& JobSystem::instance()
+    {
+        static JobSystem system(instance_thread_count);
+        return system;
+    }
+
+    void JobSystem::setInstanceThreadCount(uint32_t threadCount)
+    {
+        instance_thread_count = threadCount;
+    }
+
+    JobSystem::JobSystem(uint32_t threadCount)
+    {
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        threads_.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; ++i)
+        {
+            threads_.push_back(std::make_unique<ThreadState>());
+        }
+        current_system = this;
+        current_index = 0;
+        sampled_at_ = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 1; i < threadCount; ++i)
+        {
+            workers_.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard lock(sleep_mutex_);
+            quit_.store(true);
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_) worker.join();
+
+        // Jobs nobody waited for are dropped
+        for (const auto& thread : threads_)
+        {
+            while (Job* job = thread->deque.pop()) job_pool_.destroy(job);
+        }
+        for (Job* job : injected_) job_pool_.destroy(job);
+        if (current_system == this)
+        {
+            current_system = nullptr;
+            current_index = NO_THREAD;
+        }
+    }
+
+    uint32_t JobSystem::currentIndex() const
+    {
+        return current_system == this ? current_index : NO_THREAD;
+    }
+
+    void JobSystem::run(std::function<void()> fn, JobCounter* counter)
+    {
+        if (counter) counter->pending_.fetch_add(1, std::memory_order_relaxed);
+        submit(job_pool_.create(std::move(fn), counter));
+    }
+
+    void JobSystem::runAfter(JobCounter& dependency, std::function<void()> fn, JobCounter* counter)
+    {
+        if (counter) counter->pending_.fetch_add(1, std::memory_order_relaxed);
+        Job* job = job_pool_.create(std::move(fn), counter);
+        {
+            std::lock_guard lock(dependency.mutex_);
+            if (dependency.pending_.load(std::memory_order_acquire) != 0)
+            {
+                dependency.continuations_.push_back(job);
+                return;
+            }
+        }
+        submit(job);
+    }
+
+    void JobSystem::submit(Job* job)
+    {
+        const uint32_t self = currentIndex();
+        if (self == NO_THREAD || !threads_[self]->deque.push(job))
+        {
+            std::lock_guard lock(injected_mutex_);
+            injected_.push_back(job);
+        }
+
+        queued_.fetch_add(1);
+        if (sleeping_.load() > 0)
+        {
+            std::lock_guard lock(sleep_mutex_);
+            wake_.notify_one();
+        }
+    }
+
+    JobSystem::Job* JobSystem::findJob(uint32_t self)
+    {
+        if (queued_.load(std::memory_order_relaxed) <= 0) return nullptr;
+
+        if (self != NO_THREAD)
+        {
+            if (Job* job = threads_[self]->deque.pop())
+            {
+                queued_.fetch_sub(1);
+                return job;
+            }
+        }
+        {
+            std::unique_lock lock(injected_mutex_, std::try_to_lock);
+            if (lock.owns_lock() && !injected_.empty())
+            {
+                Job* job = injected_.back();
+                injected_.pop_back();
+                queued_.fetch_sub(1);
+                return job;
+            }
+        }
+
+        // Random first victim, so thieves spread over the deques
+        const uint32_t count = threadCount();
+        const uint32_t first = nextRandom() % count;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t victim = (first + i) % count;
+            if (victim == self) continue;
+            if (Job* job = threads_[victim]->deque.steal())
+            {
+                queued_.fetch_sub(1);
+                if (self != NO_THREAD) threads_[self]->steals.fetch_add(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    void JobSystem::reportDetachedException(std::exception_ptr exception)
+    {
+        try
+        {
+            std::rethrow_exception(exception);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "job without a counter threw: " << e.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << "job without a counter threw an unknown exception" << std::endl;
+        }
+        detached_exceptions_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void JobSystem::execute(Job* job, uint32_t self)
+    {
+        const bool outermost = current_depth++ == 0;
+        const auto start = std::chrono::steady_clock::now();
+        try
+        {
+            job->fn();
+        }
+        catch (...)
+        {
+            if (job->counter)
+            {
+                std::lock_guard lock(job->counter->mutex_);
+                if (!job->counter->exception_) job->counter->exception_ = std::current_exception();
+            }
+            else
+            {
+                // Nobody waits for it, and rethrowing on a worker would terminate the process
+                reportDetachedException(std::current_exception());
+            }
+        }
+        --current_depth;
+
+        if (self != NO_THREAD)
+        {
+            ThreadState& state = *threads_[self];
+            state.jobs.fetch_add(1, std::memory_order_relaxed);
+            if (outermost)
+            {
+                const auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start);
+                state.busyNanoseconds.fetch_add(static_cast<uint64_t>(busy.count()), std::memory_order_relaxed);
+            }
+        }
+
+        JobCounter* counter = job->counter;
+        job_pool_.destroy(job);
+        if (counter) finish(*counter);
+    }
+
+    void JobSystem::finish(JobCounter& counter)
+    {
+        // Decrementing under the lock keeps wait() from returning, and the counter from being
+        // destroyed, while this thread still touches it
+        std::vector<Job*> released;
+        {
+            std::lock_guard lock(counter.mutex_);
+            if (counter.pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                released.swap(counter.continuations_);
+            }
+        }
+        for (Job* job : released) submit(job);
+    }
+
+    void JobSystem::wait(JobCounter& counter)
+    {
+        const uint32_t self = currentIndex();
+        while (!counter.done())
+        {
+            if (Job* job = findJob(self))
+            {
+                execute(job, self);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        std::exception_ptr exception;
+        {
+            std::lock_guard lock(counter.mutex_);
+            std::swap(exception, counter.exception_);
+        }
+        if (exception) std::rethrow_exception(exception);
+    }
+
+    void JobSystem::workerLoop(uint32_t index)
+    {
+        current_system = this;
+        current_index = index;
+        steal_seed ^= index * 0x85ebca6bu;
+
+        uint32_t idle = 0;
+        while (!quit_.load(std::memory_order_relaxed))
+        {
+            if (Job* job = findJob(index))
+            {
+                execute(job, index);
+                idle = 0;
+                continue;
+            }
+            if (++idle < IDLE_SPINS)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock lock(sleep_mutex_);
+            sleeping_.fetch_add(1);
+            wake_.wait(lock, [this] { return quit_.load() || queued_.load() > 0; });
+            sleeping_.fetch_sub(1);
+            idle = 0;
+        }
+    }
+
+    void JobSystem::parallelFor(size_t count, size_t minBatch, FunctionRef<void(size_t, size_t)> fn)
+    {
+        if (count == 0) return;
+
+        const size_t batch = std::max<size_t>(1, minBatch);
+        const size_t batches = (count + batch - 1) / batch;
+        if (batches == 1 || threadCount() == 1)
+        {
+            fn(0, count);
+            return;
+        }
+
+        // Helpers pull batches from a shared cursor, so uneven batches balance themselves
+        struct Shared
+        {
+            std::atomic<size_t> next{0};
+            size_t batch;
+            size_t count;
+            FunctionRef<void(size_t, size_t)> fn;
+
+            void drain()
+            {
+                for (;;)
+                {
+                    const size_t begin = next.fetch_add(batch, std::memory_order_relaxed);
+                    if (begin >= count) return;
+                    fn(begin, std::min(begin + batch, count));
+                }
+            }
+        } shared{{}, batch, count, fn};
+
+        JobCounter helpers;
+        const size_t helperCount = std::min<size_t>(batches, threadCount()) - 1;
+        for (size_t i = 0; i < helperCount; ++i)
+        {
+            // One pointer of capture fits std::function's inline storage
+            run([state = &shared] { state->drain(); }, &helpers);
+        }
+
+        // The helpers reference this frame, so wait for them even if the caller's batches threw
+        std::exception_ptr exception;
+        try
+        {
+            shared.drain();
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+            shared.next.store(count, std::memory_order_relaxed);
+        }
+        wait(helpers);
+        if (exception) std::rethrow_exception(exception);
+    }
+
+    const JobSystem::Stats& JobSystem::sampleStats()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double interval = std::chrono::duration<double, std::nano>(now - sampled_at_).count();
+        sampled_at_ = now;
+
+        // Reused, so the threads vector keeps its storage
+        Stats& stats = stats_;
+        stats.jobs = 0;
+        stats.steals = 0;
+        stats.workerUtilization = 0.0f;
+        stats.milliseconds = interval / 1.0e6;
+        stats.threads.resize(threads_.size());
+        float workerBusy = 0.0f;
+        for (size_t i = 0; i < threads_.size(); ++i)
+        {
+            ThreadState& state = *threads_[i];
+            const uint64_t jobs = state.jobs.load(std::memory_order_relaxed);
+            const uint64_t steals = state.steals.load(std::memory_order_relaxed);
+            const uint64_t busy = state.busyNanoseconds.load(std::memory_order_relaxed);
+
+            ThreadStats& thread = stats.threads[i];
+            thread.jobs = jobs - state.sampledJobs;
+            thread.steals = steals - state.sampledSteals;
+            thread.utilization = interval > 0.0
+                                     ? static_cast<float>(std::min(1.0, (busy - state.sampledBusy) / interval))
+                                     : 0.0f;
+            state.sampledJobs = jobs;
+            state.sampledSteals = steals;
+            state.sampledBusy = busy;
+
+            stats.jobs += thread.jobs;
+            stats.steals += thread.steals;
+            if (i > 0) workerBusy += thread.utilization;
+        }
+        if (threads_.size() > 1) stats.workerUtilization = workerBusy / static_cast<float>(threads_.size() - 1);
+        return stats;
+    }
+}
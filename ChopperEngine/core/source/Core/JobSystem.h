@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FunctionRef.h"
+#include "PoolAllocator.h"
+
+namespace Chopper
+{
+    class JobSystem;
+
+    // Counts unfinished jobs. Jobs started with a counter increment it and decrement it when they
+    // finish; JobSystem::wait() blocks until it reaches zero. Jobs started with runAfter() wait for
+    // a counter instead, which is how dependencies between jobs are expressed.
+    // A counter must outlive every job that references it.
+    class JobCounter
+    {
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        bool done() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+        struct Job;
+
+        std::atomic<uint32_t> pending_{0};
+        // Jobs released when pending_ drops to zero
+        std::mutex mutex_;
+        std::vector<Job*> continuations_;
+        // First exception thrown by a job, rethrown by wait()
+        std::exception_ptr exception_;
+    };
+
+    // Work-stealing job scheduler. Every worker owns a Chase-Lev deque: it pushes and pops jobs at
+    // the bottom, idle workers steal from the top of someone else's. The thread that creates the
+    // system (the main thread for instance()) owns deque 0 and runs jobs only while it waits, so it
+    // never blocks while there is work it could do. Other threads submit through a shared queue.
+    class JobSystem
+    {
+    public:
+        // Per-thread counters since the previous sampleStats() call; index 0 is the main thread
+        struct ThreadStats
+        {
+            uint64_t jobs = 0;
+            uint64_t steals = 0;
+            // Fraction of the sample interval spent running jobs
+            float utilization = 0.0f;
+        };
+
+        struct Stats
+        {
+            std::vector<ThreadStats> threads;
+            uint64_t jobs = 0;
+            uint64_t steals = 0;
+            // Average over the workers, excluding the main thread
+            float workerUtilization = 0.0f;
+            double milliseconds = 0.0;
+        };
+
+        // Sized to hardware concurrency unless setInstanceThreadCount() says otherwise, created by the
+        // first caller
+        static JobSystem& instance();
+        // Sizes instance(); only takes effect before its first call
+        static void setInstanceThreadCount(uint32_t threadCount);
+
+        // threadCount includes the creating thread; 0 picks hardware concurrency
+        explicit JobSystem(uint32_t threadCount = 0);
+        ~JobSystem();
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        uint32_t threadCount() const { return static_cast<uint32_t>(threads_.size()); }
+        // Exceptions thrown by jobs queued without a counter so far
+        uint64_t detachedExceptions() const { return detached_exceptions_.load(std::memory_order_relaxed); }
+
+        // Queues fn; `counter`, if given, is incremented now and decremented once fn has finished.
+        // Without a counter nobody can receive what fn throws, so it is written to stderr and counted
+        // by detachedExceptions() instead.
+        void run(std::function<void()> fn, JobCounter* counter = nullptr);
+
+        // Queues fn once `dependency` has reached zero
+        void runAfter(JobCounter& dependency, std::function<void()> fn, JobCounter* counter = nullptr);
+
+        // Runs queued jobs on the calling thread until `counter` reaches zero, then rethrows the
+        // first exception one of its jobs threw
+        void wait(JobCounter& counter);
+
+        // Splits [0, count) into batches of at least `minBatch` elements and runs fn(begin, end)
+        // for each across the workers and the calling thread. Returns when every batch finished.
+        void parallelFor(size_t count, size_t minBatch, FunctionRef<void(size_t, size_t)> fn);
+
+        // Utilization since the previous call; call from one thread only, e.g. once per frame.
+        // The result is reused by the next call.
+        const Stats& sampleStats();
+
+    private:
+        using Job = JobCounter::Job;
+
+        // Chase-Lev deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+        // Models"), fixed capacity. push()/pop() are owner-only, steal() is safe from any thread.
+        class Deque
+        {
+        public:
+            bool push(Job* job);
+            Job* pop();
+            Job* steal();
+
+        private:
+            static constexpr int64_t CAPACITY = 4096;
+            std::atomic<int64_t> top_{0};
+            std::atomic<int64_t> bottom_{0};
+            std::unique_ptr<std::atomic<Job*>[]> buffer_{new std::atomic<Job*>[CAPACITY]};
+        };
+
+        struct alignas(64) ThreadState
+        {
+            Deque deque;
+            std::atomic<uint64_t> jobs{0};
+            std::atomic<uint64_t> steals{0};
+            std::atomic<uint64_t> busyNanoseconds{0};
+            // sampleStats() baselines
+            uint64_t sampledJobs = 0;
+            uint64_t sampledSteals = 0;
+            uint64_t sampledBusy = 0;
+        };
+
+        void submit(Job* job);
+        Job* findJob(uint32_t self);
+        void execute(Job* job, uint32_t self);
+        void reportDetachedException(std::exception_ptr exception);
+        void finish(JobCounter& counter);
+        void workerLoop(uint32_t index);
+        uint32_t currentIndex() const;
+
+        // Jobs are recycled, so a steady job rate doesn't touch the heap
+        ObjectPool<Job> job_pool_;
+        std::vector<std::unique_ptr<ThreadState>> threads_;
+        std::vector<std::thread> workers_;
+
+        // Jobs from threads that own no deque
+        std::mutex injected_mutex_;
+        std::vector<Job*> injected_;
+
+        // Sleeping workers wake when queued_ becomes non-zero
+        std::atomic<int64_t> queued_{0};
+        std::atomic<uint32_t> sleeping_{0};
+        std::mutex sleep_mutex_;
+        std::condition_variable wake_;
+        std::atomic<bool> quit_{false};
+        std::atomic<uint64_t> detached_exceptions_{0};
+
+        std::chrono::steady_clock::time_point sampled_at_;
+        Stats stats_;
+    };
+}
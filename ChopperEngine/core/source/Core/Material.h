@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <vulkan/vulkan.hpp>
+
+namespace Chopper
+{
+    // Full description of a graphics pipeline: shader entry points plus every piece of
+    // fixed-function state. Two materials with equal states share one pipeline.
+    struct PipelineState
+    {
+        std::string shaderPath = "shaders/slang.spv";
+        std::string vertexEntry = "vertMain";
+        // Empty for a depth-only pipeline
+        std::string fragmentEntry = "fragMain";
+        vk::PipelineLayout layout = nullptr;
+
+        // Raster
+        vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+        vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+        vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+        vk::FrontFace frontFace = vk::FrontFace::eCounterClockwise;
+        vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+        // Depth bias; off while both are zero
+        float depthBiasConstant = 0.0f;
+        float depthBiasSlope = 0.0f;
+
+        // Depth
+        bool depthTest = true;
+        bool depthWrite = true;
+        vk::CompareOp depthCompareOp = vk::CompareOp::eLess;
+
+        // Blend (single color attachment)
+        bool blendEnable = false;
+        vk::BlendFactor srcColorBlendFactor = vk::BlendFactor::eOne;
+        vk::BlendFactor dstColorBlendFactor = vk::BlendFactor::eZero;
+        vk::BlendOp colorBlendOp = vk::BlendOp::eAdd;
+        vk::BlendFactor srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        vk::BlendFactor dstAlphaBlendFactor = vk::BlendFactor::eZero;
+        vk::BlendOp alphaBlendOp = vk::BlendOp::eAdd;
+        vk::ColorComponentFlags colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+        // Attachments (dynamic rendering); no color attachment when eUndefined
+        vk::Format colorFormat = vk::Format::eUndefined;
+        vk::Format depthFormat = vk::Format::eUndefined;
+
+        bool operator==(const PipelineState& other) const = default;
+    };
+
+    // The part of PipelineState that can be set on the command buffer through
+    // extended dynamic state instead of being baked into the pipeline.
+    struct DynamicRasterState
+    {
+        vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+        vk::FrontFace frontFace = vk::FrontFace::eCounterClockwise;
+        bool depthTest = true;
+        bool depthWrite = true;
+        vk::CompareOp depthCompareOp = vk::CompareOp::eLess;
+
+        bool operator==(const DynamicRasterState& other) const = default;
+    };
+
+    inline DynamicRasterState dynamicRasterStateOf(const PipelineState& state)
+    {
+        return {state.cullMode, state.frontFace, state.depthTest, state.depthWrite, state.depthCompareOp};
+    }
+
+    // The same test with depth reversed (1 near, 0 far): eLess becomes eGreater and so on
+    inline vk::CompareOp reversedCompareOp(vk::CompareOp op)
+    {
+        switch (op)
+        {
+        case vk::CompareOp::eLess: return vk::CompareOp::eGreater;
+        case vk::CompareOp::eLessOrEqual: return vk::CompareOp::eGreaterOrEqual;
+        case vk::CompareOp::eGreater: return vk::CompareOp::eLess;
+        case vk::CompareOp::eGreaterOrEqual: return vk::CompareOp::eLessOrEqual;
+        default: return op;
+        }
+    }
+
+    struct Material
+    {
+        std::string name;
+        // As authored, for standard depth; the renderer derives what it binds from it
+        PipelineState state;
+
+        // Resolved by PipelineCache::request(), with the dynamic state to bind it with
+        uint32_t pipeline = ~0u;
+        DynamicRasterState dynamic;
+        // Depth-only variant for the depth pre-pass; ~0u when the material is not part of it
+        uint32_t depthPipeline = ~0u;
+        DynamicRasterState depthDynamic;
+        // Depth-only variant for the cascaded shadow maps; ~0u when the material casts no shadow
+        uint32_t shadowPipeline = ~0u;
+        DynamicRasterState shadowDynamic;
+    };
+}
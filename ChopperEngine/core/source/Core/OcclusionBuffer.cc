@@ -0,0 +1,337 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace Chopper
+{
+    namespace
+    {
+        // Rows per worker band; a multiple of TILE_SIZE so each band owns whole tile rows
+        constexpr uint32_t BAND_ROWS = 2 * OcclusionBuffer::TILE_SIZE;
+
+        uint32_t roundUp(uint32_t value, uint32_t multiple)
+        {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        // All three vertices outside the same clip plane (near plane handled by clipping)
+        bool triviallyOutside(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2)
+        {
+            return (v0.x > v0.w && v1.x > v1.w && v2.x > v2.w) ||
+                (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) ||
+                (v0.y > v0.w && v1.y > v1.w && v2.y > v2.w) ||
+                (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w) ||
+                (v0.z > v0.w && v1.z > v1.w && v2.z > v2.w);
+        }
+    }
+
+    void OcclusionBuffer::resize(uint32_t width, uint32_t height)
+    {
+        width_ = roundUp(std::max(width, TILE_SIZE), TILE_SIZE);
+        height_ = roundUp(std::max(height, BAND_ROWS), BAND_ROWS);
+        tiles_x_ = width_ / TILE_SIZE;
+        tiles_y_ = height_ / TILE_SIZE;
+        depth_.assign(static_cast<size_t>(width_) * height_, 1.0f);
+        tile_max_.assign(static_cast<size_t>(tiles_x_) * tiles_y_, 1.0f);
+    }
+
+    void OcclusionBuffer::begin(const glm::mat4& viewProj)
+    {
+        view_proj_ = viewProj;
+        triangles_.clear();
+        std::fill(depth_.begin(), depth_.end(), 1.0f);
+        std::fill(tile_max_.begin(), tile_max_.end(), 1.0f);
+        stats_ = {};
+    }
+
+    void OcclusionBuffer::addOccluder(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices,
+                                      size_t indexCount, const glm::mat4& world)
+    {
+        const glm::mat4 transform = view_proj_ * world;
+        clip_scratch_.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            clip_scratch_[i] = transform * glm::vec4(positions[i], 1.0f);
+        }
+
+        for (size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            clipAndSetup(clip_scratch_[indices[i]], clip_scratch_[indices[i + 1]], clip_scratch_[indices[i + 2]]);
+        }
+        ++stats_.occluders;
+    }
+
+    void OcclusionBuffer::clipAndSetup(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2)
+    {
+        if (triviallyOutside(v0, v1, v2)) return;
+
+        const bool in0 = v0.z >= 0.0f;
+        const bool in1 = v1.z >= 0.0f;
+        const bool in2 = v2.z >= 0.0f;
+        if (in0 && in1 && in2)
+        {
+            setupTriangle(v0, v1, v2);
+            return;
+        }
+        if (!in0 && !in1 && !in2) return;
+
+        // Clip against the near plane (z >= 0); yields a triangle or a quad
+        const glm::vec4 input[3] = {v0, v1, v2};
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            const glm::vec4& a = input[i];
+            const glm::vec4& b = input[(i + 1) % 3];
+            if (a.z >= 0.0f) polygon[count++] = a;
+            if ((a.z >= 0.0f) != (b.z >= 0.0f))
+            {
+                polygon[count++] = glm::mix(a, b, a.z / (a.z - b.z));
+            }
+        }
+        for (int i = 1; i + 1 < count; ++i)
+        {
+            setupTriangle(polygon[0], polygon[i], polygon[i + 1]);
+        }
+    }
+
+    void OcclusionBuffer::setupTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2)
+    {
+        const glm::vec4* v[3] = {&v0, &v1, &v2};
+        float x[3], y[3], z[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            // Near-plane clipping guarantees w > 0
+            const float invW = 1.0f / v[i]->w;
+            x[i] = (v[i]->x * invW * 0.5f + 0.5f) * static_cast<float>(width_);
+            y[i] = (v[i]->y * invW * 0.5f + 0.5f) * static_cast<float>(height_);
+            z[i] = v[i]->z * invW;
+        }
+
+        Triangle tri{};
+        tri.minX = std::min({x[0], x[1], x[2]});
+        tri.maxX = std::max({x[0], x[1], x[2]});
+        tri.minY = std::min({y[0], y[1], y[2]});
+        tri.maxY = std::max({y[0], y[1], y[2]});
+        if (tri.maxX < 0.0f || tri.maxY < 0.0f || tri.minX >= static_cast<float>(width_) ||
+            tri.minY >= static_cast<float>(height_))
+        {
+            return;
+        }
+
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if (std::abs(area) < 1e-8f) return;
+
+        // Edge i is opposite vertex i; both windings are accepted
+        const float sign = area < 0.0f ? -1.0f : 1.0f;
+        area *= sign;
+        for (int i = 0; i < 3; ++i)
+        {
+            const int from = (i + 1) % 3;
+            const int to = (i + 2) % 3;
+            const float dx = x[to] - x[from];
+            const float dy = y[to] - y[from];
+            tri.edgeA[i] = -dy * sign;
+            tri.edgeB[i] = dx * sign;
+            tri.edgeC[i] = (dy * x[from] - dx * y[from]) * sign;
+        }
+
+        // z = sum(edge_i(p) * z_i) / area
+        const float invArea = 1.0f / area;
+        for (int i = 0; i < 3; ++i)
+        {
+            tri.depthA += tri.edgeA[i] * z[i] * invArea;
+            tri.depthB += tri.edgeB[i] * z[i] * invArea;
+            tri.depthC += tri.edgeC[i] * z[i] * invArea;
+        }
+
+        triangles_.push_back(tri);
+    }
+
+    void OcclusionBuffer::rasterize()
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        // Bands never share pixels or tiles, so workers need no synchronization
+        const uint32_t bands = height_ / BAND_ROWS;
+        parallelFor(bands, 1, [this](size_t first, size_t last)
+        {
+            for (size_t band = first; band < last; ++band)
+            {
+                rasterizeBand(static_cast<uint32_t>(band) * BAND_ROWS, static_cast<uint32_t>(band + 1) * BAND_ROWS);
+            }
+        });
+
+        stats_.triangles = static_cast<uint32_t>(triangles_.size());
+        stats_.rasterMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void OcclusionBuffer::rasterizeBand(uint32_t rowBegin, uint32_t rowEnd)
+    {
+        [[maybe_unused]] const bool useSse = Simd::level() >= Simd::Level::SSE2;
+        const auto width = static_cast<int32_t>(width_);
+
+        for (const Triangle& tri : triangles_)
+        {
+            // Pixel centers sit at +0.5
+            const int32_t y0 = std::max(static_cast<int32_t>(rowBegin), static_cast<int32_t>(std::floor(tri.minY)));
+            const int32_t y1 = std::min(static_cast<int32_t>(rowEnd) - 1, static_cast<int32_t>(std::ceil(tri.maxY)));
+            if (y0 > y1) continue;
+            // Start on a 4-pixel boundary; width is a multiple of 4 so groups never straddle rows
+            const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(tri.minX))) & ~3;
+            const int32_t x1 = std::min(width - 1, static_cast<int32_t>(std::ceil(tri.maxX)));
+
+            for (int32_t y = y0; y <= y1; ++y)
+            {
+                const float py = static_cast<float>(y) + 0.5f;
+                float* row = depth_.data() + static_cast<size_t>(y) * width_;
+                const float rowE0 = tri.edgeB[0] * py + tri.edgeC[0];
+                const float rowE1 = tri.edgeB[1] * py + tri.edgeC[1];
+                const float rowE2 = tri.edgeB[2] * py + tri.edgeC[2];
+                const float rowZ = tri.depthB * py + tri.depthC;
+
+                int32_t x = x0;
+#if defined(CHOPPER_SIMD_SSE2)
+                if (useSse)
+                {
+                    const __m128 a0 = _mm_set1_ps(tri.edgeA[0]);
+                    const __m128 a1 = _mm_set1_ps(tri.edgeA[1]);
+                    const __m128 a2 = _mm_set1_ps(tri.edgeA[2]);
+                    const __m128 az = _mm_set1_ps(tri.depthA);
+                    const __m128 c0 = _mm_set1_ps(rowE0);
+                    const __m128 c1 = _mm_set1_ps(rowE1);
+                    const __m128 c2 = _mm_set1_ps(rowE2);
+                    const __m128 cz = _mm_set1_ps(rowZ);
+                    const __m128 zero = _mm_setzero_ps();
+                    const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+                    for (; x <= x1; x += 4)
+                    {
+                        const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                        const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), c0);
+                        const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), c1);
+                        const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), c2);
+                        const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                                         _mm_cmpge_ps(e2, zero));
+                        if (_mm_movemask_ps(inside) == 0) continue;
+
+                        const __m128 z = _mm_add_ps(_mm_mul_ps(az, px), cz);
+                        const __m128 current = _mm_loadu_ps(row + x);
+                        const __m128 closer = _mm_min_ps(current, z);
+                        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, current)));
+                    }
+                }
+#endif
+                for (; x <= x1; ++x)
+                {
+                    const float px = static_cast<float>(x) + 0.5f;
+                    if (tri.edgeA[0] * px + rowE0 < 0.0f || tri.edgeA[1] * px + rowE1 < 0.0f ||
+                        tri.edgeA[2] * px + rowE2 < 0.0f)
+                    {
+                        continue;
+                    }
+                    row[x] = std::min(row[x], tri.depthA * px + rowZ);
+                }
+            }
+        }
+
+        // Reduce this band's tile rows to their farthest depth
+        for (uint32_t ty = rowBegin / TILE_SIZE; ty < rowEnd / TILE_SIZE; ++ty)
+        {
+            for (uint32_t tx = 0; tx < tiles_x_; ++tx)
+            {
+                float farthest = 0.0f;
+                for (uint32_t y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; ++y)
+                {
+                    const float* row = depth_.data() + static_cast<size_t>(y) * width_ + tx * TILE_SIZE;
+                    for (uint32_t x = 0; x < TILE_SIZE; ++x) farthest = std::max(farthest, row[x]);
+                }
+                tile_max_[ty * tiles_x_ + tx] = farthest;
+            }
+        }
+    }
+
+    bool OcclusionBuffer::isVisible(const Aabb& box) const
+    {
+        float minX = static_cast<float>(width_), minY = static_cast<float>(height_), minZ = 1.0f;
+        float maxX = 0.0f, maxY = 0.0f;
+        for (int i = 0; i < 8; ++i)
+        {
+            const glm::vec3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y,
+                                   i & 4 ? box.max.z : box.min.z);
+            const glm::vec4 clip = view_proj_ * glm::vec4(corner, 1.0f);
+            // Crosses the near plane: no meaningful screen rectangle
+            if (clip.z < 0.0f || clip.w <= 0.0f) return true;
+
+            const float invW = 1.0f / clip.w;
+            const float x = (clip.x * invW * 0.5f + 0.5f) * static_cast<float>(width_);
+            const float y = (clip.y * invW * 0.5f + 0.5f) * static_cast<float>(height_);
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            minZ = std::min(minZ, clip.z * invW);
+        }
+
+        const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(minX)));
+        const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(minY)));
+        const int32_t x1 = std::min(static_cast<int32_t>(width_) - 1, static_cast<int32_t>(std::floor(maxX)));
+        const int32_t y1 = std::min(static_cast<int32_t>(height_) - 1, static_cast<int32_t>(std::floor(maxY)));
+        // Off screen: left to frustum culling
+        if (x0 > x1 || y0 > y1) return true;
+
+        // Coarse pass: every covered tile's farthest occluder is closer than the box
+        bool tilesDecide = true;
+        for (int32_t ty = y0 / static_cast<int32_t>(TILE_SIZE); ty <= y1 / static_cast<int32_t>(TILE_SIZE) && tilesDecide; ++ty)
+        {
+            for (int32_t tx = x0 / static_cast<int32_t>(TILE_SIZE); tx <= x1 / static_cast<int32_t>(TILE_SIZE); ++tx)
+            {
+                if (tile_max_[ty * tiles_x_ + tx] >= minZ)
+                {
+                    tilesDecide = false;
+                    break;
+                }
+            }
+        }
+        if (tilesDecide) return false;
+
+        for (int32_t y = y0; y <= y1; ++y)
+        {
+            const float* row = depth_.data() + static_cast<size_t>(y) * width_;
+            for (int32_t x = x0; x <= x1; ++x)
+            {
+                if (row[x] >= minZ) return true;
+            }
+        }
+        return false;
+    }
+
+    void OcclusionBuffer::testVisibility(const Aabb* boxes, size_t count, uint8_t* visible)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        parallelFor(count, 256, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                visible[i] = isVisible(boxes[i]) ? 1 : 0;
+            }
+        });
+
+        uint32_t occluded = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            occluded += visible[i] ? 0 : 1;
+        }
+        stats_.tested += static_cast<uint32_t>(count);
+        stats_.occluded += occluded;
+        stats_.testMilliseconds += std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "DynamicAabbTree.h"
+
+namespace Chopper
+{
+    // CPU software occlusion culling. Occluder meshes are rasterized at low resolution into a
+    // depth buffer (4 pixels at a time with SSE2, in horizontal bands spread over worker threads),
+    // then reduced to a max-depth tile level. Occludee boxes are tested against the tiles first
+    // and against pixels only where a tile cannot decide.
+    //
+    // Depth is clip z / w in [0, 1], smaller is closer. Independent of Vulkan, so it can run and
+    // be tested headless.
+    class OcclusionBuffer
+    {
+    public:
+        static constexpr uint32_t TILE_SIZE = 8;
+
+        struct Stats
+        {
+            uint32_t occluders = 0;
+            uint32_t triangles = 0;
+            uint32_t tested = 0;
+            uint32_t occluded = 0;
+            double rasterMilliseconds = 0.0;
+            double testMilliseconds = 0.0;
+        };
+
+        // Width and height are rounded up to whole tiles (and height to whole raster bands)
+        void resize(uint32_t width, uint32_t height);
+
+        // Clears depth and queued occluders and sets the camera for this frame
+        void begin(const glm::mat4& viewProj);
+
+        // Queues an indexed triangle mesh; positions are object space
+        void addOccluder(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices,
+                         size_t indexCount, const glm::mat4& world);
+
+        // Rasterizes queued occluders and builds the tile level
+        void rasterize();
+
+        // False only when the box is certainly hidden behind rasterized occluders
+        bool isVisible(const Aabb& box) const;
+
+        // isVisible() for every box, spread over worker threads
+        void testVisibility(const Aabb* boxes, size_t count, uint8_t* visible);
+
+        uint32_t width() const { return width_; }
+        uint32_t height() const { return height_; }
+        const float* depth() const { return depth_.data(); }
+        const Stats& stats() const { return stats_; }
+
+    private:
+        // Screen-space triangle as edge and depth plane equations: f(x, y) = a * x + b * y + c
+        struct Triangle
+        {
+            float minX, minY, maxX, maxY;
+            float edgeA[3], edgeB[3], edgeC[3];
+            float depthA, depthB, depthC;
+        };
+
+        void setupTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2);
+        void clipAndSetup(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2);
+        void rasterizeBand(uint32_t rowBegin, uint32_t rowEnd);
+
+        uint32_t width_ = 0;
+        uint32_t height_ = 0;
+        uint32_t tiles_x_ = 0;
+        uint32_t tiles_y_ = 0;
+        glm::mat4 view_proj_{1.0f};
+
+        std::vector<float> depth_;
+        // Farthest depth in each tile
+        std::vector<float> tile_max_;
+        std::vector<Triangle> triangles_;
+        std::vector<glm::vec4> clip_scratch_;
+
+        Stats stats_{};
+    };
+}
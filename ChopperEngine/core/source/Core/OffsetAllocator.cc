@@ -0,0 +1,217 @@
+#include "OffsetAllocator.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace Chopper
+{
+    namespace
+    {
+        constexpr uint32_t MANTISSA_BITS = 3;
+        constexpr uint32_t MANTISSA_MASK = (1u << MANTISSA_BITS) - 1;
+
+        // Bin of a size on the 5.3 floating-point scale. Sizes below 8 have a bin each; above
+        // that every power of two is split into 8 bins. Rounding down gives the bin a free range
+        // is filed under, rounding up the first bin whose every range fits the size.
+        uint32_t binOf(uint32_t size, bool roundUp)
+        {
+            if (size <= MANTISSA_MASK) return size;
+            const uint32_t shift = static_cast<uint32_t>(std::bit_width(size)) - 1 - MANTISSA_BITS;
+            uint32_t bin = ((shift + 1) << MANTISSA_BITS) | ((size >> shift) & MANTISSA_MASK);
+            // A carry out of the mantissa moves to the next exponent, which is the next bin too
+            if (roundUp && (size & ((1u << shift) - 1)) != 0) ++bin;
+            return bin;
+        }
+    }
+
+    OffsetAllocator::OffsetAllocator(uint32_t size, uint32_t maxAllocations)
+    {
+        reset(size, maxAllocations);
+    }
+
+    void OffsetAllocator::reset(uint32_t size, uint32_t maxAllocations)
+    {
+        size_ = size;
+        max_allocations_ = maxAllocations;
+        free_units_ = 0;
+        free_ranges_ = 0;
+        live_ = 0;
+        used_top_bins_ = 0;
+        std::fill(std::begin(used_leaf_bins_), std::end(used_leaf_bins_), uint8_t{0});
+        std::fill(std::begin(bin_heads_), std::end(bin_heads_), NO_NODE);
+
+        // Each live allocation leaves at most one free range after it, plus one at the start
+        nodes_.assign(2 * static_cast<size_t>(maxAllocations) + 1, Node{});
+        spare_nodes_.resize(nodes_.size());
+        for (size_t i = 0; i < nodes_.size(); ++i)
+        {
+            spare_nodes_[i] = static_cast<uint32_t>(nodes_.size() - 1 - i);
+        }
+
+        if (size > 0) insertFree(takeNode(), 0, size);
+    }
+
+    OffsetAllocator::Allocation OffsetAllocator::allocate(uint32_t size)
+    {
+        size = std::max(size, 1u);
+        if (live_ >= max_allocations_ || size > free_units_) return {};
+
+        // Smallest bin whose ranges all fit; in its level first, then any larger level
+        const uint32_t minBin = binOf(size, true);
+        uint32_t top = minBin / LEAF_BINS;
+        uint32_t bin = NO_NODE;
+        if (top < TOP_BINS)
+        {
+            const uint32_t leaves = used_leaf_bins_[top] & (0xffu << (minBin % LEAF_BINS));
+            if (leaves != 0) bin = top * LEAF_BINS + static_cast<uint32_t>(std::countr_zero(leaves));
+        }
+        uint32_t node = NO_NODE;
+        if (bin == NO_NODE)
+        {
+            const uint32_t tops = top + 1 < TOP_BINS ? used_top_bins_ & (~0u << (top + 1)) : 0;
+            if (tops != 0)
+            {
+                top = static_cast<uint32_t>(std::countr_zero(tops));
+                bin = top * LEAF_BINS + static_cast<uint32_t>(std::countr_zero(used_leaf_bins_[top]));
+            }
+        }
+        if (bin != NO_NODE)
+        {
+            node = bin_heads_[bin];
+        }
+        else
+        {
+            // Nothing in the guaranteed bins; a range in the size's own bin may still be large
+            // enough, which matters for requests close to the largest free range
+            for (node = bin_heads_[binOf(size, false)]; node != NO_NODE && nodes_[node].size < size;
+                 node = nodes_[node].binNext)
+            {
+            }
+            if (node == NO_NODE) return {};
+        }
+
+        removeFree(node);
+        Node& taken = nodes_[node];
+        const uint32_t remainder = taken.size - size;
+        taken.size = size;
+        taken.used = true;
+        ++live_;
+
+        if (remainder > 0)
+        {
+            const uint32_t rest = takeNode();
+            insertFree(rest, nodes_[node].offset + size, remainder);
+            Node& allocated = nodes_[node];
+            nodes_[rest].neighborPrev = node;
+            nodes_[rest].neighborNext = allocated.neighborNext;
+            if (allocated.neighborNext != NO_NODE) nodes_[allocated.neighborNext].neighborPrev = rest;
+            allocated.neighborNext = rest;
+        }
+        return {nodes_[node].offset, node};
+    }
+
+    void OffsetAllocator::free(Allocation allocation)
+    {
+        if (!allocation.valid()) return;
+
+        const uint32_t node = allocation.node;
+        uint32_t offset = nodes_[node].offset;
+        uint32_t size = nodes_[node].size;
+
+        // Merge with free neighbours; the freed node takes over the merged range
+        const uint32_t prev = nodes_[node].neighborPrev;
+        if (prev != NO_NODE && !nodes_[prev].used)
+        {
+            offset = nodes_[prev].offset;
+            size += nodes_[prev].size;
+            removeFree(prev);
+            nodes_[node].neighborPrev = nodes_[prev].neighborPrev;
+            spare_nodes_.push_back(prev);
+        }
+        const uint32_t next = nodes_[node].neighborNext;
+        if (next != NO_NODE && !nodes_[next].used)
+        {
+            size += nodes_[next].size;
+            removeFree(next);
+            nodes_[node].neighborNext = nodes_[next].neighborNext;
+            spare_nodes_.push_back(next);
+        }
+
+        Node& freed = nodes_[node];
+        freed.used = false;
+        if (freed.neighborPrev != NO_NODE) nodes_[freed.neighborPrev].neighborNext = node;
+        if (freed.neighborNext != NO_NODE) nodes_[freed.neighborNext].neighborPrev = node;
+        insertFree(node, offset, size);
+        --live_;
+    }
+
+    uint32_t OffsetAllocator::allocationSize(Allocation allocation) const
+    {
+        return allocation.valid() ? nodes_[allocation.node].size : 0;
+    }
+
+    OffsetAllocator::StorageReport OffsetAllocator::storageReport() const
+    {
+        StorageReport report{free_units_, 0, free_ranges_};
+        if (used_top_bins_ == 0) return report;
+
+        // The largest range is in the highest used bin, though not necessarily at its head
+        const uint32_t top = 31 - static_cast<uint32_t>(std::countl_zero(used_top_bins_));
+        const uint32_t leaf = 31 - static_cast<uint32_t>(std::countl_zero(uint32_t{used_leaf_bins_[top]}));
+        for (uint32_t node = bin_heads_[top * LEAF_BINS + leaf]; node != NO_NODE; node = nodes_[node].binNext)
+        {
+            report.largestFree = std::max(report.largestFree, nodes_[node].size);
+        }
+        return report;
+    }
+
+    uint32_t OffsetAllocator::insertFree(uint32_t node, uint32_t offset, uint32_t size)
+    {
+        const uint32_t bin = binOf(size, false);
+        Node& free = nodes_[node];
+        free.offset = offset;
+        free.size = size;
+        free.used = false;
+        free.binPrev = NO_NODE;
+        free.binNext = bin_heads_[bin];
+        if (free.binNext != NO_NODE) nodes_[free.binNext].binPrev = node;
+        bin_heads_[bin] = node;
+
+        used_top_bins_ |= 1u << (bin / LEAF_BINS);
+        used_leaf_bins_[bin / LEAF_BINS] |= static_cast<uint8_t>(1u << (bin % LEAF_BINS));
+        free_units_ += size;
+        ++free_ranges_;
+        return node;
+    }
+
+    void OffsetAllocator::removeFree(uint32_t node)
+    {
+        const Node& free = nodes_[node];
+        if (free.binPrev != NO_NODE)
+        {
+            nodes_[free.binPrev].binNext = free.binNext;
+        }
+        else
+        {
+            // Head of its bin; the bin may become empty
+            const uint32_t bin = binOf(free.size, false);
+            bin_heads_[bin] = free.binNext;
+            if (free.binNext == NO_NODE)
+            {
+                used_leaf_bins_[bin / LEAF_BINS] &= static_cast<uint8_t>(~(1u << (bin % LEAF_BINS)));
+                if (used_leaf_bins_[bin / LEAF_BINS] == 0) used_top_bins_ &= ~(1u << (bin / LEAF_BINS));
+            }
+        }
+        if (free.binNext != NO_NODE) nodes_[free.binNext].binPrev = free.binPrev;
+        free_units_ -= free.size;
+        --free_ranges_;
+    }
+
+    uint32_t OffsetAllocator::takeNode()
+    {
+        const uint32_t node = spare_nodes_.back();
+        spare_nodes_.pop_back();
+        nodes_[node] = Node{};
+        return node;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Chopper
+{
+    // Suballocates ranges of an abstract space of `size` units (vertices, indices, bytes) in
+    // O(1), two-level segregated fit (TLSF) style. Free ranges are binned by size on a
+    // floating-point scale (5-bit exponent, 3-bit mantissa, 256 bins) with a bitmask per level,
+    // so finding a free range that fits is two bit scans. A range is split on allocation and
+    // merged with free neighbours when freed. Keeps no pointers into the space itself, so it can
+    // manage GPU buffers. Not thread-safe.
+    class OffsetAllocator
+    {
+    public:
+        static constexpr uint32_t NO_SPACE = 0xffffffff;
+
+        struct Allocation
+        {
+            uint32_t offset = NO_SPACE;
+            // Internal node, needed by free()
+            uint32_t node = NO_SPACE;
+
+            bool valid() const { return offset != NO_SPACE; }
+        };
+
+        struct StorageReport
+        {
+            uint32_t freeUnits = 0;
+            uint32_t largestFree = 0;
+            uint32_t freeRanges = 0;
+        };
+
+        // Empty until reset()
+        OffsetAllocator() = default;
+        OffsetAllocator(uint32_t size, uint32_t maxAllocations);
+
+        // Forgets every allocation. maxAllocations bounds the live allocations; bookkeeping is
+        // sized for it up front, so allocate() and free() never touch the heap.
+        void reset(uint32_t size, uint32_t maxAllocations);
+
+        // An invalid allocation when no free range holds `size` units or maxAllocations are live
+        Allocation allocate(uint32_t size);
+        void free(Allocation allocation);
+
+        uint32_t allocationSize(Allocation allocation) const;
+        uint32_t size() const { return size_; }
+        uint32_t liveAllocations() const { return live_; }
+        StorageReport storageReport() const;
+
+    private:
+        static constexpr uint32_t NO_NODE = 0xffffffff;
+        static constexpr uint32_t LEAF_BINS = 8;
+        static constexpr uint32_t TOP_BINS = 32;
+
+        struct Node
+        {
+            uint32_t offset = 0;
+            uint32_t size = 0;
+            // Free list of the node's bin
+            uint32_t binPrev = NO_NODE;
+            uint32_t binNext = NO_NODE;
+            // Adjacent ranges in the space, free or not
+            uint32_t neighborPrev = NO_NODE;
+            uint32_t neighborNext = NO_NODE;
+            bool used = false;
+        };
+
+        uint32_t insertFree(uint32_t node, uint32_t offset, uint32_t size);
+        void removeFree(uint32_t node);
+        uint32_t takeNode();
+
+        uint32_t size_ = 0;
+        uint32_t max_allocations_ = 0;
+        uint32_t free_units_ = 0;
+        uint32_t free_ranges_ = 0;
+        uint32_t live_ = 0;
+
+        uint32_t used_top_bins_ = 0;
+        uint8_t used_leaf_bins_[TOP_BINS] = {};
+        uint32_t bin_heads_[TOP_BINS * LEAF_BINS] = {};
+
+        std::vector<Node> nodes_;
+        // Indices of unused nodes
+        std::vector<uint32_t> spare_nodes_;
+    };
+}
@@ -0,0 +1,16 @@
+#include "Parallel.h"
+
+#include "JobSystem.h"
+
+namespace Chopper
+{
+    void parallelFor(size_t count, size_t minBatch, FunctionRef<void(size_t, size_t)> fn)
+    {
+        JobSystem::instance().parallelFor(count, minBatch, fn);
+    }
+
+    uint32_t parallelThreadCount()
+    {
+        return JobSystem::instance().threadCount();
+    }
+}
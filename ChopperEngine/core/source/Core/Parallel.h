@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FunctionRef.h"
+
+namespace Chopper
+{
+    // Splits [0, count) into batches of at least `minBatch` elements and runs
+    // fn(begin, end) for each batch on the JobSystem workers and the calling thread.
+    // Blocks until every batch has finished, running other jobs meanwhile, so it may be
+    // nested inside jobs and other parallelFor calls. Runs inline when there is only one batch.
+    void parallelFor(size_t count, size_t minBatch, FunctionRef<void(size_t, size_t)> fn);
+
+    // Number of threads parallelFor spreads work over, including the caller
+    uint32_t parallelThreadCount();
+}
@@ -0,0 +1,332 @@
+#include "PipelineCache.h"
+
+#include <array>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+
+#include "Vertex.h"
+
+namespace Chopper
+{
+    namespace
+    {
+        template <typename T>
+        void hashCombine(size_t& seed, const T& value)
+        {
+            seed ^= std::hash<T>{}(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+        }
+
+        template <typename BitType>
+        void hashCombine(size_t& seed, const vk::Flags<BitType>& flags)
+        {
+            hashCombine(seed, static_cast<typename vk::Flags<BitType>::MaskType>(flags));
+        }
+
+        std::vector<char> readSpirv(const std::string& filename)
+        {
+            std::ifstream file(filename, std::ios::ate | std::ios::binary);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("failed to open shader " + filename);
+            }
+            std::vector<char> buffer(file.tellg());
+            file.seekg(0, std::ios::beg);
+            file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            return buffer;
+        }
+    }
+
+    void PipelineCache::init(const vk::raii::Device& device, bool extendedDynamicState)
+    {
+        device_ = &device;
+        extended_dynamic_state_ = extendedDynamicState;
+        vk_cache_ = vk::raii::PipelineCache(device, vk::PipelineCacheCreateInfo{});
+    }
+
+    void PipelineCache::clear()
+    {
+        lookup_.clear();
+        entries_.clear();
+        free_ids_.clear();
+        shader_modules_.clear();
+        vk_cache_ = nullptr;
+        stats_ = {};
+        resetBindings();
+    }
+
+    PipelineState PipelineCache::normalize(const PipelineState& state) const
+    {
+        if (!extended_dynamic_state_) return state;
+
+        // These are set on the command buffer, so they must not split the cache
+        PipelineState key = state;
+        const DynamicRasterState defaults{};
+        key.cullMode = defaults.cullMode;
+        key.frontFace = defaults.frontFace;
+        key.depthTest = defaults.depthTest;
+        key.depthWrite = defaults.depthWrite;
+        key.depthCompareOp = defaults.depthCompareOp;
+        return key;
+    }
+
+    size_t PipelineCache::hashState(const PipelineState& state)
+    {
+        size_t seed = 0;
+        hashCombine(seed, state.shaderPath);
+        hashCombine(seed, state.vertexEntry);
+        hashCombine(seed, state.fragmentEntry);
+        hashCombine(seed, reinterpret_cast<uintptr_t>(static_cast<VkPipelineLayout>(state.layout)));
+        hashCombine(seed, state.topology);
+        hashCombine(seed, state.polygonMode);
+        hashCombine(seed, state.cullMode);
+        hashCombine(seed, state.frontFace);
+        hashCombine(seed, state.samples);
+        hashCombine(seed, state.depthBiasConstant);
+        hashCombine(seed, state.depthBiasSlope);
+        hashCombine(seed, state.depthTest);
+        hashCombine(seed, state.depthWrite);
+        hashCombine(seed, state.depthCompareOp);
+        hashCombine(seed, state.blendEnable);
+        hashCombine(seed, state.srcColorBlendFactor);
+        hashCombine(seed, state.dstColorBlendFactor);
+        hashCombine(seed, state.colorBlendOp);
+        hashCombine(seed, state.srcAlphaBlendFactor);
+        hashCombine(seed, state.dstAlphaBlendFactor);
+        hashCombine(seed, state.alphaBlendOp);
+        hashCombine(seed, state.colorWriteMask);
+        hashCombine(seed, state.colorFormat);
+        hashCombine(seed, state.depthFormat);
+        return seed;
+    }
+
+    uint32_t PipelineCache::request(const PipelineState& state)
+    {
+        stats_.requests++;
+
+        PipelineState key = normalize(state);
+        const size_t hash = hashState(key);
+
+        // Full compare on the bucket: hashes only narrow the search
+        auto [first, last] = lookup_.equal_range(hash);
+        for (auto it = first; it != last; ++it)
+        {
+            if (entries_[it->second].key == key)
+            {
+                stats_.hits++;
+                entries_[it->second].requested = true;
+                return it->second;
+            }
+        }
+
+        uint32_t id;
+        if (!free_ids_.empty())
+        {
+            id = free_ids_.back();
+            free_ids_.pop_back();
+            entries_[id] = {key, createPipeline(key), hash, true};
+        }
+        else
+        {
+            id = static_cast<uint32_t>(entries_.size());
+            entries_.push_back({key, createPipeline(key), hash, true});
+        }
+        lookup_.emplace(hash, id);
+        stats_.pipelines++;
+        return id;
+    }
+
+    void PipelineCache::beginRequests()
+    {
+        for (Entry& entry : entries_)
+        {
+            entry.requested = false;
+        }
+    }
+
+    void PipelineCache::evictUnrequested(DeletionQueue& deletionQueue)
+    {
+        for (uint32_t id = 0; id < entries_.size(); ++id)
+        {
+            Entry& entry = entries_[id];
+            if (entry.requested || !*entry.pipeline) continue;
+
+            auto [first, last] = lookup_.equal_range(entry.hash);
+            for (auto it = first; it != last; ++it)
+            {
+                if (it->second != id) continue;
+                lookup_.erase(it);
+                break;
+            }
+            deletionQueue.retireObject(std::move(entry.pipeline));
+            entry.pipeline = nullptr;
+            entry.requested = true;
+            free_ids_.push_back(id);
+            stats_.pipelines--;
+            stats_.evicted++;
+        }
+    }
+
+    const vk::raii::ShaderModule& PipelineCache::shaderModule(const std::string& path)
+    {
+        auto it = shader_modules_.find(path);
+        if (it != shader_modules_.end()) return it->second;
+
+        std::vector<char> code = readSpirv(path);
+        vk::ShaderModuleCreateInfo createInfo{};
+        createInfo.codeSize = code.size() * sizeof(char);
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+        return shader_modules_.emplace(path, vk::raii::ShaderModule(*device_, createInfo)).first->second;
+    }
+
+    vk::raii::Pipeline PipelineCache::createPipeline(const PipelineState& state)
+    {
+        const vk::raii::ShaderModule& module = shaderModule(state.shaderPath);
+
+        vk::PipelineShaderStageCreateInfo vertShaderStageInfo{};
+        vertShaderStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
+        vertShaderStageInfo.module = module;
+        vertShaderStageInfo.pName = state.vertexEntry.c_str();
+
+        vk::PipelineShaderStageCreateInfo fragShaderStageInfo{};
+        fragShaderStageInfo.stage = vk::ShaderStageFlagBits::eFragment;
+        fragShaderStageInfo.module = module;
+        fragShaderStageInfo.pName = state.fragmentEntry.c_str();
+
+        vk::PipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+        auto bindingDescription = Vertex::getBindingDescription();
+        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+        vk::PipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.topology = state.topology;
+
+        vk::PipelineViewportStateCreateInfo viewportState{};
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+
+        vk::PipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.depthClampEnable = vk::False;
+        rasterizer.rasterizerDiscardEnable = vk::False;
+        rasterizer.polygonMode = state.polygonMode;
+        rasterizer.cullMode = state.cullMode;
+        rasterizer.frontFace = state.frontFace;
+        rasterizer.depthBiasEnable = state.depthBiasConstant != 0.0f || state.depthBiasSlope != 0.0f;
+        rasterizer.depthBiasConstantFactor = state.depthBiasConstant;
+        rasterizer.depthBiasSlopeFactor = state.depthBiasSlope;
+        rasterizer.lineWidth = 1.0f;
+
+        vk::PipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.rasterizationSamples = state.samples;
+        multisampling.sampleShadingEnable = vk::False;
+
+        vk::PipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.depthTestEnable = state.depthTest;
+        depthStencil.depthWriteEnable = state.depthWrite;
+        depthStencil.depthCompareOp = state.depthCompareOp;
+        depthStencil.depthBoundsTestEnable = vk::False;
+        depthStencil.stencilTestEnable = vk::False;
+
+        vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.blendEnable = state.blendEnable;
+        colorBlendAttachment.srcColorBlendFactor = state.srcColorBlendFactor;
+        colorBlendAttachment.dstColorBlendFactor = state.dstColorBlendFactor;
+        colorBlendAttachment.colorBlendOp = state.colorBlendOp;
+        colorBlendAttachment.srcAlphaBlendFactor = state.srcAlphaBlendFactor;
+        colorBlendAttachment.dstAlphaBlendFactor = state.dstAlphaBlendFactor;
+        colorBlendAttachment.alphaBlendOp = state.alphaBlendOp;
+        colorBlendAttachment.colorWriteMask = state.colorWriteMask;
+
+        vk::PipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.logicOpEnable = vk::False;
+        colorBlending.logicOp = vk::LogicOp::eCopy;
+        // Depth-only pipelines have no color attachment
+        const bool hasColor = state.colorFormat != vk::Format::eUndefined;
+        colorBlending.attachmentCount = hasColor ? 1 : 0;
+        colorBlending.pAttachments = &colorBlendAttachment;
+
+        std::array<vk::DynamicState, 7> dynamicStates = {
+            vk::DynamicState::eViewport,
+            vk::DynamicState::eScissor,
+            vk::DynamicState::eCullMode,
+            vk::DynamicState::eFrontFace,
+            vk::DynamicState::eDepthTestEnable,
+            vk::DynamicState::eDepthWriteEnable,
+            vk::DynamicState::eDepthCompareOp
+        };
+        vk::PipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.dynamicStateCount = extended_dynamic_state_ ? static_cast<uint32_t>(dynamicStates.size()) : 2;
+        dynamicState.pDynamicStates = dynamicStates.data();
+
+        vk::PipelineRenderingCreateInfo pipelineRenderingCreateInfo{};
+        pipelineRenderingCreateInfo.colorAttachmentCount = hasColor ? 1 : 0;
+        pipelineRenderingCreateInfo.pColorAttachmentFormats = &state.colorFormat;
+        pipelineRenderingCreateInfo.depthAttachmentFormat = state.depthFormat;
+
+        vk::GraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.pNext = &pipelineRenderingCreateInfo;
+        // Without a fragment entry only depth is written
+        pipelineInfo.stageCount = state.fragmentEntry.empty() ? 1 : 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = state.layout;
+        pipelineInfo.renderPass = nullptr;
+
+        return vk::raii::Pipeline(*device_, vk_cache_, pipelineInfo);
+    }
+
+    void PipelineCache::resetBindings()
+    {
+        bound_pipeline_ = nullptr;
+        dynamic_valid_ = false;
+        binds_ = 0;
+    }
+
+    void PipelineCache::bind(const vk::raii::CommandBuffer& commandBuffer, uint32_t pipeline,
+                             const PipelineState& state)
+    {
+        bind(commandBuffer, get(pipeline), dynamicRasterStateOf(state));
+    }
+
+    void PipelineCache::bind(const vk::raii::CommandBuffer& commandBuffer, vk::Pipeline pipeline,
+                             const DynamicRasterState& wanted)
+    {
+        if (pipeline != bound_pipeline_)
+        {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+            bound_pipeline_ = pipeline;
+            binds_++;
+        }
+
+        if (!extended_dynamic_state_) return;
+
+        if (dynamic_valid_ && wanted == bound_dynamic_) return;
+
+        if (!dynamic_valid_ || wanted.cullMode != bound_dynamic_.cullMode)
+            commandBuffer.setCullMode(wanted.cullMode);
+        if (!dynamic_valid_ || wanted.frontFace != bound_dynamic_.frontFace)
+            commandBuffer.setFrontFace(wanted.frontFace);
+        if (!dynamic_valid_ || wanted.depthTest != bound_dynamic_.depthTest)
+            commandBuffer.setDepthTestEnable(wanted.depthTest);
+        if (!dynamic_valid_ || wanted.depthWrite != bound_dynamic_.depthWrite)
+            commandBuffer.setDepthWriteEnable(wanted.depthWrite);
+        if (!dynamic_valid_ || wanted.depthCompareOp != bound_dynamic_.depthCompareOp)
+            commandBuffer.setDepthCompareOp(wanted.depthCompareOp);
+
+        bound_dynamic_ = wanted;
+        dynamic_valid_ = true;
+    }
+}
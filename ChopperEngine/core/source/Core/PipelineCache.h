@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+#include "DeletionQueue.h"
+#include "Material.h"
+
+namespace Chopper
+{
+    // Creates graphics pipelines on demand, keyed by a hash of the full PipelineState.
+    // When extended dynamic state is available, cull mode, front face and the depth test
+    // state are left dynamic and excluded from the key, so materials that only differ
+    // there collapse onto one pipeline.
+    //
+    // Pipelines nobody asks for any more (an old swapchain format or sample count) are dropped by
+    // wrapping a full round of requests in beginRequests() and evictUnrequested().
+    class PipelineCache
+    {
+    public:
+        struct Stats
+        {
+            uint32_t requests = 0;
+            uint32_t hits = 0;
+            uint32_t pipelines = 0;
+            uint32_t evicted = 0;
+        };
+
+        void init(const vk::raii::Device& device, bool extendedDynamicState);
+        void clear();
+
+        // Returns the id of a pipeline matching `state`, creating it if needed.
+        uint32_t request(const PipelineState& state);
+
+        // Starts a round in which every pipeline still in use is requested again
+        void beginRequests();
+        // Retires the pipelines not requested since beginRequests() through `deletionQueue`, as
+        // frames in flight may still bind them; their ids are handed out again. Only call it while
+        // no recorded or pending frame can resolve those ids.
+        void evictUnrequested(DeletionQueue& deletionQueue);
+
+        vk::Pipeline get(uint32_t id) const { return *entries_[id].pipeline; }
+        bool usesDynamicState() const { return extended_dynamic_state_; }
+        const Stats& stats() const { return stats_; }
+
+        // Binds `pipeline` and the material's dynamic raster state, skipping whatever is
+        // already bound on the command buffer. Call resetBindings() at the start of each
+        // command buffer.
+        void bind(const vk::raii::CommandBuffer& commandBuffer, uint32_t pipeline, const PipelineState& state);
+        // Same, for a pipeline resolved with get() beforehand. Touches only the binding state, so
+        // a render thread can bind while another thread requests pipelines.
+        void bind(const vk::raii::CommandBuffer& commandBuffer, vk::Pipeline pipeline,
+                  const DynamicRasterState& dynamic);
+        void resetBindings();
+        uint32_t bindsThisFrame() const { return binds_; }
+
+    private:
+        struct Entry
+        {
+            PipelineState key;
+            vk::raii::Pipeline pipeline = nullptr;
+            size_t hash = 0;
+            bool requested = true;
+        };
+
+        PipelineState normalize(const PipelineState& state) const;
+        static size_t hashState(const PipelineState& state);
+        vk::raii::Pipeline createPipeline(const PipelineState& state);
+        const vk::raii::ShaderModule& shaderModule(const std::string& path);
+
+        const vk::raii::Device* device_ = nullptr;
+        bool extended_dynamic_state_ = false;
+
+        vk::raii::PipelineCache vk_cache_ = nullptr;
+        std::unordered_map<std::string, vk::raii::ShaderModule> shader_modules_;
+        std::unordered_multimap<size_t, uint32_t> lookup_;
+        std::vector<Entry> entries_;
+        // Ids of evicted entries, reused by request()
+        std::vector<uint32_t> free_ids_;
+
+        vk::Pipeline bound_pipeline_ = nullptr;
+        DynamicRasterState bound_dynamic_{};
+        bool dynamic_valid_ = false;
+        uint32_t binds_ = 0;
+
+        Stats stats_{};
+    };
+}
@@ -0,0 +1,69 @@
+#include "PoolAllocator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Chopper
+{
+    namespace
+    {
+        size_t alignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    PoolAllocator::PoolAllocator(size_t blockSize, size_t alignment, size_t blocksPerChunk)
+        : alignment_(std::max(alignment, alignof(FreeBlock))),
+          block_size_(alignUp(std::max(blockSize, sizeof(FreeBlock)), alignment_)),
+          blocks_per_chunk_(std::max<size_t>(1, blocksPerChunk))
+    {
+    }
+
+    void* PoolAllocator::allocate()
+    {
+        std::lock_guard lock(mutex_);
+        if (free_ == nullptr) grow();
+        FreeBlock* block = free_;
+        free_ = block->next;
+        ++live_;
+        return block;
+    }
+
+    void PoolAllocator::deallocate(void* block)
+    {
+        std::lock_guard lock(mutex_);
+        auto* freed = static_cast<FreeBlock*>(block);
+        freed->next = free_;
+        free_ = freed;
+        --live_;
+    }
+
+    size_t PoolAllocator::liveBlocks() const
+    {
+        std::lock_guard lock(mutex_);
+        return live_;
+    }
+
+    size_t PoolAllocator::totalBlocks() const
+    {
+        std::lock_guard lock(mutex_);
+        return chunks_.size() * blocks_per_chunk_;
+    }
+
+    void PoolAllocator::grow()
+    {
+        // Padded so the first block can be aligned beyond what new[] guarantees
+        chunks_.push_back(std::unique_ptr<std::byte[]>(new std::byte[block_size_ * blocks_per_chunk_ + alignment_]));
+        const auto base = reinterpret_cast<uintptr_t>(chunks_.back().get());
+        std::byte* first = chunks_.back().get() + (alignUp(base, alignment_) - base);
+
+        // Linked back to front, so blocks are handed out in address order
+        for (size_t i = blocks_per_chunk_; i-- > 0;)
+        {
+            auto* block = reinterpret_cast<FreeBlock*>(first + i * block_size_);
+            block->next = free_;
+            free_ = block;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace Chopper
+{
+    // Fixed-size blocks carved from chunks and recycled through a free list. Blocks are never
+    // returned to the heap before the pool is destroyed, so once the pool has grown to the
+    // peak number of live blocks it stops allocating. Thread-safe.
+    class PoolAllocator
+    {
+    public:
+        PoolAllocator(size_t blockSize, size_t alignment, size_t blocksPerChunk = 256);
+        PoolAllocator(const PoolAllocator&) = delete;
+        PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+        void* allocate();
+        // `block` must come from this pool's allocate()
+        void deallocate(void* block);
+
+        size_t blockSize() const { return block_size_; }
+        // Blocks handed out and not yet returned, and blocks carved so far
+        size_t liveBlocks() const;
+        size_t totalBlocks() const;
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+
+        void grow();
+
+        const size_t alignment_;
+        const size_t block_size_;
+        const size_t blocks_per_chunk_;
+
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<std::byte[]>> chunks_;
+        FreeBlock* free_ = nullptr;
+        size_t live_ = 0;
+    };
+
+    // PoolAllocator that constructs and destroys objects of one type
+    template <typename T>
+    class ObjectPool
+    {
+    public:
+        explicit ObjectPool(size_t objectsPerChunk = 256)
+            : pool_(sizeof(T), alignof(T), objectsPerChunk)
+        {
+        }
+
+        template <typename... Args>
+        T* create(Args&&... args)
+        {
+            void* block = pool_.allocate();
+            try
+            {
+                return ::new(block) T{std::forward<Args>(args)...};
+            }
+            catch (...)
+            {
+                pool_.deallocate(block);
+                throw;
+            }
+        }
+
+        void destroy(T* object)
+        {
+            object->~T();
+            pool_.deallocate(object);
+        }
+
+        size_t liveObjects() const { return pool_.liveBlocks(); }
+
+    private:
+        PoolAllocator pool_;
+    };
+}
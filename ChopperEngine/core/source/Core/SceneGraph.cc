@@ -0,0 +1,372 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "Parallel.h"
+#include "TransformKernel.h"
+
+namespace Chopper
+{
+    namespace
+    {
+        constexpr uint32_t NO_PARENT = ~0u;
+        constexpr uint32_t NO_INDEX = ~0u;
+
+        // World matrix updates are a single mat4 multiply each, so batches must be large
+        // before handing them to other threads pays off
+        constexpr size_t WORLD_BATCH = 1024;
+
+        template <typename T>
+        void permute(std::vector<T>& values, const std::vector<uint32_t>& order)
+        {
+            std::vector<T> permuted(order.size());
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                permuted[i] = values[order[i]];
+            }
+            values.swap(permuted);
+        }
+    }
+
+    NodeId SceneGraph::create(NodeId parent, const glm::vec3& position, const glm::vec3& rotation,
+                              const glm::vec3& scale)
+    {
+        NodeId id;
+        if (!free_ids_.empty())
+        {
+            id = free_ids_.back();
+            free_ids_.pop_back();
+        }
+        else
+        {
+            id = static_cast<NodeId>(index_of_.size());
+            index_of_.push_back(NO_INDEX);
+        }
+
+        // Appended out of order; rebuildOrder() moves it into its level
+        const uint32_t parentIndex = parent == INVALID_NODE ? NO_PARENT : index_of_[parent];
+        const auto index = static_cast<uint32_t>(parents_.size());
+        parents_.push_back(parentIndex);
+        first_child_.push_back(0);
+        child_count_.push_back(0);
+        depths_.push_back(parentIndex == NO_PARENT ? 0 : depths_[parentIndex] + 1);
+        positions_.push_back(position);
+        rotations_.push_back(rotation);
+        scales_.push_back(scale);
+        locals_.emplace_back(1.0f);
+        worlds_.emplace_back(1.0f);
+        local_dirty_.push_back(0);
+        alive_.push_back(1);
+        stamps_.push_back(0);
+        id_of_.push_back(id);
+
+        index_of_[id] = index;
+        markDirty(index);
+        order_dirty_ = true;
+        ++alive_count_;
+        return id;
+    }
+
+    void SceneGraph::destroy(NodeId node)
+    {
+        // Child ranges are only valid in breadth-first order
+        if (order_dirty_) rebuildOrder();
+
+        const uint32_t index = index_of_[node];
+        const uint32_t parentIndex = parents_[index];
+        for (uint32_t child = first_child_[index]; child < first_child_[index] + child_count_[index]; ++child)
+        {
+            parents_[child] = parentIndex;
+            markDirty(child);
+        }
+
+        alive_[index] = 0;
+        order_dirty_ = true;
+        --alive_count_;
+    }
+
+    void SceneGraph::setParent(NodeId node, NodeId parent)
+    {
+        const uint32_t index = index_of_[node];
+        const uint32_t parentIndex = parent == INVALID_NODE ? NO_PARENT : index_of_[parent];
+        for (uint32_t ancestor = parentIndex; ancestor != NO_PARENT; ancestor = parents_[ancestor])
+        {
+            if (ancestor == index)
+            {
+                throw std::runtime_error("scene graph node cannot be parented to itself or its descendant");
+            }
+        }
+
+        parents_[index] = parentIndex;
+        markDirty(index);
+        order_dirty_ = true;
+    }
+
+    NodeId SceneGraph::parent(NodeId node) const
+    {
+        const uint32_t parentIndex = parents_[index_of_[node]];
+        return parentIndex == NO_PARENT ? INVALID_NODE : id_of_[parentIndex];
+    }
+
+    void SceneGraph::setLocal(NodeId node, const glm::vec3& position, const glm::vec3& rotation,
+                              const glm::vec3& scale)
+    {
+        const uint32_t index = index_of_[node];
+        positions_[index] = position;
+        rotations_[index] = rotation;
+        scales_[index] = scale;
+        markDirty(index);
+    }
+
+    void SceneGraph::setPosition(NodeId node, const glm::vec3& position)
+    {
+        const uint32_t index = index_of_[node];
+        positions_[index] = position;
+        markDirty(index);
+    }
+
+    void SceneGraph::setRotation(NodeId node, const glm::vec3& rotation)
+    {
+        const uint32_t index = index_of_[node];
+        rotations_[index] = rotation;
+        markDirty(index);
+    }
+
+    void SceneGraph::setScale(NodeId node, const glm::vec3& scale)
+    {
+        const uint32_t index = index_of_[node];
+        scales_[index] = scale;
+        markDirty(index);
+    }
+
+    void SceneGraph::markDirty(uint32_t index)
+    {
+        if (local_dirty_[index]) return;
+        local_dirty_[index] = 1;
+        dirty_.push_back(id_of_[index]);
+    }
+
+    void SceneGraph::update()
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        if (order_dirty_) rebuildOrder();
+
+        changed_.clear();
+        stats_.localUpdates = 0;
+        stats_.worldUpdates = 0;
+        if (!dirty_.empty())
+        {
+            updateLocals();
+            updateWorlds();
+            dirty_.clear();
+        }
+
+        stats_.nodes = static_cast<uint32_t>(alive_count_);
+        stats_.levels = level_start_.empty() ? 0 : static_cast<uint32_t>(level_start_.size() - 1);
+        stats_.milliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void SceneGraph::rebuildOrder()
+    {
+        const size_t count = parents_.size();
+
+        // Children of every live node, grouped by parent
+        std::vector<uint32_t> childOffsets(count + 1, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (alive_[i] && parents_[i] != NO_PARENT) ++childOffsets[parents_[i] + 1];
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            childOffsets[i + 1] += childOffsets[i];
+        }
+        std::vector<uint32_t> children(childOffsets[count]);
+        std::vector<uint32_t> cursor(childOffsets.begin(), childOffsets.end() - 1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (alive_[i] && parents_[i] != NO_PARENT) children[cursor[parents_[i]]++] = static_cast<uint32_t>(i);
+        }
+
+        // Breadth-first walk from the roots: levels come out contiguous and each node's
+        // children contiguous within the next level
+        std::vector<uint32_t> order;
+        order.reserve(alive_count_);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (alive_[i] && parents_[i] == NO_PARENT) order.push_back(static_cast<uint32_t>(i));
+        }
+        const auto rootCount = static_cast<uint32_t>(order.size());
+        for (size_t head = 0; head < order.size(); ++head)
+        {
+            const uint32_t node = order[head];
+            order.insert(order.end(), children.begin() + childOffsets[node], children.begin() + childOffsets[node + 1]);
+        }
+
+        std::vector<uint32_t> newIndex(count, NO_INDEX);
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            newIndex[order[i]] = static_cast<uint32_t>(i);
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (newIndex[i] != NO_INDEX) continue;
+            index_of_[id_of_[i]] = NO_INDEX;
+            free_ids_.push_back(id_of_[i]);
+        }
+
+        std::vector<uint32_t> oldParents = std::move(parents_);
+        parents_.resize(order.size());
+        first_child_.resize(order.size());
+        child_count_.resize(order.size());
+        depths_.resize(order.size());
+        uint32_t nextChild = rootCount;
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            const uint32_t old = order[i];
+            const uint32_t parentIndex = oldParents[old] == NO_PARENT ? NO_PARENT : newIndex[oldParents[old]];
+            parents_[i] = parentIndex;
+            depths_[i] = parentIndex == NO_PARENT ? 0 : depths_[parentIndex] + 1;
+            first_child_[i] = nextChild;
+            child_count_[i] = childOffsets[old + 1] - childOffsets[old];
+            nextChild += child_count_[i];
+        }
+
+        permute(positions_, order);
+        permute(rotations_, order);
+        permute(scales_, order);
+        permute(locals_, order);
+        permute(worlds_, order);
+        permute(local_dirty_, order);
+        permute(stamps_, order);
+        permute(id_of_, order);
+        alive_.assign(order.size(), 1);
+
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            index_of_[id_of_[i]] = static_cast<uint32_t>(i);
+        }
+
+        level_start_.clear();
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            while (level_start_.size() <= depths_[i]) level_start_.push_back(static_cast<uint32_t>(i));
+        }
+        level_start_.push_back(static_cast<uint32_t>(order.size()));
+
+        order_dirty_ = false;
+    }
+
+    void SceneGraph::updateLocals()
+    {
+        gather_indices_.clear();
+        for (const NodeId id : dirty_)
+        {
+            const uint32_t index = index_of_[id];
+            if (index != NO_INDEX) gather_indices_.push_back(index);
+        }
+
+        const size_t count = gather_indices_.size();
+
+        // Mostly dirty: recompose everything in place rather than gather and scatter
+        if (count * 2 >= positions_.size())
+        {
+            composeTransformsParallel(positions_.data(), rotations_.data(), scales_.data(), positions_.size(),
+                                      locals_.data());
+            stats_.localUpdates = static_cast<uint32_t>(positions_.size());
+            return;
+        }
+
+        gather_positions_.resize(count);
+        gather_rotations_.resize(count);
+        gather_scales_.resize(count);
+        gather_locals_.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t index = gather_indices_[i];
+            gather_positions_[i] = positions_[index];
+            gather_rotations_[i] = rotations_[index];
+            gather_scales_[i] = scales_[index];
+        }
+
+        composeTransformsParallel(gather_positions_.data(), gather_rotations_.data(), gather_scales_.data(),
+                                  count, gather_locals_.data());
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            locals_[gather_indices_[i]] = gather_locals_[i];
+        }
+        stats_.localUpdates = static_cast<uint32_t>(count);
+    }
+
+    void SceneGraph::updateWorlds()
+    {
+        if (++stamp_ == 0)
+        {
+            std::fill(stamps_.begin(), stamps_.end(), 0u);
+            stamp_ = 1;
+        }
+
+        const size_t levels = level_start_.size() - 1;
+        level_work_.resize(levels);
+        for (auto& work : level_work_)
+        {
+            work.clear();
+        }
+        for (const uint32_t index : gather_indices_)
+        {
+            level_work_[depths_[index]].push_back(index);
+        }
+
+        for (size_t level = 0; level < levels; ++level)
+        {
+            // A dirty node may also be a child of an updated node; process it once
+            auto& work = level_work_[level];
+            size_t unique = 0;
+            for (const uint32_t index : work)
+            {
+                if (stamps_[index] == stamp_) continue;
+                stamps_[index] = stamp_;
+                work[unique++] = index;
+            }
+            work.resize(unique);
+
+            // Nodes of one level only read their parents' finished world matrices
+            parallelFor(work.size(), WORLD_BATCH, [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const uint32_t index = work[i];
+                    const uint32_t parentIndex = parents_[index];
+                    worlds_[index] = parentIndex == NO_PARENT ? locals_[index] : worlds_[parentIndex] * locals_[index];
+                }
+            });
+
+            if (level + 1 < levels)
+            {
+                auto& next = level_work_[level + 1];
+                for (const uint32_t index : work)
+                {
+                    for (uint32_t child = first_child_[index]; child < first_child_[index] + child_count_[index]; ++child)
+                    {
+                        next.push_back(child);
+                    }
+                }
+            }
+
+            for (const uint32_t index : work)
+            {
+                changed_.push_back(id_of_[index]);
+            }
+            stats_.worldUpdates += static_cast<uint32_t>(work.size());
+        }
+
+        for (const uint32_t index : gather_indices_)
+        {
+            local_dirty_[index] = 0;
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+namespace Chopper
+{
+    using NodeId = uint32_t;
+    constexpr NodeId INVALID_NODE = ~0u;
+
+    // Transform hierarchy. Nodes are stored breadth-first as structure of arrays, so every
+    // level is a contiguous range and a node's children are contiguous in the next level.
+    // Only nodes whose local transform changed, and their descendants, get their matrices
+    // recomputed by update(); a static scene costs nothing per frame.
+    //
+    // NodeIds are stable handles. Topology changes (create, destroy, setParent) are applied
+    // lazily: the breadth-first order is rebuilt on the next update().
+    class SceneGraph
+    {
+    public:
+        struct Stats
+        {
+            uint32_t nodes = 0;
+            uint32_t levels = 0;
+            uint32_t localUpdates = 0;
+            uint32_t worldUpdates = 0;
+            double milliseconds = 0.0;
+        };
+
+        NodeId create(NodeId parent = INVALID_NODE, const glm::vec3& position = glm::vec3(0.0f),
+                      const glm::vec3& rotation = glm::vec3(0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+        // Removes the node; its children are reattached to its parent, keeping their local transforms
+        void destroy(NodeId node);
+
+        void setParent(NodeId node, NodeId parent);
+        NodeId parent(NodeId node) const;
+
+        void setLocal(NodeId node, const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale);
+        void setPosition(NodeId node, const glm::vec3& position);
+        void setRotation(NodeId node, const glm::vec3& rotation);
+        void setScale(NodeId node, const glm::vec3& scale);
+
+        const glm::vec3& position(NodeId node) const { return positions_[index_of_[node]]; }
+        const glm::vec3& rotation(NodeId node) const { return rotations_[index_of_[node]]; }
+        const glm::vec3& scale(NodeId node) const { return scales_[index_of_[node]]; }
+        const glm::mat4& localMatrix(NodeId node) const { return locals_[index_of_[node]]; }
+        const glm::mat4& worldMatrix(NodeId node) const { return worlds_[index_of_[node]]; }
+
+        // Recomputes local and world matrices of dirty nodes and their descendants
+        void update();
+
+        // Nodes whose world matrix was recomputed by the last update()
+        const std::vector<NodeId>& changed() const { return changed_; }
+
+        size_t size() const { return alive_count_; }
+        const Stats& stats() const { return stats_; }
+
+    private:
+        void markDirty(uint32_t index);
+        void rebuildOrder();
+        void updateLocals();
+        void updateWorlds();
+
+        // Per node, in breadth-first order once rebuilt
+        std::vector<uint32_t> parents_;
+        std::vector<uint32_t> first_child_;
+        std::vector<uint32_t> child_count_;
+        std::vector<uint32_t> depths_;
+        std::vector<glm::vec3> positions_;
+        std::vector<glm::vec3> rotations_;
+        std::vector<glm::vec3> scales_;
+        std::vector<glm::mat4> locals_;
+        std::vector<glm::mat4> worlds_;
+        std::vector<uint8_t> local_dirty_;
+        std::vector<uint8_t> alive_;
+        std::vector<uint32_t> stamps_;
+        std::vector<NodeId> id_of_;
+
+        // Per NodeId
+        std::vector<uint32_t> index_of_;
+        std::vector<NodeId> free_ids_;
+
+        std::vector<uint32_t> level_start_;
+        std::vector<NodeId> dirty_;
+        std::vector<NodeId> changed_;
+        bool order_dirty_ = false;
+        size_t alive_count_ = 0;
+        uint32_t stamp_ = 0;
+
+        // Scratch buffers reused across updates
+        std::vector<uint32_t> gather_indices_;
+        std::vector<glm::vec3> gather_positions_;
+        std::vector<glm::vec3> gather_rotations_;
+        std::vector<glm::vec3> gather_scales_;
+        std::vector<glm::mat4> gather_locals_;
+        std::vector<std::vector<uint32_t>> level_work_;
+
+        Stats stats_{};
+    };
+}
@@ -0,0 +1,81 @@
+#include "ShadowCascadeFitter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace Chopper
+{
+    namespace
+    {
+        // Blend between logarithmic (1) and uniform (0) split spacing
+        constexpr float SPLIT_LAMBDA = 0.75f;
+        // How far towards the sun a cascade's box reaches past its slice, so casters outside the
+        // view still shadow what is in it
+        constexpr float CASTER_REACH = 64.0f;
+    }
+
+    void ShadowCascadeFitter::fit(const glm::mat4& view, const glm::mat4& proj, float nearPlane,
+                                  const glm::vec3& toSun, float shadowDistance, uint64_t staticVersion,
+                                  std::array<ShadowCascade, SHADOW_CASCADES>& cascades)
+    {
+        // A view-space point at distance d along the axis, at the frustum's corner, lies
+        // d * sqrt(k2) off the axis
+        const float k2 = 1.0f / (proj[0][0] * proj[0][0]) + 1.0f / (proj[1][1] * proj[1][1]);
+        const glm::mat4 cameraToWorld = glm::inverse(view);
+        const glm::vec3 up = std::abs(toSun.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        // Rotation only: cascades are placed by their projection, so light space stays the same
+        // as the camera moves
+        const glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), -toSun, up);
+        const float farPlane = std::max(shadowDistance, 2.0f * nearPlane);
+        const float scrollFraction = static_cast<float>(SCROLL_TEXELS) / SHADOW_MAP_SIZE;
+
+        float splitNear = nearPlane;
+        for (uint32_t i = 0; i < SHADOW_CASCADES; ++i)
+        {
+            const float t = static_cast<float>(i + 1) / SHADOW_CASCADES;
+            const float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+            const float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+            const float splitFar = SPLIT_LAMBDA * logSplit + (1.0f - SPLIT_LAMBDA) * uniformSplit;
+
+            // Smallest sphere around the slice: its centre sits on the view axis, as far as the
+            // far corners allow
+            const float centerDistance = std::min(splitFar, 0.5f * (splitFar + splitNear) * (1.0f + k2));
+            const float farRadius = std::sqrt(splitFar * splitFar * k2 +
+                (splitFar - centerDistance) * (splitFar - centerDistance));
+            const float nearRadius = std::sqrt(splitNear * splitNear * k2 +
+                (centerDistance - splitNear) * (centerDistance - splitNear));
+            // Rounded up so float noise never changes the cascade's size
+            const float radius = std::ceil(std::max(farRadius, nearRadius) * 16.0f) / 16.0f;
+
+            // The box holds the sphere wherever it sits within half a scroll step of the box's centre
+            const float halfSize = radius / (1.0f - scrollFraction);
+            const float texel = 2.0f * halfSize / SHADOW_MAP_SIZE;
+            const float step = texel * SCROLL_TEXELS;
+
+            const glm::vec3 center = glm::vec3(lightView * (cameraToWorld * glm::vec4(0.0f, 0.0f, -centerDistance,
+                                                                                     1.0f)));
+            const glm::ivec3 origin = glm::ivec3(glm::round(center / step));
+            const glm::vec3 snapped = glm::vec3(origin) * step;
+
+            // The light looks down -z: casters between the sun and the slice have larger z
+            const glm::mat4 lightProj = glm::ortho(snapped.x - halfSize, snapped.x + halfSize,
+                                                   snapped.y - halfSize, snapped.y + halfSize,
+                                                   -(snapped.z + halfSize + CASTER_REACH),
+                                                   -(snapped.z - halfSize));
+
+            ShadowCascade& cascade = cascades[i];
+            cascade.viewProj = lightProj * lightView;
+            cascade.planes = extractFrustumPlanes(cascade.viewProj);
+            cascade.splitFar = splitFar;
+            cascade.texelSize = texel;
+
+            const PageKey key{origin, halfSize, toSun, staticVersion};
+            cascade.redrawStatic = !fitted_ || key != keys_[i];
+            keys_[i] = key;
+            splitNear = splitFar;
+        }
+        fitted_ = true;
+    }
+}
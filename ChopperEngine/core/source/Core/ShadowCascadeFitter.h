@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "FrustumCulling.h"
+
+namespace Chopper
+{
+    static constexpr uint32_t SHADOW_CASCADES = 4;
+    // Width and height of a cascade's shadow map, in texels
+    static constexpr uint32_t SHADOW_MAP_SIZE = 2048;
+
+    // One cascade of the sun's shadow, as fitted by ShadowCascadeFitter
+    struct ShadowCascade
+    {
+        // World to the cascade's shadow map, standard depth
+        glm::mat4 viewProj{1.0f};
+        // viewProj's planes, to cull the cascade's casters
+        FrustumPlanes planes{};
+        // View distance where the cascade ends
+        float splitFar = 0.0f;
+        // World-space size of one shadow map texel
+        float texelSize = 0.0f;
+        // viewProj moved (the cascade scrolled, the sun turned) or the static casters changed, so the
+        // cascade's static page must be drawn again
+        bool redrawStatic = false;
+    };
+
+    // Fits SHADOW_CASCADES cascades to the camera's frustum, split between the near plane and the
+    // shadow distance on a blend of logarithmic and uniform spacing. Each cascade is an orthographic
+    // box around its slice's bounding sphere, so its size does not change as the camera turns, and
+    // is centred on a grid of whole texels in light space, so the shadow map does not shimmer as
+    // the camera moves. The grid is coarse (SCROLL_TEXELS) and the box is that much wider than the
+    // sphere: a cascade only scrolls once the camera has moved a good fraction of its width, and
+    // only then is its static page redrawn.
+    class ShadowCascadeFitter
+    {
+    public:
+        // Cascades scroll in steps of this many texels
+        static constexpr uint32_t SCROLL_TEXELS = 128;
+
+        // `nearPlane` is the camera's, `toSun` is a unit vector; `staticVersion` changes whenever the
+        // static casters do
+        void fit(const glm::mat4& view, const glm::mat4& proj, float nearPlane, const glm::vec3& toSun,
+                 float shadowDistance, uint64_t staticVersion, std::array<ShadowCascade, SHADOW_CASCADES>& cascades);
+
+    private:
+        // Everything a cascade's viewProj and static page depend on
+        struct PageKey
+        {
+            glm::ivec3 origin{0};
+            float halfSize = 0.0f;
+            glm::vec3 toSun{0.0f};
+            uint64_t staticVersion = 0;
+
+            bool operator==(const PageKey& other) const = default;
+        };
+
+        std::array<PageKey, SHADOW_CASCADES> keys_{};
+        bool fitted_ = false;
+    };
+}
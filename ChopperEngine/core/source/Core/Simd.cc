@@ -0,0 +1,62 @@
+#include "Simd.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Chopper::Simd
+{
+    namespace
+    {
+        Level detectLevel()
+        {
+#if defined(CHOPPER_SIMD_SSE2)
+#if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] >= 7)
+            {
+                __cpuidex(info, 7, 0);
+                const bool avx2 = (info[1] & (1 << 5)) != 0;
+                __cpuid(info, 1);
+                const bool fma = (info[2] & (1 << 12)) != 0;
+                const bool osxsave = (info[2] & (1 << 27)) != 0;
+                // The OS must also save the upper halves of the YMM registers
+                if (avx2 && fma && osxsave && (_xgetbv(0) & 0x6) == 0x6) return Level::AVX2;
+            }
+#else
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Level::AVX2;
+#endif
+            return Level::SSE2;
+#else
+            return Level::Scalar;
+#endif
+        }
+
+        const Level supported = detectLevel();
+        Level active = supported;
+    }
+
+    Level level()
+    {
+        return active;
+    }
+
+    void setLevel(Level level)
+    {
+        active = std::min(level, supported);
+    }
+
+    const char* levelName(Level level)
+    {
+        switch (level)
+        {
+        case Level::AVX2: return "AVX2";
+        case Level::SSE2: return "SSE2";
+        default: return "Scalar";
+        }
+    }
+}
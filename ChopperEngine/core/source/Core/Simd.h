@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+// SIMD support. SSE2 is the x64 baseline and is always compiled in; AVX2 kernels live in
+// *_avx2.cc translation units built with AVX2 code generation (see Build-Core.lua) and are
+// only called when the running CPU supports them.
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHOPPER_SIMD_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace Chopper::Simd
+{
+    enum class Level : uint8_t
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // Highest level supported by both the build and the CPU, unless lowered by setLevel()
+    Level level();
+
+    // Lowers (or restores) the level used by batched kernels, e.g. to compare code paths.
+    // Requests above what the CPU supports are clamped.
+    void setLevel(Level level);
+
+    const char* levelName(Level level);
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "Simd.h"
+
+// Width-generic math for batched kernels. The same kernel template can be instantiated for
+// float (scalar fallback and tails), __m128 (SSE2) and, in AVX2 translation units, __m256.
+// Everything lives in an anonymous namespace so the SSE2 and AVX2 translation units never
+// share (and the linker never merges) differently compiled copies.
+namespace Chopper::Simd
+{
+    namespace
+    {
+        template <typename V>
+        V splat(float value);
+
+        // ---------------------------------------------------------------- scalar
+
+        template <>
+        inline float splat<float>(float value) { return value; }
+
+        inline float add(float a, float b) { return a + b; }
+        inline float sub(float a, float b) { return a - b; }
+        inline float mul(float a, float b) { return a * b; }
+        inline float madd(float a, float b, float c) { return a * b + c; }
+        inline float min(float a, float b) { return a < b ? a : b; }
+        inline float max(float a, float b) { return a > b ? a : b; }
+
+        inline void sincos(float x, float& s, float& c)
+        {
+            s = std::sin(x);
+            c = std::cos(x);
+        }
+
+#if defined(CHOPPER_SIMD_SSE2)
+        // ---------------------------------------------------------------- SSE2
+
+        template <>
+        inline __m128 splat<__m128>(float value) { return _mm_set1_ps(value); }
+
+        inline __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+        inline __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+        inline __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+        inline __m128 madd(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        inline __m128 min(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+        inline __m128 max(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+
+        // Cephes-style sin/cos with octant range reduction; accurate to a few ulp for
+        // |x| < 8192, which comfortably covers rotation angles.
+        inline void sincos(__m128 x, __m128& s, __m128& c)
+        {
+            const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+            __m128 signSin = _mm_and_ps(x, signMask);
+            x = _mm_andnot_ps(signMask, x);
+
+            __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f))); // 4 / pi
+            j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+            const __m128 y = _mm_cvtepi32_ps(j);
+
+            const __m128 swapSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+            const __m128 polyMask = _mm_castsi128_ps(
+                _mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+            const __m128 signCos = _mm_castsi128_ps(
+                _mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+            signSin = _mm_xor_ps(signSin, swapSin);
+
+            x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+            x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+            x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+            const __m128 z = _mm_mul_ps(x, x);
+
+            __m128 cosPoly = madd(_mm_set1_ps(2.443315711809948e-5f), z, _mm_set1_ps(-1.388731625493765e-3f));
+            cosPoly = madd(cosPoly, z, _mm_set1_ps(4.166664568298827e-2f));
+            cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+            cosPoly = _mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+            cosPoly = _mm_add_ps(cosPoly, _mm_set1_ps(1.0f));
+
+            __m128 sinPoly = madd(_mm_set1_ps(-1.9515295891e-4f), z, _mm_set1_ps(8.3321608736e-3f));
+            sinPoly = madd(sinPoly, z, _mm_set1_ps(-1.6666654611e-1f));
+            sinPoly = madd(_mm_mul_ps(sinPoly, z), x, x);
+
+            const __m128 sinResult = _mm_or_ps(_mm_and_ps(polyMask, sinPoly), _mm_andnot_ps(polyMask, cosPoly));
+            const __m128 cosResult = _mm_or_ps(_mm_and_ps(polyMask, cosPoly), _mm_andnot_ps(polyMask, sinPoly));
+            s = _mm_xor_ps(sinResult, signSin);
+            c = _mm_xor_ps(cosResult, signCos);
+        }
+
+        // Splits four consecutive xyz triples into x, y and z vectors
+        inline void loadVec3x4(const float* p, __m128& x, __m128& y, __m128& z)
+        {
+            const __m128 a = _mm_loadu_ps(p); // x0 y0 z0 x1
+            const __m128 b = _mm_loadu_ps(p + 4); // y1 z1 x2 y2
+            const __m128 c = _mm_loadu_ps(p + 8); // z2 x3 y3 z3
+            x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)),
+                               _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+            y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                               _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+            z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                               _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        }
+#endif
+
+#if defined(__AVX2__)
+        // ---------------------------------------------------------------- AVX2
+
+        template <>
+        inline __m256 splat<__m256>(float value) { return _mm256_set1_ps(value); }
+
+        inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+        inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+        inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+        inline __m256 madd(__m256 a, __m256 b, __m256 c) { return _mm256_fmadd_ps(a, b, c); }
+        inline __m256 min(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+        inline __m256 max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+
+        inline void sincos(__m256 x, __m256& s, __m256& c)
+        {
+            const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000u)));
+            __m256 signSin = _mm256_and_ps(x, signMask);
+            x = _mm256_andnot_ps(signMask, x);
+
+            __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f)));
+            j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+            const __m256 y = _mm256_cvtepi32_ps(j);
+
+            const __m256 swapSin = _mm256_castsi256_ps(
+                _mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29));
+            const __m256 polyMask = _mm256_castsi256_ps(
+                _mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+            const __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(
+                _mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+            signSin = _mm256_xor_ps(signSin, swapSin);
+
+            x = _mm256_fnmadd_ps(y, _mm256_set1_ps(0.78515625f), x);
+            x = _mm256_fnmadd_ps(y, _mm256_set1_ps(2.4187564849853515625e-4f), x);
+            x = _mm256_fnmadd_ps(y, _mm256_set1_ps(3.77489497744594108e-8f), x);
+            const __m256 z = _mm256_mul_ps(x, x);
+
+            __m256 cosPoly = madd(_mm256_set1_ps(2.443315711809948e-5f), z, _mm256_set1_ps(-1.388731625493765e-3f));
+            cosPoly = madd(cosPoly, z, _mm256_set1_ps(4.166664568298827e-2f));
+            cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+            cosPoly = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), cosPoly);
+            cosPoly = _mm256_add_ps(cosPoly, _mm256_set1_ps(1.0f));
+
+            __m256 sinPoly = madd(_mm256_set1_ps(-1.9515295891e-4f), z, _mm256_set1_ps(8.3321608736e-3f));
+            sinPoly = madd(sinPoly, z, _mm256_set1_ps(-1.6666654611e-1f));
+            sinPoly = madd(_mm256_mul_ps(sinPoly, z), x, x);
+
+            const __m256 sinResult = _mm256_blendv_ps(cosPoly, sinPoly, polyMask);
+            const __m256 cosResult = _mm256_blendv_ps(sinPoly, cosPoly, polyMask);
+            s = _mm256_xor_ps(sinResult, signSin);
+            c = _mm256_xor_ps(cosResult, signCos);
+        }
+
+        inline void loadVec3x8(const float* p, __m256& x, __m256& y, __m256& z)
+        {
+            __m128 x0, y0, z0, x1, y1, z1;
+            loadVec3x4(p, x0, y0, z0);
+            loadVec3x4(p + 12, x1, y1, z1);
+            x = _mm256_set_m128(x1, x0);
+            y = _mm256_set_m128(y1, y0);
+            z = _mm256_set_m128(z1, z0);
+        }
+#endif
+    }
+}
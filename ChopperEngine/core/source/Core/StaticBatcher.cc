@@ -0,0 +1,88 @@
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+
+namespace Chopper
+{
+    namespace
+    {
+        glm::ivec3 cellOf(const StaticInstance& instance, float cellSize)
+        {
+            const glm::vec3 center = glm::vec3(instance.world * glm::vec4(instance.center, 1.0f));
+            return glm::ivec3(glm::floor(center / cellSize));
+        }
+
+        auto batchKey(uint32_t material, const glm::ivec3& cell)
+        {
+            return std::make_tuple(material, cell.x, cell.y, cell.z);
+        }
+
+        void appendInstance(StaticBatch& batch, const StaticInstance& instance)
+        {
+            const auto base = static_cast<uint32_t>(batch.vertices.size());
+            for (const Vertex& vertex : instance.vertices)
+            {
+                Vertex transformed = vertex;
+                transformed.pos = glm::vec3(instance.world * glm::vec4(vertex.pos, 1.0f));
+                batch.vertices.push_back(transformed);
+            }
+
+            // A mirroring transform turns counter-clockwise triangles clockwise; swap two corners
+            // so they still face the same way under back-face culling
+            const bool mirrored = glm::determinant(glm::mat3(instance.world)) < 0.0f;
+            for (size_t i = 0; i + 2 < instance.indices.size(); i += 3)
+            {
+                batch.indices.push_back(base + instance.indices[i]);
+                batch.indices.push_back(base + instance.indices[mirrored ? i + 2 : i + 1]);
+                batch.indices.push_back(base + instance.indices[mirrored ? i + 1 : i + 2]);
+            }
+            ++batch.instanceCount;
+        }
+    }
+
+    std::vector<StaticBatch> buildStaticBatches(std::span<const StaticInstance> instances, float cellSize,
+                                                uint32_t maxVertices)
+    {
+        std::vector<glm::ivec3> cells(instances.size());
+        for (size_t i = 0; i < instances.size(); ++i)
+        {
+            cells[i] = cellOf(instances[i], cellSize);
+        }
+
+        // Sorted by (material, cell) so every group is a contiguous run
+        std::vector<uint32_t> order(instances.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+        {
+            return batchKey(instances[a].material, cells[a]) < batchKey(instances[b].material, cells[b]);
+        });
+
+        std::vector<StaticBatch> batches;
+        StaticBatch* batch = nullptr;
+        for (const uint32_t i : order)
+        {
+            const StaticInstance& instance = instances[i];
+            if (instance.vertices.empty() || instance.indices.empty()) continue;
+
+            const bool sameGroup = batch && batchKey(batch->material, batch->cell) ==
+                batchKey(instance.material, cells[i]);
+            const bool fits = batch && batch->vertices.size() + instance.vertices.size() <= maxVertices;
+            if (!sameGroup || !fits)
+            {
+                batch = &batches.emplace_back();
+                batch->material = instance.material;
+                batch->cell = cells[i];
+            }
+            appendInstance(*batch, instance);
+        }
+
+        for (StaticBatch& finished : batches)
+        {
+            finished.bounds = computeMeshBounds(finished.vertices);
+        }
+        return batches;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "FrustumCulling.h"
+#include "Vertex.h"
+
+namespace Chopper
+{
+    // An object that never moves, as given to buildStaticBatches()
+    struct StaticInstance
+    {
+        uint32_t material = 0;
+        // Object-space geometry, which must outlive the call
+        std::span<const Vertex> vertices;
+        std::span<const uint32_t> indices;
+        // Object-space center, used to pick the instance's cell
+        glm::vec3 center = glm::vec3(0.0f);
+        glm::mat4 world = glm::mat4(1.0f);
+    };
+
+    // Static instances sharing a material and a cell, merged into one world-space mesh
+    struct StaticBatch
+    {
+        uint32_t material = 0;
+        glm::ivec3 cell = glm::ivec3(0);
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        // World space: what culls the whole batch
+        MeshBounds bounds;
+        uint32_t instanceCount = 0;
+    };
+
+    // Merges static instances into few large meshes, so thousands of small draws become a
+    // handful. Instances are grouped by material and by the cell of a world-space grid their
+    // center falls in; the cell keeps each batch compact enough to still be culled as a whole.
+    // Vertices are transformed into world space, so a batch is drawn with an identity transform.
+    // A group that would exceed maxVertices is split; an instance is never split.
+    std::vector<StaticBatch> buildStaticBatches(std::span<const StaticInstance> instances, float cellSize,
+                                                uint32_t maxVertices);
+}
@@ -0,0 +1,446 @@
+#include "TemporalUpscaler.h"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace Chopper
+{
+    namespace
+    {
+        // Matches UpscaleUniforms in upscale.slang (std140)
+        struct UpscaleUniforms
+        {
+            // Current unjittered NDC to last frame's clip space
+            glm::mat4 reprojection;
+            // Render extent over target extent: output UV to scene target UV
+            glm::vec2 renderScale;
+            // Jitter in output UV
+            glm::vec2 jitter;
+            // One scene target texel in UV
+            glm::vec2 sceneTexel;
+            // Weight of the current frame
+            float blend;
+            uint32_t historyValid;
+            // Edge-directed filtering of the scene color before it is used (FXAA-style)
+            uint32_t edgeFilter;
+        };
+
+        // Share of the current frame in the accumulated history
+        constexpr float TEMPORAL_BLEND = 0.1f;
+        // Jitter sequence length: long enough to cover a pixel, short enough to converge quickly
+        constexpr uint32_t JITTER_PHASES = 8;
+
+        float halton(uint32_t index, uint32_t base)
+        {
+            float result = 0.0f;
+            float fraction = 1.0f;
+            for (; index > 0; index /= base)
+            {
+                fraction /= static_cast<float>(base);
+                result += fraction * static_cast<float>(index % base);
+            }
+            return result;
+        }
+
+        void imageBarrier(const vk::raii::CommandBuffer& cmd, VkImage image, vk::ImageAspectFlags aspect,
+                          vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlags2 srcStage,
+                          vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess)
+        {
+            const vk::ImageMemoryBarrier2 barrier{
+                srcStage, srcAccess, dstStage, dstAccess, oldLayout, newLayout, VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED, image, vk::ImageSubresourceRange{aspect, 0, 1, 0, 1}
+            };
+            vk::DependencyInfo info{};
+            info.imageMemoryBarrierCount = 1;
+            info.pImageMemoryBarriers = &barrier;
+            cmd.pipelineBarrier2(info);
+        }
+
+        // The scene pass either resolves into the targets, in the color attachment output stage,
+        // or, single-sampled, draws to them directly
+        constexpr vk::PipelineStageFlags2 SCENE_STAGES = vk::PipelineStageFlagBits2::eColorAttachmentOutput |
+            vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
+        constexpr vk::AccessFlags2 SCENE_ACCESS = vk::AccessFlagBits2::eColorAttachmentRead |
+            vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+            vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+    }
+
+    void TemporalUpscaler::init(const vk::raii::Device& device, GpuMemory& memory, const std::vector<char>& spirv,
+                                uint32_t framesInFlight)
+    {
+        device_ = &device;
+        memory_ = &memory;
+        spirv_ = spirv;
+
+        // Bilinear, clamped: the history is sampled at reprojected positions between texels
+        vk::SamplerCreateInfo samplerInfo{};
+        samplerInfo.magFilter = vk::Filter::eLinear;
+        samplerInfo.minFilter = vk::Filter::eLinear;
+        samplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+        samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+        samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+        samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+        sampler_ = vk::raii::Sampler(device, samplerInfo);
+
+        // 0 scene color, 1 scene depth, 2 history, 3 uniforms
+        std::array bindings{
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eSampledImage, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr),
+            vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eUniformBuffer, 1,
+                                           vk::ShaderStageFlagBits::eFragment, nullptr)
+        };
+        vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+        set_layout_ = vk::raii::DescriptorSetLayout(device, layoutInfo);
+
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &*set_layout_;
+        pipeline_layout_ = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
+
+        frames_.resize(framesInFlight);
+        for (FrameData& frame : frames_)
+        {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = sizeof(UpscaleUniforms);
+            bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VmaAllocationCreateInfo allocInfo{};
+            allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+            allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+            VmaAllocationInfo details{};
+            if (memory.createBuffer(bufferInfo, allocInfo, MemoryCategory::Uniforms, "Upscale uniforms",
+                                    frame.uniforms, frame.uniformsAllocation, &details) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create upscale uniform buffer!");
+            }
+            frame.uniformsMapped = details.pMappedData;
+        }
+    }
+
+    vk::raii::Pipeline TemporalUpscaler::createPipeline(vk::Format format) const
+    {
+        vk::ShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.codeSize = spirv_.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(spirv_.data());
+        const vk::raii::ShaderModule module(*device_, moduleInfo);
+        const std::array stages{
+            vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, *module, "vertMain"),
+            vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, *module, "fragMain")
+        };
+
+        // A full-screen triangle generated from the vertex index: no vertex input, no depth
+        vk::PipelineVertexInputStateCreateInfo vertexInput{};
+        vk::PipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
+        vk::PipelineViewportStateCreateInfo viewportState{};
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+        vk::PipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.polygonMode = vk::PolygonMode::eFill;
+        rasterizer.cullMode = vk::CullModeFlagBits::eNone;
+        rasterizer.lineWidth = 1.0f;
+        vk::PipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
+        vk::PipelineDepthStencilStateCreateInfo depthStencil{};
+
+        // The output and the next history
+        vk::PipelineColorBlendAttachmentState blendAttachment{};
+        blendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+        const std::array blendAttachments{blendAttachment, blendAttachment};
+        vk::PipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+        colorBlending.pAttachments = blendAttachments.data();
+
+        const std::array dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+        vk::PipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+        dynamicState.pDynamicStates = dynamicStates.data();
+
+        const std::array colorFormats{format, format};
+        vk::PipelineRenderingCreateInfo renderingInfo{};
+        renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorFormats.size());
+        renderingInfo.pColorAttachmentFormats = colorFormats.data();
+
+        vk::GraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.pNext = &renderingInfo;
+        pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+        pipelineInfo.pStages = stages.data();
+        pipelineInfo.pVertexInputState = &vertexInput;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = *pipeline_layout_;
+        return vk::raii::Pipeline(*device_, nullptr, pipelineInfo);
+    }
+
+    void TemporalUpscaler::destroyTargets(Targets& targets) const
+    {
+        // Sets before their pool, views before their images
+        targets.sets.clear();
+        targets.descriptorPool = nullptr;
+        targets.sceneColorView = nullptr;
+        targets.sceneDepthView = nullptr;
+        targets.historyViews = {nullptr, nullptr};
+        if (targets.sceneColor != VK_NULL_HANDLE)
+        {
+            memory_->destroyImage(targets.sceneColor, targets.sceneColorAllocation);
+            memory_->destroyImage(targets.sceneDepth, targets.sceneDepthAllocation);
+            for (size_t i = 0; i < targets.history.size(); ++i)
+            {
+                memory_->destroyImage(targets.history[i], targets.historyAllocations[i]);
+            }
+        }
+        targets.sceneColor = VK_NULL_HANDLE;
+    }
+
+    void TemporalUpscaler::destroy()
+    {
+        destroyTargets(targets_);
+        for (FrameData& frame : frames_)
+        {
+            memory_->destroyBuffer(frame.uniforms, frame.uniformsAllocation);
+        }
+        frames_.clear();
+        pipeline_ = nullptr;
+        format_ = vk::Format::eUndefined;
+        pipeline_layout_ = nullptr;
+        set_layout_ = nullptr;
+        sampler_ = nullptr;
+    }
+
+    VkImage TemporalUpscaler::createTarget(vk::Format format, VkImageUsageFlags usage, const char* name,
+                                           VmaAllocation& allocation) const
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = static_cast<VkFormat>(format);
+        imageInfo.extent = {extent_.width, extent_.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        VkImage image = VK_NULL_HANDLE;
+        if (memory_->createImage(imageInfo, allocInfo, MemoryCategory::RenderTargets, name, image, allocation) !=
+            VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create upscaler target!");
+        }
+        return image;
+    }
+
+    vk::raii::ImageView TemporalUpscaler::createView(VkImage image, vk::Format format,
+                                                     vk::ImageAspectFlags aspect) const
+    {
+        vk::ImageViewCreateInfo viewInfo{};
+        viewInfo.image = image;
+        viewInfo.viewType = vk::ImageViewType::e2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {aspect, 0, 1, 0, 1};
+        return vk::raii::ImageView(*device_, viewInfo);
+    }
+
+    void TemporalUpscaler::resize(vk::Extent2D extent, vk::Format colorFormat, vk::Format depthFormat,
+                                  DeletionQueue& deletionQueue)
+    {
+        if (targets_.sceneColor != VK_NULL_HANDLE)
+        {
+            deletionQueue.retire([this, old = std::make_shared<Targets>(std::move(targets_))]
+            {
+                destroyTargets(*old);
+            });
+            targets_ = Targets{};
+        }
+        if (colorFormat != format_)
+        {
+            // Frames in flight may still draw with the old one
+            if (*pipeline_) deletionQueue.retireObject(std::move(pipeline_));
+            pipeline_ = createPipeline(colorFormat);
+            format_ = colorFormat;
+        }
+        extent_ = extent;
+        history_valid_ = false;
+
+        targets_.sceneColor = createTarget(colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, "Scene color",
+                                           targets_.sceneColorAllocation);
+        targets_.sceneColorView = createView(targets_.sceneColor, colorFormat, vk::ImageAspectFlagBits::eColor);
+        targets_.sceneDepth = createTarget(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, "Scene depth",
+                                           targets_.sceneDepthAllocation);
+        targets_.sceneDepthView = createView(targets_.sceneDepth, depthFormat, vk::ImageAspectFlagBits::eDepth);
+        for (size_t i = 0; i < targets_.history.size(); ++i)
+        {
+            targets_.history[i] = createTarget(colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, "Upscale history",
+                                               targets_.historyAllocations[i]);
+            targets_.historyViews[i] = createView(targets_.history[i], colorFormat, vk::ImageAspectFlagBits::eColor);
+        }
+
+        const auto setCount = static_cast<uint32_t>(2 * frames_.size());
+        std::array poolSizes{
+            vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 2 * setCount),
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, setCount),
+            vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, setCount)
+        };
+        vk::DescriptorPoolCreateInfo poolInfo{};
+        poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        poolInfo.maxSets = setCount;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        targets_.descriptorPool = vk::raii::DescriptorPool(*device_, poolInfo);
+
+        std::vector<vk::DescriptorSetLayout> layouts(setCount, *set_layout_);
+        vk::DescriptorSetAllocateInfo allocInfo{};
+        allocInfo.descriptorPool = targets_.descriptorPool;
+        allocInfo.descriptorSetCount = setCount;
+        allocInfo.pSetLayouts = layouts.data();
+        targets_.sets = device_->allocateDescriptorSets(allocInfo);
+
+        const vk::DescriptorImageInfo colorInfo(*sampler_, *targets_.sceneColorView,
+                                                vk::ImageLayout::eShaderReadOnlyOptimal);
+        const vk::DescriptorImageInfo depthInfo(nullptr, *targets_.sceneDepthView,
+                                                vk::ImageLayout::eShaderReadOnlyOptimal);
+        for (uint32_t frame = 0; frame < frames_.size(); ++frame)
+        {
+            const vk::DescriptorBufferInfo uniformsInfo(vk::Buffer(frames_[frame].uniforms), 0,
+                                                        sizeof(UpscaleUniforms));
+            for (uint32_t written = 0; written < 2; ++written)
+            {
+                // Reads the history the previous frame wrote
+                const vk::DescriptorImageInfo historyInfo(*sampler_, *targets_.historyViews[1 - written],
+                                                          vk::ImageLayout::eShaderReadOnlyOptimal);
+                const vk::DescriptorSet set = *targets_.sets[frame * 2 + written];
+                const std::array writes{
+                    vk::WriteDescriptorSet(set, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &colorInfo),
+                    vk::WriteDescriptorSet(set, 1, 0, 1, vk::DescriptorType::eSampledImage, &depthInfo),
+                    vk::WriteDescriptorSet(set, 2, 0, 1, vk::DescriptorType::eCombinedImageSampler, &historyInfo),
+                    vk::WriteDescriptorSet(set, 3, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &uniformsInfo)
+                };
+                device_->updateDescriptorSets(writes, {});
+            }
+        }
+    }
+
+    void TemporalUpscaler::beginFrame(const vk::raii::CommandBuffer& cmd, uint32_t frame, vk::Extent2D renderExtent,
+                                      bool temporal, bool edgeFilter)
+    {
+        FrameData& data = frames_[frame];
+        data.renderExtent = renderExtent;
+        data.temporal = temporal;
+        data.edgeFilter = edgeFilter;
+        data.jitter = glm::vec2(0.0f);
+        if (temporal)
+        {
+            // Halton (2, 3): well spread over the pixel at any point in the sequence
+            const auto index = static_cast<uint32_t>(jitter_index_++ % JITTER_PHASES) + 1;
+            data.jitter = glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+        }
+
+        // The previous frame's upscale may still be reading them
+        imageBarrier(cmd, targets_.sceneColor, vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eUndefined,
+                     vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits2::eFragmentShader, {},
+                     SCENE_STAGES, SCENE_ACCESS);
+        imageBarrier(cmd, targets_.sceneDepth, vk::ImageAspectFlagBits::eDepth, vk::ImageLayout::eUndefined,
+                     vk::ImageLayout::eDepthAttachmentOptimal, vk::PipelineStageFlagBits2::eFragmentShader, {},
+                     SCENE_STAGES, SCENE_ACCESS);
+    }
+
+    void TemporalUpscaler::record(const vk::raii::CommandBuffer& cmd, uint32_t frame, vk::ImageView output)
+    {
+        FrameData& data = frames_[frame];
+        data.historyValid = history_valid_ && data.temporal;
+        const VkImage written = targets_.history[history_];
+        const VkImage read = targets_.history[1 - history_];
+
+        imageBarrier(cmd, targets_.sceneColor, vk::ImageAspectFlagBits::eColor,
+                     vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                     SCENE_STAGES, SCENE_ACCESS, vk::PipelineStageFlagBits2::eFragmentShader,
+                     vk::AccessFlagBits2::eShaderSampledRead);
+        imageBarrier(cmd, targets_.sceneDepth, vk::ImageAspectFlagBits::eDepth,
+                     vk::ImageLayout::eDepthAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                     SCENE_STAGES, SCENE_ACCESS, vk::PipelineStageFlagBits2::eFragmentShader,
+                     vk::AccessFlagBits2::eShaderSampledRead);
+        imageBarrier(cmd, written, vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eUndefined,
+                     vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits2::eFragmentShader, {},
+                     vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite);
+        if (!history_valid_)
+        {
+            // Never written since the last resize; sampled, but weighted out by the shader
+            imageBarrier(cmd, read, vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eUndefined,
+                         vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits2::eTopOfPipe, {},
+                         vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead);
+        }
+
+        std::array<vk::RenderingAttachmentInfo, 2> attachments{};
+        attachments[0].imageView = output;
+        attachments[0].imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        attachments[0].loadOp = vk::AttachmentLoadOp::eDontCare;
+        attachments[0].storeOp = vk::AttachmentStoreOp::eStore;
+        attachments[1] = attachments[0];
+        attachments[1].imageView = *targets_.historyViews[history_];
+
+        vk::RenderingInfo renderingInfo{};
+        renderingInfo.renderArea = vk::Rect2D({0, 0}, extent_);
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = static_cast<uint32_t>(attachments.size());
+        renderingInfo.pColorAttachments = attachments.data();
+
+        cmd.beginRendering(renderingInfo);
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline_);
+        cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent_.width),
+                                        static_cast<float>(extent_.height), 0.0f, 1.0f));
+        cmd.setScissor(0, vk::Rect2D({0, 0}, extent_));
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *pipeline_layout_, 0,
+                               *targets_.sets[frame * 2 + history_], nullptr);
+        cmd.draw(3, 1, 0, 0);
+        cmd.endRendering();
+
+        // Read by the next frame's upscale
+        imageBarrier(cmd, written, vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eColorAttachmentOptimal,
+                     vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                     vk::AccessFlagBits2::eColorAttachmentWrite, vk::PipelineStageFlagBits2::eFragmentShader,
+                     vk::AccessFlagBits2::eShaderSampledRead);
+        history_ = 1 - history_;
+        history_valid_ = true;
+    }
+
+    void TemporalUpscaler::latchCamera(uint32_t frame, const glm::mat4& viewProj)
+    {
+        const FrameData& data = frames_[frame];
+        const glm::vec2 renderSize(static_cast<float>(data.renderExtent.width),
+                                   static_cast<float>(data.renderExtent.height));
+        const glm::vec2 targetSize(static_cast<float>(extent_.width), static_cast<float>(extent_.height));
+
+        UpscaleUniforms uniforms{};
+        uniforms.reprojection = previous_view_proj_ * glm::inverse(viewProj);
+        uniforms.renderScale = renderSize / targetSize;
+        uniforms.jitter = data.jitter / renderSize;
+        uniforms.sceneTexel = 1.0f / targetSize;
+        uniforms.blend = data.temporal ? TEMPORAL_BLEND : 1.0f;
+        uniforms.historyValid = data.historyValid ? 1u : 0u;
+        uniforms.edgeFilter = data.edgeFilter ? 1u : 0u;
+        std::memcpy(data.uniformsMapped, &uniforms, sizeof(uniforms));
+        vmaFlushAllocation(memory_->allocator(), data.uniformsAllocation, 0, sizeof(uniforms));
+        previous_view_proj_ = viewProj;
+    }
+}
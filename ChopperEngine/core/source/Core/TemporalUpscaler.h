@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+#include "vma/vk_mem_alloc.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "DeletionQueue.h"
+#include "GpuMemory.h"
+
+namespace Chopper
+{
+    // Temporal upscaling from a variable render resolution to the output (shaders/upscale.spv).
+    // The scene renders into the top-left renderExtent of full-size targets, with its
+    // projection jittered by a different sub-pixel offset every frame, and resolves its color
+    // and depth into sceneColorView() and sceneDepthView(). record() then draws one full-screen
+    // triangle at output resolution that reprojects last frame's output (the history) with the
+    // camera motion reconstructed from depth, clamps it to the current frame's neighbourhood to
+    // reject stale samples, and blends the current frame in. The result goes to the output image
+    // and to the next history image; over a few frames the jittered samples add up to detail
+    // finer than the render resolution. The same pass can also run an FXAA-style edge filter on
+    // the scene color, which costs a few extra taps instead of a pass of its own.
+    //
+    // Motion comes from the camera only: moving objects are handled by the neighbourhood clamp,
+    // which trades their ghosting for some blur.
+    class TemporalUpscaler
+    {
+    public:
+        void init(const vk::raii::Device& device, GpuMemory& memory, const std::vector<char>& spirv,
+                  uint32_t framesInFlight);
+        void destroy();
+
+        // (Re)creates the scene targets and the history at the output size and format. The old
+        // ones go to `deletionQueue`, as frames in flight may still use them; the history starts
+        // over.
+        void resize(vk::Extent2D extent, vk::Format colorFormat, vk::Format depthFormat,
+                    DeletionQueue& deletionQueue);
+
+        // Before the scene pass of `frame`: moves the scene targets to attachment layouts and
+        // picks the frame's jitter. Without temporal accumulation the jitter is zero and the
+        // output is a plain bilinear upscale. `edgeFilter` smooths the scene's edges first, the
+        // post-process anti-aliasing for single-sampled scenes.
+        void beginFrame(const vk::raii::CommandBuffer& cmd, uint32_t frame, vk::Extent2D renderExtent,
+                        bool temporal, bool edgeFilter);
+        // After the scene pass: writes `output`, in ColorAttachmentOptimal and of the format given
+        // to resize(), and the next history
+        void record(const vk::raii::CommandBuffer& cmd, uint32_t frame, vk::ImageView output);
+        // Writes `frame`'s reprojection from the unjittered camera it is submitted with
+        void latchCamera(uint32_t frame, const glm::mat4& viewProj);
+        // Drops the history, e.g. after a camera cut
+        void resetHistory() { history_valid_ = false; }
+
+        // Offset of `frame`'s projection in render pixels, for Camera::jitterProjection()
+        glm::vec2 jitter(uint32_t frame) const { return frames_[frame].jitter; }
+        vk::Extent2D extent() const { return extent_; }
+        // Resolve targets of a multisampled scene, or its attachments when it is single-sampled
+        vk::ImageView sceneColorView() const { return *targets_.sceneColorView; }
+        VkImage sceneDepthImage() const { return targets_.sceneDepth; }
+        vk::ImageView sceneDepthView() const { return *targets_.sceneDepthView; }
+
+    private:
+        struct FrameData
+        {
+            VkBuffer uniforms = VK_NULL_HANDLE;
+            VmaAllocation uniformsAllocation = nullptr;
+            void* uniformsMapped = nullptr;
+            vk::Extent2D renderExtent{};
+            glm::vec2 jitter{0.0f};
+            bool historyValid = false;
+            bool temporal = false;
+            bool edgeFilter = false;
+        };
+
+        // Everything sized by the output, replaced together on resize
+        struct Targets
+        {
+            VkImage sceneColor = VK_NULL_HANDLE;
+            VmaAllocation sceneColorAllocation = nullptr;
+            vk::raii::ImageView sceneColorView = nullptr;
+            VkImage sceneDepth = VK_NULL_HANDLE;
+            VmaAllocation sceneDepthAllocation = nullptr;
+            vk::raii::ImageView sceneDepthView = nullptr;
+            std::array<VkImage, 2> history{};
+            std::array<VmaAllocation, 2> historyAllocations{};
+            std::array<vk::raii::ImageView, 2> historyViews{nullptr, nullptr};
+            vk::raii::DescriptorPool descriptorPool = nullptr;
+            // Per frame and history image written: frame * 2 + history
+            std::vector<vk::raii::DescriptorSet> sets;
+        };
+
+        vk::raii::Pipeline createPipeline(vk::Format format) const;
+        VkImage createTarget(vk::Format format, VkImageUsageFlags usage, const char* name,
+                             VmaAllocation& allocation) const;
+        vk::raii::ImageView createView(VkImage image, vk::Format format, vk::ImageAspectFlags aspect) const;
+        void destroyTargets(Targets& targets) const;
+
+        const vk::raii::Device* device_ = nullptr;
+        GpuMemory* memory_ = nullptr;
+
+        vk::raii::Sampler sampler_ = nullptr;
+        vk::raii::DescriptorSetLayout set_layout_ = nullptr;
+        vk::raii::PipelineLayout pipeline_layout_ = nullptr;
+        // Output format of pipeline_
+        vk::Format format_ = vk::Format::eUndefined;
+        vk::raii::Pipeline pipeline_ = nullptr;
+        std::vector<char> spirv_;
+        std::vector<FrameData> frames_;
+
+        Targets targets_;
+        vk::Extent2D extent_{};
+        uint32_t history_ = 0;
+        bool history_valid_ = false;
+        uint64_t jitter_index_ = 0;
+        glm::mat4 previous_view_proj_{1.0f};
+    };
+}
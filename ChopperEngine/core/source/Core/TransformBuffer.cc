@@ -0,0 +1,143 @@
+#include "TransformBuffer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Chopper
+{
+    void TransformBuffer::init(GpuMemory& memory, uint32_t capacity, uint32_t framesInFlight)
+    {
+        memory_ = &memory;
+        capacity_ = capacity;
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size();
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+        if (memory_->createBuffer(bufferInfo, allocInfo, MemoryCategory::Other, "Transforms", buffer_,
+                                  allocation_) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create transform buffer!");
+        }
+
+        // Worst case every slot changes in one frame
+        staging_buffers_.resize(framesInFlight);
+        staging_allocations_.resize(framesInFlight);
+        staging_mapped_.resize(framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; ++i)
+        {
+            VkBufferCreateInfo stagingInfo{};
+            stagingInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            stagingInfo.size = size();
+            stagingInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            stagingInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VmaAllocationCreateInfo stagingAllocInfo{};
+            stagingAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+            stagingAllocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+            VmaAllocationInfo stagingDetails{};
+            if (memory_->createBuffer(stagingInfo, stagingAllocInfo, MemoryCategory::Staging, "Transform staging",
+                                      staging_buffers_[i], staging_allocations_[i], &stagingDetails) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create transform staging buffer!");
+            }
+            staging_mapped_[i] = static_cast<glm::mat4*>(stagingDetails.pMappedData);
+        }
+
+        pending_matrices_.assign(capacity_, glm::mat4(1.0f));
+        pending_flags_.assign(capacity_, 0);
+        pending_slots_.clear();
+        pending_slots_.reserve(capacity_);
+        regions_.reserve(capacity_);
+    }
+
+    void TransformBuffer::destroy()
+    {
+        for (size_t i = 0; i < staging_buffers_.size(); ++i)
+        {
+            memory_->destroyBuffer(staging_buffers_[i], staging_allocations_[i]);
+        }
+        staging_buffers_.clear();
+        staging_allocations_.clear();
+        staging_mapped_.clear();
+
+        if (buffer_ != VK_NULL_HANDLE)
+        {
+            memory_->destroyBuffer(buffer_, allocation_);
+            buffer_ = VK_NULL_HANDLE;
+        }
+    }
+
+    void TransformBuffer::set(uint32_t slot, const glm::mat4& matrix)
+    {
+        pending_matrices_[slot] = matrix;
+        if (pending_flags_[slot]) return;
+        pending_flags_[slot] = 1;
+        pending_slots_.push_back(slot);
+    }
+
+    void TransformBuffer::record(const vk::raii::CommandBuffer& cmd, uint32_t frame)
+    {
+        stats_ = {};
+        if (pending_slots_.empty()) return;
+
+        // Sorted slots let neighbouring matrices share one copy region
+        std::sort(pending_slots_.begin(), pending_slots_.end());
+
+        constexpr vk::DeviceSize MATRIX_SIZE = sizeof(glm::mat4);
+        glm::mat4* staging = staging_mapped_[frame];
+        regions_.clear();
+        for (size_t i = 0; i < pending_slots_.size(); ++i)
+        {
+            const uint32_t slot = pending_slots_[i];
+            staging[i] = pending_matrices_[slot];
+            pending_flags_[slot] = 0;
+
+            const vk::DeviceSize dst = slot * MATRIX_SIZE;
+            if (!regions_.empty() && regions_.back().dstOffset + regions_.back().size == dst)
+            {
+                regions_.back().size += MATRIX_SIZE;
+            }
+            else
+            {
+                regions_.emplace_back(i * MATRIX_SIZE, dst, MATRIX_SIZE);
+            }
+        }
+        const vk::DeviceSize bytes = pending_slots_.size() * MATRIX_SIZE;
+        vmaFlushAllocation(memory_->allocator(), staging_allocations_[frame], 0, bytes);
+
+        // Previous frames may still be reading the slots we overwrite (draws and GPU culling)
+        vk::MemoryBarrier2 before{
+            vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eComputeShader, {},
+            vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite
+        };
+        vk::DependencyInfo beforeInfo{};
+        beforeInfo.memoryBarrierCount = 1;
+        beforeInfo.pMemoryBarriers = &before;
+        cmd.pipelineBarrier2(beforeInfo);
+
+        cmd.copyBuffer(vk::Buffer(staging_buffers_[frame]), vk::Buffer(buffer_), regions_);
+
+        vk::MemoryBarrier2 after{
+            vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+            vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eComputeShader,
+            vk::AccessFlagBits2::eShaderStorageRead
+        };
+        vk::DependencyInfo afterInfo{};
+        afterInfo.memoryBarrierCount = 1;
+        afterInfo.pMemoryBarriers = &after;
+        cmd.pipelineBarrier2(afterInfo);
+
+        stats_.uploads = static_cast<uint32_t>(pending_slots_.size());
+        stats_.copyRegions = static_cast<uint32_t>(regions_.size());
+        stats_.bytes = bytes;
+        pending_slots_.clear();
+    }
+}
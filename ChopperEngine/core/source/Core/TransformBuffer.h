@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+#include "vma/vk_mem_alloc.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "GpuMemory.h"
+
+namespace Chopper
+{
+    // Device-local array of per-instance world matrices, indexed by Renderable::slot. Only
+    // matrices written with set() since the last record() are uploaded: they are packed into
+    // the frame's staging buffer and scattered into place with one copy region per run of
+    // consecutive slots, so upload bandwidth follows what moved rather than scene size.
+    class TransformBuffer
+    {
+    public:
+        struct Stats
+        {
+            uint32_t uploads = 0;
+            uint32_t copyRegions = 0;
+            vk::DeviceSize bytes = 0;
+        };
+
+        void init(GpuMemory& memory, uint32_t capacity, uint32_t framesInFlight);
+        void destroy();
+
+        // Queues the matrix for upload; repeated sets of one slot before record() upload once
+        void set(uint32_t slot, const glm::mat4& matrix);
+
+        // Records the pending copies into `cmd` using staging buffer `frame`, outside rendering.
+        // The staging buffer must not be in use by the GPU (i.e. the frame that last used it has finished).
+        void record(const vk::raii::CommandBuffer& cmd, uint32_t frame);
+
+        VkBuffer buffer() const { return buffer_; }
+        vk::DeviceSize size() const { return static_cast<vk::DeviceSize>(capacity_) * sizeof(glm::mat4); }
+        uint32_t capacity() const { return capacity_; }
+        const Stats& stats() const { return stats_; }
+
+    private:
+        GpuMemory* memory_ = nullptr;
+        uint32_t capacity_ = 0;
+
+        VkBuffer buffer_ = VK_NULL_HANDLE;
+        VmaAllocation allocation_ = nullptr;
+
+        std::vector<VkBuffer> staging_buffers_;
+        std::vector<VmaAllocation> staging_allocations_;
+        std::vector<glm::mat4*> staging_mapped_;
+
+        // Latest matrix per slot and the slots queued since the last record()
+        std::vector<glm::mat4> pending_matrices_;
+        std::vector<uint8_t> pending_flags_;
+        std::vector<uint32_t> pending_slots_;
+        std::vector<vk::BufferCopy> regions_;
+
+        Stats stats_{};
+    };
+}
@@ -0,0 +1,48 @@
+#include "TransformKernel.h"
+
+#include "Parallel.h"
+#include "TransformKernelImpl.h"
+
+namespace Chopper
+{
+    namespace
+    {
+        // Below this many elements per batch, thread handoff costs more than it saves
+        constexpr size_t TRANSFORM_BATCH = 4096;
+    }
+
+    void composeTransforms(const glm::vec3* positions, const glm::vec3* rotations, const glm::vec3* scales,
+                           size_t count, glm::mat4* out)
+    {
+        if (count == 0) return;
+
+        const float* pos = &positions[0].x;
+        const float* rot = &rotations[0].x;
+        const float* scl = &scales[0].x;
+        float* dst = &out[0][0][0];
+
+        switch (Simd::level())
+        {
+        case Simd::Level::AVX2:
+            detail::composeTransformsAvx2(pos, rot, scl, count, dst);
+            return;
+#if defined(CHOPPER_SIMD_SSE2)
+        case Simd::Level::SSE2:
+            Simd::composeRangeSse2(pos, rot, scl, count, dst);
+            return;
+#endif
+        default:
+            Simd::composeRangeScalar(pos, rot, scl, 0, count, dst);
+            return;
+        }
+    }
+
+    void composeTransformsParallel(const glm::vec3* positions, const glm::vec3* rotations,
+                                   const glm::vec3* scales, size_t count, glm::mat4* out)
+    {
+        parallelFor(count, TRANSFORM_BATCH, [&](size_t begin, size_t end)
+        {
+            composeTransforms(positions + begin, rotations + begin, scales + begin, end - begin, out + begin);
+        });
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+namespace Chopper
+{
+    // Batched TRS -> matrix conversion. For every element computes
+    //     out[i] = T(positions[i]) * Rx * Ry * Rz (rotations[i]) * S(scales[i])
+    // which matches composeModelMatrix(), without any mat4 multiplies. Uses AVX2 (8 wide) or
+    // SSE2 (4 wide) when available and a scalar path otherwise.
+    void composeTransforms(const glm::vec3* positions, const glm::vec3* rotations, const glm::vec3* scales,
+                           size_t count, glm::mat4* out);
+
+    // Same as composeTransforms(), split into batches across worker threads
+    void composeTransformsParallel(const glm::vec3* positions, const glm::vec3* rotations,
+                                   const glm::vec3* scales, size_t count, glm::mat4* out);
+
+    namespace detail
+    {
+        void composeTransformsAvx2(const float* positions, const float* rotations, const float* scales,
+                                   size_t count, float* out);
+    }
+}
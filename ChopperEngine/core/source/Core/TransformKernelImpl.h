@@ -0,0 +1,144 @@
+#pragma once
+
+// Kernel body shared by TransformKernel.cc (scalar, SSE2) and TransformKernel_avx2.cc.
+// Include only from those translation units.
+
+#include <cstring>
+
+#include "SimdMath.h"
+
+namespace Chopper::Simd
+{
+    namespace
+    {
+        // Builds 16 matrix elements (column-major) per lane from TRS components
+        template <typename V>
+        inline void composeLanes(V px, V py, V pz, V rx, V ry, V rz, V sx, V sy, V sz, V m[16])
+        {
+            V sinX, cosX, sinY, cosY, sinZ, cosZ;
+            sincos(rx, sinX, cosX);
+            sincos(ry, sinY, cosY);
+            sincos(rz, sinZ, cosZ);
+
+            // Rx * Ry * Rz, expanded
+            const V sxsy = mul(sinX, sinY);
+            const V cxsy = mul(cosX, sinY);
+            const V zero = splat<V>(0.0f);
+
+            const V r00 = mul(cosY, cosZ);
+            const V r01 = madd(sxsy, cosZ, mul(cosX, sinZ));
+            const V r02 = sub(mul(sinX, sinZ), mul(cxsy, cosZ));
+
+            const V r10 = sub(zero, mul(cosY, sinZ));
+            const V r11 = sub(mul(cosX, cosZ), mul(sxsy, sinZ));
+            const V r12 = madd(cxsy, sinZ, mul(sinX, cosZ));
+
+            const V r20 = sinY;
+            const V r21 = sub(zero, mul(sinX, cosY));
+            const V r22 = mul(cosX, cosY);
+
+            // T * R * S, bottom row (0, 0, 0, 1)
+            const V a[4][3] = {
+                {mul(r00, sx), mul(r01, sx), mul(r02, sx)},
+                {mul(r10, sy), mul(r11, sy), mul(r12, sy)},
+                {mul(r20, sz), mul(r21, sz), mul(r22, sz)},
+                {px, py, pz}
+            };
+
+            for (int col = 0; col < 4; ++col)
+            {
+                m[col * 4 + 0] = a[col][0];
+                m[col * 4 + 1] = a[col][1];
+                m[col * 4 + 2] = a[col][2];
+                m[col * 4 + 3] = splat<V>(col == 3 ? 1.0f : 0.0f);
+            }
+        }
+
+        inline void composeRangeScalar(const float* pos, const float* rot, const float* scl, size_t begin,
+                                       size_t end, float* out)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                float m[16];
+                composeLanes<float>(pos[i * 3], pos[i * 3 + 1], pos[i * 3 + 2],
+                                    rot[i * 3], rot[i * 3 + 1], rot[i * 3 + 2],
+                                    scl[i * 3], scl[i * 3 + 1], scl[i * 3 + 2], m);
+                std::memcpy(out + i * 16, m, sizeof(m));
+            }
+        }
+
+#if defined(CHOPPER_SIMD_SSE2)
+        inline void composeRangeSse2(const float* pos, const float* rot, const float* scl, size_t count,
+                                     float* out)
+        {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 px, py, pz, rx, ry, rz, sx, sy, sz;
+                loadVec3x4(pos + i * 3, px, py, pz);
+                loadVec3x4(rot + i * 3, rx, ry, rz);
+                loadVec3x4(scl + i * 3, sx, sy, sz);
+
+                __m128 m[16];
+                composeLanes(px, py, pz, rx, ry, rz, sx, sy, sz, m);
+
+                // Each group of four vectors holds one column of four matrices
+                float* dst = out + i * 16;
+                for (int col = 0; col < 4; ++col)
+                {
+                    __m128 c0 = m[col * 4 + 0], c1 = m[col * 4 + 1], c2 = m[col * 4 + 2], c3 = m[col * 4 + 3];
+                    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+                    _mm_storeu_ps(dst + 0 * 16 + col * 4, c0);
+                    _mm_storeu_ps(dst + 1 * 16 + col * 4, c1);
+                    _mm_storeu_ps(dst + 2 * 16 + col * 4, c2);
+                    _mm_storeu_ps(dst + 3 * 16 + col * 4, c3);
+                }
+            }
+            composeRangeScalar(pos, rot, scl, i, count, out);
+        }
+#endif
+
+#if defined(__AVX2__)
+        inline void composeRangeAvx2(const float* pos, const float* rot, const float* scl, size_t count,
+                                     float* out)
+        {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 px, py, pz, rx, ry, rz, sx, sy, sz;
+                loadVec3x8(pos + i * 3, px, py, pz);
+                loadVec3x8(rot + i * 3, rx, ry, rz);
+                loadVec3x8(scl + i * 3, sx, sy, sz);
+
+                __m256 m[16];
+                composeLanes(px, py, pz, rx, ry, rz, sx, sy, sz, m);
+
+                // 4x4 transpose inside each 128-bit half: the low half yields matrices 0-3,
+                // the high half matrices 4-7
+                float* dst = out + i * 16;
+                for (int col = 0; col < 4; ++col)
+                {
+                    const __m256 t0 = _mm256_unpacklo_ps(m[col * 4 + 0], m[col * 4 + 1]);
+                    const __m256 t1 = _mm256_unpackhi_ps(m[col * 4 + 0], m[col * 4 + 1]);
+                    const __m256 t2 = _mm256_unpacklo_ps(m[col * 4 + 2], m[col * 4 + 3]);
+                    const __m256 t3 = _mm256_unpackhi_ps(m[col * 4 + 2], m[col * 4 + 3]);
+                    const __m256 c0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+                    const __m256 c1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+                    const __m256 c2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+                    const __m256 c3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+                    _mm_storeu_ps(dst + 0 * 16 + col * 4, _mm256_castps256_ps128(c0));
+                    _mm_storeu_ps(dst + 1 * 16 + col * 4, _mm256_castps256_ps128(c1));
+                    _mm_storeu_ps(dst + 2 * 16 + col * 4, _mm256_castps256_ps128(c2));
+                    _mm_storeu_ps(dst + 3 * 16 + col * 4, _mm256_castps256_ps128(c3));
+                    _mm_storeu_ps(dst + 4 * 16 + col * 4, _mm256_extractf128_ps(c0, 1));
+                    _mm_storeu_ps(dst + 5 * 16 + col * 4, _mm256_extractf128_ps(c1, 1));
+                    _mm_storeu_ps(dst + 6 * 16 + col * 4, _mm256_extractf128_ps(c2, 1));
+                    _mm_storeu_ps(dst + 7 * 16 + col * 4, _mm256_extractf128_ps(c3, 1));
+                }
+            }
+            composeRangeScalar(pos, rot, scl, i, count, out);
+        }
+#endif
+    }
+}
@@ -0,0 +1,17 @@
+// Compiled with AVX2 + FMA code generation, see Build-Core.lua
+#include "TransformKernel.h"
+
+#include "TransformKernelImpl.h"
+
+namespace Chopper::detail
+{
+    void composeTransformsAvx2(const float* positions, const float* rotations, const float* scales,
+                               size_t count, float* out)
+    {
+#if defined(__AVX2__)
+        Simd::composeRangeAvx2(positions, rotations, scales, count, out);
+#else
+        Simd::composeRangeScalar(positions, rotations, scales, 0, count, out);
+#endif
+    }
+}
@@ -1 +1,19 @@
-C:/VulkanSDK/1.4.313.1/bin/slangc.exe shader.slang -target spirv -profile spirv_1_4 -emit-spirv-directly -fvk-use-entrypoint-name -entry vertMain -entry fragMain -o slang.spv
\ No newline at end of file
+@echo off
+rem Compiles every shader in app/shaders to SPIR-V next to its source, for Windows. The app
+rem build runs it first; run it by hand after editing a shader without rebuilding.
+
+set SLANGC=%VULKAN_SDK%\bin\slangc.exe
+set FLAGS=-target spirv -profile spirv_1_4 -emit-spirv-directly -fvk-use-entrypoint-name
+
+pushd "%~dp0..\app\shaders"
+"%SLANGC%" shader.slang %FLAGS% -entry vertMain -entry vertShadow -entry fragMain -o slang.spv || goto failed
+"%SLANGC%" cull.slang %FLAGS% -entry cullMain -o cull.spv || goto failed
+"%SLANGC%" cluster.slang %FLAGS% -entry binLights -o cluster.spv || goto failed
+"%SLANGC%" hiz.slang %FLAGS% -entry depthToHiz -entry depthToHizMs -entry reduceHiz -o hiz.spv || goto failed
+"%SLANGC%" upscale.slang %FLAGS% -entry vertMain -entry fragMain -o upscale.spv || goto failed
+popd
+exit /b 0
+
+:failed
+popd
+exit /b 1
@@ -0,0 +1,14 @@
+#!/bin/bash
+# Compiles every shader in app/shaders to SPIR-V next to its source, for Linux. The app
+# build runs it first; run it by hand after editing a shader without rebuilding.
+set -e
+
+SLANGC="${VULKAN_SDK:+$VULKAN_SDK/bin/}slangc"
+FLAGS="-target spirv -profile spirv_1_4 -emit-spirv-directly -fvk-use-entrypoint-name"
+
+cd "$(dirname "$0")/../app/shaders"
+"$SLANGC" shader.slang $FLAGS -entry vertMain -entry vertShadow -entry fragMain -o slang.spv
+"$SLANGC" cull.slang $FLAGS -entry cullMain -o cull.spv
+"$SLANGC" cluster.slang $FLAGS -entry binLights -o cluster.spv
+"$SLANGC" hiz.slang $FLAGS -entry depthToHiz -entry depthToHizMs -entry reduceHiz -o hiz.spv
+"$SLANGC" upscale.slang $FLAGS -entry vertMain -entry fragMain -o upscale.spv
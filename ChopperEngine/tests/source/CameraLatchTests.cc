@@ -0,0 +1,92 @@
+#include "Test.h"
+
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/CameraLatch.h"
+
+using namespace Chopper;
+
+namespace
+{
+    glm::mat4 testProjection()
+    {
+        glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        proj[1][1] *= -1;
+        return proj;
+    }
+
+    glm::mat4 lookFrom(const glm::vec3& eye, float yawDegrees, float pitchDegrees)
+    {
+        const float yaw = glm::radians(yawDegrees);
+        const float pitch = glm::radians(pitchDegrees);
+        const glm::vec3 direction(std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch));
+        return glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    bool inside(const FrustumPlanes& planes, const glm::vec3& point)
+    {
+        for (const glm::vec4& plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), point) + plane.w < -1e-4f) return false;
+        }
+        return true;
+    }
+}
+
+TEST(LatchBudgetAcceptsSmallMoves)
+{
+    const glm::mat4 proj = testProjection();
+    const CameraSample culled{lookFrom(glm::vec3(0.0f, 1.0f, 3.0f), -90.0f, 0.0f), proj};
+
+    const CameraSample nudged{lookFrom(glm::vec3(0.1f, 1.0f, 3.0f), -88.0f, 1.0f), proj};
+    CHECK(withinLatchBudget(culled, nudged, LATCH_MAX_TRANSLATION, LATCH_MAX_ANGLE));
+
+    const CameraSample moved{lookFrom(glm::vec3(1.0f, 1.0f, 3.0f), -90.0f, 0.0f), proj};
+    CHECK(!withinLatchBudget(culled, moved, LATCH_MAX_TRANSLATION, LATCH_MAX_ANGLE));
+
+    const CameraSample turned{lookFrom(glm::vec3(0.0f, 1.0f, 3.0f), -80.0f, 0.0f), proj};
+    CHECK(!withinLatchBudget(culled, turned, LATCH_MAX_TRANSLATION, LATCH_MAX_ANGLE));
+
+    CameraSample zoomed = culled;
+    zoomed.proj[0][0] *= 1.1f;
+    CHECK(!withinLatchBudget(culled, zoomed, LATCH_MAX_TRANSLATION, LATCH_MAX_ANGLE));
+}
+
+TEST(PaddedFrustumContainsLatchedFrustums)
+{
+    const glm::mat4 proj = testProjection();
+    const glm::mat4 view = lookFrom(glm::vec3(0.0f, 1.0f, 3.0f), -90.0f, 10.0f);
+    const FrustumPlanes padded = padLatchFrustum(view, proj, LATCH_MAX_TRANSLATION, LATCH_MAX_ANGLE);
+    const CameraSample culled{view, proj};
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+    int tested = 0;
+    for (int camera = 0; camera < 64; ++camera)
+    {
+        // Cameras on the edge of the budget
+        const glm::vec3 offset = glm::normalize(glm::vec3(unit(random), unit(random), unit(random))) *
+                                 LATCH_MAX_TRANSLATION * 0.99f;
+        const float turn = glm::degrees(LATCH_MAX_ANGLE) * 0.7f;
+        const CameraSample latched{lookFrom(glm::vec3(0.0f, 1.0f, 3.0f) + offset, -90.0f + turn * unit(random),
+                                            10.0f + turn * unit(random)), proj};
+        if (!withinLatchBudget(culled, latched, LATCH_MAX_TRANSLATION, LATCH_MAX_ANGLE)) continue;
+
+        // Points inside the latched frustum, out to its far plane
+        const glm::mat4 inverse = glm::inverse(latched.proj * latched.view);
+        for (int i = 0; i < 64; ++i)
+        {
+            const glm::vec4 clip = inverse * glm::vec4(unit(random), unit(random), depth(random), 1.0f);
+            CHECK(inside(padded, glm::vec3(clip) / clip.w));
+            ++tested;
+        }
+    }
+    CHECK(tested > 0);
+
+    // Still culls what is well outside
+    CHECK(!inside(padded, glm::vec3(0.0f, 1.0f, 10.0f)));
+    CHECK(!inside(padded, glm::vec3(30.0f, 1.0f, -5.0f)));
+}
@@ -0,0 +1,176 @@
+#include "Test.h"
+
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/ClusterGrid.h"
+
+using namespace Chopper;
+
+namespace
+{
+    const glm::vec2 RENDER_SIZE(1600.0f, 900.0f);
+
+    glm::mat4 testProjection()
+    {
+        glm::mat4 proj = glm::perspective(glm::radians(60.0f), RENDER_SIZE.x / RENDER_SIZE.y, 0.1f, 500.0f);
+        proj[1][1] *= -1;
+        return proj;
+    }
+
+    // Pixel of a view-space point in front of the camera, as the fragment shader sees it
+    glm::vec2 pixelOf(const glm::mat4& proj, const glm::vec3& viewPoint)
+    {
+        const glm::vec4 clip = proj * glm::vec4(viewPoint, 1.0f);
+        const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        return (ndc * 0.5f + 0.5f) * RENDER_SIZE;
+    }
+
+    bool contains(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& point, float slack)
+    {
+        return glm::all(glm::greaterThanEqual(point, boxMin - slack)) &&
+               glm::all(glm::lessThanEqual(point, boxMax + slack));
+    }
+
+    // A view-space point inside the frustum, between 0.05 and 400 units away
+    glm::vec3 randomViewPoint(std::mt19937& rng, const glm::mat4& proj)
+    {
+        std::uniform_real_distribution<float> unit(-0.999f, 0.999f);
+        std::uniform_real_distribution<float> logDepth(std::log(0.05f), std::log(400.0f));
+        const float depth = std::exp(logDepth(rng));
+        return glm::vec3(unit(rng) * depth / proj[0][0], unit(rng) * depth / proj[1][1], -depth);
+    }
+}
+
+TEST(ClusterSlicesSpanTheSliceRange)
+{
+    const ClusterSlicing slicing = clusterSlicing();
+    CHECK_NEAR(clusterSliceDistance(slicing, 0), ClusterGrid::SLICE_NEAR, 1e-5f);
+    CHECK_NEAR(clusterSliceDistance(slicing, ClusterGrid::GRID_Z), ClusterGrid::SLICE_FAR, 1e-2f);
+
+    float previous = 0.0f;
+    for (uint32_t slice = 0; slice <= ClusterGrid::GRID_Z; ++slice)
+    {
+        const float distance = clusterSliceDistance(slicing, slice);
+        CHECK(distance > previous);
+        previous = distance;
+    }
+}
+
+TEST(ClusterDepthMapsToItsSlice)
+{
+    const ClusterSlicing slicing = clusterSlicing();
+    const glm::vec2 center = RENDER_SIZE * 0.5f;
+    const uint32_t tile = (ClusterGrid::GRID_Y / 2) * ClusterGrid::GRID_X + ClusterGrid::GRID_X / 2;
+    const uint32_t perSlice = ClusterGrid::GRID_X * ClusterGrid::GRID_Y;
+
+    for (uint32_t slice = 0; slice < ClusterGrid::GRID_Z; ++slice)
+    {
+        const float nearDistance = clusterSliceDistance(slicing, slice);
+        const float farDistance = clusterSliceDistance(slicing, slice + 1);
+        const float middle = std::sqrt(nearDistance * farDistance);
+        CHECK(clusterIndex(slicing, center, RENDER_SIZE, middle) == slice * perSlice + tile);
+    }
+
+    // Closer than the slices and beyond them clamp to the first and last slice
+    CHECK(clusterIndex(slicing, center, RENDER_SIZE, 0.0f) == tile);
+    CHECK(clusterIndex(slicing, center, RENDER_SIZE, 1.0e5f) == (ClusterGrid::GRID_Z - 1) * perSlice + tile);
+
+    uint32_t previous = 0;
+    for (float depth = 0.01f; depth < 1000.0f; depth *= 1.01f)
+    {
+        const uint32_t slice = clusterIndex(slicing, center, RENDER_SIZE, depth) / perSlice;
+        CHECK(slice >= previous);
+        previous = slice;
+    }
+}
+
+TEST(ClusterBoxHoldsItsFragments)
+{
+    const ClusterSlicing slicing = clusterSlicing();
+    const glm::mat4 proj = testProjection();
+    const glm::vec2 projScale(proj[0][0], proj[1][1]);
+    std::mt19937 rng(7);
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        const glm::vec3 point = randomViewPoint(rng, proj);
+        const uint32_t index = clusterIndex(slicing, pixelOf(proj, point), RENDER_SIZE, -point.z);
+        CHECK(index < ClusterGrid::CLUSTER_COUNT);
+
+        glm::vec3 boxMin, boxMax;
+        clusterBox(slicing, index, projScale, boxMin, boxMax);
+        // Fragments closer than the first slice are shaded with it but lie outside its box
+        if (-point.z >= ClusterGrid::SLICE_NEAR) CHECK(contains(boxMin, boxMax, point, 1e-3f * -point.z));
+    }
+}
+
+TEST(ClusterSphereTest)
+{
+    const glm::vec3 boxMin(-1.0f, -1.0f, -3.0f);
+    const glm::vec3 boxMax(1.0f, 1.0f, -2.0f);
+    CHECK(sphereTouchesBox(glm::vec3(0.0f, 0.0f, -2.5f), 0.1f, boxMin, boxMax));
+    CHECK(sphereTouchesBox(glm::vec3(2.0f, 0.0f, -2.5f), 1.01f, boxMin, boxMax));
+    CHECK(!sphereTouchesBox(glm::vec3(2.0f, 0.0f, -2.5f), 0.99f, boxMin, boxMax));
+    // Past a corner the distance is to the corner, not to the nearest face
+    CHECK(!sphereTouchesBox(glm::vec3(2.0f, 2.0f, -2.5f), 1.2f, boxMin, boxMax));
+    CHECK(sphereTouchesBox(glm::vec3(2.0f, 2.0f, -2.5f), 1.5f, boxMin, boxMax));
+}
+
+TEST(ClusterConeTest)
+{
+    const glm::vec3 apex(0.0f);
+    const glm::vec3 axis(0.0f, 0.0f, -1.0f);
+    const float cosAngle = std::cos(glm::radians(30.0f));
+    const float length = 10.0f;
+
+    // On the axis, within and past the cone's length
+    CHECK(coneTouchesSphere(apex, axis, length, cosAngle, glm::vec3(0.0f, 0.0f, -5.0f), 0.1f));
+    CHECK(!coneTouchesSphere(apex, axis, length, cosAngle, glm::vec3(0.0f, 0.0f, -11.0f), 0.5f));
+    CHECK(coneTouchesSphere(apex, axis, length, cosAngle, glm::vec3(0.0f, 0.0f, -11.0f), 1.5f));
+    // Behind the apex
+    CHECK(!coneTouchesSphere(apex, axis, length, cosAngle, glm::vec3(0.0f, 0.0f, 2.0f), 1.0f));
+    // Beside the cone: 5 units down the axis the side is 5 * tan(30) ~ 2.89 out, and the center is
+    // (6 - 2.89) * cos(30) ~ 2.69 from it
+    const glm::vec3 beside(6.0f, 0.0f, -5.0f);
+    CHECK(!coneTouchesSphere(apex, axis, length, cosAngle, beside, 2.6f));
+    CHECK(coneTouchesSphere(apex, axis, length, cosAngle, beside, 2.8f));
+}
+
+TEST(ClusterBinningKeepsLitFragments)
+{
+    // Every fragment a light reaches must find the light in its cluster: the cluster's box passes
+    // the light's sphere and, for a spot light, the cone passes the box's bounding sphere
+    const ClusterSlicing slicing = clusterSlicing();
+    const glm::mat4 proj = testProjection();
+    const glm::vec2 projScale(proj[0][0], proj[1][1]);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    const glm::vec3 lightCenter(1.0f, -0.5f, -8.0f);
+    const float range = 3.0f;
+    const glm::vec3 spotAxis = glm::normalize(glm::vec3(0.3f, 0.0f, -1.0f));
+    const float cosOuter = std::cos(glm::radians(25.0f));
+
+    int lit = 0;
+    for (int i = 0; i < 1000000 && lit < 5000; ++i)
+    {
+        const glm::vec3 point = lightCenter + glm::vec3(unit(rng), unit(rng), unit(rng)) * range;
+        const glm::vec3 toPoint = point - lightCenter;
+        if (glm::length(toPoint) > range || glm::dot(glm::normalize(toPoint), spotAxis) < cosOuter) continue;
+        const glm::vec2 pixel = pixelOf(proj, point);
+        if (glm::any(glm::lessThan(pixel, glm::vec2(0.0f))) || glm::any(glm::greaterThan(pixel, RENDER_SIZE)))
+            continue;
+        ++lit;
+
+        const uint32_t index = clusterIndex(slicing, pixel, RENDER_SIZE, -point.z);
+        glm::vec3 boxMin, boxMax;
+        clusterBox(slicing, index, projScale, boxMin, boxMax);
+        const glm::vec3 boxCenter = 0.5f * (boxMin + boxMax);
+        const float boxRadius = glm::length(boxMax - boxCenter);
+        CHECK(sphereTouchesBox(lightCenter, range, boxMin, boxMax));
+        CHECK(coneTouchesSphere(lightCenter, spotAxis, range, cosOuter, boxCenter, boxRadius));
+    }
+    CHECK(lit == 5000);
+}
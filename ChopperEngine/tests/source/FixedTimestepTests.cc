@@ -0,0 +1,93 @@
+#include "Test.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/FixedTimestep.h"
+
+using namespace Chopper;
+
+namespace
+{
+    bool isFinite(const glm::mat4& m)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int r = 0; r < 4; ++r)
+            {
+                if (!std::isfinite(m[c][r])) return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST(FixedTimestepBanksLeftoverTime)
+{
+    FixedTimestep timestep(0.01, 8);
+    CHECK(timestep.advance(0.025) == 2);
+    CHECK_NEAR(timestep.alpha(), 0.5f, 1e-4f);
+    CHECK(timestep.advance(0.005) == 1);
+    CHECK_NEAR(timestep.alpha(), 0.0f, 1e-4f);
+    CHECK(timestep.advance(-1.0) == 0);
+    CHECK(timestep.stepCount() == 3);
+}
+
+TEST(FixedTimestepDropsStepsAboveMax)
+{
+    FixedTimestep timestep(0.01, 4);
+    CHECK(timestep.advance(0.1) == 4);
+    CHECK(timestep.droppedSteps() == 6);
+    // The excess is gone, not carried into the next frame
+    CHECK(timestep.advance(0.0) == 0);
+}
+
+TEST(FixedTimestepMaxStepsIsAtLeastOne)
+{
+    FixedTimestep timestep(0.01, 0);
+    CHECK(timestep.maxSteps() == 1);
+    timestep.setMaxSteps(0);
+    CHECK(timestep.maxSteps() == 1);
+    CHECK(timestep.advance(0.05) == 1);
+}
+
+TEST(FixedTimestepSetStepKeepsFraction)
+{
+    FixedTimestep timestep(0.01, 8);
+    timestep.advance(0.0125);
+    timestep.setStep(0.02);
+    CHECK_NEAR(timestep.alpha(), 0.25f, 1e-4f);
+}
+
+TEST(InterpolateTransformBlendsComponents)
+{
+    const glm::mat4 from = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.0f));
+    const glm::mat4 to = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f)),
+                                                glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+                                    glm::vec3(3.0f));
+    const glm::mat4 half = interpolateTransform(from, to, 0.5f);
+    const glm::mat4 expected = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+                                                      glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+                                          glm::vec3(2.0f));
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            CHECK_NEAR(half[c][r], expected[c][r], 1e-4f);
+        }
+    }
+}
+
+TEST(InterpolateTransformHandlesZeroScale)
+{
+    const glm::mat4 rotated = glm::rotate(glm::mat4(1.0f), glm::radians(60.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    const glm::mat4 collapsed = glm::scale(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 1.0f));
+
+    const glm::mat4 grow = interpolateTransform(collapsed, rotated, 0.5f);
+    CHECK(isFinite(grow));
+    // The collapsed end takes the other end's rotation, so only the scale changes
+    const glm::vec3 axisY = glm::normalize(glm::vec3(grow[1]));
+    CHECK_NEAR(glm::dot(axisY, glm::vec3(rotated[1])), 1.0f, 1e-4f);
+
+    CHECK(isFinite(interpolateTransform(rotated, collapsed, 0.5f)));
+    CHECK(isFinite(interpolateTransform(collapsed, collapsed, 0.5f)));
+}
@@ -0,0 +1,114 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/AllocationCounter.h"
+#include "Core/Components.h"
+#include "Core/DynamicAabbTree.h"
+#include "Core/ECS.h"
+#include "Core/FixedTimestep.h"
+#include "Core/FrameArena.h"
+#include "Core/FrustumCulling.h"
+#include "Core/SceneGraph.h"
+
+using namespace Chopper;
+
+namespace
+{
+    // The CPU side of a frame without the window or the GPU: fixed-step spinning, scene graph
+    // update, bounds and tree refit, culling, and transient data in a frame arena
+    struct FrameLoop
+    {
+        static constexpr uint32_t OBJECTS = 3000;
+
+        World world;
+        SceneGraph graph;
+        BoundingSphereSet bounds;
+        DynamicAabbTree tree;
+        std::vector<uint32_t> proxies;
+        FixedTimestep clock{1.0 / 120.0};
+        FrameArena arena{16 * 1024};
+        FrustumPlanes planes{};
+        MeshBounds mesh{glm::vec3(-0.5f), glm::vec3(0.5f), glm::vec3(0.0f), 0.87f};
+        size_t visible = 0;
+
+        FrameLoop()
+        {
+            bounds.resize(OBJECTS);
+            proxies.resize(OBJECTS);
+            for (uint32_t i = 0; i < OBJECTS; ++i)
+            {
+                // Every tenth object is a parent of the next nine
+                const NodeId parent = i % 10 == 0 ? INVALID_NODE : i - i % 10;
+                const glm::vec3 position(static_cast<float>(i % 60) - 30.0f, static_cast<float>(i / 60 % 10),
+                                         -static_cast<float>(i / 600) * 8.0f);
+                const NodeId node = graph.create(parent, parent == INVALID_NODE ? position : glm::vec3(1.0f, 0, 0));
+                world.create(TransformNode{node}, Spin{glm::vec3(0.0f, 0.5f + 0.001f * i, 0.0f)});
+                proxies[i] = tree.createProxy({position - 1.0f, position + 1.0f}, node);
+            }
+
+            glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+            proj[1][1] *= -1;
+            const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0, 1, 0));
+            planes = extractFrustumPlanes(proj * view);
+        }
+
+        void frame()
+        {
+            arena.reset();
+
+            const uint32_t steps = clock.advance(1.0 / 60.0);
+            for (uint32_t step = 0; step < steps; ++step)
+            {
+                const float dt = static_cast<float>(clock.step());
+                world.eachChunk<TransformNode, Spin>([this, dt](uint32_t count, const Entity*, TransformNode* nodes,
+                                                                Spin* spins)
+                {
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        graph.setRotation(nodes[i].node, graph.rotation(nodes[i].node) + spins[i].rate * dt);
+                    }
+                });
+            }
+            graph.update();
+
+            for (const NodeId node : graph.changed())
+            {
+                const glm::mat4& transform = graph.worldMatrix(node);
+                bounds.set(node, mesh, transform);
+                const glm::vec3 center(transform[3]);
+                tree.moveProxy(proxies[node], {center - 1.0f, center + 1.0f});
+            }
+
+            uint32_t* visibleSlots = arena.allocateArray<uint32_t>(OBJECTS);
+            visible = frustumCullSpheresParallel(bounds, OBJECTS, planes, visibleSlots);
+            size_t treeVisible = 0;
+            tree.queryFrustum(planes, [&treeVisible](uint32_t) { ++treeVisible; });
+            visible += treeVisible;
+        }
+    };
+}
+
+TEST(SteadyFramesDoNotAllocate)
+{
+    if constexpr (!AllocationCounter::enabled())
+    {
+        std::printf("  allocation counting is compiled out in this configuration\n");
+        return;
+    }
+
+    FrameLoop loop;
+    // Containers and the arena grow to their working size in the first frames
+    for (int i = 0; i < 4; ++i) loop.frame();
+
+    const uint64_t before = AllocationCounter::allocations();
+    for (int i = 0; i < 120; ++i) loop.frame();
+    const uint64_t allocations = AllocationCounter::allocations() - before;
+
+    if (allocations != 0) std::printf("  %llu allocations\n", static_cast<unsigned long long>(allocations));
+    CHECK(allocations == 0);
+    CHECK(loop.visible > 0);
+}
@@ -0,0 +1,99 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/FrustumCulling.h"
+
+using namespace Chopper;
+
+namespace
+{
+    // Spheres scattered around the origin, about half of them inside a frustum looking down -Z
+    BoundingSphereSet scatterSpheres(size_t count)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> radius(0.1f, 3.0f);
+
+        BoundingSphereSet spheres;
+        spheres.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            spheres.set(i, glm::vec3(position(random), position(random), position(random)), radius(random));
+        }
+        // A few cleared slots, which never pass
+        for (size_t i = 0; i < count; i += 97) spheres.clear(i);
+        return spheres;
+    }
+
+    FrustumPlanes testFrustum()
+    {
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 proj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        return extractFrustumPlanes(proj * view);
+    }
+}
+
+TEST(FrustumCullParallelMatchesSerial)
+{
+    // Enough batches that the workers take some of them, the last one partial
+    const size_t count = 1000000;
+    const BoundingSphereSet spheres = scatterSpheres(count);
+    const FrustumPlanes planes = testFrustum();
+
+    std::vector<uint32_t> serial(count);
+    std::vector<uint32_t> parallel(count);
+    const size_t serialCount = frustumCullSpheres(spheres, count, planes, serial.data());
+    const size_t parallelCount = frustumCullSpheresParallel(spheres, count, planes, parallel.data());
+
+    CHECK(serialCount > 0);
+    CHECK(serialCount < count);
+    CHECK(parallelCount == serialCount);
+    serial.resize(serialCount);
+    parallel.resize(parallelCount);
+    CHECK(parallel == serial);
+}
+
+TEST(FrustumCullParallelRepeatsWithFewerBatches)
+{
+    // The scratch reused between calls must follow the batch count down
+    const FrustumPlanes planes = testFrustum();
+    for (const size_t count : {100000u, 40000u, 70000u})
+    {
+        const BoundingSphereSet spheres = scatterSpheres(count);
+        std::vector<uint32_t> serial(count);
+        std::vector<uint32_t> parallel(count);
+        const size_t serialCount = frustumCullSpheres(spheres, count, planes, serial.data());
+        const size_t parallelCount = frustumCullSpheresParallel(spheres, count, planes, parallel.data());
+
+        CHECK(parallelCount == serialCount);
+        CHECK(std::equal(serial.begin(), serial.begin() + serialCount, parallel.begin()));
+    }
+}
+
+TEST(FrustumCullAgreesWithScalarReference)
+{
+    const size_t count = 5000;
+    const BoundingSphereSet spheres = scatterSpheres(count);
+    const FrustumPlanes planes = testFrustum();
+
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const glm::vec3 center(spheres.x()[i], spheres.y()[i], spheres.z()[i]);
+        bool inside = true;
+        for (const glm::vec4& plane : planes)
+        {
+            inside = inside && glm::dot(glm::vec3(plane), center) + plane.w >= -spheres.radius()[i];
+        }
+        if (inside) expected.push_back(i);
+    }
+
+    std::vector<uint32_t> visible(count);
+    visible.resize(frustumCullSpheres(spheres, count, planes, visible.data()));
+    CHECK(visible == expected);
+}
@@ -0,0 +1,45 @@
+#include "Test.h"
+
+#include <atomic>
+#include <stdexcept>
+
+#include "Core/JobSystem.h"
+
+using namespace Chopper;
+
+TEST(JobExceptionReachesWait)
+{
+    JobSystem& jobs = JobSystem::instance();
+    JobCounter counter;
+    std::atomic<int> ran{0};
+    jobs.run([] { throw std::runtime_error("expected"); }, &counter);
+    jobs.run([&ran] { ran.fetch_add(1); }, &counter);
+
+    bool caught = false;
+    try
+    {
+        jobs.wait(counter);
+    }
+    catch (const std::runtime_error&)
+    {
+        caught = true;
+    }
+    CHECK(caught);
+    CHECK(ran.load() == 1);
+}
+
+TEST(DetachedJobExceptionIsReported)
+{
+    JobSystem& jobs = JobSystem::instance();
+    const uint64_t before = jobs.detachedExceptions();
+    jobs.run([] { throw std::runtime_error("expected, reported on stderr"); });
+
+    // Keep the system busy until some thread has run the throwing job
+    for (int i = 0; i < 100000 && jobs.detachedExceptions() == before; ++i)
+    {
+        JobCounter counter;
+        jobs.run([] {}, &counter);
+        jobs.wait(counter);
+    }
+    CHECK(jobs.detachedExceptions() == before + 1);
+}
@@ -0,0 +1,105 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Core/OffsetAllocator.h"
+
+using namespace Chopper;
+
+namespace
+{
+    struct Range
+    {
+        OffsetAllocator::Allocation allocation;
+        uint32_t size = 0;
+    };
+
+    bool overlaps(const Range& a, const Range& b)
+    {
+        return a.allocation.offset < b.allocation.offset + b.size && b.allocation.offset < a.allocation.offset + a.size;
+    }
+}
+
+TEST(OffsetAllocatorSplitsAndMerges)
+{
+    OffsetAllocator allocator(1000, 16);
+    const OffsetAllocator::Allocation a = allocator.allocate(100);
+    const OffsetAllocator::Allocation b = allocator.allocate(200);
+    const OffsetAllocator::Allocation c = allocator.allocate(300);
+    CHECK(a.valid() && b.valid() && c.valid());
+    CHECK(allocator.allocationSize(b) == 200);
+    CHECK(allocator.liveAllocations() == 3);
+    CHECK(allocator.storageReport().freeUnits == 400);
+
+    // Freeing the middle, then its neighbours, leaves one free range again
+    allocator.free(b);
+    CHECK(allocator.storageReport().freeUnits == 600);
+    allocator.free(a);
+    allocator.free(c);
+    const OffsetAllocator::StorageReport report = allocator.storageReport();
+    CHECK(report.freeUnits == 1000);
+    CHECK(report.largestFree == 1000);
+    CHECK(report.freeRanges == 1);
+    CHECK(allocator.allocate(1000).valid());
+}
+
+TEST(OffsetAllocatorFailsWhenFull)
+{
+    OffsetAllocator allocator(256, 2);
+    CHECK(!allocator.allocate(257).valid());
+    const OffsetAllocator::Allocation a = allocator.allocate(16);
+    const OffsetAllocator::Allocation b = allocator.allocate(16);
+    CHECK(a.valid() && b.valid());
+    // maxAllocations bounds the live allocations
+    CHECK(!allocator.allocate(16).valid());
+    allocator.free(a);
+    CHECK(allocator.allocate(16).valid());
+}
+
+TEST(OffsetAllocatorRandomOperationsStayDisjoint)
+{
+    constexpr uint32_t SIZE = 1 << 20;
+    OffsetAllocator allocator(SIZE, 4096);
+    std::vector<Range> live;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<uint32_t> sizes(1, 4000);
+
+    uint32_t liveUnits = 0;
+    for (int i = 0; i < 20000; ++i)
+    {
+        if (!live.empty() && (random() % 3 == 0 || live.size() == 4096))
+        {
+            const size_t index = random() % live.size();
+            allocator.free(live[index].allocation);
+            liveUnits -= live[index].size;
+            live[index] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        const uint32_t size = sizes(random);
+        const OffsetAllocator::Allocation allocation = allocator.allocate(size);
+        if (!allocation.valid()) continue;
+        CHECK(allocation.offset + size <= SIZE);
+        CHECK(allocator.allocationSize(allocation) >= size);
+        live.push_back({allocation, allocator.allocationSize(allocation)});
+        liveUnits += live.back().size;
+    }
+
+    CHECK(allocator.liveAllocations() == live.size());
+    CHECK(allocator.storageReport().freeUnits == SIZE - liveUnits);
+    std::sort(live.begin(), live.end(), [](const Range& a, const Range& b)
+    {
+        return a.allocation.offset < b.allocation.offset;
+    });
+    for (size_t i = 1; i < live.size(); ++i)
+    {
+        CHECK(!overlaps(live[i - 1], live[i]));
+    }
+
+    for (const Range& range : live) allocator.free(range.allocation);
+    CHECK(allocator.storageReport().freeRanges == 1);
+    CHECK(allocator.storageReport().freeUnits == SIZE);
+}
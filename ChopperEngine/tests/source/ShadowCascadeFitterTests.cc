@@ -0,0 +1,158 @@
+#include "Test.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/ShadowCascadeFitter.h"
+
+using namespace Chopper;
+
+namespace
+{
+    constexpr float NEAR_PLANE = 0.1f;
+    constexpr float SHADOW_DISTANCE = 80.0f;
+
+    glm::mat4 testProjection(float nearPlane)
+    {
+        glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, nearPlane, 500.0f);
+        proj[1][1] *= -1;
+        return proj;
+    }
+
+    glm::mat4 testView(const glm::vec3& eye)
+    {
+        return glm::lookAt(eye, eye + glm::vec3(0.6f, -0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    const glm::vec3 TO_SUN = glm::normalize(glm::vec3(0.3f, 1.0f, 0.4f));
+
+    // Whether the world-space corners of the camera's frustum between `nearDistance` and `farDistance`
+    // all land inside `viewProj`'s box
+    bool holdsSlice(const glm::mat4& viewProj, const glm::mat4& view, const glm::mat4& proj, float nearDistance,
+                    float farDistance)
+    {
+        const glm::mat4 cameraToWorld = glm::inverse(view);
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            const float distance = (i & 4) != 0 ? farDistance : nearDistance;
+            const glm::vec3 corner((i & 1) != 0 ? distance / proj[0][0] : -distance / proj[0][0],
+                                   (i & 2) != 0 ? distance / proj[1][1] : -distance / proj[1][1], -distance);
+            const glm::vec4 clip = viewProj * cameraToWorld * glm::vec4(corner, 1.0f);
+            const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            if (std::abs(ndc.x) > 1.0f || std::abs(ndc.y) > 1.0f || ndc.z < 0.0f || ndc.z > 1.0f) return false;
+        }
+        return true;
+    }
+
+    bool anyRedraw(const std::array<ShadowCascade, SHADOW_CASCADES>& cascades)
+    {
+        for (const ShadowCascade& cascade : cascades)
+        {
+            if (cascade.redrawStatic) return true;
+        }
+        return false;
+    }
+}
+
+TEST(ShadowCascadesSplitUpToTheShadowDistance)
+{
+    ShadowCascadeFitter fitter;
+    std::array<ShadowCascade, SHADOW_CASCADES> cascades{};
+    fitter.fit(testView(glm::vec3(0.0f)), testProjection(NEAR_PLANE), NEAR_PLANE, TO_SUN, SHADOW_DISTANCE, 0,
+               cascades);
+
+    float previous = NEAR_PLANE;
+    for (const ShadowCascade& cascade : cascades)
+    {
+        CHECK(cascade.splitFar > previous);
+        CHECK(cascade.texelSize > 0.0f);
+        previous = cascade.splitFar;
+    }
+    CHECK_NEAR(cascades[SHADOW_CASCADES - 1].splitFar, SHADOW_DISTANCE, 1e-3f);
+    // Mostly logarithmic: the first cascade covers far less than a uniform quarter
+    CHECK(cascades[0].splitFar < 0.25f * SHADOW_DISTANCE);
+    // Finer texels close to the camera
+    CHECK(cascades[0].texelSize < cascades[SHADOW_CASCADES - 1].texelSize);
+}
+
+TEST(ShadowCascadesHoldTheirSlices)
+{
+    // Another near plane moves every split; each cascade still holds its slice
+    for (const float nearPlane : {NEAR_PLANE, 0.5f})
+    {
+        const glm::mat4 view = testView(glm::vec3(3.0f, 2.0f, -7.0f));
+        const glm::mat4 proj = testProjection(nearPlane);
+        ShadowCascadeFitter fitter;
+        std::array<ShadowCascade, SHADOW_CASCADES> cascades{};
+        fitter.fit(view, proj, nearPlane, TO_SUN, SHADOW_DISTANCE, 0, cascades);
+
+        float splitNear = nearPlane;
+        for (const ShadowCascade& cascade : cascades)
+        {
+            CHECK(holdsSlice(cascade.viewProj, view, proj, splitNear, cascade.splitFar));
+            splitNear = cascade.splitFar;
+        }
+    }
+}
+
+TEST(ShadowCascadesFollowTheNearPlane)
+{
+    const glm::mat4 view = testView(glm::vec3(0.0f));
+    ShadowCascadeFitter nearFitter;
+    ShadowCascadeFitter farFitter;
+    std::array<ShadowCascade, SHADOW_CASCADES> nearCascades{};
+    std::array<ShadowCascade, SHADOW_CASCADES> farCascades{};
+    nearFitter.fit(view, testProjection(0.1f), 0.1f, TO_SUN, SHADOW_DISTANCE, 0, nearCascades);
+    farFitter.fit(view, testProjection(1.0f), 1.0f, TO_SUN, SHADOW_DISTANCE, 0, farCascades);
+    CHECK(farCascades[0].splitFar > nearCascades[0].splitFar);
+}
+
+TEST(ShadowCascadesRedrawOnlyWhenTheirPageChanges)
+{
+    const glm::mat4 proj = testProjection(NEAR_PLANE);
+    ShadowCascadeFitter fitter;
+    std::array<ShadowCascade, SHADOW_CASCADES> cascades{};
+
+    fitter.fit(testView(glm::vec3(0.0f)), proj, NEAR_PLANE, TO_SUN, SHADOW_DISTANCE, 1, cascades);
+    for (const ShadowCascade& cascade : cascades) CHECK(cascade.redrawStatic);
+
+    fitter.fit(testView(glm::vec3(0.0f)), proj, NEAR_PLANE, TO_SUN, SHADOW_DISTANCE, 1, cascades);
+    CHECK(!anyRedraw(cascades));
+
+    // Moving far less than a scroll step
+    fitter.fit(testView(glm::vec3(0.002f, 0.0f, 0.001f)), proj, NEAR_PLANE, TO_SUN, SHADOW_DISTANCE, 1, cascades);
+    CHECK(!anyRedraw(cascades));
+
+    fitter.fit(testView(glm::vec3(0.0f)), proj, NEAR_PLANE, TO_SUN, SHADOW_DISTANCE, 2, cascades);
+    for (const ShadowCascade& cascade : cascades) CHECK(cascade.redrawStatic);
+
+    fitter.fit(testView(glm::vec3(0.0f)), proj, NEAR_PLANE, glm::normalize(TO_SUN + glm::vec3(0.1f, 0.0f, 0.0f)),
+               SHADOW_DISTANCE, 2, cascades);
+    for (const ShadowCascade& cascade : cascades) CHECK(cascade.redrawStatic);
+
+    // Across the whole shadow distance every cascade has to scroll
+    fitter.fit(testView(glm::vec3(200.0f, 0.0f, 0.0f)), proj, NEAR_PLANE, TO_SUN, SHADOW_DISTANCE, 2, cascades);
+    for (const ShadowCascade& cascade : cascades) CHECK(cascade.redrawStatic);
+}
+
+TEST(ShadowCascadesScrollInWholeSteps)
+{
+    // Walking slowly, the first cascade scrolls only every so often, and never shimmers in between
+    const glm::mat4 proj = testProjection(NEAR_PLANE);
+    ShadowCascadeFitter fitter;
+    std::array<ShadowCascade, SHADOW_CASCADES> cascades{};
+    fitter.fit(testView(glm::vec3(0.0f)), proj, NEAR_PLANE, TO_SUN, SHADOW_DISTANCE, 0, cascades);
+    glm::mat4 previous = cascades[0].viewProj;
+
+    int redraws = 0;
+    const int frames = 1000;
+    for (int frame = 1; frame <= frames; ++frame)
+    {
+        fitter.fit(testView(glm::vec3(0.01f * frame, 0.0f, 0.0f)), proj, NEAR_PLANE, TO_SUN, SHADOW_DISTANCE, 0,
+                   cascades);
+        if (cascades[0].redrawStatic) ++redraws;
+        else CHECK(cascades[0].viewProj == previous);
+        previous = cascades[0].viewProj;
+    }
+    CHECK(redraws > 0);
+    CHECK(redraws < frames / 20);
+}
@@ -0,0 +1,91 @@
+#include "Test.h"
+
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/StaticBatcher.h"
+
+using namespace Chopper;
+
+namespace
+{
+    // One counter-clockwise triangle in the XY plane
+    const std::vector<Vertex> TRIANGLE_VERTICES = {
+        {glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f), glm::vec2(0.0f)},
+        {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(1.0f), glm::vec2(0.0f)},
+        {glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f), glm::vec2(0.0f)}
+    };
+    const std::vector<uint32_t> TRIANGLE_INDICES = {0, 1, 2};
+
+    StaticInstance triangleAt(const glm::vec3& position, uint32_t material)
+    {
+        return {material, TRIANGLE_VERTICES, TRIANGLE_INDICES, glm::vec3(0.0f),
+                glm::translate(glm::mat4(1.0f), position)};
+    }
+
+    glm::vec3 faceNormal(const StaticBatch& batch, size_t triangle)
+    {
+        const glm::vec3 a = batch.vertices[batch.indices[triangle * 3 + 0]].pos;
+        const glm::vec3 b = batch.vertices[batch.indices[triangle * 3 + 1]].pos;
+        const glm::vec3 c = batch.vertices[batch.indices[triangle * 3 + 2]].pos;
+        return glm::cross(b - a, c - a);
+    }
+}
+
+TEST(StaticBatchesGroupByMaterialAndCell)
+{
+    const std::vector<StaticInstance> instances = {
+        triangleAt(glm::vec3(1.0f, 0.0f, 1.0f), 0),
+        triangleAt(glm::vec3(2.0f, 0.0f, 3.0f), 0),
+        triangleAt(glm::vec3(2.0f, 0.0f, 3.0f), 1),
+        triangleAt(glm::vec3(12.0f, 0.0f, 1.0f), 0)
+    };
+    const std::vector<StaticBatch> batches = buildStaticBatches(instances, 8.0f, 1024);
+
+    CHECK(batches.size() == 3);
+    uint32_t merged = 0;
+    for (const StaticBatch& batch : batches)
+    {
+        merged += batch.instanceCount;
+        CHECK(batch.vertices.size() == batch.instanceCount * 3);
+        CHECK(batch.indices.size() == batch.instanceCount * 3);
+    }
+    CHECK(merged == instances.size());
+
+    // Coarser cells merge the two material-0 groups
+    CHECK(buildStaticBatches(instances, 32.0f, 1024).size() == 2);
+}
+
+TEST(StaticBatchesAreInWorldSpace)
+{
+    const std::vector<StaticInstance> instances = {triangleAt(glm::vec3(4.0f, 5.0f, 6.0f), 0)};
+    const std::vector<StaticBatch> batches = buildStaticBatches(instances, 16.0f, 1024);
+
+    CHECK(batches.size() == 1);
+    CHECK(batches[0].vertices[1].pos == glm::vec3(5.0f, 5.0f, 6.0f));
+    CHECK(batches[0].bounds.min == glm::vec3(4.0f, 5.0f, 6.0f));
+    CHECK(batches[0].bounds.max == glm::vec3(5.0f, 6.0f, 6.0f));
+}
+
+TEST(StaticBatchesSplitAboveMaxVertices)
+{
+    std::vector<StaticInstance> instances;
+    for (int i = 0; i < 10; ++i) instances.push_back(triangleAt(glm::vec3(0.1f * i, 0.0f, 0.0f), 0));
+    const std::vector<StaticBatch> batches = buildStaticBatches(instances, 16.0f, 9);
+
+    // Three triangles per batch; an instance is never split
+    CHECK(batches.size() == 4);
+    for (const StaticBatch& batch : batches) CHECK(batch.vertices.size() <= 9);
+}
+
+TEST(StaticBatchesKeepWindingUnderMirroring)
+{
+    StaticInstance mirrored = triangleAt(glm::vec3(0.0f), 0);
+    mirrored.world = glm::scale(glm::mat4(1.0f), glm::vec3(-1.0f, 1.0f, 1.0f));
+    const std::vector<StaticBatch> batches = buildStaticBatches(std::vector<StaticInstance>{mirrored}, 16.0f, 1024);
+
+    // The original faces +Z; mirrored in X, with the corners swapped back, it still does
+    CHECK(batches.size() == 1);
+    CHECK(faceNormal(batches[0], 0).z > 0.0f);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cmath>
+
+// Minimal test harness: TEST registers a function run by main(), CHECK records a failure and
+// carries on. The executable returns non-zero when any check failed or a test threw.
+
+namespace Chopper::Test
+{
+    using TestFunction = void (*)();
+
+    struct Registrar
+    {
+        Registrar(const char* name, TestFunction function);
+    };
+
+    void fail(const char* file, int line, const char* expression);
+}
+
+#define TEST(name) \
+    static void name(); \
+    static const ::Chopper::Test::Registrar name##Registrar(#name, &name); \
+    static void name()
+
+#define CHECK(expression) \
+    do \
+    { \
+        if (!(expression)) ::Chopper::Test::fail(__FILE__, __LINE__, #expression); \
+    } while (false)
+
+#define CHECK_NEAR(a, b, epsilon) CHECK(std::fabs((a) - (b)) <= (epsilon))
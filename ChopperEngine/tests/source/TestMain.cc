@@ -0,0 +1,68 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <vector>
+
+#include "Core/JobSystem.h"
+
+namespace Chopper::Test
+{
+    namespace
+    {
+        struct Registered
+        {
+            const char* name;
+            TestFunction function;
+        };
+
+        std::vector<Registered>& registry()
+        {
+            static std::vector<Registered> tests;
+            return tests;
+        }
+
+        int failures = 0;
+    }
+
+    Registrar::Registrar(const char* name, TestFunction function)
+    {
+        registry().push_back({name, function});
+    }
+
+    void fail(const char* file, int line, const char* expression)
+    {
+        std::printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+        ++failures;
+    }
+}
+
+int main()
+{
+    using namespace Chopper::Test;
+
+    // Parallel code paths need workers even on a single-core machine
+    Chopper::JobSystem::setInstanceThreadCount(4);
+
+    int failedTests = 0;
+    for (const Registered& test : registry())
+    {
+        const int failuresBefore = failures;
+        try
+        {
+            test.function();
+        }
+        catch (const std::exception& e)
+        {
+            std::printf("  threw: %s\n", e.what());
+            ++failures;
+        }
+        const bool passed = failures == failuresBefore;
+        std::printf("[%s] %s\n", passed ? "PASS" : "FAIL", test.name);
+        if (!passed) ++failedTests;
+    }
+
+    std::printf("%zu tests, %d failed\n", registry().size(), failedTests);
+    return failedTests == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}